@@ -178,7 +178,7 @@ CCutsceneMgr::LoadCutsceneData(const char *szCutsceneName)
 		ms_useLodMultiplier = true;
 	CTimer::Stop();
 
-	ms_pCutsceneDir->numEntries = 0;
+	ms_pCutsceneDir->Clear();
 	ms_pCutsceneDir->ReadDirFile("ANIM\\CUTS.DIR");
 
 	CStreaming::RemoveUnusedModelsInLoadedList();
@@ -6,6 +6,9 @@
 #include "AnimBlendAssociation.h"
 #include "RpAnimBlend.h"
 
+#ifdef PARALLEL_WORLD_PROCESS
+thread_local	// frames of different clumps are updated concurrently
+#endif
 CAnimBlendClumpData *gpAnimBlendClump;
 
 // PS2 names without "NonSkinned"
@@ -466,3 +466,107 @@ RpAnimBlendClumpUpdateAnimations(RpClump *clump, float timeDelta)
 	}
 	RwFrameUpdateObjects(RpClumpGetFrame(clump));
 }
+
+#ifdef PARALLEL_WORLD_PROCESS
+// RpAnimBlendClumpUpdateAnimations split into three steps so the frame update
+// of many clumps can run on worker threads. Blends and times have to be updated
+// on the main thread because associations can call back into game code there.
+
+// Whether updating the clump by timeDelta won't delete an association or call
+// back into game code, going through the same sums as the update itself
+bool
+RpAnimBlendClumpCanUpdateWithoutCallbacks(RpClump *clump, float timeDelta)
+{
+	CAnimBlendLink *link;
+	CAnimBlendAssociation *assoc;
+	float blend, timeStep;
+	float totalLength = 0.0f;
+	float totalBlend = 0.0f;
+	CAnimBlendClumpData *clumpData = *RPANIMBLENDCLUMPDATA(clump);
+
+	for(link = clumpData->link.next; link; link = link->next){
+		assoc = CAnimBlendAssociation::FromLink(link);
+		blend = assoc->blendAmount + assoc->blendDelta * timeDelta;
+		if(blend <= 0.0f && assoc->blendDelta < 0.0f){
+			if(assoc->flags & ASSOC_DELETEFADEDOUT)
+				return false;
+			blend = 0.0f;
+		}
+		if(blend > 1.0f)
+			blend = 1.0f;
+		if(assoc->flags & ASSOC_MOVEMENT){
+			totalLength += assoc->hierarchy->totalLength/assoc->speed * blend;
+			totalBlend += blend;
+		}
+	}
+
+	for(link = clumpData->link.next; link; link = link->next){
+		assoc = CAnimBlendAssociation::FromLink(link);
+		if(!assoc->IsRunning() || assoc->IsRepeating())
+			continue;
+		float relSpeed = totalLength == 0.0f ? 1.0f : totalBlend/totalLength;
+		timeStep = (assoc->flags & ASSOC_MOVEMENT ? relSpeed*assoc->hierarchy->totalLength : assoc->speed) * timeDelta;
+		if(assoc->currentTime + timeStep >= assoc->hierarchy->totalLength)
+			return false;
+	}
+	return true;
+}
+
+void
+RpAnimBlendClumpUpdateBlends(RpClump *clump, float timeDelta)
+{
+	CAnimBlendLink *link, *next;
+	CAnimBlendClumpData *clumpData = *RPANIMBLENDCLUMPDATA(clump);
+
+	for(link = clumpData->link.next; link; link = next){
+		next = link->next;
+		CAnimBlendAssociation::FromLink(link)->UpdateBlend(timeDelta);
+	}
+}
+
+// only touches the clump's own frames, returns relative speed for RpAnimBlendClumpUpdateTimes
+float
+RpAnimBlendClumpUpdateFrames(RpClump *clump)
+{
+	int i;
+	AnimBlendFrameUpdateData updateData;
+	float totalLength = 0.0f;
+	float totalBlend = 0.0f;
+	CAnimBlendLink *link;
+	CAnimBlendClumpData *clumpData = *RPANIMBLENDCLUMPDATA(clump);
+	gpAnimBlendClump = clumpData;
+
+	i = 0;
+	updateData.foobar = 0;
+	for(link = clumpData->link.next; link; link = link->next){
+		CAnimBlendAssociation *assoc = CAnimBlendAssociation::FromLink(link);
+		updateData.nodes[i++] = assoc->GetNode(0);
+		if(assoc->flags & ASSOC_MOVEMENT){
+			totalLength += assoc->hierarchy->totalLength/assoc->speed * assoc->blendAmount;
+			totalBlend += assoc->blendAmount;
+		}else
+			updateData.foobar = 1;
+	}
+	updateData.nodes[i] = nil;
+
+#ifdef PED_SKIN
+	if(IsClumpSkinned(clump))
+		clumpData->ForAllFrames(FrameUpdateCallBackSkinned, &updateData);
+	else
+#endif
+		clumpData->ForAllFrames(FrameUpdateCallBackNonSkinned, &updateData);
+
+	return totalLength == 0.0f ? 1.0f : totalBlend/totalLength;
+}
+
+void
+RpAnimBlendClumpUpdateTimes(RpClump *clump, float timeDelta, float relSpeed)
+{
+	CAnimBlendLink *link;
+	CAnimBlendClumpData *clumpData = *RPANIMBLENDCLUMPDATA(clump);
+
+	for(link = clumpData->link.next; link; link = link->next)
+		CAnimBlendAssociation::FromLink(link)->UpdateTime(timeDelta, relSpeed);
+	RwFrameUpdateObjects(RpClumpGetFrame(clump));
+}
+#endif
@@ -35,8 +35,18 @@ CAnimBlendAssociation *RpAnimBlendClumpGetMainPartialAssociation_N(RpClump *clum
 CAnimBlendAssociation *RpAnimBlendClumpGetFirstAssociation(RpClump *clump, uint32 mask);
 CAnimBlendAssociation *RpAnimBlendClumpGetFirstAssociation(RpClump *clump);
 void RpAnimBlendClumpUpdateAnimations(RpClump* clump, float timeDelta);
+#ifdef PARALLEL_WORLD_PROCESS
+bool RpAnimBlendClumpCanUpdateWithoutCallbacks(RpClump *clump, float timeDelta);
+void RpAnimBlendClumpUpdateBlends(RpClump *clump, float timeDelta);
+float RpAnimBlendClumpUpdateFrames(RpClump *clump);
+void RpAnimBlendClumpUpdateTimes(RpClump *clump, float timeDelta, float relSpeed);
+#endif
 
 
+#ifdef PARALLEL_WORLD_PROCESS
+extern thread_local CAnimBlendClumpData *gpAnimBlendClump;
+#else
 extern CAnimBlendClumpData *gpAnimBlendClump;
+#endif
 void FrameUpdateCallBackNonSkinned(AnimBlendFrameData *frame, void *arg);
 void FrameUpdateCallBackSkinned(AnimBlendFrameData *frame, void *arg);
@@ -643,6 +643,22 @@ cAudioManager::UpdateReflections()
 	CColPoint colpoint;
 	CEntity *ent;
 
+#ifdef LINE_OF_SIGHT_BATCHES
+	// still one horizontal ray a frame on frames 0, 7, 6 and 5, so the cost stays flat
+	static const CVector reflectionOffsets[4] = {
+		CVector(0.0f, 50.0f, 0.0f), CVector(0.0f, -50.0f, 0.0f), CVector(-50.0f, 0.0f, 0.0f), CVector(50.0f, 0.0f, 0.0f)
+	};
+	int32 ray = (8 - m_FrameCounter % 8) % 8;
+	if (ray < 4) {
+		CColLine line;
+		m_avecReflectionsPos[ray] = camPos + reflectionOffsets[ray];
+		line.Set(camPos, m_avecReflectionsPos[ray]);
+		if (CWorld::ProcessLineOfSightBatch(1, &line, &colpoint, &ent, true, false, false, true, false, true, true))
+			m_afReflectionsDistances[ray] = Distance(camPos, colpoint.point);
+		else
+			m_afReflectionsDistances[ray] = 50.0f;
+	} else if ((m_FrameCounter + 4) % 8 == 0) {
+#else
 	if (m_FrameCounter % 8 == 0) {
 		m_avecReflectionsPos[0] = camPos;
 		m_avecReflectionsPos[0].y += 50.f;
@@ -672,6 +688,7 @@ cAudioManager::UpdateReflections()
 		else
 			m_afReflectionsDistances[3] = 50.0f;
 	} else if ((m_FrameCounter + 4) % 8 == 0) {
+#endif
 		m_avecReflectionsPos[4] = camPos;
 		m_avecReflectionsPos[4].z += 50.0f;
 		if (CWorld::ProcessVerticalLine(camPos, m_avecReflectionsPos[4].z, colpoint, ent, true, false, false, false, true, false, nil))
@@ -5,6 +5,7 @@
 #include "ModelIndices.h"
 #include "PathFind.h"
 #include "Stats.h"
+#include "World.h"
 
 CEntity *CBridge::pLiftRoad;
 CEntity *CBridge::pLiftPart;
@@ -105,6 +106,12 @@ void CBridge::Update()
 		pWeight->GetMatrix().GetPosition().z = DefaultZLiftWeight - liftHeight;
 		pWeight->GetMatrix().UpdateRW();
 		pWeight->UpdateRwFrame();
+#ifdef PACKED_SECTOR_LISTS
+		CWorld::UpdateSectorArrayBounds(pLiftPart);
+		if (pLiftRoad)
+			CWorld::UpdateSectorArrayBounds(pLiftRoad);
+		CWorld::UpdateSectorArrayBounds(pWeight);
+#endif
 
 		OldLift = liftHeight;
 	}
@@ -340,7 +340,10 @@ CPathFind::CalcNodeCoors(int16 x, int16 y, int16 z, int id, CVector *out)
 bool
 CPathFind::LoadPathFindData(void)
 {
+#ifndef PARALLEL_INIT
+	// runs on an init thread there and loads nothing anyway
 	CFileMgr::SetDir("");
+#endif
 	return false;
 }
 
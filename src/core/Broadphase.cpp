@@ -0,0 +1,273 @@
+#include "common.h"
+
+#include "Object.h"
+#include "Ped.h"
+#include "Pools.h"
+#include "Timer.h"
+#include "Vehicle.h"
+#include "World.h"
+#include "Broadphase.h"
+
+// room for the bound centre swinging around and the passes pushing things a bit further
+#define BROADPHASE_MARGIN (0.25f)
+#define MAX_BROADPHASE_PROXIES (NUMOBJECTS + NUMVEHICLES + NUMPEDS)
+
+enum
+{
+	BROADPHASE_OBJECTS,
+	BROADPHASE_VEHICLES,
+	BROADPHASE_PEDS,
+	NUM_BROADPHASE_TYPES
+};
+
+struct tBroadphaseProxy
+{
+	CPhysical *entity;	// only valid after Update
+	CVector centre;
+	float radius;	// bound radius grown by how far the entity can get this frame
+	float minX, maxX;
+	int16 type;
+	int16 slot;
+	bool bMoving;
+	int32 firstCandidate;
+	int16 numCandidates[NUM_BROADPHASE_TYPES];
+};
+
+bool CBroadphase::ms_bValid;
+bool CBroadphase::bUseBroadphase = true;
+int32 CBroadphase::ms_nNumProxies;
+int32 CBroadphase::ms_nNumPairs;
+
+// stays sorted on minX from one frame to the next, so the insertion sort has little to do
+static tBroadphaseProxy aProxies[MAX_BROADPHASE_PROXIES];
+static int16 aObjectProxies[NUMOBJECTS];
+static int16 aVehicleProxies[NUMVEHICLES];
+static int16 aPedProxies[NUMPEDS];
+static int16 *apProxyOfSlot[NUM_BROADPHASE_TYPES] = { aObjectProxies, aVehicleProxies, aPedProxies };
+static const int32 aPoolSizes[NUM_BROADPHASE_TYPES] = { NUMOBJECTS, NUMVEHICLES, NUMPEDS };
+
+static int16 (*aPairs)[2];
+static int32 numPairsAllocated;
+static CSectorArrayEntry *aCandidates;
+static int32 numCandidatesAllocated;
+static int32 numCandidatesInUse;
+
+static CPhysical*
+GetProxyEntity(int32 type, int32 slot)
+{
+	switch(type){
+	case BROADPHASE_OBJECTS: return CPools::GetObjectPool()->GetSlot(slot);
+	case BROADPHASE_VEHICLES: return CPools::GetVehiclePool()->GetSlot(slot);
+	default: return CPools::GetPedPool()->GetSlot(slot);
+	}
+}
+
+static int32
+GetProxyIndex(CEntity *ent)
+{
+	int32 type, slot;
+	switch(ent->GetType()){
+	case ENTITY_TYPE_OBJECT:
+		type = BROADPHASE_OBJECTS;
+		slot = CPools::GetObjectPool()->GetJustIndex((CObject*)ent);
+		break;
+	case ENTITY_TYPE_VEHICLE:
+		type = BROADPHASE_VEHICLES;
+		slot = CPools::GetVehiclePool()->GetJustIndex((CVehicle*)ent);
+		break;
+	case ENTITY_TYPE_PED:
+		type = BROADPHASE_PEDS;
+		slot = CPools::GetPedPool()->GetJustIndex((CPed*)ent);
+		break;
+	default:
+		return -1;
+	}
+	if(slot < 0 || slot >= aPoolSizes[type])
+		return -1;
+	int32 i = apProxyOfSlot[type][slot];
+	return i >= 0 && aProxies[i].entity == ent ? i : -1;
+}
+
+static bool
+ProxiesOverlap(const tBroadphaseProxy &a, const tBroadphaseProxy &b)
+{
+	return (a.centre - b.centre).MagnitudeSqr() <= SQR(a.radius + b.radius);
+}
+
+static void
+AddPair(int32 a, int32 b)
+{
+	if(CBroadphase::ms_nNumPairs == numPairsAllocated){
+		numPairsAllocated = numPairsAllocated == 0 ? 256 : numPairsAllocated * 2;
+		aPairs = (int16(*)[2])realloc(aPairs, numPairsAllocated * sizeof(aPairs[0]));
+		assert(aPairs);
+	}
+	aPairs[CBroadphase::ms_nNumPairs][0] = a;
+	aPairs[CBroadphase::ms_nNumPairs][1] = b;
+	CBroadphase::ms_nNumPairs++;
+}
+
+void
+CBroadphase::Update(void)
+{
+	int32 i, j, type, slot;
+
+	ms_bValid = false;
+	ms_nNumPairs = 0;
+	if(!bUseBroadphase)
+		return;
+
+	// keep the entities that are still in the world in their old order and add the new ones
+	for(type = 0; type < NUM_BROADPHASE_TYPES; type++)
+		for(slot = 0; slot < aPoolSizes[type]; slot++)
+			apProxyOfSlot[type][slot] = -1;
+	int32 n = 0;
+	for(i = 0; i < ms_nNumProxies; i++){
+		CPhysical *e = GetProxyEntity(aProxies[i].type, aProxies[i].slot);
+		if(e == nil || e->m_entryInfoList.first == nil)
+			continue;
+		aProxies[n] = aProxies[i];
+		apProxyOfSlot[aProxies[n].type][aProxies[n].slot] = n;
+		n++;
+	}
+	for(type = 0; type < NUM_BROADPHASE_TYPES; type++)
+		for(slot = 0; slot < aPoolSizes[type]; slot++){
+			if(apProxyOfSlot[type][slot] >= 0)
+				continue;
+			CPhysical *e = GetProxyEntity(type, slot);
+			if(e == nil || e->m_entryInfoList.first == nil)
+				continue;
+			aProxies[n].type = type;
+			aProxies[n].slot = slot;
+			apProxyOfSlot[type][slot] = n;
+			n++;
+		}
+	ms_nNumProxies = n;
+
+	// collisions pass speed on, so anything could get as far as the fastest entity this frame
+	float maxSpeed = 0.0f;
+	for(i = 0; i < n; i++){
+		tBroadphaseProxy &p = aProxies[i];
+		p.entity = GetProxyEntity(p.type, p.slot);
+		p.bMoving = p.entity->m_movingListNode != nil;
+		if(p.bMoving)
+			maxSpeed = Max(maxSpeed, p.entity->m_vecMoveSpeed.Magnitude());
+	}
+	float timeStep = CTimer::GetTimeStep();
+	for(i = 0; i < n; i++){
+		tBroadphaseProxy &p = aProxies[i];
+		CPhysical *e = p.entity;
+		float radius = e->GetBoundRadius();
+		e->GetBoundCentre(p.centre);
+		p.radius = radius + BROADPHASE_MARGIN +
+			(e->m_vecMoveSpeed.Magnitude() + maxSpeed + e->m_vecTurnSpeed.Magnitude()*radius) * timeStep;
+		p.minX = p.centre.x - p.radius;
+		p.maxX = p.centre.x + p.radius;
+	}
+
+	for(i = 1; i < n; i++){
+		tBroadphaseProxy p = aProxies[i];
+		for(j = i; j > 0 && aProxies[j-1].minX > p.minX; j--){
+			aProxies[j] = aProxies[j-1];
+			apProxyOfSlot[aProxies[j].type][aProxies[j].slot] = j;
+		}
+		aProxies[j] = p;
+		apProxyOfSlot[p.type][p.slot] = j;
+	}
+
+	// sweep, pairs where neither entity moves aren't needed
+	for(i = 0; i < n; i++)
+		for(j = i+1; j < n && aProxies[j].minX <= aProxies[i].maxX; j++)
+			if((aProxies[i].bMoving || aProxies[j].bMoving) && ProxiesOverlap(aProxies[i], aProxies[j]))
+				AddPair(i, j);
+
+	// the collision code resets m_pCollidingEntity once the two don't touch anymore, it has to see those pairs
+	for(i = 0; i < n; i++){
+		CPhysical *e = aProxies[i].entity;
+		CEntity *colliding = e->IsPed() ? ((CPed*)e)->m_pCollidingEntity :
+			e->IsObject() ? ((CObject*)e)->m_pCollidingEntity : nil;
+		if(colliding == nil)
+			continue;
+		j = GetProxyIndex(colliding);
+		if(j >= 0 && (aProxies[i].bMoving || aProxies[j].bMoving) && !ProxiesOverlap(aProxies[i], aProxies[j]))
+			AddPair(i, j);
+	}
+
+	// candidate lists of the moving entities: objects, vehicles and peds one after the other
+	for(i = 0; i < n; i++)
+		for(type = 0; type < NUM_BROADPHASE_TYPES; type++)
+			aProxies[i].numCandidates[type] = 0;
+	for(i = 0; i < ms_nNumPairs; i++){
+		tBroadphaseProxy &a = aProxies[aPairs[i][0]];
+		tBroadphaseProxy &b = aProxies[aPairs[i][1]];
+		if(a.bMoving) a.numCandidates[b.type]++;
+		if(b.bMoving) b.numCandidates[a.type]++;
+	}
+	int32 numCandidates = 0;
+	for(i = 0; i < n; i++){
+		aProxies[i].firstCandidate = numCandidates;
+		for(type = 0; type < NUM_BROADPHASE_TYPES; type++)
+			numCandidates += aProxies[i].numCandidates[type];
+	}
+	if(numCandidates > numCandidatesAllocated){
+		numCandidatesAllocated = Max(numCandidates, numCandidatesAllocated * 2);
+		aCandidates = (CSectorArrayEntry*)realloc(aCandidates, numCandidatesAllocated * sizeof(CSectorArrayEntry));
+		assert(aCandidates);
+	}
+	static int16 aNumFilled[MAX_BROADPHASE_PROXIES][NUM_BROADPHASE_TYPES];
+	memset(aNumFilled, 0, n * sizeof(aNumFilled[0]));
+	for(i = 0; i < ms_nNumPairs; i++)
+		for(j = 0; j < 2; j++){
+			tBroadphaseProxy &a = aProxies[aPairs[i][j]];
+			tBroadphaseProxy &b = aProxies[aPairs[i][j^1]];
+			if(!a.bMoving)
+				continue;
+			int32 k = a.firstCandidate + aNumFilled[aPairs[i][j]][b.type]++;
+			for(type = 0; type < b.type; type++)
+				k += a.numCandidates[type];
+			aCandidates[k].entity = b.entity;
+			aCandidates[k].bStaticBounds = false;
+		}
+
+	numCandidatesInUse = numCandidates;
+	ms_bValid = true;
+}
+
+// The passes skip the cleared entries
+void
+CBroadphase::Remove(CPhysical *ent)
+{
+	ms_bValid = false;
+	for(int32 i = 0; i < numCandidatesInUse; i++)
+		if(aCandidates[i].entity == ent)
+			aCandidates[i].entity = nil;
+}
+
+void
+CBroadphase::EndPasses(void)
+{
+	ms_bValid = false;
+	numCandidatesInUse = 0;
+}
+
+// Fills the object, vehicle and ped lists with the candidates of a moving entity
+bool
+CBroadphase::GetCandidateLists(CPhysical *ent, CSectorQueryList *lists)
+{
+	if(!ms_bValid)
+		return false;
+	int32 i = GetProxyIndex(ent);
+	if(i < 0 || !aProxies[i].bMoving)
+		return false;
+
+	const int32 listTypes[NUM_BROADPHASE_TYPES] = { ENTITYLIST_OBJECTS, ENTITYLIST_VEHICLES, ENTITYLIST_PEDS };
+	CSectorArrayEntry *entries = &aCandidates[aProxies[i].firstCandidate];
+	for(int32 type = 0; type < NUM_BROADPHASE_TYPES; type++){
+		CSectorQueryList &list = lists[listTypes[type]];
+		list.entries = entries;
+		list.num = list.size = aProxies[i].numCandidates[type];
+		lists[listTypes[type]+1] = CSectorQueryList();	// the overlap list
+		entries += list.num;
+	}
+	return true;
+}
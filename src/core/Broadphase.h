@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Lists.h"
+
+// Sweep and prune on x over the bound spheres of all vehicles, peds and objects in the
+// world. It runs once per frame before the collision passes of CWorld::Process and keeps,
+// for every entity on the moving list, the ones it may touch during the frame. The
+// collision passes then take those instead of the moving entity lists of all their
+// sectors. Buildings still come from the sector lists.
+
+class CPhysical;
+
+class CBroadphase
+{
+	static bool ms_bValid;
+	static int32 ms_nNumProxies;
+public:
+	static bool bUseBroadphase;
+	static int32 ms_nNumPairs;	// last frame, for the debug menu
+
+	static void Update(void);
+	// call when the candidates are out of date: at the end of the collision passes
+	// and when a physical is added in the middle of them
+	static void Invalidate(void) { ms_bValid = false; }
+	// call when a physical is removed, lists handed out may still be gone through
+	static void Remove(CPhysical *ent);
+	static void EndPasses(void);
+	static bool GetCandidateLists(CPhysical *ent, CSectorQueryList *lists);
+};
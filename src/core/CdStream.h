@@ -45,4 +45,13 @@ int32 CdStreamGetNumImages(void);
 
 #ifndef _WIN32
 extern bool flushStream[MAX_CDCHANNELS];
+#ifdef PARALLEL_CD_READS
+void CdStreamDumpStats(void);
+#endif
+#ifdef MAPPED_CD_IMAGES
+extern bool gbCdStreamMapImages;
+void *CdStreamGetMappedData(uint32 offset, uint32 size);
+void *CdStreamReadMapped(uint32 offset, uint32 size);
+void CdStreamPrefetch(uint32 offset, uint32 size);
+#endif
 #endif
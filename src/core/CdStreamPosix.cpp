@@ -23,6 +23,31 @@
 
 // #define ONE_THREAD_PER_CHANNEL // Don't use if you're not on SSD/Flash. (Also you may want to benefit from this via using all channels in Streaming.cpp)
 
+#ifdef PARALLEL_CD_READS
+#undef ONE_THREAD_PER_CHANNEL
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#if defined __linux__ && defined __has_include
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#if defined IORING_FEAT_RW_CUR_POS && defined __NR_io_uring_setup
+#define CDSTREAM_IO_URING
+#endif
+#endif
+#endif
+#endif
+
+#ifdef MAPPED_CD_IMAGES
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/vfs.h>
+#else
+#include <sys/param.h>
+#include <sys/mount.h>
+#endif
+#endif
+
 bool flushStream[MAX_CDCHANNELS];
 
 struct CdReadInfo
@@ -38,7 +63,15 @@ struct CdReadInfo
     pthread_t pChannelThread;
     sem_t pStartSemaphore;
 #endif
+#ifdef PARALLEL_CD_READS
+	uint32 nBytesToRead;
+	uint32 nBytesRead;
+	int64 nStartTime;
+	pthread_mutex_t pMutex;
+	pthread_cond_t pDoneCond; // used for CdStreamSync
+#else
 	sem_t pDoneSemaphore; // used for CdStreamSync
+#endif
 	int32 hFile;
 };
 
@@ -63,6 +96,7 @@ int32 lastPosnRead;
 
 int _gdwCdStreamFlags;
 
+#ifndef PARALLEL_CD_READS
 void *CdStreamThread(void* channelId);
 
 void
@@ -138,6 +172,7 @@ CdStreamInitThread(void)
     debug("Using seperate streaming threads for each channel\n");
 #endif
 }
+#endif
 
 void
 CdStreamInit(int32 numChannels)
@@ -208,6 +243,7 @@ ok:
 	return statbuf.st_size;
 }
 
+#ifndef PARALLEL_CD_READS
 void
 CdStreamShutdown(void)
 {
@@ -297,12 +333,15 @@ CdStreamGetStatus(int32 channel)
     return STREAM_NONE;
 }
 
+#endif
+
 int32
 CdStreamGetLastPosn(void)
 {
 	return lastPosnRead;
 }
 
+#ifndef PARALLEL_CD_READS
 // wait for channel to finish reading
 int32
 CdStreamSync(int32 channel)
@@ -339,6 +378,7 @@ CdStreamSync(int32 channel)
 
     return pChannel->nStatus;
 }
+#endif
 
 void
 AddToQueue(Queue *queue, int32 item)
@@ -377,6 +417,7 @@ RemoveFirstInQueue(Queue *queue)
 	queue->head = (queue->head + 1) % queue->size;
 }
 
+#ifndef PARALLEL_CD_READS
 void *CdStreamThread(void *param)
 {
 	debug("Created cdstream thread\n");
@@ -455,6 +496,634 @@ void *CdStreamThread(void *param)
     free(gpReadInfo);
 	pthread_exit(nil);
 }
+#endif
+
+#ifdef PARALLEL_CD_READS
+/*
+ * All channels read at the same time. Reads go to io_uring when the kernel
+ * has it, otherwise a few threads do pread, so they don't share a file position.
+ * Flushing a channel waits for its read instead of interrupting it, the
+ * buffer must not be written to after the channel was given up.
+ */
+
+#define NUM_CDSTREAM_READ_THREADS (4)	// pread fallback
+#define CDSTREAM_RING_ENTRIES (16)
+#define CDSTREAM_RING_SHUTDOWN (~(uint64)0)
+
+#ifdef CDSTREAM_IO_URING
+struct CdStreamRing
+{
+	int fd;
+	uint32 *sqHead, *sqTail, *sqMask, *sqArray;
+	uint32 *cqHead, *cqTail, *cqMask;
+	io_uring_sqe *sqes;
+	io_uring_cqe *cqes;
+	void *sqRing, *cqRing;
+	size_t sqRingSize, cqRingSize, sqesSize;
+	pthread_mutex_t submitMutex;
+};
+CdStreamRing gCdStreamRing;
+#endif
+bool gbCdStreamUseRing;
+pthread_t gCdStreamReadThreads[NUM_CDSTREAM_READ_THREADS];
+pthread_mutex_t gCdStreamQueueMutex;
+
+// latency buckets are powers of two starting at 1/4 ms
+#define NUM_CDSTREAM_LATENCY_BUCKETS (9)
+struct CdStreamStats
+{
+	int32 numReads;
+	int32 numErrors;
+	int64 numBytes;
+	int64 totalLatency;	// microseconds
+	int64 maxLatency;
+	int32 totalQueueDepth;
+	int32 maxQueueDepth;
+	int32 queueDepths[MAX_CDCHANNELS+1];
+	int32 latencies[NUM_CDSTREAM_LATENCY_BUCKETS];
+#ifdef MAPPED_CD_IMAGES
+	int32 numMappedReads;
+	int64 numMappedBytes;
+#endif
+};
+CdStreamStats gCdStreamStats;
+pthread_mutex_t gCdStreamStatsMutex;
+int32 gnCdStreamReadsInFlight;
+
+static int64
+CdStreamGetTime(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+static void
+CdStreamFinishRead(CdReadInfo *pChannel, int32 status)
+{
+	int64 latency = CdStreamGetTime() - pChannel->nStartTime;
+	int32 bucket = 0;
+	while(bucket < NUM_CDSTREAM_LATENCY_BUCKETS-1 && latency >= (250 << bucket))
+		bucket++;
+
+	pthread_mutex_lock(&gCdStreamStatsMutex);
+	gCdStreamStats.numReads++;
+	if(status != STREAM_NONE)
+		gCdStreamStats.numErrors++;
+	gCdStreamStats.numBytes += pChannel->nBytesRead;
+	gCdStreamStats.totalLatency += latency;
+	gCdStreamStats.maxLatency = Max(gCdStreamStats.maxLatency, latency);
+	gCdStreamStats.latencies[bucket]++;
+	gnCdStreamReadsInFlight--;
+	pthread_mutex_unlock(&gCdStreamStatsMutex);
+
+	pthread_mutex_lock(&pChannel->pMutex);
+	// nSectorsToRead == 0 at this point means we wanted to flush channel
+	pChannel->nStatus = pChannel->nSectorsToRead == 0 ? STREAM_NONE : status;
+	pChannel->nSectorsToRead = 0;
+	pChannel->bReading = false;
+	pthread_cond_broadcast(&pChannel->pDoneCond);
+	pthread_mutex_unlock(&pChannel->pMutex);
+}
+
+// Reads what's left of the request, short reads just continue
+static int32
+CdStreamReadRest(CdReadInfo *pChannel)
+{
+	while(pChannel->nBytesRead < pChannel->nBytesToRead){
+		ssize_t n = pread(pChannel->hFile, (uint8*)pChannel->pBuffer + pChannel->nBytesRead,
+			pChannel->nBytesToRead - pChannel->nBytesRead,
+			(off_t)pChannel->nSectorOffset*CDSTREAM_SECTOR_SIZE + pChannel->nBytesRead);
+		if(n < 0){
+			if(errno == EINTR)
+				continue;
+			return STREAM_ERROR;
+		}
+		if(n == 0)
+			break;	// end of the image, same as read() did
+		pChannel->nBytesRead += n;
+	}
+	return STREAM_NONE;
+}
+
+#ifdef CDSTREAM_IO_URING
+static int
+CdStreamRingEnter(uint32 toSubmit, uint32 minComplete, uint32 flags)
+{
+	return (int)syscall(__NR_io_uring_enter, gCdStreamRing.fd, toSubmit, minComplete, flags, nil, 0);
+}
+
+static bool
+CdStreamRingInit(void)
+{
+	CdStreamRing &ring = gCdStreamRing;
+	io_uring_params params;
+
+	memset(&params, 0, sizeof(params));
+	ring.fd = (int)syscall(__NR_io_uring_setup, CDSTREAM_RING_ENTRIES, &params);
+	if(ring.fd < 0)
+		return false;
+
+	ring.sqRingSize = params.sq_off.array + params.sq_entries*sizeof(uint32);
+	ring.cqRingSize = params.cq_off.cqes + params.cq_entries*sizeof(io_uring_cqe);
+	if(params.features & IORING_FEAT_SINGLE_MMAP)
+		ring.sqRingSize = ring.cqRingSize = Max(ring.sqRingSize, ring.cqRingSize);
+	ring.sqesSize = params.sq_entries*sizeof(io_uring_sqe);
+
+	ring.sqRing = mmap(nil, ring.sqRingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+	if(ring.sqRing == MAP_FAILED){
+		close(ring.fd);
+		return false;
+	}
+	if(params.features & IORING_FEAT_SINGLE_MMAP)
+		ring.cqRing = ring.sqRing;
+	else{
+		ring.cqRing = mmap(nil, ring.cqRingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ring.fd, IORING_OFF_CQ_RING);
+		if(ring.cqRing == MAP_FAILED){
+			munmap(ring.sqRing, ring.sqRingSize);
+			close(ring.fd);
+			return false;
+		}
+	}
+	ring.sqes = (io_uring_sqe*)mmap(nil, ring.sqesSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+	if(ring.sqes == MAP_FAILED){
+		if(ring.cqRing != ring.sqRing)
+			munmap(ring.cqRing, ring.cqRingSize);
+		munmap(ring.sqRing, ring.sqRingSize);
+		close(ring.fd);
+		return false;
+	}
+
+	uint8 *sq = (uint8*)ring.sqRing;
+	uint8 *cq = (uint8*)ring.cqRing;
+	ring.sqHead = (uint32*)(sq + params.sq_off.head);
+	ring.sqTail = (uint32*)(sq + params.sq_off.tail);
+	ring.sqMask = (uint32*)(sq + params.sq_off.ring_mask);
+	ring.sqArray = (uint32*)(sq + params.sq_off.array);
+	ring.cqHead = (uint32*)(cq + params.cq_off.head);
+	ring.cqTail = (uint32*)(cq + params.cq_off.tail);
+	ring.cqMask = (uint32*)(cq + params.cq_off.ring_mask);
+	ring.cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+	pthread_mutex_init(&ring.submitMutex, nil);
+	return true;
+}
+
+static void
+CdStreamRingShutdown(void)
+{
+	CdStreamRing &ring = gCdStreamRing;
+	munmap(ring.sqes, ring.sqesSize);
+	if(ring.cqRing != ring.sqRing)
+		munmap(ring.cqRing, ring.cqRingSize);
+	munmap(ring.sqRing, ring.sqRingSize);
+	close(ring.fd);
+	pthread_mutex_destroy(&ring.submitMutex);
+}
+
+// Called from the main thread for new reads and from the completion thread for the rest of short ones.
+// Returns false when the kernel didn't take the entry, it's taken back out of the ring then.
+static bool
+CdStreamRingSubmit(uint8 opcode, int32 fd, void *buffer, uint32 size, uint64 offset, uint64 userData)
+{
+	CdStreamRing &ring = gCdStreamRing;
+
+	pthread_mutex_lock(&ring.submitMutex);
+	// every channel has one read at most, the ring has more entries than that
+	uint32 tail = *ring.sqTail;
+	uint32 index = tail & *ring.sqMask;
+	io_uring_sqe *sqe = &ring.sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = (uint64)(uintptr)buffer;
+	sqe->len = size;
+	sqe->off = offset;
+	sqe->user_data = userData;
+	ring.sqArray[index] = index;
+	__atomic_store_n(ring.sqTail, tail+1, __ATOMIC_RELEASE);
+	int res;
+	while((res = CdStreamRingEnter(1, 0, 0)) < 0 && errno == EINTR);
+	// nothing else submits while we hold the mutex, so an entry the kernel didn't consume is still ours,
+	// whether io_uring_enter failed or returned 0
+	bool submitted = res > 0 || __atomic_load_n(ring.sqHead, __ATOMIC_ACQUIRE) != tail;
+	if(!submitted)
+		__atomic_store_n(ring.sqTail, tail, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&ring.submitMutex);
+	return submitted;
+}
+
+// Falls back to pread on this thread if the ring won't take the read
+static void
+CdStreamRingSubmitRead(int32 channel)
+{
+	CdReadInfo *pChannel = &gpReadInfo[channel];
+	if(!CdStreamRingSubmit(IORING_OP_READ, pChannel->hFile, (uint8*)pChannel->pBuffer + pChannel->nBytesRead,
+		pChannel->nBytesToRead - pChannel->nBytesRead,
+		(uint64)pChannel->nSectorOffset*CDSTREAM_SECTOR_SIZE + pChannel->nBytesRead, channel))
+		CdStreamFinishRead(pChannel, CdStreamReadRest(pChannel));
+}
+
+void *CdStreamRingThread(void *param)
+{
+	CdStreamRing &ring = gCdStreamRing;
+
+	debug("Created cdstream completion thread\n");
+
+	for(;;){
+		uint32 head = *ring.cqHead;
+		if(head == __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE)){
+			CdStreamRingEnter(0, 1, IORING_ENTER_GETEVENTS);
+			continue;
+		}
+		io_uring_cqe *cqe = &ring.cqes[head & *ring.cqMask];
+		uint64 userData = cqe->user_data;
+		int32 res = cqe->res;
+		__atomic_store_n(ring.cqHead, head+1, __ATOMIC_RELEASE);
+
+		if(userData == CDSTREAM_RING_SHUTDOWN)
+			break;
+
+		int32 channel = (int32)userData;
+		CdReadInfo *pChannel = &gpReadInfo[channel];
+		if(res == -EINTR || res == -EAGAIN){
+			CdStreamRingSubmitRead(channel);
+			continue;
+		}
+		if(res == -EINVAL || res == -EOPNOTSUPP){
+			// kernel without IORING_OP_READ, do it ourselves
+			CdStreamFinishRead(pChannel, CdStreamReadRest(pChannel));
+			continue;
+		}
+		if(res < 0){
+			CdStreamFinishRead(pChannel, STREAM_ERROR);
+			continue;
+		}
+		if(res == 0 && pChannel->nBytesRead < pChannel->nBytesToRead){
+			// end of the file before the read was done
+			CdStreamFinishRead(pChannel, STREAM_ERROR);
+			continue;
+		}
+		pChannel->nBytesRead += res;
+		if(pChannel->nBytesRead < pChannel->nBytesToRead)
+			CdStreamRingSubmitRead(channel);
+		else
+			CdStreamFinishRead(pChannel, STREAM_NONE);
+	}
+
+	pthread_exit(nil);
+}
+#endif
+
+void *CdStreamReadThread(void *param)
+{
+	debug("Created cdstream read thread\n");
+
+	for(;;){
+		sem_wait(&gCdStreamSema);
+		if(gCdStreamThreadStatus == 2)
+			break;
+
+		pthread_mutex_lock(&gCdStreamQueueMutex);
+		int32 channel = GetFirstInQueue(&gChannelRequestQ);
+		if(channel != -1)
+			RemoveFirstInQueue(&gChannelRequestQ);
+		pthread_mutex_unlock(&gCdStreamQueueMutex);
+		if(channel == -1)
+			continue;
+
+		ASSERT( channel < gNumChannels );
+		CdReadInfo *pChannel = &gpReadInfo[channel];
+		ASSERT(pChannel->hFile >= 0);
+		ASSERT(pChannel->pBuffer != nil );
+		CdStreamFinishRead(pChannel, CdStreamReadRest(pChannel));
+	}
+	pthread_exit(nil);
+}
+
+void
+CdStreamInitThread(void)
+{
+	int status;
+
+	gChannelRequestQ.items = (int32 *)calloc(gNumChannels + 1, sizeof(int32));
+	gChannelRequestQ.head = 0;
+	gChannelRequestQ.tail = 0;
+	gChannelRequestQ.size = gNumChannels + 1;
+	ASSERT(gChannelRequestQ.items != nil );
+	pthread_mutex_init(&gCdStreamQueueMutex, nil);
+	pthread_mutex_init(&gCdStreamStatsMutex, nil);
+	memset(&gCdStreamStats, 0, sizeof(gCdStreamStats));
+	gnCdStreamReadsInFlight = 0;
+	gCdStreamThreadStatus = 0;
+
+	for ( int32 i = 0; i < gNumChannels; i++ )
+	{
+		pthread_mutex_init(&gpReadInfo[i].pMutex, nil);
+		pthread_cond_init(&gpReadInfo[i].pDoneCond, nil);
+	}
+
+#ifdef CDSTREAM_IO_URING
+	gbCdStreamUseRing = CdStreamRingInit();
+	if(gbCdStreamUseRing){
+		status = pthread_create(&_gCdStreamThread, NULL, CdStreamRingThread, nil);
+		if(status == 0){
+			debug("Using io_uring for streaming\n");
+			return;
+		}
+		CdStreamRingShutdown();
+		gbCdStreamUseRing = false;
+	}
+#endif
+
+	status = sem_init(&gCdStreamSema, 0, 0);
+	if (status == -1) {
+		CDTRACE("failed to create stream semaphore");
+		ASSERT(0);
+		return;
+	}
+	for(int32 i = 0; i < NUM_CDSTREAM_READ_THREADS; i++){
+		status = pthread_create(&gCdStreamReadThreads[i], NULL, CdStreamReadThread, nil);
+		if (status != 0)
+		{
+			CDTRACE("failed to create read thread");
+			ASSERT(0);
+			return;
+		}
+	}
+	debug("Using %d threads for streaming\n", NUM_CDSTREAM_READ_THREADS);
+}
+
+void
+CdStreamShutdown(void)
+{
+	gCdStreamThreadStatus = 2;
+#ifdef CDSTREAM_IO_URING
+	if(gbCdStreamUseRing){
+		CdStreamRingSubmit(IORING_OP_NOP, -1, nil, 0, 0, CDSTREAM_RING_SHUTDOWN);
+		pthread_join(_gCdStreamThread, nil);
+		CdStreamRingShutdown();
+	}else
+#endif
+	{
+		for(int32 i = 0; i < NUM_CDSTREAM_READ_THREADS; i++)
+			sem_post(&gCdStreamSema);
+		for(int32 i = 0; i < NUM_CDSTREAM_READ_THREADS; i++)
+			pthread_join(gCdStreamReadThreads[i], nil);
+		sem_destroy(&gCdStreamSema);
+	}
+
+	for ( int32 i = 0; i < gNumChannels; i++ )
+	{
+		pthread_mutex_destroy(&gpReadInfo[i].pMutex);
+		pthread_cond_destroy(&gpReadInfo[i].pDoneCond);
+	}
+	pthread_mutex_destroy(&gCdStreamQueueMutex);
+	pthread_mutex_destroy(&gCdStreamStatsMutex);
+	free(gChannelRequestQ.items);
+	free(gpReadInfo);
+}
+
+int32
+CdStreamRead(int32 channel, void *buffer, uint32 offset, uint32 size)
+{
+	ASSERT( channel < gNumChannels );
+	ASSERT( buffer != nil );
+
+	lastPosnRead = size + offset;
+
+	ASSERT( _GET_INDEX(offset) < MAX_CDIMAGES );
+	int32 hImage = gImgFiles[_GET_INDEX(offset)];
+	ASSERT( hImage > 0 );
+
+	CdReadInfo *pChannel = &gpReadInfo[channel];
+	ASSERT( pChannel != nil );
+
+	// the read threads clear bReading under the lock
+	pthread_mutex_lock(&pChannel->pMutex);
+	if ( pChannel->nSectorsToRead != 0 || pChannel->bReading )
+	{
+		pthread_mutex_unlock(&pChannel->pMutex);
+		return STREAM_NONE;
+	}
+
+	pChannel->hFile = hImage - 1;
+	pChannel->nStatus = STREAM_NONE;
+	pChannel->nSectorOffset = _GET_OFFSET(offset);
+	pChannel->nSectorsToRead = size;
+	pChannel->pBuffer = buffer;
+	pChannel->bLocked = 0;
+	pChannel->bReading = true;
+	pChannel->nBytesToRead = size * CDSTREAM_SECTOR_SIZE;
+	pChannel->nBytesRead = 0;
+	pChannel->nStartTime = CdStreamGetTime();
+	pthread_mutex_unlock(&pChannel->pMutex);
+
+	pthread_mutex_lock(&gCdStreamStatsMutex);
+	int32 depth = ++gnCdStreamReadsInFlight;
+	gCdStreamStats.totalQueueDepth += depth;
+	gCdStreamStats.maxQueueDepth = Max(gCdStreamStats.maxQueueDepth, depth);
+	gCdStreamStats.queueDepths[Min(depth, MAX_CDCHANNELS)]++;
+	pthread_mutex_unlock(&gCdStreamStatsMutex);
+
+#ifdef CDSTREAM_IO_URING
+	if(gbCdStreamUseRing){
+		CdStreamRingSubmitRead(channel);
+		return STREAM_SUCCESS;
+	}
+#endif
+	pthread_mutex_lock(&gCdStreamQueueMutex);
+	AddToQueue(&gChannelRequestQ, channel);
+	pthread_mutex_unlock(&gCdStreamQueueMutex);
+	if ( sem_post(&gCdStreamSema) != 0 )
+		printf("Signal Sema Error\n");
+
+	return STREAM_SUCCESS;
+}
+
+int32
+CdStreamGetStatus(int32 channel)
+{
+	ASSERT( channel < gNumChannels );
+	CdReadInfo *pChannel = &gpReadInfo[channel];
+	ASSERT( pChannel != nil );
+
+	if (gCdStreamThreadStatus == 2)
+		return STREAM_NONE;
+
+	int32 status = STREAM_NONE;
+	pthread_mutex_lock(&pChannel->pMutex);
+	if ( pChannel->bReading )
+		status = STREAM_READING;
+	else if ( pChannel->nStatus != STREAM_NONE )
+	{
+		status = pChannel->nStatus;
+
+		pChannel->nStatus = STREAM_NONE;
+	}
+	pthread_mutex_unlock(&pChannel->pMutex);
+
+	return status;
+}
+
+// wait for channel to finish reading
+int32
+CdStreamSync(int32 channel)
+{
+	ASSERT( channel < gNumChannels );
+	CdReadInfo *pChannel = &gpReadInfo[channel];
+	ASSERT( pChannel != nil );
+
+	pthread_mutex_lock(&pChannel->pMutex);
+	if (flushStream[channel])
+		pChannel->nSectorsToRead = 0;
+	while ( pChannel->bReading )
+		pthread_cond_wait(&pChannel->pDoneCond, &pChannel->pMutex);
+	pthread_mutex_unlock(&pChannel->pMutex);
+
+	if (flushStream[channel]) {
+		flushStream[channel] = false;
+		pChannel->nStatus = STREAM_NONE;
+		return STREAM_NONE;
+	}
+
+	return pChannel->nStatus;
+}
+
+void
+CdStreamDumpStats(void)
+{
+	pthread_mutex_lock(&gCdStreamStatsMutex);
+	CdStreamStats stats = gCdStreamStats;
+	pthread_mutex_unlock(&gCdStreamStatsMutex);
+
+	int32 numReads = Max(stats.numReads, 1);
+	debug("CdStream: %s, %d reads, %d errors, %d KB\n", gbCdStreamUseRing ? "io_uring" : "pread threads",
+		stats.numReads, stats.numErrors, (int32)(stats.numBytes/1024));
+	debug("CdStream: queue depth avg %.2f max %d\n", (float)stats.totalQueueDepth/numReads, stats.maxQueueDepth);
+	for(int32 i = 1; i <= MAX_CDCHANNELS; i++)
+		debug("CdStream:   depth %d%s: %d\n", i, i == MAX_CDCHANNELS ? "+" : "", stats.queueDepths[i]);
+	debug("CdStream: latency avg %.3f ms max %.3f ms\n", stats.totalLatency/1000.0f/numReads, stats.maxLatency/1000.0f);
+	for(int32 i = 0; i < NUM_CDSTREAM_LATENCY_BUCKETS; i++)
+		if(i == NUM_CDSTREAM_LATENCY_BUCKETS-1)
+			debug("CdStream:   >= %.2f ms: %d\n", (250 << (i-1))/1000.0f, stats.latencies[i]);
+		else
+			debug("CdStream:   < %.2f ms: %d\n", (250 << i)/1000.0f, stats.latencies[i]);
+#ifdef MAPPED_CD_IMAGES
+	debug("CdStream: %d mapped reads, %d KB\n", stats.numMappedReads, (int32)(stats.numMappedBytes/1024));
+#endif
+}
+#endif
+
+#ifdef MAPPED_CD_IMAGES
+bool gbCdStreamMapImages;
+
+struct CdImageMapping
+{
+	uint8 *pData;
+	size_t nSize;
+};
+CdImageMapping gImgMappings[MAX_CDIMAGES];
+
+// Touching a mapped page that can't be read is a SIGBUS, not an error the
+// retry code could handle. Only map images on disks that don't go away.
+static bool
+CdStreamIsOnLocalDisk(int fd)
+{
+	struct statfs fsInfo;
+	if(fstatfs(fd, &fsInfo) < 0)
+		return false;
+#ifdef __linux__
+	switch((uint32)fsInfo.f_type){
+	case 0x6969:		// NFS
+	case 0x517B:		// SMB
+	case 0xFE534D42:	// SMB2
+	case 0xFF534D42:	// CIFS
+	case 0x65735546:	// FUSE
+	case 0x01021997:	// 9P
+		return false;
+	}
+	return true;
+#elif defined MNT_LOCAL
+	return (fsInfo.f_flags & MNT_LOCAL) != 0;
+#else
+	return false;
+#endif
+}
+
+static void
+CdStreamMapImage(int32 cd)
+{
+	int fd = gImgFiles[cd] - 1;
+	struct stat statbuf;
+
+	if(fstat(fd, &statbuf) < 0 || statbuf.st_size == 0 || !CdStreamIsOnLocalDisk(fd)){
+		CDDEBUG("not mapping %s", gImgNames[cd]);
+		return;
+	}
+	// private and writable, so loading may scribble on the data like it could on the streaming buffer
+	void *data = mmap(nil, statbuf.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if(data == MAP_FAILED){
+		CDDEBUG("can't map %s", gImgNames[cd]);
+		return;
+	}
+	gImgMappings[cd].pData = (uint8*)data;
+	gImgMappings[cd].nSize = statbuf.st_size;
+	CDDEBUG("mapped %s", gImgNames[cd]);
+}
+
+static void
+CdStreamUnmapImage(int32 cd)
+{
+	if(gImgMappings[cd].pData)
+		munmap(gImgMappings[cd].pData, gImgMappings[cd].nSize);
+	gImgMappings[cd].pData = nil;
+	gImgMappings[cd].nSize = 0;
+}
+
+// Where the sectors are if their image is mapped, nil if they have to be read
+void*
+CdStreamGetMappedData(uint32 offset, uint32 size)
+{
+	uint32 cd = _GET_INDEX(offset);
+	if(cd >= MAX_CDIMAGES || gImgMappings[cd].pData == nil)
+		return nil;
+	size_t start = (size_t)_GET_OFFSET(offset) * CDSTREAM_SECTOR_SIZE;
+	if(start + (size_t)size * CDSTREAM_SECTOR_SIZE > gImgMappings[cd].nSize)
+		return nil;
+	return gImgMappings[cd].pData + start;
+}
+
+// CdStreamRead for mapped sectors, done as soon as it returns
+void*
+CdStreamReadMapped(uint32 offset, uint32 size)
+{
+	void *data = CdStreamGetMappedData(offset, size);
+	if(data == nil)
+		return nil;
+	lastPosnRead = size + offset;
+#ifdef PARALLEL_CD_READS
+	pthread_mutex_lock(&gCdStreamStatsMutex);
+	gCdStreamStats.numMappedReads++;
+	gCdStreamStats.numMappedBytes += size * CDSTREAM_SECTOR_SIZE;
+	pthread_mutex_unlock(&gCdStreamStatsMutex);
+#endif
+	return data;
+}
+
+// Start paging in sectors that will be needed soon
+void
+CdStreamPrefetch(uint32 offset, uint32 size)
+{
+	static uintptr pageSize;
+	uint8 *data = (uint8*)CdStreamGetMappedData(offset, size);
+	if(data == nil)
+		return;
+	if(pageSize == 0)
+		pageSize = sysconf(_SC_PAGESIZE);
+	uintptr start = (uintptr)data & ~(pageSize-1);
+	madvise((void*)start, (uintptr)data + size*CDSTREAM_SECTOR_SIZE - start, MADV_WILLNEED);
+}
+#endif
 
 bool
 CdStreamAddImage(char const *path)
@@ -484,6 +1153,11 @@ CdStreamAddImage(char const *path)
 
 	strcpy(gCdImageNames[gNumImages], path);
 
+#ifdef MAPPED_CD_IMAGES
+	if(gbCdStreamMapImages)
+		CdStreamMapImage(gNumImages);
+#endif
+
 	gNumImages++;
 
 	return true;
@@ -507,6 +1181,9 @@ CdStreamRemoveImages(void)
 
 	for ( int32 i = 0; i < gNumImages; i++ )
 	{
+#ifdef MAPPED_CD_IMAGES
+		CdStreamUnmapImage(i);
+#endif
 		close(gImgFiles[i] - 1);
 		free(gImgNames[i]);
 		gImgFiles[i] = 0;
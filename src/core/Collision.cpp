@@ -22,6 +22,9 @@
 #include "Lines.h"
 #include "Collision.h"
 #include "Frontend.h"
+#include "ModelInfo.h"
+#include "TempColModels.h"
+#include "Simd.h"
 
 
 // TODO: where do these go?
@@ -373,6 +376,253 @@ enum Direction
 	DIR_Z_NEG,
 };
 
+#ifdef COLLISION_BVH
+// candidates found in a model's tree, the callers then run the normal per triangle tests on them
+static int32 aBVHTriangles[COLBVH_MAX_TRIANGLES];
+
+struct tBVHBuildNode
+{
+	CVector min, max;
+	int32 first;
+	int32 numTriangles;
+	int32 secondChild;
+};
+
+struct tBVHBuildData
+{
+	CVector *triMin;
+	CVector *triMax;
+	CVector *centroid;
+	int32 *order;
+	tBVHBuildNode *nodes;
+	int32 numNodes;
+};
+
+static int32 gBVHSortAxis;
+static tBVHBuildData *gpBVHSortData;
+
+static int
+CompareBVHCentroids(const void *a, const void *b)
+{
+	float ca = ((float*)&gpBVHSortData->centroid[*(int32*)a])[gBVHSortAxis];
+	float cb = ((float*)&gpBVHSortData->centroid[*(int32*)b])[gBVHSortAxis];
+	return ca < cb ? -1 : ca > cb ? 1 : 0;
+}
+
+static int32
+BuildBVHNode(tBVHBuildData &data, int32 first, int32 numTriangles, int32 depth)
+{
+	int32 i;
+	int32 n = data.numNodes++;
+	tBVHBuildNode *node = &data.nodes[n];
+	CVector cmin, cmax;
+
+	node->min = cmin = CVector(1.0e24f, 1.0e24f, 1.0e24f);
+	node->max = cmax = CVector(-1.0e24f, -1.0e24f, -1.0e24f);
+	for(i = first; i < first + numTriangles; i++){
+		int32 t = data.order[i];
+		node->min = CVector(Min(node->min.x, data.triMin[t].x), Min(node->min.y, data.triMin[t].y), Min(node->min.z, data.triMin[t].z));
+		node->max = CVector(Max(node->max.x, data.triMax[t].x), Max(node->max.y, data.triMax[t].y), Max(node->max.z, data.triMax[t].z));
+		cmin = CVector(Min(cmin.x, data.centroid[t].x), Min(cmin.y, data.centroid[t].y), Min(cmin.z, data.centroid[t].z));
+		cmax = CVector(Max(cmax.x, data.centroid[t].x), Max(cmax.y, data.centroid[t].y), Max(cmax.z, data.centroid[t].z));
+	}
+
+	if(numTriangles <= COLBVH_LEAF_TRIANGLES || depth >= COLBVH_MAX_DEPTH){
+		node->first = first;
+		node->numTriangles = numTriangles;
+		node->secondChild = 0;
+		return n;
+	}
+
+	// split at the median along the longest axis of the centroids
+	CVector size = cmax - cmin;
+	gBVHSortAxis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+	gpBVHSortData = &data;
+	qsort(&data.order[first], numTriangles, sizeof(int32), CompareBVHCentroids);
+
+	int32 numLeft = numTriangles/2;
+	node->first = 0;
+	node->numTriangles = 0;
+	BuildBVHNode(data, first, numLeft, depth+1);
+	int32 second = BuildBVHNode(data, first + numLeft, numTriangles - numLeft, depth+1);
+	node->secondChild = second;
+	return n;
+}
+
+// Builds the tree and puts the model's triangles into tree order
+CColBVH*
+CColBVH::Build(CColModel &model)
+{
+	int32 i;
+	int32 n = model.numTriangles;
+	tBVHBuildData data;
+
+	if(n < COLBVH_MIN_TRIANGLES || n > COLBVH_MAX_TRIANGLES)
+		return nil;
+
+	data.triMin = new CVector[n];
+	data.triMax = new CVector[n];
+	data.centroid = new CVector[n];
+	data.order = new int32[n];
+	data.nodes = new tBVHBuildNode[2*n];
+	data.numNodes = 0;
+	for(i = 0; i < n; i++){
+		CVector a = model.vertices[model.triangles[i].a].Get();
+		CVector b = model.vertices[model.triangles[i].b].Get();
+		CVector c = model.vertices[model.triangles[i].c].Get();
+		data.triMin[i] = CVector(Min(a.x, Min(b.x, c.x)), Min(a.y, Min(b.y, c.y)), Min(a.z, Min(b.z, c.z)));
+		data.triMax[i] = CVector(Max(a.x, Max(b.x, c.x)), Max(a.y, Max(b.y, c.y)), Max(a.z, Max(b.z, c.z)));
+		data.centroid[i] = (a + b + c)/3.0f;
+		data.order[i] = i;
+	}
+	BuildBVHNode(data, 0, n, 0);
+
+	CColBVH *bvh = (CColBVH*)RwMalloc(sizeof(CColBVH) + (data.numNodes-1)*sizeof(CColBVHNode));
+	bvh->numNodes = data.numNodes;
+	// pad the box so quantisation never makes a node smaller than its triangles
+	CVector rootMin = data.nodes[0].min - CVector(0.01f, 0.01f, 0.01f);
+	CVector rootMax = data.nodes[0].max + CVector(0.01f, 0.01f, 0.01f);
+	bvh->origin = rootMin;
+	bvh->step = (rootMax - rootMin) / 65535.0f;
+	for(i = 0; i < data.numNodes; i++){
+		tBVHBuildNode *src = &data.nodes[i];
+		CColBVHNode *dst = &bvh->nodes[i];
+		float *min = (float*)&src->min;
+		float *max = (float*)&src->max;
+		float *origin = (float*)&bvh->origin;
+		float *step = (float*)&bvh->step;
+		for(int32 j = 0; j < 3; j++){
+			dst->min[j] = clamp(Floor((min[j] - origin[j]) / step[j]) - 1.0f, 0.0f, 65535.0f);
+			dst->max[j] = clamp(Ceil((max[j] - origin[j]) / step[j]) + 1.0f, 0.0f, 65535.0f);
+		}
+		if(src->numTriangles){
+			dst->first = src->first;
+			dst->numTriangles = src->numTriangles;
+		}else{
+			dst->first = src->secondChild;
+			dst->numTriangles = 0;
+		}
+	}
+
+	// store the triangles in tree order so every leaf is a contiguous range
+	CColTriangle *triangles = (CColTriangle*)RwMalloc(n*sizeof(CColTriangle));
+	for(i = 0; i < n; i++)
+		triangles[i] = model.triangles[data.order[i]];
+	RwFree(model.triangles);
+	model.triangles = triangles;
+
+	delete[] data.triMin;
+	delete[] data.triMax;
+	delete[] data.centroid;
+	delete[] data.order;
+	delete[] data.nodes;
+	return bvh;
+}
+
+static bool
+LineTouchesBVHBox(const CColLine &line, const CVector &min, const CVector &max)
+{
+	float tmin = 0.0f, tmax = 1.0f;
+	const float *p0 = (const float*)&line.p0;
+	const float *p1 = (const float*)&line.p1;
+	const float *bmin = (const float*)&min;
+	const float *bmax = (const float*)&max;
+	for(int32 i = 0; i < 3; i++){
+		float d = p1[i] - p0[i];
+		if(Abs(d) < 0.000001f){
+			if(p0[i] < bmin[i] || p0[i] > bmax[i])
+				return false;
+			continue;
+		}
+		float t0 = (bmin[i] - p0[i]) / d;
+		float t1 = (bmax[i] - p0[i]) / d;
+		if(t0 > t1){
+			float tmp = t0;
+			t0 = t1;
+			t1 = tmp;
+		}
+		tmin = Max(tmin, t0);
+		tmax = Min(tmax, t1);
+		if(tmin > tmax)
+			return false;
+	}
+	return true;
+}
+
+int32
+CColBVH::FindTriangles(int32 type, const CColLine *line, const CColSphere *sphere, int32 *triangles) const
+{
+	int32 stack[COLBVH_MAX_DEPTH+2];
+	int32 sp = 0;
+	int32 numTriangles = 0;
+	CVector min, max;
+
+	stack[sp++] = 0;
+	while(sp > 0){
+		const CColBVHNode *node = &nodes[stack[--sp]];
+		min = CVector(origin.x + node->min[0]*step.x, origin.y + node->min[1]*step.y, origin.z + node->min[2]*step.z);
+		max = CVector(origin.x + node->max[0]*step.x, origin.y + node->max[1]*step.y, origin.z + node->max[2]*step.z);
+
+		bool touches;
+		switch(type){
+		case COLBVH_LINE:
+			touches = LineTouchesBVHBox(*line, min, max);
+			break;
+		case COLBVH_VERTICAL_LINE:
+			touches = line->p0.x >= min.x && line->p0.x <= max.x &&
+				line->p0.y >= min.y && line->p0.y <= max.y &&
+				Min(line->p0.z, line->p1.z) <= max.z && Max(line->p0.z, line->p1.z) >= min.z;
+			break;
+		default:
+			touches = sphere->center.x + sphere->radius >= min.x && sphere->center.x - sphere->radius <= max.x &&
+				sphere->center.y + sphere->radius >= min.y && sphere->center.y - sphere->radius <= max.y &&
+				sphere->center.z + sphere->radius >= min.z && sphere->center.z - sphere->radius <= max.z;
+			break;
+		}
+		if(!touches)
+			continue;
+
+		if(node->numTriangles){
+			for(int32 i = 0; i < node->numTriangles; i++)
+				triangles[numTriangles++] = node->first + i;
+		}else{
+			// second child goes first on the stack so the triangles come out in ascending order
+			stack[sp++] = node->first;
+			stack[sp++] = node - nodes + 1;
+		}
+	}
+	return numTriangles;
+}
+
+#ifndef MASTER
+void
+CCollision::ReportBVHMemory(void)
+{
+	int32 numTrees[4] = { 0, 0, 0, 0 };
+	int32 numNodes[4] = { 0, 0, 0, 0 };
+	int32 treeBytes[4] = { 0, 0, 0, 0 };
+	int32 meshBytes[4] = { 0, 0, 0, 0 };
+
+	for(int32 i = 0; i < MODELINFOSIZE; i++){
+		CBaseModelInfo *mi = CModelInfo::GetModelInfo(i);
+		if(mi == nil || mi->GetColModel() == nil)
+			continue;
+		CColModel *model = mi->GetColModel();
+		int32 level = clamp(model->level, LEVEL_GENERIC, LEVEL_SUBURBAN);
+		meshBytes[level] += model->numTriangles*sizeof(CColTriangle);
+		if(model->bvh){
+			numTrees[level]++;
+			numNodes[level] += model->bvh->numNodes;
+			treeBytes[level] += model->bvh->GetSize();
+		}
+	}
+	for(int32 level = LEVEL_GENERIC; level <= LEVEL_SUBURBAN; level++)
+		debug("Col BVH level %d: %d trees, %d nodes, %d bytes (%d bytes of triangles)\n",
+			level, numTrees[level], numNodes[level], treeBytes[level], meshBytes[level]);
+}
+#endif
+#endif
+
 eLevelName CCollision::ms_collisionInMemory;
 CLinkList<CColModel*> CCollision::ms_colModelCache;
 
@@ -1054,6 +1304,18 @@ CCollision::TestLineOfSight(const CColLine &line, const CMatrix &matrix, CColMod
 	}
 
 	CalculateTrianglePlanes(&model);
+#ifdef COLLISION_BVH
+	if(model.bvh){
+		int32 numTriangles = model.bvh->FindTriangles(COLBVH_LINE, &newline, nil, aBVHTriangles);
+		for(int32 j = 0; j < numTriangles; j++){
+			i = aBVHTriangles[j];
+			if(ignoreSeeThrough && IsSeeThrough(model.triangles[i].surface)) continue;
+			if(TestLineTriangle(newline, model.vertices, model.triangles[i], model.trianglePlanes[i]))
+				return true;
+		}
+		return false;
+	}
+#endif
 	for(i = 0; i < model.numTriangles; i++){
 		if(ignoreSeeThrough && IsSeeThrough(model.triangles[i].surface)) continue;
 		if(TestLineTriangle(newline, model.vertices, model.triangles[i], model.trianglePlanes[i]))
@@ -1884,6 +2146,16 @@ CCollision::ProcessLineOfSight(const CColLine &line,
 	}
 
 	CalculateTrianglePlanes(&model);
+#ifdef COLLISION_BVH
+	if(model.bvh){
+		int32 numTriangles = model.bvh->FindTriangles(COLBVH_LINE, &newline, nil, aBVHTriangles);
+		for(int32 j = 0; j < numTriangles; j++){
+			i = aBVHTriangles[j];
+			if(ignoreSeeThrough && IsSeeThrough(model.triangles[i].surface)) continue;
+			ProcessLineTriangle(newline, model.vertices, model.triangles[i], model.trianglePlanes[i], point, coldist);
+		}
+	}else
+#endif
 	for(i = 0; i < model.numTriangles; i++){
 		if(ignoreSeeThrough && IsSeeThrough(model.triangles[i].surface)) continue;
 		ProcessLineTriangle(newline, model.vertices, model.triangles[i], model.trianglePlanes[i], point, coldist);
@@ -1899,6 +2171,155 @@ CCollision::ProcessLineOfSight(const CColLine &line,
 #endif
 }
 
+#ifdef CONCURRENT_WORLD_QUERIES
+// models that aren't in the plane cache get their planes worked out on the fly
+static const CColTrianglePlane&
+GetTrianglePlane(const CColModel &model, int i, CColTrianglePlane &plane)
+{
+	if(model.trianglePlanes)
+		return model.trianglePlanes[i];
+	const CColTriangle &tri = model.triangles[i];
+	plane.Set(model.vertices[tri.a].Get(), model.vertices[tri.b].Get(), model.vertices[tri.c].Get());
+	return plane;
+}
+
+bool
+CCollision::TestLineOfSight(const CColLine &line, const CMatrix &matrix, const CColModel &model, bool ignoreSeeThrough, int32 *bvhTriangles)
+{
+	CMatrix matTransform;
+	CColTrianglePlane plane;
+	int i;
+
+	Invert(matrix, matTransform);
+	CColLine newline(matTransform * line.p0, matTransform * line.p1);
+
+	if(!TestLineBox(newline, model.boundingBox))
+		return false;
+
+	for(i = 0; i < model.numSpheres; i++){
+		if(ignoreSeeThrough && IsSeeThrough(model.spheres[i].surface)) continue;
+		if(TestLineSphere(newline, model.spheres[i]))
+			return true;
+	}
+
+	for(i = 0; i < model.numBoxes; i++){
+		if(ignoreSeeThrough && IsSeeThrough(model.boxes[i].surface)) continue;
+		if(TestLineBox(newline, model.boxes[i]))
+			return true;
+	}
+
+#ifdef COLLISION_BVH
+	if(model.bvh){
+		int32 numTriangles = model.bvh->FindTriangles(COLBVH_LINE, &newline, nil, bvhTriangles);
+		for(int32 j = 0; j < numTriangles; j++){
+			i = bvhTriangles[j];
+			if(ignoreSeeThrough && IsSeeThrough(model.triangles[i].surface)) continue;
+			if(TestLineTriangle(newline, model.vertices, model.triangles[i], GetTrianglePlane(model, i, plane)))
+				return true;
+		}
+		return false;
+	}
+#endif
+	for(i = 0; i < model.numTriangles; i++){
+		if(ignoreSeeThrough && IsSeeThrough(model.triangles[i].surface)) continue;
+		if(TestLineTriangle(newline, model.vertices, model.triangles[i], GetTrianglePlane(model, i, plane)))
+			return true;
+	}
+
+	return false;
+}
+
+bool
+CCollision::ProcessLineOfSight(const CColLine &line, const CMatrix &matrix, const CColModel &model,
+	CColPoint &point, float &mindist, bool ignoreSeeThrough, int32 *bvhTriangles)
+{
+	CMatrix matTransform;
+	CColTrianglePlane plane;
+	int i;
+
+	Invert(matrix, matTransform);
+	CColLine newline(matTransform * line.p0, matTransform * line.p1);
+
+	if(!TestLineBox(newline, model.boundingBox))
+		return false;
+
+	float coldist = mindist;
+	for(i = 0; i < model.numSpheres; i++){
+		if(ignoreSeeThrough && IsSeeThrough(model.spheres[i].surface)) continue;
+		ProcessLineSphere(newline, model.spheres[i], point, coldist);
+	}
+
+	for(i = 0; i < model.numBoxes; i++){
+		if(ignoreSeeThrough && IsSeeThrough(model.boxes[i].surface)) continue;
+		ProcessLineBox(newline, model.boxes[i], point, coldist);
+	}
+
+#ifdef COLLISION_BVH
+	if(model.bvh){
+		int32 numTriangles = model.bvh->FindTriangles(COLBVH_LINE, &newline, nil, bvhTriangles);
+		for(int32 j = 0; j < numTriangles; j++){
+			i = bvhTriangles[j];
+			if(ignoreSeeThrough && IsSeeThrough(model.triangles[i].surface)) continue;
+			ProcessLineTriangle(newline, model.vertices, model.triangles[i], GetTrianglePlane(model, i, plane), point, coldist);
+		}
+	}else
+#endif
+	for(i = 0; i < model.numTriangles; i++){
+		if(ignoreSeeThrough && IsSeeThrough(model.triangles[i].surface)) continue;
+		ProcessLineTriangle(newline, model.vertices, model.triangles[i], GetTrianglePlane(model, i, plane), point, coldist);
+	}
+
+	if(coldist < mindist){
+		point.point = matrix * point.point;
+		point.normal = Multiply3x3(matrix, point.normal);
+		mindist = coldist;
+		return true;
+	}
+	return false;
+}
+
+// Whether the sphere touches the model, like ProcessColModels with a one sphere model A
+bool
+CCollision::TestSphereColModel(const CColSphere &sphere, const CMatrix &matrix, const CColModel &model, int32 *bvhTriangles)
+{
+	CMatrix matTransform;
+	CColTrianglePlane plane;
+	CColSphere newsphere;
+	int i;
+
+	Invert(matrix, matTransform);
+	newsphere.Set(sphere.radius, matTransform * sphere.center, sphere.surface, sphere.piece);
+
+	if(!TestSphereBox(newsphere, model.boundingBox))
+		return false;
+
+	for(i = 0; i < model.numSpheres; i++)
+		if(TestSphereSphere(newsphere, model.spheres[i]))
+			return true;
+
+	for(i = 0; i < model.numBoxes; i++)
+		if(TestSphereBox(newsphere, model.boxes[i]))
+			return true;
+
+#ifdef COLLISION_BVH
+	if(model.bvh){
+		int32 numTriangles = model.bvh->FindTriangles(COLBVH_SPHERE, nil, &newsphere, bvhTriangles);
+		for(int32 j = 0; j < numTriangles; j++){
+			i = bvhTriangles[j];
+			if(TestSphereTriangle(newsphere, model.vertices, model.triangles[i], GetTrianglePlane(model, i, plane)))
+				return true;
+		}
+		return false;
+	}
+#endif
+	for(i = 0; i < model.numTriangles; i++)
+		if(TestSphereTriangle(newsphere, model.vertices, model.triangles[i], GetTrianglePlane(model, i, plane)))
+			return true;
+
+	return false;
+}
+#endif
+
 bool
 CCollision::ProcessVerticalLine(const CColLine &line,
 	const CMatrix &matrix, CColModel &model,
@@ -2048,6 +2469,16 @@ CCollision::ProcessVerticalLine(const CColLine &line,
 
 	CalculateTrianglePlanes(&model);
 	TempStoredPoly.valid = false;
+#ifdef COLLISION_BVH
+	if(model.bvh){
+		int32 numTriangles = model.bvh->FindTriangles(COLBVH_VERTICAL_LINE, &newline, nil, aBVHTriangles);
+		for(int32 j = 0; j < numTriangles; j++){
+			i = aBVHTriangles[j];
+			if(ignoreSeeThrough && IsSeeThrough(model.triangles[i].surface)) continue;
+			ProcessVerticalLineTriangle(newline, model.vertices, model.triangles[i], model.trianglePlanes[i], point, coldist, &TempStoredPoly);
+		}
+	}else
+#endif
 	for(i = 0; i < model.numTriangles; i++){
 		if(ignoreSeeThrough && IsSeeThrough(model.triangles[i].surface)) continue;
 		ProcessVerticalLineTriangle(newline, model.vertices, model.triangles[i], model.trianglePlanes[i], point, coldist, &TempStoredPoly);
@@ -2085,6 +2516,180 @@ static uint8 fakeSPR[16*1024];
 #endif
 #endif
 
+#ifdef SIMD_COLLISION
+bool CCollision::bUseSimd = true;
+
+// Transforms sphere centres four components at a time, same order of operations as CMatrix * CVector
+static void
+TransformSpheres(CColSphere *dst, const CColSphere *src, int n, const CMatrix &mat)
+{
+	Simd4f right = Simd4Set(mat.m_matrix.right.x, mat.m_matrix.right.y, mat.m_matrix.right.z, 0.0f);
+	Simd4f up = Simd4Set(mat.m_matrix.up.x, mat.m_matrix.up.y, mat.m_matrix.up.z, 0.0f);
+	Simd4f at = Simd4Set(mat.m_matrix.at.x, mat.m_matrix.at.y, mat.m_matrix.at.z, 0.0f);
+	Simd4f pos = Simd4Set(mat.m_matrix.pos.x, mat.m_matrix.pos.y, mat.m_matrix.pos.z, 0.0f);
+	for(int i = 0; i < n; i++){
+		const CColSphere &s = src[i];
+		Simd4f v = Simd4Add(Simd4Add(Simd4Add(Simd4Mul(right, Simd4Splat(s.center.x)), Simd4Mul(up, Simd4Splat(s.center.y))),
+			Simd4Mul(at, Simd4Splat(s.center.z))), pos);
+		// CColSphere is laid out like a CVuVector, the w lane lands on the radius
+		Simd4Store(&dst[i].center.x, v);
+		dst[i].radius = s.radius;
+		dst[i].surface = s.surface;
+		dst[i].piece = s.piece;
+	}
+}
+
+static void
+TransformLines(CColLine *dst, const CColLine *src, int n, const CMatrix &mat)
+{
+	Simd4f right = Simd4Set(mat.m_matrix.right.x, mat.m_matrix.right.y, mat.m_matrix.right.z, 0.0f);
+	Simd4f up = Simd4Set(mat.m_matrix.up.x, mat.m_matrix.up.y, mat.m_matrix.up.z, 0.0f);
+	Simd4f at = Simd4Set(mat.m_matrix.at.x, mat.m_matrix.at.y, mat.m_matrix.at.z, 0.0f);
+	Simd4f pos = Simd4Set(mat.m_matrix.pos.x, mat.m_matrix.pos.y, mat.m_matrix.pos.z, 0.0f);
+	for(int i = 0; i < n; i++){
+		const CColLine &l = src[i];
+		Simd4Store(&dst[i].p0.x, Simd4Add(Simd4Add(Simd4Add(Simd4Mul(right, Simd4Splat(l.p0.x)), Simd4Mul(up, Simd4Splat(l.p0.y))),
+			Simd4Mul(at, Simd4Splat(l.p0.z))), pos));
+		Simd4Store(&dst[i].p1.x, Simd4Add(Simd4Add(Simd4Add(Simd4Mul(right, Simd4Splat(l.p1.x)), Simd4Mul(up, Simd4Splat(l.p1.y))),
+			Simd4Mul(at, Simd4Splat(l.p1.z))), pos));
+	}
+}
+
+// Same test as CCollision::TestSphereBox on four spheres at once.
+// Appends the indices (plus base) of the spheres touching the box.
+static int
+FindSpheresTouchingBox(const CColSphere *spheres, int n, const CColBox &box, int base, int *indices)
+{
+	int num = 0;
+	Simd4f minx = Simd4Splat(box.min.x), maxx = Simd4Splat(box.max.x);
+	Simd4f miny = Simd4Splat(box.min.y), maxy = Simd4Splat(box.max.y);
+	Simd4f minz = Simd4Splat(box.min.z), maxz = Simd4Splat(box.max.z);
+	for(int i = 0; i < n; i += 4){
+		const CColSphere &s0 = spheres[i];
+		const CColSphere &s1 = spheres[Min(i+1, n-1)];
+		const CColSphere &s2 = spheres[Min(i+2, n-1)];
+		const CColSphere &s3 = spheres[Min(i+3, n-1)];
+		Simd4f x = Simd4Set(s0.center.x, s1.center.x, s2.center.x, s3.center.x);
+		Simd4f y = Simd4Set(s0.center.y, s1.center.y, s2.center.y, s3.center.y);
+		Simd4f z = Simd4Set(s0.center.z, s1.center.z, s2.center.z, s3.center.z);
+		Simd4f r = Simd4Set(s0.radius, s1.radius, s2.radius, s3.radius);
+		int outside = Simd4Less(Simd4Add(x, r), minx) | Simd4Greater(Simd4Sub(x, r), maxx) |
+			Simd4Less(Simd4Add(y, r), miny) | Simd4Greater(Simd4Sub(y, r), maxy) |
+			Simd4Less(Simd4Add(z, r), minz) | Simd4Greater(Simd4Sub(z, r), maxz);
+		for(int j = 0; j < 4 && i+j < n; j++)
+			if((outside & (1<<j)) == 0)
+				indices[num++] = base + i + j;
+	}
+	return num;
+}
+
+// Rejects four triangles at once whose plane is further than maxDist from the sphere centre,
+// like the first test in TestSphereTriangle and ProcessSphereTriangle.
+// Returns a bit for every triangle that still needs the full test.
+static int
+TestSphereTrianglePlanes4(const CColSphere &sphere, float maxDistSq, const CColTrianglePlane *planes, const int *tris, int n)
+{
+	const CColTrianglePlane &p0 = planes[tris[0]];
+	const CColTrianglePlane &p1 = planes[tris[Min(1, n-1)]];
+	const CColTrianglePlane &p2 = planes[tris[Min(2, n-1)]];
+	const CColTrianglePlane &p3 = planes[tris[Min(3, n-1)]];
+	Simd4f nx = Simd4Set(p0.normal.x, p1.normal.x, p2.normal.x, p3.normal.x);
+	Simd4f ny = Simd4Set(p0.normal.y, p1.normal.y, p2.normal.y, p3.normal.y);
+	Simd4f nz = Simd4Set(p0.normal.z, p1.normal.z, p2.normal.z, p3.normal.z);
+	Simd4f d = Simd4Set(p0.dist, p1.dist, p2.dist, p3.dist);
+	Simd4f planedist = Simd4Sub(Simd4Add(Simd4Add(Simd4Mul(nx, Simd4Splat(sphere.center.x)), Simd4Mul(ny, Simd4Splat(sphere.center.y))),
+		Simd4Mul(nz, Simd4Splat(sphere.center.z))), d);
+	int outside = Simd4Greater(Simd4Abs(planedist), Simd4Splat(sphere.radius)) |
+		Simd4Greater(Simd4Mul(planedist, planedist), Simd4Splat(maxDistSq));
+	return ~outside & ((1<<Min(n, 4)) - 1);
+}
+
+// Candidates are the triangles to look at, or all of them if nil
+static int
+FindTrianglesTouchingSphere(const CColSphere &sphere, CColModel &model, const int32 *candidates, int numCandidates, int *indices)
+{
+	int32 aTriangles[4];
+	int num = 0;
+	for(int i = 0; i < numCandidates; i += 4){
+		int n = Min(numCandidates - i, 4);
+		for(int j = 0; j < n; j++)
+			aTriangles[j] = candidates ? candidates[i+j] : i+j;
+		int mask = TestSphereTrianglePlanes4(sphere, 1.0e24f, model.trianglePlanes, aTriangles, n);
+		for(int j = 0; j < n; j++)
+			if(mask & (1<<j) &&
+			   CCollision::TestSphereTriangle(sphere, model.vertices, model.triangles[aTriangles[j]], model.trianglePlanes[aTriangles[j]]))
+				indices[num++] = aTriangles[j];
+	}
+	return num;
+}
+
+#ifndef MASTER
+static float
+GetColPointError(const CColPoint &a, const CColPoint &b)
+{
+	return Max(Max((a.point - b.point).Magnitude(), (a.normal - b.normal).Magnitude()), Abs(a.depth - b.depth));
+}
+
+// Runs ProcessColModels with and without SIMD on every loaded col model and reports differences
+void
+CCollision::CheckSimdCollision(void)
+{
+	static CColPoint aSpherePoints[2][MAXNUMSPHERES];	// the non-VU path doesn't clamp to MAX_COLLISION_POINTS
+	static CColPoint aLinePoints[2][MAXNUMLINES];
+	static float aLineDists[2][MAXNUMLINES];
+	const float tolerance = 0.001f;
+	bool useSimd = bUseSimd;
+	int numModels = 0, numTests = 0, numMismatches = 0;
+
+	for(int i = 0; i < MODELINFOSIZE; i++){
+		CBaseModelInfo *mi = CModelInfo::GetModelInfo(i);
+		if(mi == nil || mi->GetColModel() == nil)
+			continue;
+		CColModel &model = *mi->GetColModel();
+		if(model.numSpheres == 0 && model.numBoxes == 0 && model.numTriangles == 0)
+			continue;
+		numModels++;
+
+		// collide the model against itself and against the ped col model from a few directions
+		for(int test = 0; test < 8; test++){
+			// the buffers of ProcessColModels are sized for vehicles and objects
+			if(test < 4 && (model.numSpheres > MAXNUMSPHERES || model.numTriangles > MAXNUMTRIS))
+				continue;
+			CColModel &modelA = test < 4 ? model : CTempColModels::ms_colModelPed1;
+			CMatrix matA, matB;
+			matB.SetUnity();
+			matA.SetRotateZ(test * HALFPI + 0.3f);
+			matA.GetPosition() = model.boundingSphere.center +
+				CVector(Cos(test * HALFPI), Sin(test * HALFPI), 0.25f) * model.boundingSphere.radius * 0.5f;
+
+			int numCollisions[2];
+			for(int simd = 0; simd < 2; simd++){
+				bUseSimd = simd == 1;
+				for(int l = 0; l < MAXNUMLINES; l++)
+					aLineDists[simd][l] = 1.0f;
+				numCollisions[simd] = ProcessColModels(matA, modelA, matB, model,
+					aSpherePoints[simd], aLinePoints[simd], aLineDists[simd]);
+			}
+			numTests++;
+
+			bool mismatch = numCollisions[0] != numCollisions[1];
+			for(int c = 0; !mismatch && c < numCollisions[0]; c++)
+				mismatch = GetColPointError(aSpherePoints[0][c], aSpherePoints[1][c]) > tolerance;
+			for(int l = 0; !mismatch && l < modelA.numLines; l++)
+				mismatch = Abs(aLineDists[0][l] - aLineDists[1][l]) > tolerance ||
+					aLineDists[0][l] < 1.0f && GetColPointError(aLinePoints[0][l], aLinePoints[1][l]) > tolerance;
+			if(mismatch){
+				debug("SIMD collision mismatch: model %d test %d (%d vs %d collisions)\n", i, test, numCollisions[0], numCollisions[1]);
+				numMismatches++;
+			}
+		}
+	}
+	bUseSimd = useSimd;
+	debug("SIMD collision check: %d models, %d tests, %d mismatches\n", numModels, numTests, numMismatches);
+}
+#endif
+#endif
+
 // This checks model A's spheres and lines against model B's spheres, boxes and triangles.
 // Returns the number of A's spheres that collide.
 // Returned ColPoints are in world space.
@@ -2403,6 +3008,9 @@ CCollision::ProcessColModels(const CMatrix &matrixA, CColModel &modelA,
 	static int aTriangleIndicesB[MAXNUMTRIS];
 	static bool aCollided[MAXNUMLINES];
 	static CColSphere aSpheresA[MAXNUMSPHERES];
+#ifdef SIMD_COLLISION
+	static CColSphere aSpheresB[MAXNUMSPHERES];
+#endif
 	static CColLine aLinesA[MAXNUMLINES];
 	static CMatrix matAB, matBA;
 	CColSphere s;
@@ -2424,16 +3032,29 @@ CCollision::ProcessColModels(const CMatrix &matrixA, CColModel &modelA,
 	matBA *= matrixB;
 
 	// transform modelA's spheres and lines to B space
-	for(i = 0; i < modelA.numSpheres; i++){
-		CColSphere &s = modelA.spheres[i];
-		aSpheresA[i].Set(s.radius, matAB * s.center, s.surface, s.piece);
+#ifdef SIMD_COLLISION
+	if(bUseSimd){
+		TransformSpheres(aSpheresA, modelA.spheres, modelA.numSpheres, matAB);
+		TransformLines(aLinesA, modelA.lines, modelA.numLines, matAB);
+	}else
+#endif
+	{
+		for(i = 0; i < modelA.numSpheres; i++){
+			CColSphere &s = modelA.spheres[i];
+			aSpheresA[i].Set(s.radius, matAB * s.center, s.surface, s.piece);
+		}
+		for(i = 0; i < modelA.numLines; i++)
+			aLinesA[i].Set(matAB * modelA.lines[i].p0, matAB * modelA.lines[i].p1);
 	}
-	for(i = 0; i < modelA.numLines; i++)
-		aLinesA[i].Set(matAB * modelA.lines[i].p0, matAB * modelA.lines[i].p1);
 
 	// Test them against model B's bounding volumes
 	int numSpheresA = 0;
 	int numLinesA = 0;
+#ifdef SIMD_COLLISION
+	if(bUseSimd)
+		numSpheresA = FindSpheresTouchingBox(aSpheresA, modelA.numSpheres, modelB.boundingBox, 0, aSphereIndicesA);
+	else
+#endif
 	for(i = 0; i < modelA.numSpheres; i++)
 		if(TestSphereBox(aSpheresA[i], modelB.boundingBox))
 			aSphereIndicesA[numSpheresA++] = i;
@@ -2448,6 +3069,16 @@ CCollision::ProcessColModels(const CMatrix &matrixA, CColModel &modelA,
 	int numSpheresB = 0;
 	int numBoxesB = 0;
 	int numTrianglesB = 0;
+#ifdef SIMD_COLLISION
+	if(bUseSimd){
+		// B may have more spheres than fit the buffer, do them in batches
+		for(i = 0; i < modelB.numSpheres; i += MAXNUMSPHERES){
+			int n = Min(modelB.numSpheres - i, MAXNUMSPHERES);
+			TransformSpheres(aSpheresB, &modelB.spheres[i], n, matBA);
+			numSpheresB += FindSpheresTouchingBox(aSpheresB, n, modelA.boundingBox, i, &aSphereIndicesB[numSpheresB]);
+		}
+	}else
+#endif
 	for(i = 0; i < modelB.numSpheres; i++){
 		s.Set(modelB.spheres[i].radius, matBA * modelB.spheres[i].center);
 		if(TestSphereBox(s, modelA.boundingBox))
@@ -2457,6 +3088,26 @@ CCollision::ProcessColModels(const CMatrix &matrixA, CColModel &modelA,
 		if(TestSphereBox(bsphereAB, modelB.boxes[i]))
 			aBoxIndicesB[numBoxesB++] = i;
 	CalculateTrianglePlanes(&modelB);
+#ifdef COLLISION_BVH
+	if(modelB.bvh){
+		int32 numCandidates = modelB.bvh->FindTriangles(COLBVH_SPHERE, nil, &bsphereAB, aBVHTriangles);
+#ifdef SIMD_COLLISION
+		if(bUseSimd)
+			numTrianglesB = FindTrianglesTouchingSphere(bsphereAB, modelB, aBVHTriangles, numCandidates, aTriangleIndicesB);
+		else
+#endif
+		for(j = 0; j < numCandidates; j++){
+			i = aBVHTriangles[j];
+			if(TestSphereTriangle(bsphereAB, modelB.vertices, modelB.triangles[i], modelB.trianglePlanes[i]))
+				aTriangleIndicesB[numTrianglesB++] = i;
+		}
+	}else
+#endif
+#ifdef SIMD_COLLISION
+	if(bUseSimd)
+		numTrianglesB = FindTrianglesTouchingSphere(bsphereAB, modelB, nil, modelB.numTriangles, aTriangleIndicesB);
+	else
+#endif
 	for(i = 0; i < modelB.numTriangles; i++)
 		if(TestSphereTriangle(bsphereAB, modelB.vertices, modelB.triangles[i], modelB.trianglePlanes[i]))
 			aTriangleIndicesB[numTrianglesB++] = i;
@@ -2485,6 +3136,23 @@ CCollision::ProcessColModels(const CMatrix &matrixA, CColModel &modelA,
 				aSpheresA[aSphereIndicesA[i]],
 				modelB.boxes[aBoxIndicesB[j]],
 				spherepoints[numCollisions], coldist);
+#ifdef SIMD_COLLISION
+		if(bUseSimd){
+			// coldist only shrinks, so rejecting against the value at the start of a group is safe
+			for(j = 0; j < numTrianglesB; j += 4){
+				int mask = TestSphereTrianglePlanes4(aSpheresA[aSphereIndicesA[i]], coldist,
+					modelB.trianglePlanes, &aTriangleIndicesB[j], numTrianglesB - j);
+				for(int k = 0; mask; k++, mask >>= 1)
+					if(mask & 1)
+						hasCollided |= ProcessSphereTriangle(
+							aSpheresA[aSphereIndicesA[i]],
+							modelB.vertices,
+							modelB.triangles[aTriangleIndicesB[j+k]],
+							modelB.trianglePlanes[aTriangleIndicesB[j+k]],
+							spherepoints[numCollisions], coldist);
+			}
+		}else
+#endif
 		for(j = 0; j < numTrianglesB; j++)
 			hasCollided |= ProcessSphereTriangle(
 				aSpheresA[aSphereIndicesA[i]],
@@ -3120,6 +3788,9 @@ CColModel::CColModel(void)
 	vertices = nil;
 	triangles = nil;
 	trianglePlanes = nil;
+#ifdef COLLISION_BVH
+	bvh = nil;
+#endif
 	level = CGame::currLevel;
 	ownsCollisionVolumes = true;
 }
@@ -3139,6 +3810,9 @@ CColModel::RemoveCollisionVolumes(void)
 		RwFree(boxes);
 		RwFree(vertices);
 		RwFree(triangles);
+#ifdef COLLISION_BVH
+		RwFree(bvh);
+#endif
 	}
 	numSpheres = 0;
 	numLines = 0;
@@ -3149,6 +3823,9 @@ CColModel::RemoveCollisionVolumes(void)
 	boxes = nil;
 	vertices = nil;
 	triangles = nil;
+#ifdef COLLISION_BVH
+	bvh = nil;
+#endif
 }
 
 void
@@ -3286,5 +3963,16 @@ CColModel::operator=(const CColModel &other)
 			RwFree(vertices);
 		vertices = nil;
 	}
+
+#ifdef COLLISION_BVH
+	// copy tree, triangles are already in its order
+	if(bvh)
+		RwFree(bvh);
+	bvh = nil;
+	if(other.bvh){
+		bvh = (CColBVH*)RwMalloc(other.bvh->GetSize());
+		memcpy(bvh, other.bvh, other.bvh->GetSize());
+	}
+#endif
 	return *this;
 }
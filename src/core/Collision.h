@@ -178,6 +178,43 @@ struct CStoredCollPoly
 	bool valid;
 };
 
+#ifdef COLLISION_BVH
+// Node of the triangle tree of a big CColModel, bounds are quantised to the tree's box
+struct CColBVHNode
+{
+	uint16 min[3];
+	uint16 max[3];
+	uint16 first;	// first triangle of a leaf, second child of an inner node (the first child follows the node)
+	uint16 numTriangles;	// 0 for inner nodes
+};
+
+enum {
+	COLBVH_LINE,
+	COLBVH_VERTICAL_LINE,
+	COLBVH_SPHERE
+};
+
+enum {
+	COLBVH_MIN_TRIANGLES = 64,	// smaller models just test all their triangles
+	COLBVH_LEAF_TRIANGLES = 8,
+	COLBVH_MAX_DEPTH = 32,
+	COLBVH_MAX_TRIANGLES = 0x8000
+};
+
+struct CColBVH
+{
+	CVector origin;
+	CVector step;	// size of one quantisation unit
+	int32 numNodes;
+	CColBVHNode nodes[1];	// numNodes of them
+
+	static CColBVH *Build(struct CColModel &model);
+	int32 GetSize(void) const { return sizeof(CColBVH) + (numNodes-1)*sizeof(CColBVHNode); }
+	// Writes the indices of the triangles in leaves touched by the line or sphere, in ascending order
+	int32 FindTriangles(int32 type, const CColLine *line, const CColSphere *sphere, int32 *triangles) const;
+};
+#endif
+
 struct CColModel
 {
 	CColSphere boundingSphere;
@@ -194,6 +231,9 @@ struct CColModel
 	CompressedVector *vertices;
 	CColTriangle *triangles;
 	CColTrianglePlane *trianglePlanes;
+#ifdef COLLISION_BVH
+	CColBVH *bvh;	// only for models with many triangles, which are stored in tree order
+#endif
 
 	CColModel(void);
 	~CColModel(void);
@@ -215,6 +255,9 @@ public:
 #ifdef NO_ISLAND_LOADING
 	static bool bAlreadyLoaded;
 #endif
+#ifdef SIMD_COLLISION
+	static bool bUseSimd;
+#endif
 
 	static void Init(void);
 	static void Shutdown(void);
@@ -247,8 +290,21 @@ public:
 	static bool ProcessLineOfSight(const CColLine &line, const CMatrix &matrix, CColModel &model, CColPoint &point, float &mindist, bool ignoreSeeThrough);
 	static bool ProcessVerticalLine(const CColLine &line, const CMatrix &matrix, CColModel &model, CColPoint &point, float &mindist, bool ignoreSeeThrough, CStoredCollPoly *poly);
 	static int32 ProcessColModels(const CMatrix &matrixA, CColModel &modelA, const CMatrix &matrixB, CColModel &modelB, CColPoint *spherepoints, CColPoint *linepoints, float *linedists);
+#ifdef CONCURRENT_WORLD_QUERIES
+	// Read only versions for queries that may run on several threads at once. They leave the
+	// triangle plane cache alone and need room for COLBVH_MAX_TRIANGLES in bvhTriangles.
+	static bool TestLineOfSight(const CColLine &line, const CMatrix &matrix, const CColModel &model, bool ignoreSeeThrough, int32 *bvhTriangles);
+	static bool ProcessLineOfSight(const CColLine &line, const CMatrix &matrix, const CColModel &model, CColPoint &point, float &mindist, bool ignoreSeeThrough, int32 *bvhTriangles);
+	static bool TestSphereColModel(const CColSphere &sphere, const CMatrix &matrix, const CColModel &model, int32 *bvhTriangles);
+#endif
 	static bool IsStoredPolyStillValidVerticalLine(const CVector &pos, float z, CColPoint &point, CStoredCollPoly *poly);
 
 	static float DistToLine(const CVector *l0, const CVector *l1, const CVector *point);
 	static float DistToLine(const CVector *l0, const CVector *l1, const CVector *point, CVector &closest);
+#if defined SIMD_COLLISION && !defined MASTER
+	static void CheckSimdCollision(void);
+#endif
+#if defined COLLISION_BVH && !defined MASTER
+	static void ReportBVHMemory(void);
+#endif
 };
@@ -0,0 +1,144 @@
+#include "common.h"
+
+#include "Object.h"
+#include "Ped.h"
+#include "Pools.h"
+#include "Timer.h"
+#include "Vehicle.h"
+#include "World.h"
+#include "CollisionIslands.h"
+
+#define ISLAND_SLEEP_FRAMES (8)
+#define ISLAND_SLEEP_SPEED (0.005f)	// per unit of time step, a bit above what CPhysical::ProcessControl calls static
+#define MAX_ISLAND_NODES (NUMOBJECTS + NUMVEHICLES + NUMPEDS)
+
+bool CCollisionIslands::ms_bCollectContacts;
+bool CCollisionIslands::bUseIslands = true;
+int32 CCollisionIslands::ms_nNumSleeping;
+int32 CCollisionIslands::ms_aNumProcessed[NUM_COLLISIONPASSES];
+
+// union find over pool slots: objects, then vehicles, then peds
+static int16 aParents[MAX_ISLAND_NODES];
+static CPhysical *aEntities[MAX_ISLAND_NODES];	// whose rest frames these are
+static uint8 aRestFrames[MAX_ISLAND_NODES];
+static uint8 aIslandRestFrames[MAX_ISLAND_NODES];	// of the root, min over the island
+static bool aIslandResting[MAX_ISLAND_NODES];
+
+static int32
+GetNode(CEntity *ent)
+{
+	int32 slot;
+	switch(ent->GetType()){
+	case ENTITY_TYPE_OBJECT:
+		slot = CPools::GetObjectPool()->GetJustIndex((CObject*)ent);
+		return slot >= 0 && slot < NUMOBJECTS ? slot : -1;
+	case ENTITY_TYPE_VEHICLE:
+		slot = CPools::GetVehiclePool()->GetJustIndex((CVehicle*)ent);
+		return slot >= 0 && slot < NUMVEHICLES ? NUMOBJECTS + slot : -1;
+	case ENTITY_TYPE_PED:
+		slot = CPools::GetPedPool()->GetJustIndex((CPed*)ent);
+		return slot >= 0 && slot < NUMPEDS ? NUMOBJECTS + NUMVEHICLES + slot : -1;
+	default:
+		return -1;
+	}
+}
+
+static int32
+FindRoot(int32 i)
+{
+	while(aParents[i] != i){
+		aParents[i] = aParents[aParents[i]];
+		i = aParents[i];
+	}
+	return i;
+}
+
+static bool
+IsResting(CPhysical *ent)
+{
+	if(ent->GetStatus() == STATUS_PLAYER || ent->GetStatus() == STATUS_SIMPLE ||
+	   ent->IsPed() && ((CPed*)ent)->IsPlayer())
+		return false;
+	float step = CTimer::GetTimeStep() * ISLAND_SLEEP_SPEED;
+	return ent->m_vecMoveSpeed.MagnitudeSqr() < SQR(step) &&
+		ent->m_vecTurnSpeed.MagnitudeSqr() < SQR(step);
+}
+
+void
+CCollisionIslands::BeginFrame(void)
+{
+	int32 i;
+	for(i = 0; i < MAX_ISLAND_NODES; i++){
+		aParents[i] = i;
+		aIslandRestFrames[i] = ISLAND_SLEEP_FRAMES;
+		aIslandResting[i] = true;
+	}
+	for(i = 0; i < NUM_COLLISIONPASSES; i++)
+		ms_aNumProcessed[i] = 0;
+	ms_nNumSleeping = 0;
+	for(CPtrNode *node = CWorld::GetMovingEntityList().first; node; node = node->next)
+		((CPhysical*)node->item)->bIsSleeping = false;
+	ms_bCollectContacts = bUseIslands;
+}
+
+// Called for every collision between two physicals. Only contacts between
+// entities on the moving list join islands, static ones are like buildings.
+void
+CCollisionIslands::AddContact(CPhysical *a, CEntity *b)
+{
+	if(!ms_bCollectContacts)
+		return;
+	int32 i = GetNode(a);
+	int32 j = GetNode(b);
+	if(i < 0 || j < 0 ||
+	   a->m_movingListNode == nil || ((CPhysical*)b)->m_movingListNode == nil)
+		return;
+	i = FindRoot(i);
+	j = FindRoot(j);
+	if(i != j)
+		aParents[i] = j;
+}
+
+// After the first collision pass. Entities of islands that have been resting long
+// enough are put to sleep so the passes after it skip them.
+void
+CCollisionIslands::PutRestingIslandsToSleep(void)
+{
+	CPtrNode *node;
+	int32 i, root;
+
+	if(!ms_bCollectContacts)
+		return;
+	ms_bCollectContacts = false;
+
+	for(node = CWorld::GetMovingEntityList().first; node; node = node->next){
+		CPhysical *ent = (CPhysical*)node->item;
+		i = GetNode(ent);
+		if(i < 0)
+			continue;
+		if(aEntities[i] != ent){
+			aEntities[i] = ent;
+			aRestFrames[i] = 0;
+		}
+		root = FindRoot(i);
+		aIslandResting[root] = aIslandResting[root] && IsResting(ent);
+		aIslandRestFrames[root] = Min(aIslandRestFrames[root], aRestFrames[i]);
+	}
+
+	for(node = CWorld::GetMovingEntityList().first; node; node = node->next){
+		CPhysical *ent = (CPhysical*)node->item;
+		i = GetNode(ent);
+		if(i < 0)
+			continue;
+		root = FindRoot(i);
+		if(!aIslandResting[root]){
+			aRestFrames[i] = 0;
+			continue;
+		}
+		aRestFrames[i] = Min(aIslandRestFrames[root] + 1, ISLAND_SLEEP_FRAMES);
+		if(aRestFrames[i] == ISLAND_SLEEP_FRAMES){
+			ent->bIsSleeping = true;
+			ms_nNumSleeping++;
+		}
+	}
+}
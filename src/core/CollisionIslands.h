@@ -0,0 +1,35 @@
+#pragma once
+
+// Entities that touched each other in the first collision pass of CWorld::Process form
+// an island. Once every entity of an island has been slow for a few frames the island
+// sleeps: its entities still get the first pass every frame, but not the retries and
+// shifts after it. Anything fast touching the island joins it and wakes it up again.
+
+class CEntity;
+class CPhysical;
+
+enum
+{
+	COLLISIONPASS_FIRST,
+	COLLISIONPASS_RETRY1,
+	COLLISIONPASS_RETRY2,
+	COLLISIONPASS_RETRY3,
+	COLLISIONPASS_RETRY4,
+	COLLISIONPASS_STUCK,
+	COLLISIONPASS_SHIFT,
+	COLLISIONPASS_SECOND_SHIFT,
+	NUM_COLLISIONPASSES
+};
+
+class CCollisionIslands
+{
+	static bool ms_bCollectContacts;
+public:
+	static bool bUseIslands;
+	static int32 ms_nNumSleeping;
+	static int32 ms_aNumProcessed[NUM_COLLISIONPASSES];	// last frame, for the debug menu
+
+	static void BeginFrame(void);
+	static void AddContact(CPhysical *a, CEntity *b);
+	static void PutRestingIslandsToSleep(void);
+};
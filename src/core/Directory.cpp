@@ -4,15 +4,46 @@
 #include "FileMgr.h"
 #include "Directory.h"
 
+#ifdef HASHED_NAME_LOOKUPS
+int32 CDirectory::ms_nNumLookups;
+int32 CDirectory::ms_nNumCompares;
+int32 CDirectory::ms_nNumLinearCompares;
+#endif
+
 CDirectory::CDirectory(int32 maxEntries)
  : numEntries(0), maxEntries(maxEntries)
 {
 	entries = new DirectoryInfo[maxEntries];
+#ifdef HASHED_NAME_LOOKUPS
+	int32 numBuckets = 16;
+	while(numBuckets < maxEntries)
+		numBuckets *= 2;
+	hashMask = numBuckets-1;
+	hashHeads = new int32[numBuckets];
+	hashNext = new int32[maxEntries];
+	for(int32 i = 0; i < numBuckets; i++)
+		hashHeads[i] = -1;
+#endif
 }
 
 CDirectory::~CDirectory(void)
 {
 	delete[] entries;
+#ifdef HASHED_NAME_LOOKUPS
+	delete[] hashHeads;
+	delete[] hashNext;
+#endif
+}
+
+// Removes all entries, so the directory can be read again
+void
+CDirectory::Clear(void)
+{
+	numEntries = 0;
+#ifdef HASHED_NAME_LOOKUPS
+	for(uint32 i = 0; i <= hashMask; i++)
+		hashHeads[i] = -1;
+#endif
 }
 
 void
@@ -25,6 +56,9 @@ CDirectory::ReadDirFile(const char *filename)
 	while(CFileMgr::Read(fd, (char*)&dirinfo, sizeof(dirinfo)))
 		AddItem(dirinfo);
 	CFileMgr::CloseFile(fd);
+#if defined HASHED_NAME_LOOKUPS && !defined MASTER
+	assert(CheckHashChains());
+#endif
 }
 
 bool
@@ -47,6 +81,13 @@ CDirectory::AddItem(const DirectoryInfo &dirinfo)
 	uint32 offset, size;
 	if(FindItem(dirinfo.name, offset, size))
 		return;
+#endif
+#ifdef HASHED_NAME_LOOKUPS
+	int32 *link = &hashHeads[CGeneral::GetUppercaseKey(dirinfo.name) & hashMask];
+	while(*link != -1)
+		link = &hashNext[*link];
+	*link = numEntries;
+	hashNext[numEntries] = -1;
 #endif
 	entries[numEntries++] = dirinfo;
 }
@@ -64,6 +105,20 @@ CDirectory::FindItem(const char *name, uint32 &offset, uint32 &size)
 {
 	int i;
 
+#ifdef HASHED_NAME_LOOKUPS
+	ms_nNumLookups++;
+	for(i = hashHeads[CGeneral::GetUppercaseKey(name) & hashMask]; i != -1; i = hashNext[i]){
+		ms_nNumCompares++;
+		if(!CGeneral::faststricmp(entries[i].name, name)){
+			ms_nNumLinearCompares += i+1;
+			offset = entries[i].offset;
+			size = entries[i].size;
+			return true;
+		}
+	}
+	ms_nNumLinearCompares += numEntries;
+	return false;
+#else
 	for(i = 0; i < numEntries; i++)
 		if(!CGeneral::faststricmp(entries[i].name, name)){
 			offset = entries[i].offset;
@@ -71,4 +126,34 @@ CDirectory::FindItem(const char *name, uint32 &offset, uint32 &size)
 			return true;
 		}
 	return false;
+#endif
+}
+
+#ifdef HASHED_NAME_LOOKUPS
+void
+CDirectory::DumpLookupStats(void)
+{
+	debug("CDirectory: %d lookups, %d name compares, %d without the hash tables\n",
+		ms_nNumLookups, ms_nNumCompares, ms_nNumLinearCompares);
 }
+
+#ifndef MASTER
+// Every entry has to be in the chain of its bucket once, and the chains must hold
+// nothing else. Chains left over from before the entries were reset break this.
+bool
+CDirectory::CheckHashChains(void)
+{
+	int32 i, numLinked;
+
+	numLinked = 0;
+	for(uint32 bucket = 0; bucket <= hashMask; bucket++)
+		for(i = hashHeads[bucket]; i != -1; i = hashNext[i]){
+			if(i >= numEntries || numLinked >= numEntries ||
+			   (CGeneral::GetUppercaseKey(entries[i].name) & hashMask) != bucket)
+				return false;
+			numLinked++;
+		}
+	return numLinked == numEntries;
+}
+#endif
+#endif
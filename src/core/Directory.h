@@ -11,10 +11,24 @@ public:
 	DirectoryInfo *entries;
 	int32 maxEntries;
 	int32 numEntries;
+#ifdef HASHED_NAME_LOOKUPS
+	int32 *hashHeads;	// first entry of each bucket, -1 if none
+	int32 *hashNext;	// buckets are in entry order, so duplicates find the first entry like before
+	uint32 hashMask;
+
+	static int32 ms_nNumLookups;
+	static int32 ms_nNumCompares;
+	static int32 ms_nNumLinearCompares;	// what scanning all entries would have taken
+	static void DumpLookupStats(void);
+#ifndef MASTER
+	bool CheckHashChains(void);
+#endif
+#endif
 
 	CDirectory(int32 maxEntries);
 	~CDirectory(void);
 
+	void Clear(void);
 	void ReadDirFile(const char *filename);
 	bool WriteDirFile(const char *filename);
 	void AddItem(const DirectoryInfo &dirinfo);
@@ -24,6 +24,7 @@
 #include "ZoneCull.h"
 #include "CdStream.h"
 #include "FileLoader.h"
+#include "WorldCache.h"
 
 char CFileLoader::ms_line[256];
 
@@ -114,6 +115,9 @@ CFileLoader::LoadLevel(const char *filename)
 
 	CFileMgr::CloseFile(fd);
 	RwTexDictionarySetCurrent(savedTxd);
+#ifdef WORLD_CACHE
+	CWorldCache::Save();
+#endif
 }
 
 void
@@ -286,6 +290,10 @@ CFileLoader::LoadCollisionModel(uint8 *buf, CColModel &model, char *modelname)
 		}
 	}else
 		model.triangles = nil;
+
+#ifdef COLLISION_BVH
+	model.bvh = CColBVH::Build(model);
+#endif
 }
 
 static void
@@ -494,6 +502,218 @@ CFileLoader::AddTexDictionaries(RwTexDictionary *dst, RwTexDictionary *src)
 	RwTexDictionaryForAllTextures(src, MoveTexturesCB, dst);
 }
 
+// What the lines of the IDE, IPL and zone files parse into. The loaders
+// parse a line into its record and then add what it describes from there,
+// so the world cache can keep the records and add them again later.
+enum
+{
+	RECORD_OBJECT,
+	RECORD_MLO,
+	RECORD_MLOINSTANCE,
+	RECORD_TIMEOBJECT,
+	RECORD_CLUMPOBJECT,
+	RECORD_VEHICLEOBJECT,
+	RECORD_PEDOBJECT,
+	RECORD_PATHNODE,
+	RECORD_2DEFFECT,
+	RECORD_INSTANCE,
+	RECORD_ZONE,
+	RECORD_MAPZONE,
+	RECORD_CULLZONE,
+	NUM_RECORDS
+};
+
+struct tObjectRecord
+{
+	int id, numObjs;
+	char model[24], txd[24];
+	float dist[3];
+	uint32 flags;
+	int timeOn, timeOff;
+	int damaged;
+};
+
+struct tMloRecord
+{
+	char name[24];
+	int modelIndex;
+	float someFloat;
+};
+
+struct tMloInstanceRecord
+{
+	int id;
+	int modelIndex;
+	RwV3d pos, scale, rot;
+	float angle;
+};
+
+struct tVehicleRecord
+{
+	int id;
+	char model[24], txd[24];
+	char type[8], handlingId[16], gamename[32], vehclass[12];
+	uint32 frequency, comprules;
+	int32 level, misc;
+	float wheelScale;
+};
+
+struct tPedRecord
+{
+	int id;
+	char model[24], txd[24];
+	char pedType[24], pedStats[24], animGroup[24];
+	int carsCanDrive;
+};
+
+struct tPathNodeRecord
+{
+	int id, node;
+	int type, next, cross, numLeft, numRight;
+	float x, y, z;
+	bool ped;
+};
+
+struct t2dEffectRecord
+{
+	int id, r, g, b, a, type;
+	float x, y, z;
+	char corona[32], shadow[32];
+	float dist, range, size, shadowSize;
+	int shadowIntens, lightType, roadReflection, flare, flags, probability;
+	int particleType;
+	CVector dir;
+	float scale;
+};
+
+struct tInstanceRecord
+{
+	int id;
+	RwV3d trans, axis;
+	float angle;
+};
+
+struct tZoneRecord
+{
+	char name[24];
+	int type, level;
+	float minx, miny, minz;
+	float maxx, maxy, maxz;
+};
+
+struct tCullZoneRecord
+{
+	CVector pos;
+	float minx, miny, minz;
+	float maxx, maxy, maxz;
+	int flags;
+	int wantedLevelDrop;
+};
+
+#ifdef WORLD_CACHE
+#define CACHE_RECORD(type, rec) CWorldCache::Record(type, &rec, sizeof(rec))
+
+// what ReplayRecords casts the data of every type to
+static const int32 aRecordSizes[NUM_RECORDS] = {
+	sizeof(tObjectRecord),
+	sizeof(tMloRecord),
+	sizeof(tMloInstanceRecord),
+	sizeof(tObjectRecord),
+	sizeof(tObjectRecord),
+	sizeof(tVehicleRecord),
+	sizeof(tPedRecord),
+	sizeof(tPathNodeRecord),
+	sizeof(t2dEffectRecord),
+	sizeof(tInstanceRecord),
+	sizeof(tZoneRecord),
+	sizeof(tZoneRecord),
+	sizeof(tCullZoneRecord)
+};
+#else
+#define CACHE_RECORD(type, rec)
+#endif
+
+static void AddObject(tObjectRecord *rec);
+static int AddMLO(tMloRecord *rec);
+static void AddMLOInstance(tMloInstanceRecord *rec);
+static void AddTimeObject(tObjectRecord *rec);
+static void AddClumpObject(tObjectRecord *rec);
+static void AddVehicleObject(tVehicleRecord *rec);
+static void AddPedObject(tPedRecord *rec);
+static void AddPathNode(tPathNodeRecord *rec);
+static void Add2dEffect(t2dEffectRecord *rec);
+static void AddObjectInstance(tInstanceRecord *rec);
+static void AddZone(tZoneRecord *rec);
+static void AddMapZone(tZoneRecord *rec);
+static void AddCullZone(tCullZoneRecord *rec);
+
+#ifdef WORLD_CACHE
+// The whole file at once, for LoadLine(&buf, &len)
+static char*
+LoadTextFile(const char *filename, int *len)
+{
+	int fd;
+	char *text;
+
+	*len = 0;
+	fd = CFileMgr::OpenFile(filename, "rb");
+	if(fd == 0)
+		return nil;
+	*len = CFileMgr::GetFileLength(fd);
+	text = new char[Max(*len, 1)];
+	*len = CFileMgr::Read(fd, text, *len);
+	CFileMgr::CloseFile(fd);
+	return text;
+}
+
+static void
+ReplayRecords(void)
+{
+	int32 type;
+	void *data;
+
+	while(CWorldCache::GetRecord(&type, &data))
+		switch(type){
+		case RECORD_OBJECT: AddObject((tObjectRecord*)data); break;
+		case RECORD_MLO: AddMLO((tMloRecord*)data); break;
+		case RECORD_MLOINSTANCE: AddMLOInstance((tMloInstanceRecord*)data); break;
+		case RECORD_TIMEOBJECT: AddTimeObject((tObjectRecord*)data); break;
+		case RECORD_CLUMPOBJECT: AddClumpObject((tObjectRecord*)data); break;
+		case RECORD_VEHICLEOBJECT: AddVehicleObject((tVehicleRecord*)data); break;
+		case RECORD_PEDOBJECT: AddPedObject((tPedRecord*)data); break;
+		case RECORD_PATHNODE: AddPathNode((tPathNodeRecord*)data); break;
+		case RECORD_2DEFFECT: Add2dEffect((t2dEffectRecord*)data); break;
+		case RECORD_INSTANCE: AddObjectInstance((tInstanceRecord*)data); break;
+		case RECORD_ZONE: AddZone((tZoneRecord*)data); break;
+		case RECORD_MAPZONE: AddMapZone((tZoneRecord*)data); break;
+		case RECORD_CULLZONE: AddCullZone((tCullZoneRecord*)data); break;
+		}
+}
+
+// Same as LoadLine(fd), out of a file in memory
+char*
+CFileLoader::LoadLine(char **buf, int *len)
+{
+	int i, n;
+	char *line;
+
+	if(*len <= 0)
+		return nil;
+	for(n = 0; n < *len && n < 255; )
+		if((*buf)[n++] == '\n')
+			break;
+	memcpy(ms_line, *buf, n);
+	ms_line[n] = '\0';
+	*buf += n;
+	*len -= n;
+	for(i = 0; ms_line[i] != '\0'; i++)
+		if(ms_line[i] < ' ' || ms_line[i] == ',')
+			ms_line[i] = ' ';
+	for(line = ms_line; *line <= ' ' && *line != '\0'; line++);
+	return line;
+}
+#endif
+
 void
 CFileLoader::LoadObjectTypes(const char *filename)
 {
@@ -509,7 +729,9 @@ CFileLoader::LoadObjectTypes(const char *filename)
 		TWODFX
 	};
 	char *line;
+#ifndef WORLD_CACHE
 	int fd;
+#endif
 	int section;
 	int pathIndex;
 	char pathTypeStr[20];
@@ -521,8 +743,19 @@ CFileLoader::LoadObjectTypes(const char *filename)
 	mlo = 0;
 	debug("Loading object types from %s...\n", filename);
 
+#ifdef WORLD_CACHE
+	char *text, *p;
+	int len;
+	p = text = LoadTextFile(filename, &len);
+	if(CWorldCache::Begin(filename, text, len, aRecordSizes, NUM_RECORDS)){
+		ReplayRecords();
+		len = 0;	// nothing left to parse
+	}
+	for(line = CFileLoader::LoadLine(&p, &len); line; line = CFileLoader::LoadLine(&p, &len)){
+#else
 	fd = CFileMgr::OpenFile(filename, "rb");
 	for(line = CFileLoader::LoadLine(fd); line; line = CFileLoader::LoadLine(fd)){
+#endif
 		if(*line == '\0' || *line == '#')
 			continue;
 
@@ -581,7 +814,12 @@ CFileLoader::LoadObjectTypes(const char *filename)
 			break;
 		}
 	}
+#ifdef WORLD_CACHE
+	CWorldCache::End();
+	delete[] text;
+#else
 	CFileMgr::CloseFile(fd);
+#endif
 
 	for(id = 0; id < MODELINFOSIZE; id++){
 		CSimpleModelInfo *mi = (CSimpleModelInfo*)CModelInfo::GetModelInfo(id);
@@ -605,239 +843,269 @@ SetModelInfoFlags(CSimpleModelInfo *mi, uint32 flags)
 void
 CFileLoader::LoadObject(const char *line)
 {
-	int id, numObjs;
-	char model[24], txd[24];
-	float dist[3];
-	uint32 flags;
-	int damaged;
-	CSimpleModelInfo *mi;
+	tObjectRecord obj;
 
-	if(sscanf(line, "%d %s %s %d", &id, model, txd, &numObjs) != 4)
+	if(sscanf(line, "%d %s %s %d", &obj.id, obj.model, obj.txd, &obj.numObjs) != 4)
 		return;
 
-	switch(numObjs){
+	switch(obj.numObjs){
 	case 1:
 		sscanf(line, "%d %s %s %d %f %d",
-			&id, model, txd, &numObjs, &dist[0], &flags);
-		damaged = 0;
+			&obj.id, obj.model, obj.txd, &obj.numObjs, &obj.dist[0], &obj.flags);
+		obj.damaged = 0;
 		break;
 	case 2:
 		sscanf(line, "%d %s %s %d %f %f %d",
-			&id, model, txd, &numObjs, &dist[0], &dist[1], &flags);
-		damaged = dist[0] < dist[1] ?	// Are distances increasing?
+			&obj.id, obj.model, obj.txd, &obj.numObjs, &obj.dist[0], &obj.dist[1], &obj.flags);
+		obj.damaged = obj.dist[0] < obj.dist[1] ?	// Are distances increasing?
 			0 :	// Yes, no damage model
 			1;	// No, 1 is damaged
 		break;
 	case 3:
 		sscanf(line, "%d %s %s %d %f %f %f %d",
-			&id, model, txd, &numObjs, &dist[0], &dist[1], &dist[2], &flags);
-		damaged = dist[0] < dist[1] ?	// Are distances increasing?
-				(dist[1] < dist[2] ? 0 : 2) :	// Yes, only 2 can still be a damage model
+			&obj.id, obj.model, obj.txd, &obj.numObjs, &obj.dist[0], &obj.dist[1], &obj.dist[2], &obj.flags);
+		obj.damaged = obj.dist[0] < obj.dist[1] ?	// Are distances increasing?
+				(obj.dist[1] < obj.dist[2] ? 0 : 2) :	// Yes, only 2 can still be a damage model
 			1;	// No, 1 and 2 are damaged
 		break;
 	}
 
-	mi = CModelInfo::AddSimpleModel(id);
-	mi->SetName(model);
-	mi->SetNumAtomics(numObjs);
-	mi->SetLodDistances(dist);
-	SetModelInfoFlags(mi, flags);
-	mi->m_firstDamaged = damaged;
-	mi->SetTexDictionary(txd);
-	MatchModelString(model, id);
+	CACHE_RECORD(RECORD_OBJECT, obj);
+	AddObject(&obj);
+}
+
+static void
+AddObject(tObjectRecord *rec)
+{
+	CSimpleModelInfo *mi;
+
+	mi = CModelInfo::AddSimpleModel(rec->id);
+	mi->SetName(rec->model);
+	mi->SetNumAtomics(rec->numObjs);
+	mi->SetLodDistances(rec->dist);
+	SetModelInfoFlags(mi, rec->flags);
+	mi->m_firstDamaged = rec->damaged;
+	mi->SetTexDictionary(rec->txd);
+	MatchModelString(rec->model, rec->id);
 }
 
 int
 CFileLoader::LoadMLO(const char *line)
 {
 	char smth[8];
-	char name[24];
-	int modelIndex;
-	float someFloat;
+	tMloRecord mlo;
 
-	sscanf(line, "%s %s %d %f", smth, name, &modelIndex, &someFloat);
-	CMloModelInfo *minfo = CModelInfo::AddMloModel(modelIndex);
-	minfo->SetName(name);
-	minfo->field_34 = someFloat;
+	sscanf(line, "%s %s %d %f", smth, mlo.name, &mlo.modelIndex, &mlo.someFloat);
+	CACHE_RECORD(RECORD_MLO, mlo);
+	return AddMLO(&mlo);
+}
+
+static int
+AddMLO(tMloRecord *rec)
+{
+	CMloModelInfo *minfo = CModelInfo::AddMloModel(rec->modelIndex);
+	minfo->SetName(rec->name);
+	minfo->field_34 = rec->someFloat;
 	int instId = CModelInfo::GetMloInstanceStore().allocPtr;
 	minfo->firstInstance = instId;
 	minfo->lastInstance = instId;
 	minfo->SetTexDictionary("generic");
-	return modelIndex;
+	return rec->modelIndex;
 }
 
 void
 CFileLoader::LoadMLOInstance(int id, const char *line)
 {
 	char name[24];
-	RwV3d pos, scale, rot;
-	float angle;
-	int modelIndex;
+	tMloInstanceRecord inst;
 
-	CMloModelInfo *minfo = (CMloModelInfo*)CModelInfo::GetModelInfo(id);
+	inst.id = id;
 	sscanf(line, "%d %s %f %f %f %f %f %f %f %f %f %f",
-		&modelIndex,
+		&inst.modelIndex,
 		name,
-		&pos.x, &pos.y, &pos.z,
-		&scale.x, &scale.y, &scale.z,
-		&rot.x, &rot.y, &rot.z,
-		&angle);
-	float rad = Acos(angle) * 2.0f;
+		&inst.pos.x, &inst.pos.y, &inst.pos.z,
+		&inst.scale.x, &inst.scale.y, &inst.scale.z,
+		&inst.rot.x, &inst.rot.y, &inst.rot.z,
+		&inst.angle);
+	CACHE_RECORD(RECORD_MLOINSTANCE, inst);
+	AddMLOInstance(&inst);
+}
+
+static void
+AddMLOInstance(tMloInstanceRecord *rec)
+{
+	CMloModelInfo *minfo = (CMloModelInfo*)CModelInfo::GetModelInfo(rec->id);
+	float rad = Acos(rec->angle) * 2.0f;
 	CInstance *inst = CModelInfo::GetMloInstanceStore().alloc();
 	minfo->lastInstance++;
 
 	RwMatrix *matrix = RwMatrixCreate();
-	RwMatrixScale(matrix, &scale, rwCOMBINEREPLACE);
-	RwMatrixRotate(matrix, &rot, -RADTODEG(rad), rwCOMBINEPOSTCONCAT);
-	RwMatrixTranslate(matrix, &pos, rwCOMBINEPOSTCONCAT);
+	RwMatrixScale(matrix, &rec->scale, rwCOMBINEREPLACE);
+	RwMatrixRotate(matrix, &rec->rot, -RADTODEG(rad), rwCOMBINEPOSTCONCAT);
+	RwMatrixTranslate(matrix, &rec->pos, rwCOMBINEPOSTCONCAT);
 
 	inst->GetMatrix() = CMatrix(matrix);
 	inst->GetMatrix().UpdateRW();
 
-	inst->m_modelIndex = modelIndex;
+	inst->m_modelIndex = rec->modelIndex;
 	RwMatrixDestroy(matrix);
 }
 
 void
 CFileLoader::LoadTimeObject(const char *line)
 {
-	int id, numObjs;
-	char model[24], txd[24];
-	float dist[3];
-	uint32 flags;
-	int timeOn, timeOff;
-	int damaged;
-	CTimeModelInfo *mi, *other;
+	tObjectRecord obj;
 
-	if(sscanf(line, "%d %s %s %d", &id, model, txd, &numObjs) != 4)
+	if(sscanf(line, "%d %s %s %d", &obj.id, obj.model, obj.txd, &obj.numObjs) != 4)
 		return;
 
-	switch(numObjs){
+	switch(obj.numObjs){
 	case 1:
 		sscanf(line, "%d %s %s %d %f %d %d %d",
-			&id, model, txd, &numObjs, &dist[0], &flags, &timeOn, &timeOff);
-		damaged = 0;
+			&obj.id, obj.model, obj.txd, &obj.numObjs, &obj.dist[0], &obj.flags, &obj.timeOn, &obj.timeOff);
+		obj.damaged = 0;
 		break;
 	case 2:
 		sscanf(line, "%d %s %s %d %f %f %d %d %d",
-			&id, model, txd, &numObjs, &dist[0], &dist[1], &flags, &timeOn, &timeOff);
-		damaged = dist[0] < dist[1] ?	// Are distances increasing?
+			&obj.id, obj.model, obj.txd, &obj.numObjs, &obj.dist[0], &obj.dist[1], &obj.flags, &obj.timeOn, &obj.timeOff);
+		obj.damaged = obj.dist[0] < obj.dist[1] ?	// Are distances increasing?
 			0 :	// Yes, no damage model
 			1;	// No, 1 is damaged
 		break;
 	case 3:
 		sscanf(line, "%d %s %s %d %f %f %f %d %d %d",
-			&id, model, txd, &numObjs, &dist[0], &dist[1], &dist[2], &flags, &timeOn, &timeOff);
-		damaged = dist[0] < dist[1] ?	// Are distances increasing?
-				(dist[1] < dist[2] ? 0 : 2) :	// Yes, only 2 can still be a damage model
+			&obj.id, obj.model, obj.txd, &obj.numObjs, &obj.dist[0], &obj.dist[1], &obj.dist[2], &obj.flags, &obj.timeOn, &obj.timeOff);
+		obj.damaged = obj.dist[0] < obj.dist[1] ?	// Are distances increasing?
+				(obj.dist[1] < obj.dist[2] ? 0 : 2) :	// Yes, only 2 can still be a damage model
 			1;	// No, 1 and 2 are damaged
 		break;
 	}
 
-	mi = CModelInfo::AddTimeModel(id);
-	mi->SetName(model);
-	mi->SetNumAtomics(numObjs);
-	mi->SetLodDistances(dist);
-	SetModelInfoFlags(mi, flags);
-	mi->m_firstDamaged = damaged;
-	mi->SetTimes(timeOn, timeOff);
-	mi->SetTexDictionary(txd);
+	CACHE_RECORD(RECORD_TIMEOBJECT, obj);
+	AddTimeObject(&obj);
+}
+
+static void
+AddTimeObject(tObjectRecord *rec)
+{
+	CTimeModelInfo *mi, *other;
+
+	mi = CModelInfo::AddTimeModel(rec->id);
+	mi->SetName(rec->model);
+	mi->SetNumAtomics(rec->numObjs);
+	mi->SetLodDistances(rec->dist);
+	SetModelInfoFlags(mi, rec->flags);
+	mi->m_firstDamaged = rec->damaged;
+	mi->SetTimes(rec->timeOn, rec->timeOff);
+	mi->SetTexDictionary(rec->txd);
 	other = mi->FindOtherTimeModel();
 	if(other)
-		other->SetOtherTimeModel(id);
-	MatchModelString(model, id);
+		other->SetOtherTimeModel(rec->id);
+	MatchModelString(rec->model, rec->id);
 }
 
 void
 CFileLoader::LoadClumpObject(const char *line)
 {
-	int id;
-	char model[24], txd[24];
-	CClumpModelInfo *mi;
+	tObjectRecord obj;
 
-	if(sscanf(line, "%d %s %s", &id, model, txd) == 3){
-		mi = CModelInfo::AddClumpModel(id);
-		mi->SetName(model);
-		mi->SetTexDictionary(txd);
-		mi->SetColModel(&CTempColModels::ms_colModelBBox);
+	if(sscanf(line, "%d %s %s", &obj.id, obj.model, obj.txd) == 3){
+		CACHE_RECORD(RECORD_CLUMPOBJECT, obj);
+		AddClumpObject(&obj);
 	}
 }
 
+static void
+AddClumpObject(tObjectRecord *rec)
+{
+	CClumpModelInfo *mi;
+
+	mi = CModelInfo::AddClumpModel(rec->id);
+	mi->SetName(rec->model);
+	mi->SetTexDictionary(rec->txd);
+	mi->SetColModel(&CTempColModels::ms_colModelBBox);
+}
+
 void
 CFileLoader::LoadVehicleObject(const char *line)
 {
-	int id;
-	char model[24], txd[24];
-	char type[8], handlingId[16], gamename[32], vehclass[12];
-	uint32 frequency, comprules;
-	int32 level, misc;
-	float wheelScale;
-	CVehicleModelInfo *mi;
+	tVehicleRecord veh;
 	char *p;
 
 	sscanf(line, "%d %s %s %s %s %s %s %d %d %x %d %f",
-		&id, model, txd,
-		type, handlingId, gamename, vehclass,
-		&frequency, &level, &comprules, &misc, &wheelScale);
-
-	mi = CModelInfo::AddVehicleModel(id);
-	mi->SetName(model);
-	mi->SetTexDictionary(txd);
-	for(p = gamename; *p; p++)
+		&veh.id, veh.model, veh.txd,
+		veh.type, veh.handlingId, veh.gamename, veh.vehclass,
+		&veh.frequency, &veh.level, &veh.comprules, &veh.misc, &veh.wheelScale);
+	for(p = veh.gamename; *p; p++)
 		if(*p == '_') *p = ' ';
-	strcpy(mi->m_gameName, gamename);
-	mi->m_level = level;
-	mi->m_compRules = comprules;
 
-	if(strncmp(type, "car", 4) == 0){
-		mi->m_wheelId = misc;
-		mi->m_wheelScale = wheelScale;
+	CACHE_RECORD(RECORD_VEHICLEOBJECT, veh);
+	AddVehicleObject(&veh);
+}
+
+static void
+AddVehicleObject(tVehicleRecord *rec)
+{
+	int id = rec->id;
+	uint32 frequency = rec->frequency;
+	CVehicleModelInfo *mi;
+
+	mi = CModelInfo::AddVehicleModel(id);
+	mi->SetName(rec->model);
+	mi->SetTexDictionary(rec->txd);
+	strcpy(mi->m_gameName, rec->gamename);
+	mi->m_level = rec->level;
+	mi->m_compRules = rec->comprules;
+
+	if(strncmp(rec->type, "car", 4) == 0){
+		mi->m_wheelId = rec->misc;
+		mi->m_wheelScale = rec->wheelScale;
 		mi->m_vehicleType = VEHICLE_TYPE_CAR;
-	}else if(strncmp(type, "boat", 5) == 0){
+	}else if(strncmp(rec->type, "boat", 5) == 0){
 		mi->m_vehicleType = VEHICLE_TYPE_BOAT;
-	}else if(strncmp(type, "train", 6) == 0){
+	}else if(strncmp(rec->type, "train", 6) == 0){
 		mi->m_vehicleType = VEHICLE_TYPE_TRAIN;
-	}else if(strncmp(type, "heli", 5) == 0){
+	}else if(strncmp(rec->type, "heli", 5) == 0){
 		mi->m_vehicleType = VEHICLE_TYPE_HELI;
-	}else if(strncmp(type, "plane", 6) == 0){
-		mi->m_planeLodId = misc;
+	}else if(strncmp(rec->type, "plane", 6) == 0){
+		mi->m_planeLodId = rec->misc;
 		mi->m_wheelScale = 1.0f;
 		mi->m_vehicleType = VEHICLE_TYPE_PLANE;
-	}else if(strncmp(type, "bike", 5) == 0){
-		mi->m_bikeSteerAngle = misc;
-		mi->m_wheelScale = wheelScale;
+	}else if(strncmp(rec->type, "bike", 5) == 0){
+		mi->m_bikeSteerAngle = rec->misc;
+		mi->m_wheelScale = rec->wheelScale;
 		mi->m_vehicleType = VEHICLE_TYPE_BIKE;
 	}else
 		assert(0);
 
-	mi->m_handlingId = mod_HandlingManager.GetHandlingId(handlingId);
+	mi->m_handlingId = mod_HandlingManager.GetHandlingId(rec->handlingId);
 
 	// Well this is kinda dumb....
-	if(strncmp(vehclass, "poorfamily", 11) == 0){
+	if(strncmp(rec->vehclass, "poorfamily", 11) == 0){
 		mi->m_vehicleClass = CCarCtrl::POOR;
 		while(frequency-- > 0)
 			CCarCtrl::AddToCarArray(id, CCarCtrl::POOR);
-	}else if(strncmp(vehclass, "richfamily", 11) == 0){
+	}else if(strncmp(rec->vehclass, "richfamily", 11) == 0){
 		mi->m_vehicleClass = CCarCtrl::RICH;
 		while(frequency-- > 0)
 			CCarCtrl::AddToCarArray(id, CCarCtrl::RICH);
-	}else if(strncmp(vehclass, "executive", 10) == 0){
+	}else if(strncmp(rec->vehclass, "executive", 10) == 0){
 		mi->m_vehicleClass = CCarCtrl::EXEC;
 		while(frequency-- > 0)
 			CCarCtrl::AddToCarArray(id, CCarCtrl::EXEC);
-	}else if(strncmp(vehclass, "worker", 7) == 0){
+	}else if(strncmp(rec->vehclass, "worker", 7) == 0){
 		mi->m_vehicleClass = CCarCtrl::WORKER;
 		while(frequency-- > 0)
 			CCarCtrl::AddToCarArray(id, CCarCtrl::WORKER);
-	}else if(strncmp(vehclass, "special", 8) == 0){
+	}else if(strncmp(rec->vehclass, "special", 8) == 0){
 		mi->m_vehicleClass = CCarCtrl::SPECIAL;
 		while(frequency-- > 0)
 			CCarCtrl::AddToCarArray(id, CCarCtrl::SPECIAL);
-	}else if(strncmp(vehclass, "big", 4) == 0){
+	}else if(strncmp(rec->vehclass, "big", 4) == 0){
 		mi->m_vehicleClass = CCarCtrl::BIG;
 		while(frequency-- > 0)
 			CCarCtrl::AddToCarArray(id, CCarCtrl::BIG);
-	}else if(strncmp(vehclass, "taxi", 5) == 0){
+	}else if(strncmp(rec->vehclass, "taxi", 5) == 0){
 		mi->m_vehicleClass = CCarCtrl::TAXI;
 		while(frequency-- > 0)
 			CCarCtrl::AddToCarArray(id, CCarCtrl::TAXI);
@@ -847,29 +1115,34 @@ CFileLoader::LoadVehicleObject(const char *line)
 void
 CFileLoader::LoadPedObject(const char *line)
 {
-	int id;
-	char model[24], txd[24];
-	char pedType[24], pedStats[24], animGroup[24];
-	int carsCanDrive;
-	CPedModelInfo *mi;
-	int animGroupId;
+	tPedRecord ped;
 
 	if(sscanf(line, "%d %s %s %s %s %s %x",
-	          &id, model, txd,
-	          pedType, pedStats, animGroup, &carsCanDrive) != 7)
+	          &ped.id, ped.model, ped.txd,
+	          ped.pedType, ped.pedStats, ped.animGroup, &ped.carsCanDrive) != 7)
 		return;
 
-	mi = CModelInfo::AddPedModel(id);
-	mi->SetName(model);
-	mi->SetTexDictionary(txd);
+	CACHE_RECORD(RECORD_PEDOBJECT, ped);
+	AddPedObject(&ped);
+}
+
+static void
+AddPedObject(tPedRecord *rec)
+{
+	CPedModelInfo *mi;
+	int animGroupId;
+
+	mi = CModelInfo::AddPedModel(rec->id);
+	mi->SetName(rec->model);
+	mi->SetTexDictionary(rec->txd);
 	mi->SetColModel(&CTempColModels::ms_colModelPed1);
-	mi->m_pedType = CPedType::FindPedType(pedType);
-	mi->m_pedStatType = CPedStats::GetPedStatType(pedStats);
+	mi->m_pedType = CPedType::FindPedType(rec->pedType);
+	mi->m_pedStatType = CPedStats::GetPedStatType(rec->pedStats);
 	for(animGroupId = 0; animGroupId < NUM_ANIM_ASSOC_GROUPS; animGroupId++)
-		if(strcmp(animGroup, CAnimManager::GetAnimGroupName((AssocGroupId)animGroupId)) == 0)
+		if(strcmp(rec->animGroup, CAnimManager::GetAnimGroupName((AssocGroupId)animGroupId)) == 0)
 			break;
 	mi->m_animGroup = animGroupId;
-	mi->m_carsCanDrive = carsCanDrive;
+	mi->m_carsCanDrive = rec->carsCanDrive;
 
 	// ???
 	CModelInfo::GetModelInfo(MI_LOPOLYGUY)->SetColModel(&CTempColModels::ms_colModelPed1);
@@ -888,99 +1161,142 @@ CFileLoader::LoadPathHeader(const char *line, char *type)
 void
 CFileLoader::LoadPedPathNode(const char *line, int id, int node)
 {
-	int type, next, cross;
-	float x, y, z, width;
-
-	sscanf(line, "%d %d %d %f %f %f %f", &type, &next, &cross, &x, &y, &z, &width);
-	ThePaths.StoreNodeInfoPed(id, node, type, next, x, y, z, 0, !!cross);
+	tPathNodeRecord pn;
+	float width;
+
+	sscanf(line, "%d %d %d %f %f %f %f", &pn.type, &pn.next, &pn.cross, &pn.x, &pn.y, &pn.z, &width);
+	pn.id = id;
+	pn.node = node;
+	pn.ped = true;
+	CACHE_RECORD(RECORD_PATHNODE, pn);
+	AddPathNode(&pn);
 }
 
 void
 CFileLoader::LoadCarPathNode(const char *line, int id, int node)
 {
-	int type, next, cross, numLeft, numRight;
-	float x, y, z, width;
+	tPathNodeRecord pn;
+	float width;
+
+	sscanf(line, "%d %d %d %f %f %f %f %d %d", &pn.type, &pn.next, &pn.cross, &pn.x, &pn.y, &pn.z, &width, &pn.numLeft, &pn.numRight);
+	pn.id = id;
+	pn.node = node;
+	pn.ped = false;
+	CACHE_RECORD(RECORD_PATHNODE, pn);
+	AddPathNode(&pn);
+}
 
-	sscanf(line, "%d %d %d %f %f %f %f %d %d", &type, &next, &cross, &x, &y, &z, &width, &numLeft, &numRight);
-	ThePaths.StoreNodeInfoCar(id, node, type, next, x, y, z, 0, numLeft, numRight);
+static void
+AddPathNode(tPathNodeRecord *rec)
+{
+	if(rec->ped)
+		ThePaths.StoreNodeInfoPed(rec->id, rec->node, rec->type, rec->next, rec->x, rec->y, rec->z, 0, !!rec->cross);
+	else
+		ThePaths.StoreNodeInfoCar(rec->id, rec->node, rec->type, rec->next, rec->x, rec->y, rec->z, 0, rec->numLeft, rec->numRight);
 }
 
 
 void
 CFileLoader::Load2dEffect(const char *line)
 {
-	int id, r, g, b, a, type;
-	float x, y, z;
-	char corona[32], shadow[32];
-	int shadowIntens, lightType, roadReflection, flare, flags, probability;
-	CBaseModelInfo *mi;
-	C2dEffect *effect;
+	t2dEffectRecord fx;
 	char *p;
 
-	sscanf(line, "%d %f %f %f %d %d %d %d %d", &id, &x, &y, &z, &r, &g, &b, &a, &type);
+	sscanf(line, "%d %f %f %f %d %d %d %d %d", &fx.id, &fx.x, &fx.y, &fx.z, &fx.r, &fx.g, &fx.b, &fx.a, &fx.type);
 
-	CTxdStore::PushCurrentTxd();
-	CTxdStore::SetCurrentTxd(CTxdStore::FindTxdSlot("particle"));
-
-	mi = CModelInfo::GetModelInfo(id);
-	effect = CModelInfo::Get2dEffectStore().alloc();
-	mi->Add2dEffect(effect);
-	effect->pos = CVector(x, y, z);
-	effect->col = CRGBA(r, g, b, a);
-	effect->type = type;
-
-	switch(effect->type){
+	switch(fx.type){
 	case EFFECT_LIGHT:
 		while(*line++ != '"');
-		p = corona;
+		p = fx.corona;
 		while(*line != '"') *p++ = *line++;
 		*p = '\0';
 		line++;
 
 		while(*line++ != '"');
-		p = shadow;
+		p = fx.shadow;
 		while(*line != '"') *p++ = *line++;
 		*p = '\0';
 		line++;
 
 		sscanf(line, "%f %f %f %f %d %d %d %d %d",
-			&effect->light.dist,
-			&effect->light.range,
-			&effect->light.size,
-			&effect->light.shadowSize,
-			&shadowIntens, &lightType, &roadReflection, &flare, &flags);
-		effect->light.corona = RwTextureRead(corona, nil);
-		effect->light.shadow = RwTextureRead(shadow, nil);
-		effect->light.shadowIntensity = shadowIntens;
-		effect->light.lightType = lightType;
-		effect->light.roadReflection = roadReflection;
-		effect->light.flareType = flare;
+			&fx.dist,
+			&fx.range,
+			&fx.size,
+			&fx.shadowSize,
+			&fx.shadowIntens, &fx.lightType, &fx.roadReflection, &fx.flare, &fx.flags);
+		break;
 
+	case EFFECT_PARTICLE:
+		sscanf(line, "%d %f %f %f %d %d %d %d %d %d %f %f %f %f",
+			&fx.id, &fx.x, &fx.y, &fx.z, &fx.r, &fx.g, &fx.b, &fx.a, &fx.type,
+			&fx.particleType,
+			&fx.dir.x,
+			&fx.dir.y,
+			&fx.dir.z,
+			&fx.scale);
+		break;
+
+	case EFFECT_ATTRACTOR:
+		sscanf(line, "%d %f %f %f %d %d %d %d %d %d %f %f %f %d",
+			&fx.id, &fx.x, &fx.y, &fx.z, &fx.r, &fx.g, &fx.b, &fx.a, &fx.type,
+			&fx.flags,
+			&fx.dir.x,
+			&fx.dir.y,
+			&fx.dir.z,
+			&fx.probability);
+		break;
+	}
+
+	CACHE_RECORD(RECORD_2DEFFECT, fx);
+	Add2dEffect(&fx);
+}
+
+static void
+Add2dEffect(t2dEffectRecord *rec)
+{
+	CBaseModelInfo *mi;
+	C2dEffect *effect;
+	int flags;
+
+	CTxdStore::PushCurrentTxd();
+	CTxdStore::SetCurrentTxd(CTxdStore::FindTxdSlot("particle"));
+
+	mi = CModelInfo::GetModelInfo(rec->id);
+	effect = CModelInfo::Get2dEffectStore().alloc();
+	mi->Add2dEffect(effect);
+	effect->pos = CVector(rec->x, rec->y, rec->z);
+	effect->col = CRGBA(rec->r, rec->g, rec->b, rec->a);
+	effect->type = rec->type;
+
+	switch(effect->type){
+	case EFFECT_LIGHT:
+		effect->light.dist = rec->dist;
+		effect->light.range = rec->range;
+		effect->light.size = rec->size;
+		effect->light.shadowSize = rec->shadowSize;
+		effect->light.corona = RwTextureRead(rec->corona, nil);
+		effect->light.shadow = RwTextureRead(rec->shadow, nil);
+		effect->light.shadowIntensity = rec->shadowIntens;
+		effect->light.lightType = rec->lightType;
+		effect->light.roadReflection = rec->roadReflection;
+		effect->light.flareType = rec->flare;
+
+		flags = rec->flags;
 		if(flags & LIGHTFLAG_FOG_ALWAYS)
 			flags &= ~LIGHTFLAG_FOG_NORMAL;
 		effect->light.flags = flags;
 		break;
 
 	case EFFECT_PARTICLE:
-		sscanf(line, "%d %f %f %f %d %d %d %d %d %d %f %f %f %f",
-			&id, &x, &y, &z, &r, &g, &b, &a, &type,
-			&effect->particle.particleType,
-			&effect->particle.dir.x,
-			&effect->particle.dir.y,
-			&effect->particle.dir.z,
-			&effect->particle.scale);
+		effect->particle.particleType = rec->particleType;
+		effect->particle.dir = rec->dir;
+		effect->particle.scale = rec->scale;
 		break;
 
 	case EFFECT_ATTRACTOR:
-		sscanf(line, "%d %f %f %f %d %d %d %d %d %d %f %f %f %d",
-			&id, &x, &y, &z, &r, &g, &b, &a, &type,
-			&flags,
-			&effect->attractor.dir.x,
-			&effect->attractor.dir.y,
-			&effect->attractor.dir.z,
-			&probability);
-		effect->attractor.type = flags;
-		effect->attractor.probability = probability;
+		effect->attractor.dir = rec->dir;
+		effect->attractor.type = rec->flags;
+		effect->attractor.probability = rec->probability;
 		break;
 	}
 
@@ -999,7 +1315,9 @@ CFileLoader::LoadScene(const char *filename)
 		PATH,
 	};
 	char *line;
+#ifndef WORLD_CACHE
 	int fd;
+#endif
 	int section;
 	int pathIndex;
 	char pathTypeStr[20];
@@ -1008,8 +1326,19 @@ CFileLoader::LoadScene(const char *filename)
 	pathIndex = -1;
 	debug("Creating objects from %s...\n", filename);
 
+#ifdef WORLD_CACHE
+	char *text, *p;
+	int len;
+	p = text = LoadTextFile(filename, &len);
+	if(CWorldCache::Begin(filename, text, len, aRecordSizes, NUM_RECORDS)){
+		ReplayRecords();
+		len = 0;	// nothing left to parse
+	}
+	for(line = CFileLoader::LoadLine(&p, &len); line; line = CFileLoader::LoadLine(&p, &len)){
+#else
 	fd = CFileMgr::OpenFile(filename, "rb");
 	for(line = CFileLoader::LoadLine(fd); line; line = CFileLoader::LoadLine(fd)){
+#endif
 		if(*line == '\0' || *line == '#')
 			continue;
 
@@ -1050,7 +1379,12 @@ CFileLoader::LoadScene(const char *filename)
 			break;
 		}
 	}
+#ifdef WORLD_CACHE
+	CWorldCache::End();
+	delete[] text;
+#else
 	CFileMgr::CloseFile(fd);
+#endif
 
 	debug("Finished loading IPL\n");
 }
@@ -1058,29 +1392,39 @@ CFileLoader::LoadScene(const char *filename)
 void
 CFileLoader::LoadObjectInstance(const char *line)
 {
-	int id;
+	tInstanceRecord inst;
 	char name[24];
-	RwV3d trans, scale, axis;
+	RwV3d scale;
+
+	if(sscanf(line, "%d %s %f %f %f %f %f %f %f %f %f %f",
+	          &inst.id, name,
+	          &inst.trans.x, &inst.trans.y, &inst.trans.z,
+	          &scale.x, &scale.y, &scale.z,
+	          &inst.axis.x, &inst.axis.y, &inst.axis.z, &inst.angle) != 12)
+		return;
+
+	CACHE_RECORD(RECORD_INSTANCE, inst);
+	AddObjectInstance(&inst);
+}
+
+static void
+AddObjectInstance(tInstanceRecord *rec)
+{
+	int id = rec->id;
 	float angle;
 	CSimpleModelInfo *mi;
 	RwMatrix *xform;
 	CEntity *entity;
-	if(sscanf(line, "%d %s %f %f %f %f %f %f %f %f %f %f",
-	          &id, name,
-	          &trans.x, &trans.y, &trans.z,
-	          &scale.x, &scale.y, &scale.z,
-	          &axis.x, &axis.y, &axis.z, &angle) != 12)
-		return;
 
 	mi = (CSimpleModelInfo*)CModelInfo::GetModelInfo(id);
 	if(mi == nil)
 		return;
 	assert(mi->IsSimple());
 
-	angle = -RADTODEG(2.0f * acosf(angle));
+	angle = -RADTODEG(2.0f * acosf(rec->angle));
 	xform = RwMatrixCreate();
-	RwMatrixRotate(xform, &axis, angle, rwCOMBINEREPLACE);
-	RwMatrixTranslate(xform, &trans, rwCOMBINEPOSTCONCAT);
+	RwMatrixRotate(xform, &rec->axis, angle, rwCOMBINEREPLACE);
+	RwMatrixTranslate(xform, &rec->trans, rwCOMBINEPOSTCONCAT);
 
 	if(mi->GetObjectID() == -1){
 		if(ThePaths.IsPathObject(id)){
@@ -1116,30 +1460,39 @@ CFileLoader::LoadObjectInstance(const char *line)
 void
 CFileLoader::LoadZone(const char *line)
 {
-	char name[24];
-	int type, level;
-	float minx, miny, minz;
-	float maxx, maxy, maxz;
+	tZoneRecord zone;
 
-	if(sscanf(line, "%s %d %f %f %f %f %f %f %d", name, &type, &minx, &miny, &minz, &maxx, &maxy, &maxz, &level) == 9)
-		CTheZones::CreateZone(name, (eZoneType)type, minx, miny, minz, maxx, maxy, maxz, (eLevelName)level);
+	if(sscanf(line, "%s %d %f %f %f %f %f %f %d", zone.name, &zone.type, &zone.minx, &zone.miny, &zone.minz, &zone.maxx, &zone.maxy, &zone.maxz, &zone.level) == 9){
+		CACHE_RECORD(RECORD_ZONE, zone);
+		AddZone(&zone);
+	}
+}
+
+static void
+AddZone(tZoneRecord *rec)
+{
+	CTheZones::CreateZone(rec->name, (eZoneType)rec->type, rec->minx, rec->miny, rec->minz, rec->maxx, rec->maxy, rec->maxz, (eLevelName)rec->level);
 }
 
 void
 CFileLoader::LoadCullZone(const char *line)
 {
-	CVector pos;
-	float minx, miny, minz;
-	float maxx, maxy, maxz;
-	int flags;
-	int wantedLevelDrop = 0;
+	tCullZoneRecord cull;
 
+	cull.wantedLevelDrop = 0;
 	sscanf(line, "%f %f %f %f %f %f %f %f %f %d %d",
-		&pos.x, &pos.y, &pos.z,
-		&minx, &miny, &minz,
-		&maxx, &maxy, &maxz,
-		&flags, &wantedLevelDrop);
-	CCullZones::AddCullZone(pos, minx, maxx, miny, maxy, minz, maxz, flags, wantedLevelDrop);
+		&cull.pos.x, &cull.pos.y, &cull.pos.z,
+		&cull.minx, &cull.miny, &cull.minz,
+		&cull.maxx, &cull.maxy, &cull.maxz,
+		&cull.flags, &cull.wantedLevelDrop);
+	CACHE_RECORD(RECORD_CULLZONE, cull);
+	AddCullZone(&cull);
+}
+
+static void
+AddCullZone(tCullZoneRecord *rec)
+{
+	CCullZones::AddCullZone(rec->pos, rec->minx, rec->maxx, rec->miny, rec->maxy, rec->minz, rec->maxz, rec->flags, rec->wantedLevelDrop);
 }
 
 // unused
@@ -1164,14 +1517,27 @@ CFileLoader::LoadMapZones(const char *filename)
 		PATH,
 	};
 	char *line;
+#ifndef WORLD_CACHE
 	int fd;
+#endif
 	int section;
 
 	section = NONE;
 	debug("Creating zones from %s...\n", filename);
 
+#ifdef WORLD_CACHE
+	char *text, *p;
+	int len;
+	p = text = LoadTextFile(filename, &len);
+	if(CWorldCache::Begin(filename, text, len, aRecordSizes, NUM_RECORDS)){
+		ReplayRecords();
+		len = 0;	// nothing left to parse
+	}
+	for(line = CFileLoader::LoadLine(&p, &len); line; line = CFileLoader::LoadLine(&p, &len)){
+#else
 	fd = CFileMgr::OpenFile(filename, "rb");
 	for(line = CFileLoader::LoadLine(fd); line; line = CFileLoader::LoadLine(fd)){
+#endif
 		if(*line == '\0' || *line == '#')
 			continue;
 
@@ -1181,25 +1547,35 @@ CFileLoader::LoadMapZones(const char *filename)
 			section = NONE;
 		}else switch(section){
 		case ZONE: {
-			char name[24];
-			int type, level;
-			float minx, miny, minz;
-			float maxx, maxy, maxz;
+			tZoneRecord zone;
 			if(sscanf(line, "%s %d %f %f %f %f %f %f %d",
-			          name, &type,
-			          &minx, &miny, &minz,
-			          &maxx, &maxy, &maxz,
-			          &level) == 9)
-				CTheZones::CreateMapZone(name, (eZoneType)type, minx, miny, minz, maxx, maxy, maxz, (eLevelName)level);
+			          zone.name, &zone.type,
+			          &zone.minx, &zone.miny, &zone.minz,
+			          &zone.maxx, &zone.maxy, &zone.maxz,
+			          &zone.level) == 9){
+				CACHE_RECORD(RECORD_MAPZONE, zone);
+				AddMapZone(&zone);
+			}
 			}
 			break;
 		}
 	}
+#ifdef WORLD_CACHE
+	CWorldCache::End();
+	delete[] text;
+#else
 	CFileMgr::CloseFile(fd);
+#endif
 
 	debug("Finished loading IPL\n");
 }
 
+static void
+AddMapZone(tZoneRecord *rec)
+{
+	CTheZones::CreateMapZone(rec->name, (eZoneType)rec->type, rec->minx, rec->miny, rec->minz, rec->maxx, rec->maxy, rec->maxz, (eLevelName)rec->level);
+}
+
 void
 CFileLoader::ReloadPaths(const char *filename)
 {
@@ -7,6 +7,9 @@ public:
 	static void LoadLevel(const char *filename);
 	static void LoadCollisionFromDatFile(int currlevel);
 	static char *LoadLine(int fd);
+#ifdef WORLD_CACHE
+	static char *LoadLine(char **buf, int *len);
+#endif
 	static RwTexDictionary *LoadTexDictionary(const char *filename);
 	static void LoadCollisionFile(const char *filename);
 	static void LoadCollisionModel(uint8 *buf, struct CColModel &model, char *name);
@@ -186,6 +186,12 @@ myfseek(int fd, long offset, int whence)
 	return fseek(myfiles[fd].file, offset, whence);
 }
 
+static long
+myftell(int fd)
+{
+	return ftell(myfiles[fd].file);
+}
+
 static int
 myfeof(int fd)
 {
@@ -291,6 +297,17 @@ CFileMgr::Seek(int fd, int offset, int whence)
 	return !!myfseek(fd, offset, whence);
 }
 
+int
+CFileMgr::GetFileLength(int fd)
+{
+	long pos, len;
+	pos = myftell(fd);
+	myfseek(fd, 0, SEEK_END);
+	len = myftell(fd);
+	myfseek(fd, pos, SEEK_SET);
+	return len;
+}
+
 bool
 CFileMgr::ReadLine(int fd, char *buf, int len)
 {
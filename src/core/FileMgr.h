@@ -16,6 +16,7 @@ public:
 	static size_t Read(int fd, const char *buf, int len);
 	static size_t Write(int fd, const char *buf, int len);
 	static bool Seek(int fd, int offset, int whence);
+	static int GetFileLength(int fd);
 	static bool ReadLine(int fd, char *buf, int len);
 	static int CloseFile(int fd);
 	static int GetErrorReadWrite(int fd);
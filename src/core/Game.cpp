@@ -3,6 +3,7 @@
 #pragma warning( pop )
 #include "common.h"
 #include "platform.h"
+#include "crossplatform.h"
 
 #include "Game.h"
 #include "main.h"
@@ -25,8 +26,10 @@
 #include "DMAudio.h"
 #include "Darkel.h"
 #include "Debug.h"
+#include "Directory.h"
 #include "EventList.h"
 #include "FileLoader.h"
+#include "WorldCache.h"
 #include "FileMgr.h"
 #include "Fire.h"
 #include "Fluff.h"
@@ -36,10 +39,12 @@
 #include "Garages.h"
 #include "GenericGameStorage.h"
 #include "Glass.h"
+#include "GroundHeights.h"
 #include "HandlingMgr.h"
 #include "Heli.h"
 #include "Hud.h"
 #include "IniFile.h"
+#include "InitGraph.h"
 #include "Lights.h"
 #include "MBlur.h"
 #include "Messages.h"
@@ -82,6 +87,7 @@
 #include "Weapon.h"
 #include "WeaponEffects.h"
 #include "Weather.h"
+#include "WorkerPool.h"
 #include "World.h"
 #include "ZoneCull.h"
 #include "Zones.h"
@@ -148,6 +154,7 @@ bool
 CGame::InitialiseOnceBeforeRW(void)
 {
 	CFileMgr::Initialise();
+	CWorkerPool::Initialise();
 	CdStreamInit(MAX_CDCHANNELS);
 	ValidateVersion();
 #ifdef EXTENDED_COLOURFILTER
@@ -309,24 +316,44 @@ CGame::FinalShutdown(void)
 	CTxdStore::Shutdown();
 	CPedStats::Shutdown();
 	CdStreamShutdown();
+	CWorkerPool::Shutdown();
 }
 
+#ifdef PARALLEL_INIT
+static void
+PreparePathData(void)
+{
+	ThePaths.PreparePathData();
+}
+#endif
+
 bool CGame::Initialise(const char* datFile)
 {
+#ifdef PARALLEL_INIT
+	CInitGraph::Begin();
+	int32 pathsTask;
+#ifdef GROUND_HEIGHT_FIELD
+	int32 groundTask;
+#endif
+#endif
+	INIT_STAGE("Pools and ini file");
 	ResetLoadingScreenBar();
 	strcpy(aDatFile, datFile);
 	CPools::Initialise();
 	CIniFile::LoadIniFile();
 	currLevel = LEVEL_INDUSTRIAL;
+	INIT_STAGE("Generic textures");
 	LoadingScreen("Loading the Game", "Loading generic textures", GetRandomSplashScreen());
 	gameTxdSlot = CTxdStore::AddTxdSlot("generic");
 	CTxdStore::Create(gameTxdSlot);
 	CTxdStore::AddRef(gameTxdSlot);
+	INIT_STAGE("Particles");
 	LoadingScreen("Loading the Game", "Loading particles", nil);
 	int particleTxdSlot = CTxdStore::AddTxdSlot("particle");
 	CTxdStore::LoadTxd(particleTxdSlot, "MODELS/PARTICLE.TXD");
 	CTxdStore::AddRef(particleTxdSlot);
 	CTxdStore::SetCurrentTxd(gameTxdSlot);
+	INIT_STAGE("Game variables");
 	LoadingScreen("Loading the Game", "Setup game variables", nil);
 	CGameLogic::InitAtStartOfGame();
 	CReferences::Init();
@@ -362,27 +389,41 @@ bool CGame::Initialise(const char* datFile)
 	CPickups::Init();
 	CTheCarGenerators::Init();
 	CdStreamAddImage("MODELS\\GTA3.IMG");
+	INIT_STAGE("Level");
 	CFileLoader::LoadLevel("DATA\\DEFAULT.DAT");
 	CFileLoader::LoadLevel(datFile);
+#ifdef WORLD_CACHE
+	CWorldCache::Shutdown();
+#endif
 #ifdef EXTENDED_PIPELINES
 	// for generic fallback
 	CustomPipes::SetTxdFindCallback();
 #endif
+#ifdef PARALLEL_INIT
+	// only needs the path nodes and map objects of the level, nothing up to the traffic lights touches them
+	pathsTask = CInitGraph::StartTask("Prepare paths", PreparePathData);
+#endif
+	INIT_STAGE("Level setup");
 	CWorld::AddParticles();
 	CVehicleModelInfo::LoadVehicleColours();
 	CVehicleModelInfo::LoadEnvironmentMaps();
 	CTheZones::PostZoneCreation();
 	LoadingScreen("Loading the Game", "Setup paths", GetRandomSplashScreen());
+#ifndef PARALLEL_INIT
 	ThePaths.PreparePathData();
+#endif
+	INIT_STAGE("Players");
 	for (int i = 0; i < NUMPLAYERS; i++)
 		CWorld::Players[i].Clear();
 	CWorld::Players[0].LoadPlayerSkin();
 	TestModelIndices();
+	INIT_STAGE("Water");
 	LoadingScreen("Loading the Game", "Setup water", nil);
 	CWaterLevel::Initialise("DATA\\WATER.DAT");
 	TheConsole.Init();
 	CDraw::SetFOV(120.0f);
 	CDraw::ms_fLODDistance = 500.0f;
+	INIT_STAGE("Streaming");
 	LoadingScreen("Loading the Game", "Setup streaming", nil);
 	CStreaming::Init();
 	CStreaming::LoadInitialVehicles();
@@ -390,20 +431,28 @@ bool CGame::Initialise(const char* datFile)
 	CStreaming::RequestBigBuildings(LEVEL_GENERIC);
 	CStreaming::LoadAllRequestedModels(false);
 	printf("Streaming uses %zuK of its memory", CStreaming::ms_memoryUsed / 1024); // original modifier was %d
+	INIT_STAGE("Animations");
 	LoadingScreen("Loading the Game", "Load animations", GetRandomSplashScreen());
 	CAnimManager::LoadAnimFiles();
 	CPed::Initialise();
 	CRouteNode::Initialise();
 	CEventList::Initialise();
+	INIT_STAGE("Big buildings");
 	LoadingScreen("Loading the Game", "Find big buildings", nil);
 	CRenderer::Init();
+	INIT_STAGE("Radar and weapons");
 	LoadingScreen("Loading the Game", "Setup game variables", nil);
 	CRadar::Initialise();
 	CRadar::LoadTextures();
 	CWeapon::InitialiseWeapons();
+	INIT_STAGE("Traffic lights");
 	LoadingScreen("Loading the Game", "Setup traffic lights", nil);
+#ifdef PARALLEL_INIT
+	CInitGraph::WaitForTask(pathsTask);
+#endif
 	CTrafficLights::ScanForLightsOnMap();
 	CRoadBlocks::Init();
+	INIT_STAGE("Population and effects");
 	LoadingScreen("Loading the Game", "Setup game variables", nil);
 	CPopulation::Initialise();
 	CWorld::PlayerInFocus = 0;
@@ -415,9 +464,11 @@ bool CGame::Initialise(const char* datFile)
 	CGlass::Init();
 	gPhoneInfo.Initialise();
 	CSceneEdit::Initialise();
+	INIT_STAGE("Scripts");
 	LoadingScreen("Loading the Game", "Load scripts", nil);
 	CTheScripts::Init();
 	CGangs::Initialise();
+	INIT_STAGE("Game objects");
 	LoadingScreen("Loading the Game", "Setup game variables", nil);
 	CClock::Initialise(1000);
 	CHeli::InitHelis();
@@ -432,8 +483,16 @@ bool CGame::Initialise(const char* datFile)
 	CWaterCannons::Init();
 	CBridge::Init();
 	CGarages::Init();
+#if defined PARALLEL_INIT && defined GROUND_HEIGHT_FIELD
+	// needs the bridge parts CBridge::Init found, nothing up to the ground heights stage
+	// changes buildings or collision. The start script can load collision, so it waits.
+	CGroundHeights::BeginInitialise();
+	groundTask = CInitGraph::StartTask("Bake ground heights", CGroundHeights::Bake);
+#endif
+	INIT_STAGE("Dynamic objects");
 	LoadingScreen("Loading the Game", "Position dynamic objects", nil);
 	CWorld::RepositionCertainDynamicObjects();
+	INIT_STAGE("Cull zones and vehicle paths");
 	LoadingScreen("Loading the Game", "Initialise vehicle paths", nil);
 	CCullZones::ResolveVisibilities();
 	CTrain::InitTrains();
@@ -441,10 +500,22 @@ bool CGame::Initialise(const char* datFile)
 	CCredits::Init();
 	CRecordDataForChase::Init();
 	CReplay::Init();
+#ifdef GROUND_HEIGHT_FIELD
+	// needs the collision of all levels, so before the other levels' is removed below
+	INIT_STAGE("Ground heights");
+	LoadingScreen("Loading the Game", "Setup ground heights", nil);
+#ifdef PARALLEL_INIT
+	CInitGraph::WaitForTask(groundTask);
+	CGroundHeights::EndInitialise();
+#else
+	CGroundHeights::Initialise();
+#endif
+#endif
 #ifdef PS2_MENU
 	if ( !TheMemoryCard.m_bWantToLoad )
 	{
 #endif
+	INIT_STAGE("Start script");
 	LoadingScreen("Loading the Game", "Start script", nil);
 	CTheScripts::StartTestScript();
 	CTheScripts::Process();
@@ -452,11 +523,22 @@ bool CGame::Initialise(const char* datFile)
 #ifdef PS2_MENU
 	}
 #endif
+	INIT_STAGE("Load scene");
 	LoadingScreen("Loading the Game", "Load scene", nil);
 	CModelInfo::RemoveColModelsFromOtherLevels(currLevel);
 	CCollision::ms_collisionInMemory = currLevel;
 	for (int i = 0; i < MAX_PADS; i++)
 		CPad::GetPad(i)->Clear(true);
+#ifdef HASHED_NAME_LOOKUPS
+	CModelInfo::DumpNameLookupStats();
+	CDirectory::DumpLookupStats();
+#endif
+#ifdef PARALLEL_INIT
+	CInitGraph::End();
+#endif
+#ifdef CASEPATH_CACHE
+	casepath_report();
+#endif
 	return true;
 }
 
@@ -499,6 +581,9 @@ bool CGame::ShutDown(void)
 	CStreaming::Shutdown();
 	CTxdStore::GameShutdown();
 	CCollision::Shutdown();
+#ifdef GROUND_HEIGHT_FIELD
+	CGroundHeights::Shutdown();
+#endif
 	CWaterLevel::Shutdown();
 	CRubbish::Shutdown();
 	CClouds::Shutdown();
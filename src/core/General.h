@@ -121,6 +121,15 @@ public:
 		return *str2 != '\0';
 	}
 
+	// FNV-1a, the same for strings that faststricmp says are equal
+	static uint32 GetUppercaseKey(const char *str)
+	{
+		uint32 key = 2166136261u;
+		for (; *str; str++)
+			key = (key ^ toupper(*str)) * 16777619u;
+		return key;
+	}
+
 	static bool faststricmp(const char *str1, const char *str2)
 	{
 		for (; *str1; str1++, str2++) {
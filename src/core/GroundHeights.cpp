@@ -0,0 +1,615 @@
+#include "common.h"
+
+#include "Bridge.h"
+#include "Collision.h"
+#include "FileMgr.h"
+#include "General.h"
+#include "ModelInfo.h"
+#include "Pools.h"
+#include "Timer.h"
+#include "World.h"
+#include "GroundHeights.h"
+
+#define GROUNDCELL_SIZE (8.0f)
+#define NUMGROUNDCELLS_X (int32)(WORLD_SIZE_X / GROUNDCELL_SIZE)
+#define NUMGROUNDCELLS_Y (int32)(WORLD_SIZE_Y / GROUNDCELL_SIZE)
+
+#define GROUNDHEIGHTS_FILE "groundz.dat"	// in the user files folder, the game's own may be read-only
+#define GROUNDHEIGHTS_VERSION 1
+
+// how close two triangles have to be to count as one plane
+#define GROUNDLAYER_SLOPE_EPSILON (0.001f)
+#define GROUNDLAYER_Z_EPSILON (0.01f)
+// queries this close to a layer do the line test
+#define GROUNDLAYER_QUERY_EPSILON (0.02f)
+
+struct tGroundHeightsHeader
+{
+	char ident[4];
+	int32 version;
+	int32 numCellsX;
+	int32 numCellsY;
+	uint32 inputHash;
+};
+
+struct tGroundBakeCell
+{
+	CGroundLayer planes[2];
+	float area[2];
+	uint8 surface[2];
+	int32 numPlanes;
+	float minZ, maxZ;
+	uint8 levels;
+	bool bComplex;
+	bool bUnknown;
+};
+
+CGroundCell *CGroundHeights::ms_pCells;
+bool CGroundHeights::bUseField = true;
+
+// between BeginInitialise and EndInitialise, ms_pCells stays nil until the cells are done
+static CGroundCell *pNewCells;
+static tGroundHeightsHeader fileHeader;
+static bool bHaveFileHeader;
+static uint32 nInputHash;
+static bool bBaked;
+static uint32 nBakeTime;	// ms
+
+static uint32
+HashBytes(uint32 hash, const void *data, int32 size)
+{
+	const uint8 *p = (const uint8*)data;
+	for(int32 i = 0; i < size; i++)
+		hash = (hash ^ p[i]) * 16777619u;
+	return hash;
+}
+
+static uint32 HashInt(uint32 hash, int32 i) { return HashBytes(hash, &i, sizeof(i)); }
+static uint32 HashFloat(uint32 hash, float f) { return HashBytes(hash, &f, sizeof(f)); }
+static uint32 HashVector(uint32 hash, const CVector &v) { return HashFloat(HashFloat(HashFloat(hash, v.x), v.y), v.z); }
+
+static bool
+IsBridgeEntity(CEntity *e)
+{
+	return e == CBridge::pLiftRoad || e == CBridge::pLiftPart || e == CBridge::pWeight;
+}
+
+// Only what the vertical line tests in CWorld can ever see: buildings in the sector lists
+static CColModel*
+GetGroundColModel(CEntity *e)
+{
+	if(e == nil || e->bIsBIGBuilding || !e->bUsesCollision)
+		return nil;
+	return CModelInfo::GetModelInfo(e->GetModelIndex())->GetColModel();
+}
+
+static CEntity*
+GetBuildingOrTreadable(int32 i)
+{
+	int32 numBuildings = CPools::GetBuildingPool()->GetSize();
+	if(i < numBuildings)
+		return CPools::GetBuildingPool()->GetSlot(i);
+	return CPools::GetTreadablePool()->GetSlot(i - numBuildings);
+}
+
+static int32
+GetNumBuildingsAndTreadables(void)
+{
+	return CPools::GetBuildingPool()->GetSize() + CPools::GetTreadablePool()->GetSize();
+}
+
+// Everything the baked cells depend on, so a stale file is never used
+static uint32
+CalcInputHash(void)
+{
+	int32 i, j;
+	uint32 hash = 2166136261u;
+
+	for(i = 0; i < MODELINFOSIZE; i++){
+		CBaseModelInfo *mi = CModelInfo::GetModelInfo(i);
+		if(mi == nil || mi->GetColModel() == nil)
+			continue;
+		CColModel *col = mi->GetColModel();
+		hash = HashInt(hash, i);
+		hash = HashInt(hash, col->level);
+		hash = HashInt(hash, col->numSpheres);
+		for(j = 0; j < col->numSpheres; j++){
+			hash = HashVector(hash, col->spheres[j].center);
+			hash = HashFloat(hash, col->spheres[j].radius);
+		}
+		hash = HashInt(hash, col->numBoxes);
+		for(j = 0; j < col->numBoxes; j++){
+			hash = HashVector(hash, col->boxes[j].min);
+			hash = HashVector(hash, col->boxes[j].max);
+		}
+		hash = HashInt(hash, col->numTriangles);
+		for(j = 0; j < col->numTriangles; j++){
+			hash = HashVector(hash, col->vertices[col->triangles[j].a].Get());
+			hash = HashVector(hash, col->vertices[col->triangles[j].b].Get());
+			hash = HashVector(hash, col->vertices[col->triangles[j].c].Get());
+			hash = HashInt(hash, col->triangles[j].surface);
+		}
+	}
+
+	for(i = 0; i < GetNumBuildingsAndTreadables(); i++){
+		CEntity *e = GetBuildingOrTreadable(i);
+		if(GetGroundColModel(e) == nil)
+			continue;
+		hash = HashInt(hash, i);
+		hash = HashInt(hash, e->GetModelIndex());
+		hash = HashInt(hash, IsBridgeEntity(e));
+		hash = HashVector(hash, e->GetRight());
+		hash = HashVector(hash, e->GetForward());
+		hash = HashVector(hash, e->GetUp());
+		hash = HashVector(hash, e->GetPosition());
+	}
+	return hash;
+}
+
+// Area of the part of triangle abc (in xy) that's inside the rectangle
+static float
+ClipTriangleArea(const CVector &a, const CVector &b, const CVector &c, float x0, float y0, float x1, float y1)
+{
+	CVector2D poly[2][8];
+	int32 num = 3;
+	int32 src = 0;
+	poly[0][0] = CVector2D(a.x, a.y);
+	poly[0][1] = CVector2D(b.x, b.y);
+	poly[0][2] = CVector2D(c.x, c.y);
+
+	for(int32 edge = 0; edge < 4 && num > 0; edge++){
+		CVector2D *in = poly[src];
+		CVector2D *out = poly[src^1];
+		int32 numOut = 0;
+		for(int32 i = 0; i < num; i++){
+			const CVector2D &p = in[i];
+			const CVector2D &q = in[(i+1)%num];
+			float dp, dq;
+			switch(edge){
+			case 0: dp = p.x - x0; dq = q.x - x0; break;
+			case 1: dp = x1 - p.x; dq = x1 - q.x; break;
+			case 2: dp = p.y - y0; dq = q.y - y0; break;
+			default: dp = y1 - p.y; dq = y1 - q.y; break;
+			}
+			if(dp >= 0.0f)
+				out[numOut++] = p;
+			if((dp >= 0.0f) != (dq >= 0.0f))
+				out[numOut++] = p + (q - p)*(dp / (dp - dq));
+		}
+		num = numOut;
+		src ^= 1;
+	}
+
+	float area = 0.0f;
+	for(int32 i = 0; i < num; i++){
+		const CVector2D &p = poly[src][i];
+		const CVector2D &q = poly[src][(i+1)%num];
+		area += p.x*q.y - q.x*p.y;
+	}
+	return Abs(area)/2.0f;
+}
+
+static void
+AddBoundsToCell(tGroundBakeCell &cell, float minZ, float maxZ, int32 level)
+{
+	cell.minZ = Min(cell.minZ, minZ);
+	cell.maxZ = Max(cell.maxZ, maxZ);
+	cell.levels |= 1 << level;
+}
+
+static void
+AddPlaneToCell(tGroundBakeCell &cell, const CGroundLayer &plane, float area, uint8 surface)
+{
+	for(int32 i = 0; i < cell.numPlanes; i++)
+		if(Abs(cell.planes[i].dzdx - plane.dzdx) < GROUNDLAYER_SLOPE_EPSILON &&
+		   Abs(cell.planes[i].dzdy - plane.dzdy) < GROUNDLAYER_SLOPE_EPSILON &&
+		   Abs(cell.planes[i].z - plane.z) < GROUNDLAYER_Z_EPSILON){
+			cell.area[i] += area;
+			return;
+		}
+	if(cell.numPlanes == 2){
+		cell.bComplex = true;
+		return;
+	}
+	cell.planes[cell.numPlanes] = plane;
+	cell.area[cell.numPlanes] = area;
+	cell.surface[cell.numPlanes] = surface;
+	cell.numPlanes++;
+}
+
+static void
+BakeEntity(tGroundBakeCell *cells, CEntity *e, CColModel *col)
+{
+	int32 i, x, y;
+	const CMatrix &mat = e->GetMatrix();
+
+	// the line tests only look at the sectors the entity was added to
+	CRect rect = e->GetBoundRect();
+	int32 cellsPerSector = SECTOR_SIZE_X / GROUNDCELL_SIZE;
+	int32 minX = clamp(CWorld::GetSectorIndexX(rect.left), 0, NUMSECTORS_X-1) * cellsPerSector;
+	int32 maxX = (clamp(CWorld::GetSectorIndexX(rect.right), 0, NUMSECTORS_X-1) + 1) * cellsPerSector - 1;
+	int32 minY = clamp(CWorld::GetSectorIndexY(rect.top), 0, NUMSECTORS_Y-1) * cellsPerSector;
+	int32 maxY = (clamp(CWorld::GetSectorIndexY(rect.bottom), 0, NUMSECTORS_Y-1) + 1) * cellsPerSector - 1;
+
+	if(IsBridgeEntity(e)){
+		for(y = minY; y <= maxY; y++)
+			for(x = minX; x <= maxX; x++)
+				cells[y*NUMGROUNDCELLS_X + x].bUnknown = true;
+		return;
+	}
+
+#define CELL_RANGE(bmin, bmax) \
+	int32 x0 = Max((int32)Floor(((bmin).x - WORLD_MIN_X) / GROUNDCELL_SIZE), minX); \
+	int32 x1 = Min((int32)Floor(((bmax).x - WORLD_MIN_X) / GROUNDCELL_SIZE), maxX); \
+	int32 y0 = Max((int32)Floor(((bmin).y - WORLD_MIN_Y) / GROUNDCELL_SIZE), minY); \
+	int32 y1 = Min((int32)Floor(((bmax).y - WORLD_MIN_Y) / GROUNDCELL_SIZE), maxY);
+
+	// spheres and boxes make a cell complex
+	for(i = 0; i < col->numSpheres; i++){
+		CVector c = mat * col->spheres[i].center;
+		float r = col->spheres[i].radius;
+		CVector bmin = c - CVector(r, r, r);
+		CVector bmax = c + CVector(r, r, r);
+		CELL_RANGE(bmin, bmax)
+		for(y = y0; y <= y1; y++)
+			for(x = x0; x <= x1; x++){
+				AddBoundsToCell(cells[y*NUMGROUNDCELLS_X + x], bmin.z, bmax.z, col->level);
+				cells[y*NUMGROUNDCELLS_X + x].bComplex = true;
+			}
+	}
+	for(i = 0; i < col->numBoxes; i++){
+		CVector bmin(1.0e24f, 1.0e24f, 1.0e24f);
+		CVector bmax(-1.0e24f, -1.0e24f, -1.0e24f);
+		for(int32 j = 0; j < 8; j++){
+			CVector v(j&1 ? col->boxes[i].max.x : col->boxes[i].min.x,
+				j&2 ? col->boxes[i].max.y : col->boxes[i].min.y,
+				j&4 ? col->boxes[i].max.z : col->boxes[i].min.z);
+			v = mat * v;
+			bmin = CVector(Min(bmin.x, v.x), Min(bmin.y, v.y), Min(bmin.z, v.z));
+			bmax = CVector(Max(bmax.x, v.x), Max(bmax.y, v.y), Max(bmax.z, v.z));
+		}
+		CELL_RANGE(bmin, bmax)
+		for(y = y0; y <= y1; y++)
+			for(x = x0; x <= x1; x++){
+				AddBoundsToCell(cells[y*NUMGROUNDCELLS_X + x], bmin.z, bmax.z, col->level);
+				cells[y*NUMGROUNDCELLS_X + x].bComplex = true;
+			}
+	}
+
+	for(i = 0; i < col->numTriangles; i++){
+		CVector a = mat * col->vertices[col->triangles[i].a].Get();
+		CVector b = mat * col->vertices[col->triangles[i].b].Get();
+		CVector c = mat * col->vertices[col->triangles[i].c].Get();
+		CVector bmin(Min(a.x, Min(b.x, c.x)), Min(a.y, Min(b.y, c.y)), Min(a.z, Min(b.z, c.z)));
+		CVector bmax(Max(a.x, Max(b.x, c.x)), Max(a.y, Max(b.y, c.y)), Max(a.z, Max(b.z, c.z)));
+		CVector normal = CrossProduct(b - a, c - a);
+		float len = normal.Magnitude();
+		// steep and degenerate triangles can't be a layer
+		bool steep = len < 0.0001f || Abs(normal.z) < 0.05f*len;
+		CELL_RANGE(bmin, bmax)
+		for(y = y0; y <= y1; y++)
+			for(x = x0; x <= x1; x++){
+				tGroundBakeCell &cell = cells[y*NUMGROUNDCELLS_X + x];
+				float cx = x*GROUNDCELL_SIZE + WORLD_MIN_X;
+				float cy = y*GROUNDCELL_SIZE + WORLD_MIN_Y;
+				if(steep){
+					AddBoundsToCell(cell, bmin.z, bmax.z, col->level);
+					cell.bComplex = true;
+					continue;
+				}
+				float area = ClipTriangleArea(a, b, c, cx, cy, cx + GROUNDCELL_SIZE, cy + GROUNDCELL_SIZE);
+				if(area <= 0.0f)
+					continue;
+				CGroundLayer plane;
+				plane.dzdx = -normal.x/normal.z;
+				plane.dzdy = -normal.y/normal.z;
+				plane.z = a.z + plane.dzdx*(cx - a.x) + plane.dzdy*(cy - a.y);
+				AddBoundsToCell(cell, bmin.z, bmax.z, col->level);
+				AddPlaneToCell(cell, plane, area, col->triangles[i].surface);
+			}
+	}
+#undef CELL_RANGE
+}
+
+static float
+GetLayerZ(const CGroundLayer &layer, float dx, float dy)
+{
+	return layer.z + layer.dzdx*dx + layer.dzdy*dy;
+}
+
+static void
+FinishCell(const tGroundBakeCell &bake, CGroundCell &cell)
+{
+	int32 i;
+	const float cellArea = SQR(GROUNDCELL_SIZE);
+
+	memset(&cell, 0, sizeof(cell));
+	cell.levels = bake.levels;
+	if(bake.bUnknown){
+		cell.type = GROUNDCELL_UNKNOWN;
+		return;
+	}
+	if(bake.minZ > bake.maxZ){
+		cell.type = GROUNDCELL_EMPTY;
+		return;
+	}
+	cell.minZ = clamp(Floor(bake.minZ*8.0f) - 1.0f, -32768.0f, 32767.0f);
+	cell.maxZ = clamp(Ceil(bake.maxZ*8.0f) + 1.0f, -32768.0f, 32767.0f);
+	cell.type = GROUNDCELL_COMPLEX;
+
+	// the ground queries start at z 1000 and go down to -1000
+	if(bake.bComplex || bake.minZ < -999.0f || bake.maxZ > 999.0f)
+		return;
+	// every layer has to cover the whole cell, a plane that doesn't has holes the line test would fall through
+	for(i = 0; i < bake.numPlanes; i++)
+		if(Abs(bake.area[i] - cellArea) > cellArea*0.001f)
+			return;
+
+	int32 bottom = 0;
+	if(bake.numPlanes == 2){
+		// layers have to be clearly apart in the whole cell
+		const float corners[4][2] = { { 0.0f, 0.0f }, { GROUNDCELL_SIZE, 0.0f }, { 0.0f, GROUNDCELL_SIZE }, { GROUNDCELL_SIZE, GROUNDCELL_SIZE } };
+		float minDiff = 1.0e24f, maxDiff = -1.0e24f;
+		for(i = 0; i < 4; i++){
+			float diff = GetLayerZ(bake.planes[1], corners[i][0], corners[i][1]) - GetLayerZ(bake.planes[0], corners[i][0], corners[i][1]);
+			minDiff = Min(minDiff, diff);
+			maxDiff = Max(maxDiff, diff);
+		}
+		if(minDiff > 0.5f)
+			bottom = 0;
+		else if(maxDiff < -0.5f)
+			bottom = 1;
+		else
+			return;
+	}
+	cell.type = GROUNDCELL_LAYERS;
+	cell.numLayers = bake.numPlanes;
+	for(i = 0; i < bake.numPlanes; i++)
+		cell.layers[i] = bake.planes[bottom ^ i];
+	cell.surface = bake.surface[bottom ^ (bake.numPlanes-1)];
+}
+
+static void
+BakeGroundHeights(CGroundCell *cells)
+{
+	int32 i;
+	tGroundBakeCell *bake = new tGroundBakeCell[NUMGROUNDCELLS_X*NUMGROUNDCELLS_Y];
+
+	for(i = 0; i < NUMGROUNDCELLS_X*NUMGROUNDCELLS_Y; i++){
+		bake[i].numPlanes = 0;
+		bake[i].minZ = 1.0e24f;
+		bake[i].maxZ = -1.0e24f;
+		bake[i].levels = 0;
+		bake[i].bComplex = false;
+		bake[i].bUnknown = false;
+	}
+	for(i = 0; i < GetNumBuildingsAndTreadables(); i++){
+		CEntity *e = GetBuildingOrTreadable(i);
+		CColModel *col = GetGroundColModel(e);
+		if(col)
+			BakeEntity(bake, e, col);
+	}
+	for(i = 0; i < NUMGROUNDCELLS_X*NUMGROUNDCELLS_Y; i++)
+		FinishCell(bake[i], cells[i]);
+
+	delete[] bake;
+}
+
+static bool
+IsCurrentHeader(const tGroundHeightsHeader &header, uint32 inputHash)
+{
+	return strncmp(header.ident, "GRND", 4) == 0 &&
+		header.version == GROUNDHEIGHTS_VERSION &&
+		header.numCellsX == NUMGROUNDCELLS_X &&
+		header.numCellsY == NUMGROUNDCELLS_Y &&
+		header.inputHash == inputHash;
+}
+
+static void
+BakeNewCells(void)
+{
+	uint32 start = CTimer::GetCurrentTimeInCycles();
+	BakeGroundHeights(pNewCells);
+	nBakeTime = (CTimer::GetCurrentTimeInCycles() - start) / CTimer::GetCyclesPerMillisecond();
+	bBaked = true;
+}
+
+// Called at load while the collision of all levels is still in memory
+void
+CGroundHeights::Initialise(void)
+{
+	BeginInitialise();
+	Bake();
+	EndInitialise();
+}
+
+// Initialise in three parts, so Bake can run on a CInitGraph task.
+// Begin and End do the file, Bake only reads the buildings and their collision.
+void
+CGroundHeights::BeginInitialise(void)
+{
+	int fd;
+
+	Shutdown();
+	pNewCells = new CGroundCell[NUMGROUNDCELLS_X*NUMGROUNDCELLS_Y];
+	bHaveFileHeader = false;
+	bBaked = false;
+	CFileMgr::SetDirMyDocuments();
+	fd = CFileMgr::OpenFile(GROUNDHEIGHTS_FILE, "rb");
+	if(fd > 0){
+		bHaveFileHeader = CFileMgr::Read(fd, (char*)&fileHeader, sizeof(fileHeader)) == sizeof(fileHeader);
+		CFileMgr::CloseFile(fd);
+	}
+	CFileMgr::SetDir("");
+}
+
+void
+CGroundHeights::Bake(void)
+{
+	nInputHash = CalcInputHash();
+	if(!bHaveFileHeader || !IsCurrentHeader(fileHeader, nInputHash))
+		BakeNewCells();
+}
+
+void
+CGroundHeights::EndInitialise(void)
+{
+	int fd;
+	tGroundHeightsHeader header;
+	int32 cellsSize = NUMGROUNDCELLS_X*NUMGROUNDCELLS_Y*sizeof(CGroundCell);
+
+	CFileMgr::SetDirMyDocuments();
+	if(!bBaked){
+		bool valid = false;
+		fd = CFileMgr::OpenFile(GROUNDHEIGHTS_FILE, "rb");
+		if(fd > 0){
+			valid = CFileMgr::Read(fd, (char*)&header, sizeof(header)) == sizeof(header) &&
+				IsCurrentHeader(header, nInputHash) &&
+				CFileMgr::Read(fd, (char*)pNewCells, cellsSize) == (size_t)cellsSize;
+			CFileMgr::CloseFile(fd);
+		}
+		if(valid)
+			debug("Loaded ground heights from %s\n", GROUNDHEIGHTS_FILE);
+		else
+			BakeNewCells();
+	}
+
+	if(bBaked){
+		debug("Baked ground heights in %d ms\n", nBakeTime);
+		fd = CFileMgr::OpenFileForWriting(GROUNDHEIGHTS_FILE);
+		if(fd > 0){
+			memcpy(header.ident, "GRND", 4);
+			header.version = GROUNDHEIGHTS_VERSION;
+			header.numCellsX = NUMGROUNDCELLS_X;
+			header.numCellsY = NUMGROUNDCELLS_Y;
+			header.inputHash = nInputHash;
+			// a short file fails the size check when it's read, so nothing else to do
+			if(CFileMgr::Write(fd, (char*)&header, sizeof(header)) != sizeof(header) ||
+			   CFileMgr::Write(fd, (char*)pNewCells, cellsSize) != (size_t)cellsSize)
+				debug("Couldn't write %s\n", GROUNDHEIGHTS_FILE);
+			CFileMgr::CloseFile(fd);
+		}else
+			debug("Couldn't write %s\n", GROUNDHEIGHTS_FILE);
+	}
+	CFileMgr::SetDir("");
+	ms_pCells = pNewCells;
+	pNewCells = nil;
+}
+
+void
+CGroundHeights::Shutdown(void)
+{
+	delete[] ms_pCells;
+	ms_pCells = nil;
+	delete[] pNewCells;
+	pNewCells = nil;
+}
+
+// For buildings that change at runtime, their cells always do the line test from now on
+void
+CGroundHeights::InvalidateArea(const CRect &rect)
+{
+	if(ms_pCells == nil)
+		return;
+	int32 x0 = clamp((int32)Floor((rect.left - WORLD_MIN_X) / GROUNDCELL_SIZE), 0, NUMGROUNDCELLS_X-1);
+	int32 x1 = clamp((int32)Floor((rect.right - WORLD_MIN_X) / GROUNDCELL_SIZE), 0, NUMGROUNDCELLS_X-1);
+	int32 y0 = clamp((int32)Floor((rect.top - WORLD_MIN_Y) / GROUNDCELL_SIZE), 0, NUMGROUNDCELLS_Y-1);
+	int32 y1 = clamp((int32)Floor((rect.bottom - WORLD_MIN_Y) / GROUNDCELL_SIZE), 0, NUMGROUNDCELLS_Y-1);
+	for(int32 y = y0; y <= y1; y++)
+		for(int32 x = x0; x <= x1; x++)
+			ms_pCells[y*NUMGROUNDCELLS_X + x].type = GROUNDCELL_UNKNOWN;
+}
+
+// Highest building collision at or below z. Returns false if the field can't tell
+// and the caller has to do the line test.
+bool
+CGroundHeights::FindGroundZ(float x, float y, float z, float &groundZ, bool &found)
+{
+	if(ms_pCells == nil || !bUseField)
+		return false;
+	float fx = (x - WORLD_MIN_X) / GROUNDCELL_SIZE;
+	float fy = (y - WORLD_MIN_Y) / GROUNDCELL_SIZE;
+	if(!(fx >= 0.0f && fx < NUMGROUNDCELLS_X && fy >= 0.0f && fy < NUMGROUNDCELLS_Y))
+		return false;
+	int32 ix = fx;
+	int32 iy = fy;
+	const CGroundCell &cell = ms_pCells[iy*NUMGROUNDCELLS_X + ix];
+
+	if(cell.type == GROUNDCELL_UNKNOWN)
+		return false;
+	// collision of the other levels isn't loaded, so the line test wouldn't find it
+	if(cell.levels & ~(1<<LEVEL_GENERIC | 1<<CCollision::ms_collisionInMemory))
+		return false;
+	if(cell.type == GROUNDCELL_EMPTY || z < cell.minZ/8.0f){
+		found = false;
+		return true;
+	}
+	if(cell.type != GROUNDCELL_LAYERS)
+		return false;
+
+	float dx = x - (ix*GROUNDCELL_SIZE + WORLD_MIN_X);
+	float dy = y - (iy*GROUNDCELL_SIZE + WORLD_MIN_Y);
+	for(int32 i = cell.numLayers-1; i >= 0; i--){
+		float layerZ = GetLayerZ(cell.layers[i], dx, dy);
+		if(z < layerZ - GROUNDLAYER_QUERY_EPSILON)
+			continue;
+		if(z < layerZ + GROUNDLAYER_QUERY_EPSILON)
+			return false;
+		groundZ = layerZ;
+		found = true;
+		return true;
+	}
+	found = false;
+	return true;
+}
+
+#ifndef MASTER
+// Compares the field against the line tests at random points of the map
+void
+CGroundHeights::CheckGroundHeights(void)
+{
+	const int32 numTests = 10000;
+	int32 i;
+	int32 numTypes[4] = { 0, 0, 0, 0 };
+	int32 numAnswered = 0, numWrong = 0;
+	uint32 fieldCycles = 0, lineCycles = 0;
+
+	if(ms_pCells == nil)
+		return;
+	for(i = 0; i < NUMGROUNDCELLS_X*NUMGROUNDCELLS_Y; i++)
+		numTypes[ms_pCells[i].type]++;
+
+	bool useField = bUseField;
+	for(i = 0; i < numTests; i++){
+		float x = CGeneral::GetRandomNumberInRange(WORLD_MIN_X, WORLD_MAX_X);
+		float y = CGeneral::GetRandomNumberInRange(WORLD_MIN_Y, WORLD_MAX_Y);
+		float z = CGeneral::GetRandomNumberInRange(-50.0f, 200.0f);
+		float groundZ = 0.0f;
+		bool found = false, lineFound;
+
+		bUseField = true;
+		uint32 start = CTimer::GetCurrentTimeInCycles();
+		bool answered = FindGroundZ(x, y, z, groundZ, found);
+		fieldCycles += CTimer::GetCurrentTimeInCycles() - start;
+
+		bUseField = false;
+		start = CTimer::GetCurrentTimeInCycles();
+		float lineZ = CWorld::FindGroundZFor3DCoord(x, y, z, &lineFound);
+		lineCycles += CTimer::GetCurrentTimeInCycles() - start;
+
+		if(!answered)
+			continue;
+		numAnswered++;
+		if(found != lineFound || (found && Abs(groundZ - lineZ) > 0.05f)){
+			numWrong++;
+			debug("Ground heights differ at %f %f %f: %d %f, line test %d %f\n", x, y, z, found, groundZ, lineFound, lineZ);
+		}
+	}
+	bUseField = useField;
+
+	float cyclesPerUs = CTimer::GetCyclesPerMillisecond() / 1000.0f;
+	debug("Ground heights: %d unknown, %d empty, %d layered, %d complex cells\n", numTypes[GROUNDCELL_UNKNOWN], numTypes[GROUNDCELL_EMPTY], numTypes[GROUNDCELL_LAYERS], numTypes[GROUNDCELL_COMPLEX]);
+	debug("  %d of %d queries answered, %d wrong\n", numAnswered, numTests, numWrong);
+	debug("  field %.2f us/query, line test %.2f us/query\n", fieldCycles / cyclesPerUs / numTests, lineCycles / cyclesPerUs / numTests);
+}
+#endif
@@ -0,0 +1,53 @@
+#pragma once
+
+// Ground heights of the static map collision baked into a grid of cells, so
+// CWorld::FindGroundZForCoord and FindGroundZFor3DCoord mostly don't need a line test.
+// A cell that is fully covered by one or two planes of building collision answers
+// queries directly. Cells with anything else in them only know their z range, and
+// the caller falls back to the line test whenever the field can't answer exactly.
+
+class CRect;
+
+enum
+{
+	GROUNDCELL_UNKNOWN,	// always do the line test
+	GROUNDCELL_EMPTY,	// no building collision in this cell
+	GROUNDCELL_LAYERS,	// covered by numLayers planes
+	GROUNDCELL_COMPLEX,	// only minZ and maxZ are known
+};
+
+struct CGroundLayer
+{
+	float z;	// at the min corner of the cell
+	float dzdx;
+	float dzdy;
+};
+
+struct CGroundCell
+{
+	CGroundLayer layers[2];	// bottom to top
+	int16 minZ;	// in 1/8 m, rounded outwards
+	int16 maxZ;
+	uint8 type;
+	uint8 numLayers;
+	uint8 levels;	// one bit for every col model level in this cell
+	uint8 surface;	// of the top layer
+};
+
+class CGroundHeights
+{
+	static CGroundCell *ms_pCells;
+public:
+	static bool bUseField;
+
+	static void Initialise(void);
+	static void BeginInitialise(void);
+	static void Bake(void);
+	static void EndInitialise(void);
+	static void Shutdown(void);
+	static void InvalidateArea(const CRect &rect);
+	static bool FindGroundZ(float x, float y, float z, float &groundZ, bool &found);
+#ifndef MASTER
+	static void CheckGroundHeights(void);
+#endif
+};
@@ -0,0 +1,344 @@
+#ifdef _WIN32
+#define WITHWINDOWS
+#endif
+#include "common.h"
+
+#ifdef PARALLEL_INIT
+#ifndef _WIN32
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#endif
+
+#include "Timer.h"
+#include "WorkerPool.h"
+#include "InitGraph.h"
+
+#ifdef _WIN32
+typedef HANDLE InitThread;
+typedef HANDLE InitSema;
+typedef CRITICAL_SECTION InitMutex;
+#define MUTEX_LOCK(m) EnterCriticalSection(&m)
+#define MUTEX_UNLOCK(m) LeaveCriticalSection(&m)
+#define SEMA_WAIT(s) WaitForSingleObject(s, INFINITE)
+#define SEMA_POST(s) ReleaseSemaphore(s, 1, nil)
+#define YIELD() Sleep(0)
+#else
+typedef pthread_t InitThread;
+typedef sem_t InitSema;
+typedef pthread_mutex_t InitMutex;
+#define MUTEX_LOCK(m) pthread_mutex_lock(&m)
+#define MUTEX_UNLOCK(m) pthread_mutex_unlock(&m)
+#define SEMA_WAIT(s) sem_wait(&s)
+#define SEMA_POST(s) sem_post(&s)
+#define YIELD() sched_yield()
+#endif
+
+enum
+{
+	INITTASK_PENDING,
+	INITTASK_RUNNING,
+	INITTASK_DONE
+};
+
+struct tInitStage
+{
+	const char *name;
+	uint32 start, end;	// ms since Begin
+	uint32 waitTime;	// spent in WaitForTask
+	int32 blockedBy;	// task that finished last while the stage waited, -1 if none
+	bool bCritical;
+};
+
+struct tInitTask
+{
+	const char *name;
+	InitTaskFunc func;
+	int32 dep;
+	int32 stage;	// started during this one
+	uint32 created, start, end;
+	int32 thread;	// 0 is the main thread
+	volatile int32 state;
+	bool bCritical;
+};
+
+static tInitStage aStages[MAX_INITSTAGES];
+static tInitTask aTasks[MAX_INITTASKS];
+static int32 nNumStages;
+static int32 nNumTasks;
+static uint32 nBeginTime;
+
+static InitThread aThreads[MAX_INITTHREADS];
+static int32 nNumThreads;
+static InitSema gTaskSema;	// released once for every task that can start
+static bool gbHaveTaskSema;
+static InitMutex gTaskMutex;
+static volatile bool gbInitQuit;
+
+static uint32
+GetTime(void)
+{
+	return CTimer::GetCurrentTimeInCycles() / CTimer::GetCyclesPerMillisecond() - nBeginTime;
+}
+
+static bool
+IsReady(int32 i)
+{
+	return aTasks[i].state == INITTASK_PENDING &&
+		(aTasks[i].dep == -1 || aTasks[aTasks[i].dep].state == INITTASK_DONE);
+}
+
+static void
+RunTask(int32 i, int32 thread)
+{
+	int32 j;
+	tInitTask *task = &aTasks[i];
+
+	task->thread = thread;
+	task->start = GetTime();
+	task->func();
+	task->end = GetTime();
+
+	MUTEX_LOCK(gTaskMutex);
+	task->state = INITTASK_DONE;
+	for(j = 0; j < nNumTasks; j++)
+		if(aTasks[j].dep == i && aTasks[j].state == INITTASK_PENDING)
+			SEMA_POST(gTaskSema);
+	MUTEX_UNLOCK(gTaskMutex);
+}
+
+// Claims the first task that can run, -1 if another thread was quicker
+static int32
+TakeReadyTask(void)
+{
+	int32 i;
+
+	MUTEX_LOCK(gTaskMutex);
+	for(i = 0; i < nNumTasks; i++)
+		if(IsReady(i)){
+			aTasks[i].state = INITTASK_RUNNING;
+			break;
+		}
+	MUTEX_UNLOCK(gTaskMutex);
+	return i < nNumTasks ? i : -1;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI
+InitThreadFunc(LPVOID param)
+#else
+static void*
+InitThreadFunc(void *param)
+#endif
+{
+	int32 thread = (int32)(uintptr)param;
+	int32 i;
+	for(;;){
+		SEMA_WAIT(gTaskSema);
+		if(gbInitQuit)
+			break;
+		i = TakeReadyTask();
+		if(i != -1)
+			RunTask(i, thread);
+	}
+	return 0;
+}
+
+void
+CInitGraph::Begin(void)
+{
+	int32 i, numThreads;
+
+	nNumStages = 0;
+	nNumTasks = 0;
+	nBeginTime = 0;
+	nBeginTime = GetTime();
+
+	gbInitQuit = false;
+	gbHaveTaskSema = false;
+	nNumThreads = 0;
+	numThreads = Min(CWorkerPool::GetNumWorkers(), (int32)MAX_INITTHREADS);
+#ifdef _WIN32
+	InitializeCriticalSection(&gTaskMutex);
+	gTaskSema = CreateSemaphore(nil, 0, MAX_INITTASKS, nil);
+	if(gTaskSema == nil)
+		return;
+	gbHaveTaskSema = true;
+	for(i = 0; i < numThreads; i++){
+		aThreads[i] = CreateThread(nil, 0, InitThreadFunc, (LPVOID)(uintptr)(i+1), 0, nil);
+		if(aThreads[i] == nil)
+			break;
+		nNumThreads++;
+	}
+#else
+	pthread_mutex_init(&gTaskMutex, nil);
+	if(sem_init(&gTaskSema, 0, 0) == -1)
+		return;
+	gbHaveTaskSema = true;
+	for(i = 0; i < numThreads; i++){
+		if(pthread_create(&aThreads[i], nil, InitThreadFunc, (void*)(uintptr)(i+1)) != 0)
+			break;
+		nNumThreads++;
+	}
+#endif
+}
+
+void
+CInitGraph::Stage(const char *name)
+{
+	uint32 now = GetTime();
+	tInitStage *stage;
+
+	if(nNumStages > 0)
+		aStages[nNumStages-1].end = now;
+	if(nNumStages == MAX_INITSTAGES)
+		return;
+	stage = &aStages[nNumStages++];
+	stage->name = name;
+	stage->start = now;
+	stage->end = now;
+	stage->waitTime = 0;
+	stage->blockedBy = -1;
+	stage->bCritical = false;
+}
+
+int32
+CInitGraph::StartTask(const char *name, InitTaskFunc func, int32 dep)
+{
+	int32 i;
+	tInitTask *task;
+
+	assert(nNumTasks < MAX_INITTASKS);
+	MUTEX_LOCK(gTaskMutex);
+	i = nNumTasks;
+	task = &aTasks[i];
+	task->name = name;
+	task->func = func;
+	task->dep = dep;
+	task->stage = nNumStages-1;
+	task->created = GetTime();
+	task->thread = 0;
+	task->state = INITTASK_PENDING;
+	task->bCritical = false;
+	nNumTasks++;
+	if(nNumThreads > 0 && IsReady(i))
+		SEMA_POST(gTaskSema);
+	MUTEX_UNLOCK(gTaskMutex);
+
+	// without threads the task is simply part of this stage
+	if(nNumThreads == 0){
+		task->state = INITTASK_RUNNING;
+		RunTask(i, 0);
+	}
+	return i;
+}
+
+void
+CInitGraph::WaitForTask(int32 i)
+{
+	int32 j;
+	uint32 start = GetTime();
+	tInitStage *stage = nNumStages > 0 ? &aStages[nNumStages-1] : nil;
+
+	if(aTasks[i].state == INITTASK_DONE)
+		return;
+	while(aTasks[i].state != INITTASK_DONE){
+		// rather than sit idle, run the task or what it still waits for here
+		for(j = i; aTasks[j].dep != -1 && aTasks[aTasks[j].dep].state != INITTASK_DONE; j = aTasks[j].dep);
+		MUTEX_LOCK(gTaskMutex);
+		bool take = IsReady(j);
+		if(take)
+			aTasks[j].state = INITTASK_RUNNING;
+		MUTEX_UNLOCK(gTaskMutex);
+		if(take)
+			RunTask(j, 0);
+		else
+			YIELD();
+	}
+	if(stage){
+		stage->waitTime += GetTime() - start;
+		if(stage->blockedBy == -1 || aTasks[i].end > aTasks[stage->blockedBy].end)
+			stage->blockedBy = i;
+	}
+}
+
+// Back from the last stage, always along what finished last before the next thing could go on
+static void
+MarkCriticalPath(void)
+{
+	int32 s, from, t, dep;
+
+	s = nNumStages-1;
+	while(s >= 0){
+		aStages[s].bCritical = true;
+		from = s;
+		for(t = aStages[s].blockedBy; t != -1; t = dep){
+			aTasks[t].bCritical = true;
+			s = aTasks[t].stage;
+			dep = aTasks[t].dep;
+			if(dep != -1 && aTasks[dep].end <= aTasks[t].created)
+				dep = -1;
+		}
+		if(s >= from)
+			s = from-1;
+	}
+}
+
+void
+CInitGraph::End(void)
+{
+	int32 i, j, n;
+	uint32 total, stageTime, taskTime;
+	char line[256];
+
+	for(i = 0; i < nNumTasks; i++)
+		WaitForTask(i);
+	total = GetTime();
+	if(nNumStages > 0)
+		aStages[nNumStages-1].end = total;
+
+	gbInitQuit = true;
+	for(i = 0; i < nNumThreads; i++)
+		SEMA_POST(gTaskSema);
+	for(i = 0; i < nNumThreads; i++){
+#ifdef _WIN32
+		WaitForSingleObject(aThreads[i], INFINITE);
+		CloseHandle(aThreads[i]);
+#else
+		pthread_join(aThreads[i], nil);
+#endif
+	}
+#ifdef _WIN32
+	if(gbHaveTaskSema)
+		CloseHandle(gTaskSema);
+	DeleteCriticalSection(&gTaskMutex);
+#else
+	if(gbHaveTaskSema)
+		sem_destroy(&gTaskSema);
+	pthread_mutex_destroy(&gTaskMutex);
+#endif
+	gbHaveTaskSema = false;
+	nNumThreads = 0;
+
+	MarkCriticalPath();
+	stageTime = 0;
+	taskTime = 0;
+	for(i = 0; i < nNumStages; i++)
+		stageTime += aStages[i].end - aStages[i].start - aStages[i].waitTime;
+	for(i = 0; i < nNumTasks; i++)
+		taskTime += aTasks[i].end - aTasks[i].start;
+	debug("Startup took %d ms, %d ms on the main thread and %d ms of tasks, * is the critical path\n", total, stageTime, taskTime);
+	for(i = 0; i < nNumStages; i++){
+		// one debug() per line, every call starts a new one
+		n = snprintf(line, sizeof(line), "%c %-32s %6d ms at %6d", aStages[i].bCritical ? '*' : ' ', aStages[i].name,
+			aStages[i].end - aStages[i].start, aStages[i].start);
+		if(aStages[i].waitTime && n > 0 && n < (int32)sizeof(line))
+			snprintf(line + n, sizeof(line) - n, ", %d ms of it waiting for %s", aStages[i].waitTime, aTasks[aStages[i].blockedBy].name);
+		debug("%s\n", line);
+		for(j = 0; j < nNumTasks; j++)
+			if(aTasks[j].stage == i)
+				debug("%c   %-30s %6d ms at %6d on thread %d\n", aTasks[j].bCritical ? '*' : ' ', aTasks[j].name,
+					aTasks[j].end - aTasks[j].start, aTasks[j].start, aTasks[j].thread);
+	}
+}
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+
+// Splits startup into stages and tasks. Stages run on the main thread one
+// after another, in the order the code marks them, so everything that touches
+// RW, CFileMgr's directory or the loading screen stays where it always ran.
+// Tasks run on threads of their own once the task they depend on is done and
+// are joined by the first stage that needs them. A task must not touch RW,
+// files or CWorkerPool, nor anything the stages running next to it change.
+// End prints every stage and task and the chain that decided the total time.
+
+enum
+{
+	MAX_INITSTAGES = 64,
+	MAX_INITTASKS = 16,
+	MAX_INITTHREADS = 4
+};
+
+typedef void (*InitTaskFunc)(void);
+
+class CInitGraph
+{
+public:
+	static void Begin(void);
+	static void Stage(const char *name);
+	static int32 StartTask(const char *name, InitTaskFunc func, int32 dep = -1);
+	static void WaitForTask(int32 task);
+	static void End(void);
+};
+
+#ifdef PARALLEL_INIT
+#define INIT_STAGE(name) CInitGraph::Stage(name)
+#else
+#define INIT_STAGE(name)
+#endif
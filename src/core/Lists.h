@@ -130,3 +130,37 @@ public:
 		}
 	}
 };
+
+class CEntity;
+
+#ifdef PACKED_SECTOR_LISTS
+// Packed copy of a sector list for the spatial queries so they don't have to
+// chase CPtrNodes. Buildings never move, so their bounds are cached here too.
+struct CSectorArrayEntry
+{
+	CEntity *entity;
+	CVector position;
+	CVector boundCentre;
+	float boundRadius;
+	float cullRadius;	// also encloses the bounding box of the col model
+	bool bStaticBounds;	// the fields above are only valid when this is set
+};
+
+class CSectorArray
+{
+public:
+	CSectorArrayEntry *entries;
+	int32 num;
+	int32 size;
+
+	CSectorArray(void) { entries = nil; num = 0; size = 0; }
+	void Add(CEntity *entity);
+	void Remove(CEntity *entity);	// swaps the last entry into the hole
+	void UpdateBounds(CEntity *entity);
+	void Flush(void) { num = 0; }
+};
+
+typedef CSectorArray CSectorQueryList;
+#else
+typedef CPtrList CSectorQueryList;
+#endif
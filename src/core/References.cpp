@@ -42,27 +42,12 @@ CReferences::RemoveReferencesToPlayer(void)
 void
 CReferences::PruneAllReferencesInWorld(void)
 {
-	int i;
-	CEntity *e;
+	for(CPed *ped : *CPools::GetPedPool())
+		ped->PruneReferences();
 
-	i = CPools::GetPedPool()->GetSize();
-	while(--i >= 0){
-		e = CPools::GetPedPool()->GetSlot(i);
-		if(e)
-			e->PruneReferences();
-	}
+	for(CVehicle *veh : *CPools::GetVehiclePool())
+		veh->PruneReferences();
 
-	i = CPools::GetVehiclePool()->GetSize();
-	while(--i >= 0){
-		e = CPools::GetVehiclePool()->GetSlot(i);
-		if(e)
-			e->PruneReferences();
-	}
-
-	i = CPools::GetObjectPool()->GetSize();
-	while(--i >= 0){
-		e = CPools::GetObjectPool()->GetSlot(i);
-		if(e)
-			e->PruneReferences();
-	}
+	for(CObject *obj : *CPools::GetObjectPool())
+		obj->PruneReferences();
 }
@@ -28,6 +28,10 @@
 #include "CutsceneMgr.h"
 #include "CdStream.h"
 #include "Streaming.h"
+#include "StreamingQueue.h"
+#include "StreamingPrefetch.h"
+#include "StreamingFinalizeQueue.h"
+#include "StreamingEviction.h"
 #ifdef FIX_BUGS
 #include "Replay.h"
 #endif
@@ -45,9 +49,9 @@ CStreamingInfo CStreaming::ms_endRequestedList;
 int32 CStreaming::ms_oldSectorX;
 int32 CStreaming::ms_oldSectorY;
 int32 CStreaming::ms_streamingBufferSize;
-int8 *CStreaming::ms_pStreamingBuffer[2];
+int8 *CStreaming::ms_pStreamingBuffer[NUM_STREAMING_CHANNELS];
 size_t CStreaming::ms_memoryUsed;
-CStreamingChannel CStreaming::ms_channel[2];
+CStreamingChannel CStreaming::ms_channel[NUM_STREAMING_CHANNELS];
 int32 CStreaming::ms_channelError;
 int32 CStreaming::ms_numVehiclesLoaded;
 int32 CStreaming::ms_vehiclesLoaded[MAXVEHICLESLOADED];
@@ -93,6 +97,9 @@ CStreamingInfo::SetCdPosnAndSize(uint32 posn, uint32 size)
 {
 	m_position = posn;
 	m_size = size;
+#ifdef SORTED_REQUEST_QUEUE
+	CStreamingQueue::PositionsChanged();
+#endif
 }
 
 void
@@ -112,12 +119,17 @@ CStreamingInfo::RemoveFromList(void)
 	m_prev->m_next = m_next;
 	m_next = nil;
 	m_prev = nil;
+#ifdef SORTED_REQUEST_QUEUE
+	int32 streamId = this - CStreaming::ms_aInfoForModel;
+	if(streamId >= 0 && streamId < NUMSTREAMINFO)
+		CStreamingQueue::Remove(streamId);
+#endif
 }
 
 void
 CStreaming::Init2(void)
 {
-	int i;
+	int i, ch;
 
 	for(i = 0; i < NUMSTREAMINFO; i++){
 		ms_aInfoForModel[i].m_loadState = STREAMSTATE_NOTLOADED;
@@ -141,6 +153,18 @@ CStreaming::Init2(void)
 	ms_startRequestedList.m_prev = nil;
 	ms_endRequestedList.m_prev = &ms_startRequestedList;
 	ms_endRequestedList.m_next = nil;
+#ifdef SORTED_REQUEST_QUEUE
+	CStreamingQueue::Init();
+#endif
+#ifdef STREAMING_PREFETCH
+	CStreamingPrefetch::Init();
+#endif
+#ifdef STREAMING_FINALIZE_QUEUE
+	CStreamingFinalizeQueue::Init();
+#endif
+#ifdef COST_AWARE_EVICTION
+	CStreamingEviction::Init();
+#endif
 
 	// init misc
 
@@ -153,13 +177,12 @@ CStreaming::Init2(void)
 
 	// init channels
 
-	ms_channel[0].state = CHANNELSTATE_IDLE;
-	ms_channel[1].state = CHANNELSTATE_IDLE;
-	for(i = 0; i < 4; i++){
-		ms_channel[0].streamIds[i] = -1;
-		ms_channel[0].offsets[i] = -1;
-		ms_channel[1].streamIds[i] = -1;
-		ms_channel[1].offsets[i] = -1;
+	for(ch = 0; ch < NUM_STREAMING_CHANNELS; ch++){
+		ms_channel[ch].state = CHANNELSTATE_IDLE;
+		for(i = 0; i < 4; i++){
+			ms_channel[ch].streamIds[i] = -1;
+			ms_channel[ch].offsets[i] = -1;
+		}
 	}
 
 	// init stream info, mark things that are already loaded
@@ -194,10 +217,12 @@ CStreaming::Init2(void)
 	LoadCdDirectory();
 
 	// allocate streaming buffers
+	// one half of the largest file per channel, big files use the buffers of channel 0 and 1
 	if(ms_streamingBufferSize & 1) ms_streamingBufferSize++;
-	ms_pStreamingBuffer[0] = (int8*)RwMallocAlign(ms_streamingBufferSize*CDSTREAM_SECTOR_SIZE, CDSTREAM_SECTOR_SIZE);
 	ms_streamingBufferSize /= 2;
-	ms_pStreamingBuffer[1] = ms_pStreamingBuffer[0] + ms_streamingBufferSize*CDSTREAM_SECTOR_SIZE;
+	ms_pStreamingBuffer[0] = (int8*)RwMallocAlign(ms_streamingBufferSize*NUM_STREAMING_CHANNELS*CDSTREAM_SECTOR_SIZE, CDSTREAM_SECTOR_SIZE);
+	for(ch = 1; ch < NUM_STREAMING_CHANNELS; ch++)
+		ms_pStreamingBuffer[ch] = ms_pStreamingBuffer[ch-1] + ms_streamingBufferSize*CDSTREAM_SECTOR_SIZE;
 	debug("Streaming buffer size is %d sectors", ms_streamingBufferSize);
 
 	// PC only, figure out how much memory we got
@@ -321,6 +346,14 @@ CStreaming::Update(void)
 		StreamZoneModels(FindPlayerCoors());
 	}
 
+#ifdef STREAMING_PREFETCH
+	CStreamingPrefetch::Update(!ms_disableStreaming &&
+		!CCutsceneMgr::IsRunning() &&
+		!requestedSubway &&
+		!CGame::playingIntro &&
+		!CRenderer::m_loadingPriority);
+#endif
+
 	LoadRequestedModels();
 
 
@@ -553,6 +586,9 @@ CStreaming::ConvertBufferToObject(int8 *buf, int32 streamId)
 	if(ms_aInfoForModel[streamId].m_loadState != STREAMSTATE_STARTED){
 		ms_aInfoForModel[streamId].m_loadState = STREAMSTATE_LOADED;
 		ms_memoryUsed += ms_aInfoForModel[streamId].GetCdSize() * CDSTREAM_SECTOR_SIZE;
+#ifdef COST_AWARE_EVICTION
+		CStreamingEviction::ModelLoaded(streamId);
+#endif
 	}
 
 	endTime = CTimer::GetCurrentTimeInCycles() / CTimer::GetCyclesPerMillisecond();
@@ -608,6 +644,9 @@ CStreaming::FinishLoadingLargeFile(int8 *buf, int32 streamId)
 	RwStreamClose(stream, &mem);
 	ms_aInfoForModel[streamId].m_loadState = STREAMSTATE_LOADED;
 	ms_memoryUsed += ms_aInfoForModel[streamId].GetCdSize() * CDSTREAM_SECTOR_SIZE;
+#ifdef COST_AWARE_EVICTION
+	CStreamingEviction::ModelLoaded(streamId);
+#endif
 
 	if(!success){
 		RemoveModel(streamId);
@@ -630,16 +669,31 @@ CStreaming::FinishLoadingLargeFile(int8 *buf, int32 streamId)
 	return true;
 }
 
+#ifdef MAPPED_CD_IMAGES
+// models whose pages we asked for and that weren't read yet,
+// so dropping and requesting them again every frame doesn't ask again
+static bool abPrefetched[NUMSTREAMINFO];
+#endif
+
 void
 CStreaming::RequestModel(int32 id, int32 flags)
 {
 	CSimpleModelInfo *mi;
+#ifdef MAPPED_CD_IMAGES
+	uint32 posn, size;
+#endif
 
+#ifdef STREAMING_PREFETCH
+	CStreamingPrefetch::ModelRequested(id);
+#endif
 	if(ms_aInfoForModel[id].m_loadState == STREAMSTATE_INQUEUE){
 		// updgrade to priority
 		if(flags & STREAMFLAGS_PRIORITY && !ms_aInfoForModel[id].IsPriority()){
 			ms_numPriorityRequests++;
 			ms_aInfoForModel[id].m_flags |= STREAMFLAGS_PRIORITY;
+#ifdef SORTED_REQUEST_QUEUE
+			CStreamingQueue::SetPriority(id);
+#endif
 		}
 	}else if(ms_aInfoForModel[id].m_loadState != STREAMSTATE_NOTLOADED){
 		flags &= ~STREAMFLAGS_PRIORITY;
@@ -655,6 +709,9 @@ CStreaming::RequestModel(int32 id, int32 flags)
 				mi->m_alpha = 255;
 		}
 
+#ifdef COST_AWARE_EVICTION
+		CStreamingEviction::ModelUsed(id);
+#endif
 		// reinsert into list
 		if(ms_aInfoForModel[id].m_next){
 			ms_aInfoForModel[id].RemoveFromList();
@@ -669,12 +726,29 @@ CStreaming::RequestModel(int32 id, int32 flags)
 				RequestTxd(CModelInfo::GetModelInfo(id)->GetTxdSlot(), flags);
 			ms_aInfoForModel[id].AddToList(&ms_startRequestedList);
 			ms_numModelsRequested++;
+#ifdef COST_AWARE_EVICTION
+			CStreamingEviction::ModelRequested(id);
+#endif
+#ifdef SORTED_REQUEST_QUEUE
+			CStreamingQueue::Add(id);
+#endif
+#ifdef MAPPED_CD_IMAGES
+			// have the pages coming in by the time the file is loaded
+			if(!abPrefetched[id] && ms_aInfoForModel[id].GetCdPosnAndSize(posn, size)){
+				CdStreamPrefetch(GetCdImageOffset(CdStreamGetLastPosn())+posn, size);
+				abPrefetched[id] = true;
+			}
+#endif
 			if(flags & STREAMFLAGS_PRIORITY)
 				ms_numPriorityRequests++;
 		}
 
 		ms_aInfoForModel[id].m_loadState = STREAMSTATE_INQUEUE;
 		ms_aInfoForModel[id].m_flags = flags;
+#ifdef SORTED_REQUEST_QUEUE
+		if(ms_aInfoForModel[id].IsPriority())
+			CStreamingQueue::SetPriority(id);
+#endif
 	}
 }
 
@@ -782,6 +856,9 @@ CStreaming::RequestSpecialModel(int32 modelId, const char *modelName, int32 flag
 
 	strcpy(oldName, mi->GetName());
 	mi->SetName(modelName);
+#ifdef HASHED_NAME_LOOKUPS
+	CModelInfo::NameChanged(modelId);
+#endif
 
 	// What exactly is going on here?
 	if(CModelInfo::GetModelInfo(oldName, nil)){
@@ -831,6 +908,9 @@ CStreaming::DecrementRef(int32 id)
 	if(ms_aInfoForModel[id].IsPriority()){
 		ms_aInfoForModel[id].m_flags &= ~STREAMFLAGS_PRIORITY;
 		ms_numPriorityRequests--;
+#ifdef SORTED_REQUEST_QUEUE
+		CStreamingQueue::ClearPriority(id);
+#endif
 	}
 }
 
@@ -841,6 +921,9 @@ CStreaming::RemoveModel(int32 id)
 
 	if(ms_aInfoForModel[id].m_loadState == STREAMSTATE_NOTLOADED)
 		return;
+#ifdef STREAMING_PREFETCH
+	CStreamingPrefetch::ModelRemoved(id);
+#endif
 
 	if(ms_aInfoForModel[id].m_loadState == STREAMSTATE_LOADED){
 		if(id < STREAM_OFFSET_TXD)
@@ -856,15 +939,19 @@ CStreaming::RemoveModel(int32 id)
 			DecrementRef(id);
 		ms_aInfoForModel[id].RemoveFromList();
 	}else if(ms_aInfoForModel[id].m_loadState == STREAMSTATE_READING){
-		for(i = 0; i < 4; i++){
-			if(ms_channel[0].streamIds[i] == id)
-				ms_channel[0].streamIds[i] = -1;
-			if(ms_channel[1].streamIds[i] == id)
-				ms_channel[1].streamIds[i] = -1;
-		}
+#ifdef STREAMING_FINALIZE_QUEUE
+		CStreamingFinalizeQueue::Cancel(id);
+#endif
+		for(int ch = 0; ch < NUM_STREAMING_CHANNELS; ch++)
+			for(i = 0; i < 4; i++)
+				if(ms_channel[ch].streamIds[i] == id)
+					ms_channel[ch].streamIds[i] = -1;
 	}
 
 	if(ms_aInfoForModel[id].m_loadState == STREAMSTATE_STARTED){
+#ifdef STREAMING_FINALIZE_QUEUE
+		CStreamingFinalizeQueue::Cancel(id);
+#endif
 		if(id < STREAM_OFFSET_TXD)
 			RpClumpGtaCancelStream();
 		else
@@ -1058,6 +1145,14 @@ found:
 bool
 CStreaming::RemoveLeastUsedModel(void)
 {
+#ifdef COST_AWARE_EVICTION
+	int streamId = CStreamingEviction::ChooseVictim();
+	if(streamId != -1){
+		CStreamingEviction::ModelEvicted(streamId);
+		RemoveModel(streamId);
+		return true;
+	}
+#else
 	CStreamingInfo *si;
 	int streamId;
 
@@ -1076,6 +1171,7 @@ CStreaming::RemoveLeastUsedModel(void)
 			}
 		}
 	}
+#endif
 	return ms_numVehiclesLoaded > 7 && RemoveLoadedVehicle();
 }
 
@@ -1124,27 +1220,31 @@ CStreaming::RemoveUnusedModelsInLoadedList(void)
 bool
 CStreaming::IsTxdUsedByRequestedModels(int32 txdId)
 {
+#ifndef SORTED_REQUEST_QUEUE
 	CStreamingInfo *si;
+#endif
 	int streamId;
 	int i;
 
+#ifdef SORTED_REQUEST_QUEUE
+	if(CStreamingQueue::IsTxdUsed(txdId))
+		return true;
+#else
 	for(si = ms_startRequestedList.m_next; si != &ms_endRequestedList; si = si->m_next){
 		streamId = si - ms_aInfoForModel;
 		if(streamId < STREAM_OFFSET_TXD &&
 		   CModelInfo::GetModelInfo(streamId)->GetTxdSlot() == txdId)
 			return true;
 	}
+#endif
 
-	for(i = 0; i < 4; i++){
-		streamId = ms_channel[0].streamIds[i];
-		if(streamId != -1 && streamId < STREAM_OFFSET_TXD &&
-		   CModelInfo::GetModelInfo(streamId)->GetTxdSlot() == txdId)
-			return true;
-		streamId = ms_channel[1].streamIds[i];
-		if(streamId != -1 && streamId < STREAM_OFFSET_TXD &&
-		   CModelInfo::GetModelInfo(streamId)->GetTxdSlot() == txdId)
-			return true;
-	}
+	for(int ch = 0; ch < NUM_STREAMING_CHANNELS; ch++)
+		for(i = 0; i < 4; i++){
+			streamId = ms_channel[ch].streamIds[i];
+			if(streamId != -1 && streamId < STREAM_OFFSET_TXD &&
+			   CModelInfo::GetModelInfo(streamId)->GetTxdSlot() == txdId)
+				return true;
+		}
 
 	return false;
 }
@@ -1528,6 +1628,56 @@ ModelNotLoaded(int32 modelId)
 inline bool TxdNotLoaded(int32 txdId) { return ModelNotLoaded(txdId + STREAM_OFFSET_TXD); }
 
 // Find stream id of next requested file in cdimage
+#ifdef SORTED_REQUEST_QUEUE
+int32
+CStreaming::GetNextFileOnCd(int32 lastPosn, bool priority)
+{
+	int streamId, txdId;
+	int rank, first, start, end, pass;
+	bool onlyPriority;
+
+	// empty files, nothing to read
+	first = CStreamingQueue::GetNumEmptyRanks();
+	for(rank = CStreamingQueue::FindNext(0, false); rank != -1 && rank < first; rank = CStreamingQueue::FindNext(rank+1, false)){
+		streamId = CStreamingQueue::GetStreamId(rank);
+		DecrementRef(streamId);
+		ms_aInfoForModel[streamId].RemoveFromList();
+		ms_aInfoForModel[streamId].m_loadState = STREAMSTATE_LOADED;
+	}
+
+	// only priority requests if there are any
+	onlyPriority = priority && ms_numPriorityRequests != 0;
+
+	// first requested file after last read position, then wrap around
+	start = CStreamingQueue::GetRank(lastPosn);
+	for(pass = 0; pass < 2; pass++){
+		end = pass == 0 ? NUMSTREAMINFO : start;
+		for(rank = CStreamingQueue::FindNext(pass == 0 ? start : first, onlyPriority);
+		    rank != -1 && rank < end;
+		    rank = CStreamingQueue::FindNext(rank+1, onlyPriority)){
+			streamId = CStreamingQueue::GetStreamId(rank);
+
+			// request Txd if necessary
+			if(streamId < STREAM_OFFSET_TXD){
+				txdId = CModelInfo::GetModelInfo(streamId)->GetTxdSlot();
+				if(TxdNotLoaded(txdId)){
+					ReRequestTxd(txdId);
+					continue;
+				}
+			}
+			return streamId;
+		}
+	}
+
+	if(ms_numPriorityRequests != 0){
+		// try non-priority files
+		ms_numPriorityRequests = 0;
+		return GetNextFileOnCd(lastPosn, false);
+	}
+
+	return -1;
+}
+#else
 int32
 CStreaming::GetNextFileOnCd(int32 lastPosn, bool priority)
 {
@@ -1590,6 +1740,7 @@ CStreaming::GetNextFileOnCd(int32 lastPosn, bool priority)
 
 	return streamIdNext;
 }
+#endif
 
 /*
  * Streaming buffer size is half of the largest file.
@@ -1607,6 +1758,7 @@ CStreaming::RequestModelStream(int32 ch)
 	uint32 posn, size, unused;
 	int i;
 	int haveBigFile, havePed;
+	bool mapped, tooBig;
 
 	lastPosn = CdStreamGetLastPosn();
 	imgOffset = GetCdImageOffset(lastPosn);
@@ -1630,9 +1782,14 @@ CStreaming::RequestModelStream(int32 ch)
 		return;
 
 	ms_aInfoForModel[streamId].GetCdPosnAndSize(posn, size);
-	if(size > (uint32)ms_streamingBufferSize){
+	mapped = false;
+#ifdef MAPPED_CD_IMAGES
+	// mapped images are loaded in place, there's no buffer to be too small
+	mapped = CdStreamGetMappedData(imgOffset+posn, size) != nil;
+#endif
+	if(!mapped && size > (uint32)ms_streamingBufferSize){
 		// Can only load big models on channel 0, and 1 has to be idle
-		if(ch == 1 || ms_channel[1].state != CHANNELSTATE_IDLE)
+		if(ch != 0 || ms_channel[1].state != CHANNELSTATE_IDLE)
 			return;
 		ms_bLoadingBigModel = true;
 	}
@@ -1668,7 +1825,12 @@ CStreaming::RequestModelStream(int32 ch)
 		totalSize += size;
 
 		// To big for buffer, remove again
-		if(totalSize > ms_streamingBufferSize && i > 0){
+		tooBig = totalSize > ms_streamingBufferSize;
+#ifdef MAPPED_CD_IMAGES
+		if(mapped)
+			tooBig = CdStreamGetMappedData(imgOffset+posn, totalSize) == nil;
+#endif
+		if(tooBig && i > 0){
 			totalSize -= size;
 			break;
 		}
@@ -1684,6 +1846,9 @@ CStreaming::RequestModelStream(int32 ch)
 		ms_aInfoForModel[streamId].m_loadState = STREAMSTATE_READING;
 		ms_aInfoForModel[streamId].RemoveFromList();
 		DecrementRef(streamId);
+#ifdef MAPPED_CD_IMAGES
+		abPrefetched[streamId] = false;
+#endif
 
 		streamId = ms_aInfoForModel[streamId].m_nextID;
 	}
@@ -1691,6 +1856,19 @@ CStreaming::RequestModelStream(int32 ch)
 	// clear remaining slots
 	for(; i < 4; i++)
 		ms_channel[ch].streamIds[i] = -1;
+#ifdef MAPPED_CD_IMAGES
+	if(mapped){
+		// Nothing to wait for, load the files right away
+		ms_channel[ch].pMappedData = (int8*)CdStreamReadMapped(imgOffset+posn, totalSize);
+		ms_channel[ch].state = CHANNELSTATE_READING;
+		ms_channel[ch].size = totalSize;
+		ms_channel[ch].position = imgOffset+posn;
+		ms_channel[ch].numTries = 0;
+		ProcessLoadingChannel(ch);
+		return;
+	}
+	ms_channel[ch].pMappedData = nil;
+#endif
 	// Now read the data
 	assert(!(ms_bLoadingBigModel && ch == 1));	// this would clobber the buffer
 	if(CdStreamRead(ch, ms_pStreamingBuffer[ch], imgOffset+posn, totalSize) == STREAM_NONE)
@@ -1708,6 +1886,7 @@ CStreaming::ProcessLoadingChannel(int32 ch)
 {
 	int status;
 	int i, id, cdsize;
+	int8 *buf;
 
 	status = CdStreamGetStatus(ch);
 	if(status != STREAM_NONE){
@@ -1720,9 +1899,15 @@ CStreaming::ProcessLoadingChannel(int32 ch)
 		return false;
 	}
 
+	buf = ms_pStreamingBuffer[ch];
+#ifdef MAPPED_CD_IMAGES
+	if(ms_channel[ch].pMappedData)
+		buf = ms_channel[ch].pMappedData;
+#endif
+
 	if(ms_channel[ch].state == CHANNELSTATE_STARTED){
 		ms_channel[ch].state = CHANNELSTATE_IDLE;
-		FinishLoadingLargeFile(&ms_pStreamingBuffer[ch][ms_channel[ch].offsets[0]*CDSTREAM_SECTOR_SIZE],
+		FinishLoadingLargeFile(&buf[ms_channel[ch].offsets[0]*CDSTREAM_SECTOR_SIZE],
 			ms_channel[ch].streamIds[0]);
 		ms_channel[ch].streamIds[0] = -1;
 	}else{
@@ -1744,8 +1929,14 @@ CStreaming::ProcessLoadingChannel(int32 ch)
 				else if(CTxdStore::GetNumRefs(CModelInfo::GetModelInfo(id)->GetTxdSlot()) == 0)
 					RemoveTxd(CModelInfo::GetModelInfo(id)->GetTxdSlot());
 			}else{
+#ifdef STREAMING_FINALIZE_QUEUE
+				// converted by FinalizeQueuedModels, the channel is free again
+				CStreamingFinalizeQueue::Submit(id, &buf[ms_channel[ch].offsets[i]*CDSTREAM_SECTOR_SIZE],
+					cdsize * CDSTREAM_SECTOR_SIZE, buf == ms_pStreamingBuffer[ch]);
+				ms_channel[ch].streamIds[i] = -1;
+#else
 				MakeSpaceFor(cdsize * CDSTREAM_SECTOR_SIZE);
-				ConvertBufferToObject(&ms_pStreamingBuffer[ch][ms_channel[ch].offsets[i]*CDSTREAM_SECTOR_SIZE],
+				ConvertBufferToObject(&buf[ms_channel[ch].offsets[i]*CDSTREAM_SECTOR_SIZE],
 					id);
 				if(ms_aInfoForModel[id].m_loadState == STREAMSTATE_STARTED){
 					// queue for second part
@@ -1756,11 +1947,12 @@ CStreaming::ProcessLoadingChannel(int32 ch)
 						ms_channel[ch].streamIds[i] = -1;
 				}else
 					ms_channel[ch].streamIds[i] = -1;
+#endif
 			}
 		}
 	}
 
-	if(ms_bLoadingBigModel && ms_channel[ch].state != CHANNELSTATE_STARTED){
+	if(ms_bLoadingBigModel && ch == 0 && ms_channel[ch].state != CHANNELSTATE_STARTED){
 		ms_bLoadingBigModel = false;
 		// reset channel 1 after loading a big model
 		for(i = 0; i < 4; i++)
@@ -1771,6 +1963,75 @@ CStreaming::ProcessLoadingChannel(int32 ch)
 	return true;
 }
 
+#ifdef STREAMING_FINALIZE_QUEUE
+// Converts the queued files in the order they were read,
+// as long as the next one is expected to fit into the budget. At least one file
+// goes every frame, so big ones get through.
+void
+CStreaming::FinalizeQueuedModels(bool flush)
+{
+	tFinalizeJob *job;
+	int32 id;
+	uint32 startTime, fileTime, now, elapsed;
+	bool converted;
+
+	startTime = CTimer::GetCurrentTimeInCycles();
+	elapsed = 0;
+	converted = false;
+	while(job = CStreamingFinalizeQueue::GetNext(), job){
+		id = job->streamId;
+		if(id == -1){
+			// removed while it was queued
+			CStreamingFinalizeQueue::ms_nNumCancelled++;
+			CStreamingFinalizeQueue::JobDone();
+			continue;
+		}
+		if(!flush && converted &&
+		   elapsed + CStreamingFinalizeQueue::EstimateCost(job) > (uint32)CStreamingFinalizeQueue::ms_nFinalizeBudget*1000){
+			CStreamingFinalizeQueue::ms_nNumDeferred++;
+			break;
+		}
+
+		fileTime = CTimer::GetCurrentTimeInCycles();
+		if(job->bStarted){
+			FinishLoadingLargeFile(job->buf, id);
+			job->bStarted = false;
+			CStreamingFinalizeQueue::ms_nNumFinalized++;
+			converted = true;
+		}else if(!job->bValid){
+			// same as a read error, get it again
+			RemoveModel(id);
+			ReRequestModel(id);
+		}else{
+			MakeSpaceFor(job->size);
+			ConvertBufferToObject(job->buf, id);
+			if(ms_aInfoForModel[id].m_loadState == STREAMSTATE_STARTED)
+				job->bStarted = true;
+			else
+				CStreamingFinalizeQueue::ms_nNumFinalized++;
+			converted = true;
+		}
+		now = CTimer::GetCurrentTimeInCycles();
+		if(converted)
+			CStreamingFinalizeQueue::AddCost(job, (uint64)(now - fileTime) * 1000 / CTimer::GetCyclesPerMillisecond());
+		elapsed = (uint64)(now - startTime) * 1000 / CTimer::GetCyclesPerMillisecond();
+
+		// second part of a large file on the next frame, like CHANNELSTATE_STARTED
+		if(job->bStarted){
+			if(flush)
+				continue;
+			break;
+		}
+
+		CStreamingFinalizeQueue::JobDone();
+	}
+
+	elapsed /= 1000;
+	if((int32)elapsed > CStreamingFinalizeQueue::ms_nMaxFinalizeTime)
+		CStreamingFinalizeQueue::ms_nMaxFinalizeTime = elapsed;
+}
+#endif
+
 void
 CStreaming::RetryLoadFile(int32 ch)
 {
@@ -1816,18 +2077,38 @@ CStreaming::LoadRequestedModels(void)
 	if(ms_bLoadingBigModel)
 		currentChannel = 0;
 
+#ifdef STREAMING_FINALIZE_QUEUE
+	FinalizeQueuedModels(false);
+#endif
+
 	// We have data, load
-	if(ms_channel[currentChannel].state == CHANNELSTATE_READING ||
-	   ms_channel[currentChannel].state == CHANNELSTATE_STARTED)
+	if((ms_channel[currentChannel].state == CHANNELSTATE_READING ||
+	    ms_channel[currentChannel].state == CHANNELSTATE_STARTED)
+#ifdef STREAMING_FINALIZE_QUEUE
+	   // or leave it with the channel until the queue has caught up
+	   && CStreamingFinalizeQueue::HasRoomForChannel()
+#endif
+	   )
 		ProcessLoadingChannel(currentChannel);
 
 	if(ms_channelError == -1){
 		// Channel is idle, read more data
 		if(ms_channel[currentChannel].state == CHANNELSTATE_IDLE)
 			RequestModelStream(currentChannel);
+#if NUM_STREAMING_CHANNELS > 2
+		// Keep the other channels reading too, their data is loaded when it's their turn
+#ifdef MAPPED_CD_IMAGES
+		// but mapped files were loaded already, don't load more than one channel's worth per frame
+		if(ms_channel[currentChannel].pMappedData == nil)
+#endif
+		for(int ch = 0; ch < NUM_STREAMING_CHANNELS; ch++)
+			if(ch != currentChannel && !(ch == 1 && ms_bLoadingBigModel) &&
+			   ms_channel[ch].state == CHANNELSTATE_IDLE)
+				RequestModelStream(ch);
+#endif
 		// Switch channel
 		if(ms_channel[currentChannel].state != CHANNELSTATE_STARTED)
-			currentChannel = 1 - currentChannel;
+			currentChannel = (currentChannel + 1) % NUM_STREAMING_CHANNELS;
 	}
 }
 
@@ -1838,6 +2119,10 @@ CStreaming::LoadAllRequestedModels(bool priority)
 	int imgOffset, streamId, status;
 	int i;
 	uint32 posn, size;
+	int8 *buf;
+#ifdef MAPPED_CD_IMAGES
+	int8 *mapped;
+#endif
 
 	if(bInsideLoadAll)
 		return;
@@ -1854,15 +2139,23 @@ CStreaming::LoadAllRequestedModels(bool priority)
 		DecrementRef(streamId);
 
 		if(ms_aInfoForModel[streamId].GetCdPosnAndSize(posn, size)){
+			buf = ms_pStreamingBuffer[0];
+#ifdef MAPPED_CD_IMAGES
+			abPrefetched[streamId] = false;
+			mapped = (int8*)CdStreamReadMapped(imgOffset+posn, size);
+			if(mapped)
+				buf = mapped;
+			else
+#endif
 			do
-				status = CdStreamRead(0, ms_pStreamingBuffer[0], imgOffset+posn, size);
+				status = CdStreamRead(0, buf, imgOffset+posn, size);
 			while(CdStreamSync(0) || status == STREAM_NONE);
 			ms_aInfoForModel[streamId].m_loadState = STREAMSTATE_READING;
 			
 			MakeSpaceFor(size * CDSTREAM_SECTOR_SIZE);
-			ConvertBufferToObject(ms_pStreamingBuffer[0], streamId);
+			ConvertBufferToObject(buf, streamId);
 			if(ms_aInfoForModel[streamId].m_loadState == STREAMSTATE_STARTED)
-				FinishLoadingLargeFile(ms_pStreamingBuffer[0], streamId);
+				FinishLoadingLargeFile(buf, streamId);
 
 			if(streamId < STREAM_OFFSET_TXD){
 				CSimpleModelInfo *mi = (CSimpleModelInfo*)CModelInfo::GetModelInfo(streamId);
@@ -1887,22 +2180,27 @@ CStreaming::LoadAllRequestedModels(bool priority)
 void
 CStreaming::FlushChannels(void)
 {
-	if(ms_channel[1].state == CHANNELSTATE_STARTED)
-		ProcessLoadingChannel(1);
-
-	if(ms_channel[0].state == CHANNELSTATE_READING){
-		CdStreamSync(0);
-		ProcessLoadingChannel(0);
-	}
-	if(ms_channel[0].state == CHANNELSTATE_STARTED)
-		ProcessLoadingChannel(0);
+	int ch;
 
-	if(ms_channel[1].state == CHANNELSTATE_READING){
-		CdStreamSync(1);
-		ProcessLoadingChannel(1);
+#ifdef STREAMING_FINALIZE_QUEUE
+	// empty the queue first, so it has room for the files of all channels
+	FinalizeQueuedModels(true);
+#endif
+	for(ch = 1; ch < NUM_STREAMING_CHANNELS; ch++)
+		if(ms_channel[ch].state == CHANNELSTATE_STARTED)
+			ProcessLoadingChannel(ch);
+
+	for(ch = 0; ch < NUM_STREAMING_CHANNELS; ch++){
+		if(ms_channel[ch].state == CHANNELSTATE_READING){
+			CdStreamSync(ch);
+			ProcessLoadingChannel(ch);
+		}
+		if(ms_channel[ch].state == CHANNELSTATE_STARTED)
+			ProcessLoadingChannel(ch);
 	}
-	if(ms_channel[1].state == CHANNELSTATE_STARTED)
-		ProcessLoadingChannel(1);
+#ifdef STREAMING_FINALIZE_QUEUE
+	FinalizeQueuedModels(true);
+#endif
 }
 
 void
@@ -2013,8 +2311,12 @@ CStreaming::ProcessEntitiesInSectorList(CPtrList &list, float x, float y, float
 				if(xmin < pos.x && pos.x < xmax &&
 				   ymin < pos.y && pos.y < ymax &&
 				   (CVector2D(x, y) - pos).MagnitudeSqr() < lodDistSq)
-					if(CRenderer::IsEntityCullZoneVisible(e))
+					if(CRenderer::IsEntityCullZoneVisible(e)){
+#ifdef COST_AWARE_EVICTION
+						CStreamingEviction::ModelSeen(e->GetModelIndex(), (CVector2D(x, y) - pos).Magnitude());
+#endif
 						RequestModel(e->GetModelIndex(), 0);
+					}
 			}
 		}
 	}
@@ -2037,8 +2339,12 @@ CStreaming::ProcessEntitiesInSectorList(CPtrList &list)
 		   (!e->IsObject() || ((CObject*)e)->ObjectCreatedBy != TEMP_OBJECT)){
 			CTimeModelInfo *mi = (CTimeModelInfo*)CModelInfo::GetModelInfo(e->GetModelIndex());
 			if (mi->GetModelType() != MITYPE_TIME || CClock::GetIsTimeInRange(mi->GetTimeOn(), mi->GetTimeOff()))
-				if(CRenderer::IsEntityCullZoneVisible(e))
+				if(CRenderer::IsEntityCullZoneVisible(e)){
+#ifdef COST_AWARE_EVICTION
+					CStreamingEviction::ModelSeen(e->GetModelIndex(), (CVector2D(TheCamera.GetPosition()) - CVector2D(e->GetPosition())).Magnitude());
+#endif
 					RequestModel(e->GetModelIndex(), 0);
+				}
 		}
 	}
 }
@@ -2440,11 +2746,22 @@ CStreaming::MakeSpaceFor(int32 size)
 	// the code still happens to work in that case because ms_memoryAvailable is unsigned
 	// but it's not nice....
 
+#ifdef COST_AWARE_EVICTION
+	CStreamingEviction::BeginBatch();
+	while(ms_memoryUsed >= ms_memoryAvailable - size)
+		if(!RemoveLeastUsedModel()){
+			CStreamingEviction::EndBatch();
+			DeleteRwObjectsBehindCamera(ms_memoryAvailable - size);
+			return;
+		}
+	CStreamingEviction::EndBatch();
+#else
 	while(ms_memoryUsed >= ms_memoryAvailable - size)
 		if(!RemoveLeastUsedModel()){
 			DeleteRwObjectsBehindCamera(ms_memoryAvailable - size);
 			return;
 		}
+#endif
 }
 
 void
@@ -56,6 +56,10 @@ public:
 	bool IsPriority(void) { return !!(m_flags & STREAMFLAGS_PRIORITY); }
 };
 
+#ifndef NUM_STREAMING_CHANNELS
+#define NUM_STREAMING_CHANNELS (2)
+#endif
+
 struct CStreamingChannel
 {
 	int32 streamIds[4];
@@ -66,6 +70,9 @@ struct CStreamingChannel
 	int32 size;
 	int32 numTries;
 	int32 status;	// from CdStream
+#ifdef MAPPED_CD_IMAGES
+	int8 *pMappedData;	// instead of the streaming buffer when the files were in a mapped image
+#endif
 };
 
 class CDirectory;
@@ -85,9 +92,9 @@ public:
 	static int32 ms_oldSectorX;
 	static int32 ms_oldSectorY;
 	static int32 ms_streamingBufferSize;
-	static int8 *ms_pStreamingBuffer[2];
+	static int8 *ms_pStreamingBuffer[NUM_STREAMING_CHANNELS];
 	static size_t ms_memoryUsed;
-	static CStreamingChannel ms_channel[2];
+	static CStreamingChannel ms_channel[NUM_STREAMING_CHANNELS];
 	static int32 ms_channelError;
 	static int32 ms_numVehiclesLoaded;
 	static int32 ms_vehiclesLoaded[MAXVEHICLESLOADED];
@@ -113,6 +120,9 @@ public:
 	static void LoadCdDirectory(const char *dirname, int32 n);
 	static bool ConvertBufferToObject(int8 *buf, int32 streamId);
 	static bool FinishLoadingLargeFile(int8 *buf, int32 streamId);
+#ifdef STREAMING_FINALIZE_QUEUE
+	static void FinalizeQueuedModels(bool flush);
+#endif
 	static bool HasModelLoaded(int32 id) { return ms_aInfoForModel[id].m_loadState == STREAMSTATE_LOADED; }
 	static bool HasTxdLoaded(int32 id) { return HasModelLoaded(id+STREAM_OFFSET_TXD); }
 	static bool CanRemoveModel(int32 id) { return (ms_aInfoForModel[id].m_flags & STREAMFLAGS_CANT_REMOVE) == 0; }
@@ -0,0 +1,288 @@
+#include "common.h"
+
+#ifdef COST_AWARE_EVICTION
+#include "Timer.h"
+#include "ModelInfo.h"
+#include "TxdStore.h"
+#include "CdStream.h"
+#include "Streaming.h"
+#include "StreamingEviction.h"
+
+#define EVICT_DIST_SCALE (100.0f)	// value halves at this distance from the camera
+#define EVICT_AGE_SCALE (10.0f)	// and when unused for this many seconds
+#define EVICT_USE_GAP (1000)	// ms without use before the next one counts again
+#define EVICT_MIN_COST (33.0f)	// ms, a frame, for files loaded with LoadAllRequestedModels
+
+struct tEvictionInfo
+{
+	float fClock;	// inflation value at the last use
+	float fCost;	// ms from request to loaded
+	float fDist;	// closest instance at the last use
+	uint32 nLastUse;
+	uint32 nRequestTime;
+	uint32 nEvictTime;
+	uint32 nSeenFrame;
+	uint8 nUses;
+	int8 nEvictedBy;	// policy, -1 when not evicted
+};
+
+int32 CStreamingEviction::ms_nPolicy = EVICTION_GDSF;
+int32 CStreamingEviction::ms_nThrashWindow = 5;
+const char *CStreamingEviction::ms_apPolicyNames[NUM_EVICTION_POLICIES] = { "LRU", "GDSF" };
+int32 CStreamingEviction::ms_aNumEvictions[NUM_EVICTION_POLICIES];
+int32 CStreamingEviction::ms_aNumThrashed[NUM_EVICTION_POLICIES];
+size_t CStreamingEviction::ms_aEvictedMemory[NUM_EVICTION_POLICIES];
+size_t CStreamingEviction::ms_aThrashedMemory[NUM_EVICTION_POLICIES];
+
+static tEvictionInfo aEvictionInfo[NUMSTREAMINFO];
+static float fInflation;
+
+// GDSF scores the loaded list once per MakeSpaceFor and then evicts in that order
+struct tEvictionCandidate
+{
+	float fPriority;
+	int32 streamId;
+	int32 order;	// on the loaded list from the tail, for ties
+};
+static tEvictionCandidate aCandidates[NUMSTREAMINFO];
+static int32 nNumCandidates;	// sorted highest first, so the next victim is the last one
+static bool bInBatch;
+
+void
+CStreamingEviction::Init(void)
+{
+	int32 i;
+	for(i = 0; i < NUMSTREAMINFO; i++){
+		aEvictionInfo[i].fClock = 0.0f;
+		aEvictionInfo[i].fCost = EVICT_MIN_COST;
+		aEvictionInfo[i].fDist = 0.0f;
+		aEvictionInfo[i].nLastUse = 0;
+		aEvictionInfo[i].nRequestTime = 0;
+		aEvictionInfo[i].nEvictTime = 0;
+		aEvictionInfo[i].nSeenFrame = 0;
+		aEvictionInfo[i].nUses = 0;
+		aEvictionInfo[i].nEvictedBy = -1;
+	}
+	fInflation = 0.0f;
+}
+
+// What the original RemoveLeastUsedModel checked
+static bool
+CanEvict(int32 streamId)
+{
+	if(streamId < STREAM_OFFSET_TXD)
+		return CModelInfo::GetModelInfo(streamId)->GetNumRefs() == 0;
+	return CTxdStore::GetNumRefs(streamId - STREAM_OFFSET_TXD) == 0 &&
+		!CStreaming::IsTxdUsedByRequestedModels(streamId - STREAM_OFFSET_TXD);
+}
+
+static int32
+ChooseLRU(void)
+{
+	CStreamingInfo *si;
+	int32 streamId;
+
+	for(si = CStreaming::ms_endLoadedList.m_prev; si != &CStreaming::ms_startLoadedList; si = si->m_prev){
+		streamId = si - CStreaming::ms_aInfoForModel;
+		if(CanEvict(streamId))
+			return streamId;
+	}
+	return -1;
+}
+
+static float
+GetGDSFPriority(int32 streamId, uint32 now)
+{
+	tEvictionInfo *info = &aEvictionInfo[streamId];
+	float size = Max(CStreaming::ms_aInfoForModel[streamId].GetCdSize(), 1u) * (CDSTREAM_SECTOR_SIZE/1024.0f);
+	float age = (now - info->nLastUse) / 1000.0f;
+	float value = Max(info->nUses, 1) * info->fCost / size;
+	value /= 1.0f + info->fDist/EVICT_DIST_SCALE;
+	value /= 1.0f + age/EVICT_AGE_SCALE;
+	return info->fClock + value;
+}
+
+static int
+CompareCandidates(const void *a, const void *b)
+{
+	const tEvictionCandidate *ca = (const tEvictionCandidate*)a;
+	const tEvictionCandidate *cb = (const tEvictionCandidate*)b;
+	if(ca->fPriority != cb->fPriority)
+		return ca->fPriority < cb->fPriority ? 1 : -1;
+	return cb->order - ca->order;
+}
+
+static void
+ScoreCandidates(void)
+{
+	CStreamingInfo *si;
+	int32 streamId;
+	uint32 now = CTimer::GetTimeInMilliseconds();
+
+	nNumCandidates = 0;
+	for(si = CStreaming::ms_endLoadedList.m_prev; si != &CStreaming::ms_startLoadedList; si = si->m_prev){
+		streamId = si - CStreaming::ms_aInfoForModel;
+		if(!CanEvict(streamId))
+			continue;
+		aCandidates[nNumCandidates].fPriority = GetGDSFPriority(streamId, now);
+		aCandidates[nNumCandidates].streamId = streamId;
+		aCandidates[nNumCandidates].order = nNumCandidates;
+		nNumCandidates++;
+	}
+	qsort(aCandidates, nNumCandidates, sizeof(tEvictionCandidate), CompareCandidates);
+}
+
+static int32
+ChooseGDSF(void)
+{
+	tEvictionCandidate *c;
+	CStreamingInfo *si;
+	bool scored = false;
+
+	if(!bInBatch)
+		nNumCandidates = 0;
+	for(;;){
+		while(nNumCandidates > 0){
+			c = &aCandidates[--nNumCandidates];
+			// removed or referenced again since it was scored
+			si = &CStreaming::ms_aInfoForModel[c->streamId];
+			if(si->m_loadState != STREAMSTATE_LOADED || si->m_next == nil || !CanEvict(c->streamId))
+				continue;
+			// everything used after this starts from here, so what isn't used ages
+			fInflation = Max(fInflation, c->fPriority);
+			return c->streamId;
+		}
+		// what was freed may have let go of more, score once more before giving up
+		if(scored)
+			return -1;
+		ScoreCandidates();
+		scored = true;
+	}
+}
+
+static int32 (*aChooseVictim[NUM_EVICTION_POLICIES])(void) = { ChooseLRU, ChooseGDSF };
+
+int32
+CStreamingEviction::ChooseVictim(void)
+{
+	return aChooseVictim[ms_nPolicy]();
+}
+
+// Around evicting many files at once, they're then scored only once
+void
+CStreamingEviction::BeginBatch(void)
+{
+	bInBatch = true;
+	nNumCandidates = 0;
+}
+
+void
+CStreamingEviction::EndBatch(void)
+{
+	bInBatch = false;
+	nNumCandidates = 0;
+}
+
+// From RequestModel when the file isn't loaded
+void
+CStreamingEviction::ModelRequested(int32 streamId)
+{
+	tEvictionInfo *info = &aEvictionInfo[streamId];
+	uint32 now = CTimer::GetTimeInMilliseconds();
+
+	info->nRequestTime = now;
+	if(info->nEvictedBy != -1){
+		if(now - info->nEvictTime < (uint32)ms_nThrashWindow*1000){
+			ms_aNumThrashed[info->nEvictedBy]++;
+			ms_aThrashedMemory[info->nEvictedBy] += CStreaming::ms_aInfoForModel[streamId].GetCdSize()*CDSTREAM_SECTOR_SIZE;
+		}
+		info->nEvictedBy = -1;
+	}
+}
+
+// From RequestModel when the file is loaded already
+void
+CStreamingEviction::ModelUsed(int32 streamId)
+{
+	tEvictionInfo *info = &aEvictionInfo[streamId];
+	uint32 now = CTimer::GetTimeInMilliseconds();
+
+	if(now - info->nLastUse > EVICT_USE_GAP && info->nUses < 255)
+		info->nUses++;
+	info->nLastUse = now;
+	info->fClock = fInflation;
+}
+
+static void
+SetSeenDist(int32 streamId, float dist, uint32 frame)
+{
+	tEvictionInfo *info = &aEvictionInfo[streamId];
+	if(info->nSeenFrame != frame || dist < info->fDist)
+		info->fDist = dist;
+	info->nSeenFrame = frame;
+}
+
+// From the entity scans that request models, the txd is as close as its closest model
+void
+CStreamingEviction::ModelSeen(int32 modelId, float dist)
+{
+	int32 txdId = CModelInfo::GetModelInfo(modelId)->GetTxdSlot();
+
+	SetSeenDist(modelId, dist, CTimer::GetFrameCounter());
+	if(txdId >= 0)
+		SetSeenDist(txdId + STREAM_OFFSET_TXD, dist, CTimer::GetFrameCounter());
+}
+
+void
+CStreamingEviction::ModelLoaded(int32 streamId)
+{
+	tEvictionInfo *info = &aEvictionInfo[streamId];
+	uint32 now = CTimer::GetTimeInMilliseconds();
+	float cost = Max((float)(now - info->nRequestTime), EVICT_MIN_COST);
+
+	// the first load sets it, later ones average in
+	if(info->nUses == 0)
+		info->fCost = cost;
+	else
+		info->fCost += (cost - info->fCost) / 4;
+	info->nUses = 1;
+	info->nLastUse = now;
+	info->fClock = fInflation;
+}
+
+void
+CStreamingEviction::ModelEvicted(int32 streamId)
+{
+	tEvictionInfo *info = &aEvictionInfo[streamId];
+
+	info->nEvictTime = CTimer::GetTimeInMilliseconds();
+	info->nEvictedBy = ms_nPolicy;
+	ms_aNumEvictions[ms_nPolicy]++;
+	ms_aEvictedMemory[ms_nPolicy] += CStreaming::ms_aInfoForModel[streamId].GetCdSize()*CDSTREAM_SECTOR_SIZE;
+}
+
+void
+CStreamingEviction::ResetStats(void)
+{
+	int32 i;
+	for(i = 0; i < NUM_EVICTION_POLICIES; i++){
+		ms_aNumEvictions[i] = 0;
+		ms_aNumThrashed[i] = 0;
+		ms_aEvictedMemory[i] = 0;
+		ms_aThrashedMemory[i] = 0;
+	}
+	for(i = 0; i < NUMSTREAMINFO; i++)
+		aEvictionInfo[i].nEvictedBy = -1;
+}
+
+void
+CStreamingEviction::DumpStats(void)
+{
+	int32 i;
+	for(i = 0; i < NUM_EVICTION_POLICIES; i++)
+		debug("Eviction %s: %d evicted (%d KB), %d thrashed within %d s (%d KB), %.1f%%\n",
+			ms_apPolicyNames[i], ms_aNumEvictions[i], (int32)(ms_aEvictedMemory[i]/1024),
+			ms_aNumThrashed[i], ms_nThrashWindow, (int32)(ms_aThrashedMemory[i]/1024),
+			ms_aNumEvictions[i] ? 100.0f*ms_aNumThrashed[i]/ms_aNumEvictions[i] : 0.0f);
+}
+#endif
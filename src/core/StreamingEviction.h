@@ -0,0 +1,39 @@
+#pragma once
+
+// Picks what CStreaming::RemoveLeastUsedModel throws out. LRU is what the game
+// always did, the tail of the loaded list. GDSF keeps files that take long to
+// load again for their size and were used often, recently and close to the
+// camera; everything else ages through the inflation value GDSF raises with
+// every eviction. Evicted files that are requested again within
+// ms_nThrashWindow seconds count as thrash of the policy that evicted them.
+
+enum eEvictionPolicy
+{
+	EVICTION_LRU,
+	EVICTION_GDSF,
+	NUM_EVICTION_POLICIES
+};
+
+class CStreamingEviction
+{
+public:
+	static int32 ms_nPolicy;
+	static int32 ms_nThrashWindow;
+	static const char *ms_apPolicyNames[NUM_EVICTION_POLICIES];
+	static int32 ms_aNumEvictions[NUM_EVICTION_POLICIES];
+	static int32 ms_aNumThrashed[NUM_EVICTION_POLICIES];
+	static size_t ms_aEvictedMemory[NUM_EVICTION_POLICIES];
+	static size_t ms_aThrashedMemory[NUM_EVICTION_POLICIES];
+
+	static void Init(void);
+	static int32 ChooseVictim(void);	// -1 if nothing on the loaded list can go
+	static void BeginBatch(void);
+	static void EndBatch(void);
+	static void ModelRequested(int32 streamId);
+	static void ModelUsed(int32 streamId);
+	static void ModelSeen(int32 modelId, float dist);
+	static void ModelLoaded(int32 streamId);
+	static void ModelEvicted(int32 streamId);
+	static void ResetStats(void);
+	static void DumpStats(void);
+};
@@ -0,0 +1,140 @@
+#include "common.h"
+
+#ifdef STREAMING_FINALIZE_QUEUE
+#include "Streaming.h"
+#include "StreamingFinalizeQueue.h"
+
+enum
+{
+	NUMFINALIZEJOBS = NUM_STREAMING_CHANNELS*4*2,	// every file of every channel, twice
+};
+
+int32 CStreamingFinalizeQueue::ms_nFinalizeBudget = 4;
+int32 CStreamingFinalizeQueue::ms_nNumQueued;
+int32 CStreamingFinalizeQueue::ms_nNumInvalid;
+int32 CStreamingFinalizeQueue::ms_nNumFinalized;
+int32 CStreamingFinalizeQueue::ms_nNumCancelled;
+int32 CStreamingFinalizeQueue::ms_nNumDeferred;
+int32 CStreamingFinalizeQueue::ms_nMaxFinalizeTime;
+
+// A ring of jobs, [nFinalized, nSubmitted) waits to be converted
+static tFinalizeJob aJobs[NUMFINALIZEJOBS];
+static int32 nSubmitted;
+static int32 nFinalized;
+
+// microseconds per KB of file, learned as files are converted
+static float fModelCost = 50.0f;
+static float fTxdCost = 50.0f;
+
+// Every top level chunk has to fit, the rest of the last sector is zeros
+static bool
+CheckChunks(tFinalizeJob *job)
+{
+	uint32 pos, type, size;
+
+	for(pos = 0; pos + 12 <= job->size; pos += 12 + size){
+		memcpy(&type, &job->buf[pos], 4);
+		memcpy(&size, &job->buf[pos+4], 4);
+		if(type == 0 && size == 0)
+			break;
+		if(size > job->size - pos - 12)
+			return false;
+	}
+	return true;
+}
+
+void
+CStreamingFinalizeQueue::Init(void)
+{
+	nSubmitted = 0;
+	nFinalized = 0;
+}
+
+// Whether a channel can hand over all its files
+bool
+CStreamingFinalizeQueue::HasRoomForChannel(void)
+{
+	return nSubmitted - nFinalized <= NUMFINALIZEJOBS/2;
+}
+
+// Files in the streaming buffers are copied, the channel reads into it again.
+// Mapped files stay where they are.
+void
+CStreamingFinalizeQueue::Submit(int32 streamId, int8 *buf, uint32 size, bool copy)
+{
+	tFinalizeJob *job;
+
+	assert(nSubmitted - nFinalized < NUMFINALIZEJOBS);
+	job = &aJobs[nSubmitted % NUMFINALIZEJOBS];
+	job->streamId = streamId;
+	job->size = size;
+	job->bOwnsBuf = copy;
+	if(copy){
+		job->buf = new int8[size];
+		memcpy(job->buf, buf, size);
+	}else
+		job->buf = buf;
+	job->bStarted = false;
+	job->bValid = CheckChunks(job);
+	ms_nNumQueued++;
+	if(!job->bValid)
+		ms_nNumInvalid++;
+	nSubmitted++;
+}
+
+// The model was removed while it was queued, its job is skipped
+void
+CStreamingFinalizeQueue::Cancel(int32 streamId)
+{
+	int32 i;
+	for(i = nFinalized; i < nSubmitted; i++)
+		if(aJobs[i % NUMFINALIZEJOBS].streamId == streamId)
+			aJobs[i % NUMFINALIZEJOBS].streamId = -1;
+}
+
+// Oldest job not converted yet, nil if there is none
+tFinalizeJob*
+CStreamingFinalizeQueue::GetNext(void)
+{
+	if(nFinalized == nSubmitted)
+		return nil;
+	return &aJobs[nFinalized % NUMFINALIZEJOBS];
+}
+
+void
+CStreamingFinalizeQueue::JobDone(void)
+{
+	tFinalizeJob *job = &aJobs[nFinalized % NUMFINALIZEJOBS];
+	if(job->bOwnsBuf)
+		delete[] job->buf;
+	job->buf = nil;
+	nFinalized++;
+}
+
+// Expected microseconds of converting
+int32
+CStreamingFinalizeQueue::EstimateCost(tFinalizeJob *job)
+{
+	float cost = job->streamId < STREAM_OFFSET_TXD ? fModelCost : fTxdCost;
+	return cost * job->size / 1024;
+}
+
+void
+CStreamingFinalizeQueue::AddCost(tFinalizeJob *job, int32 time)
+{
+	float cost = (float)time * 1024 / Max(job->size, 1u);
+	if(job->streamId < STREAM_OFFSET_TXD)
+		fModelCost += (cost - fModelCost) / 16;
+	else
+		fTxdCost += (cost - fTxdCost) / 16;
+}
+
+void
+CStreamingFinalizeQueue::DumpStats(void)
+{
+	debug("Finalize queue: %d files queued, %d broken and requested again\n", ms_nNumQueued, ms_nNumInvalid);
+	debug("Finalize queue: %d converted, %d cancelled, %d frames over the %d ms budget, longest %d ms\n",
+		ms_nNumFinalized, ms_nNumCancelled, ms_nNumDeferred, ms_nFinalizeBudget, ms_nMaxFinalizeTime);
+	debug("Finalize queue: models %.1f us/KB, txds %.1f us/KB\n", fModelCost, fTxdCost);
+}
+#endif
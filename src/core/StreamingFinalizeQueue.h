@@ -0,0 +1,40 @@
+#pragma once
+
+// Files CStreaming has read are queued here before they're converted, so their
+// channel can read the next ones right away. The main thread converts them in the
+// order they were read, as many as fit into the finalize budget every frame, so a
+// burst of files is spread over a few frames. One big file still takes its frame:
+// the RW objects can't be created on another thread, librw links new frames into
+// a global dirty list and rasters belong to the render thread.
+
+struct tFinalizeJob
+{
+	int32 streamId;	// -1 once the model was removed
+	int8 *buf;
+	uint32 size;	// in bytes
+	bool bOwnsBuf;	// a copy of the channel's buffer
+	bool bValid;	// chunks fit into the file
+	bool bStarted;	// first part of a large file converted, second part is next
+};
+
+class CStreamingFinalizeQueue
+{
+public:
+	static int32 ms_nFinalizeBudget;	// milliseconds of converting per frame
+	static int32 ms_nNumQueued;
+	static int32 ms_nNumInvalid;
+	static int32 ms_nNumFinalized;
+	static int32 ms_nNumCancelled;
+	static int32 ms_nNumDeferred;	// frames where the budget ran out with files left
+	static int32 ms_nMaxFinalizeTime;	// longest frame of converting, ms
+
+	static void Init(void);
+	static bool HasRoomForChannel(void);
+	static void Submit(int32 streamId, int8 *buf, uint32 size, bool copy);
+	static void Cancel(int32 streamId);
+	static tFinalizeJob *GetNext(void);
+	static void JobDone(void);
+	static int32 EstimateCost(tFinalizeJob *job);
+	static void AddCost(tFinalizeJob *job, int32 time);
+	static void DumpStats(void);
+};
@@ -0,0 +1,306 @@
+#include "common.h"
+
+#ifdef STREAMING_PREFETCH
+#include "Camera.h"
+#include "CdStream.h"
+#include "Clock.h"
+#include "ModelIndices.h"
+#include "ModelInfo.h"
+#include "Object.h"
+#include "PathFind.h"
+#include "Streaming.h"
+#include "Vehicle.h"
+#include "World.h"
+#include "StreamingPrefetch.h"
+
+#define PREFETCH_MIN_SPEED (10.0f)	// m/s, normal streaming keeps up below this
+#define PREFETCH_NUM_SECONDS (3)	// a wedge is scanned for every second ahead
+#define PREFETCH_SCAN_DIST (200.0f)
+#define PREFETCH_SCAN_COS (0.64f)	// of half the wedge angle, 50 degrees
+#define PREFETCH_MARGIN (30.0f)	// STREAM_DISTANCE in Renderer.cpp
+#define PREFETCH_MAX_REQUESTS (20)	// prefetch only while fewer are waiting
+#define PREFETCH_MEMORY_SHARE (8)	// prefetched models may use 1/8 of ms_memoryAvailable
+#define PREFETCH_MAX_PATH_STEPS (16)
+#define PREFETCH_PATH_NODE_DIST (40.0f)	// look for the closest node again when further away than this
+
+enum
+{
+	PREFETCH_REQUESTED = 1,
+	PREFETCH_EXPIRED = 2	// request went away at the end of the frame, see if it's made again
+};
+
+bool CStreamingPrefetch::ms_bRequesting;
+uint8 CStreamingPrefetch::ms_aPrefetched[STREAM_OFFSET_TXD];
+int16 CStreamingPrefetch::ms_aExpired[MAX_EXPIRED];
+int32 CStreamingPrefetch::ms_nNumExpired;
+size_t CStreamingPrefetch::ms_nPrefetchedMemory;
+bool CStreamingPrefetch::bUsePrefetch = true;
+int32 CStreamingPrefetch::ms_nNumPrefetched;
+int32 CStreamingPrefetch::ms_nNumHits;
+int32 CStreamingPrefetch::ms_nNumLate;
+int32 CStreamingPrefetch::ms_nNumWasted;
+int32 CStreamingPrefetch::ms_nNumCancelled;
+
+static int32 nPathNode = -1;	// first car path node ahead of the player
+static CVector2D vecScanPos;
+
+void
+CStreamingPrefetch::Init(void)
+{
+	memset(ms_aPrefetched, 0, sizeof(ms_aPrefetched));
+	ms_nPrefetchedMemory = 0;
+	ms_nNumExpired = 0;
+	ms_bRequesting = false;
+	nPathNode = -1;
+}
+
+void
+CStreamingPrefetch::Forget(int32 id)
+{
+	if(ms_aPrefetched[id] & PREFETCH_REQUESTED)
+		ms_nPrefetchedMemory -= CStreaming::ms_aInfoForModel[id].GetCdSize()*CDSTREAM_SECTOR_SIZE;
+	ms_aPrefetched[id] = 0;
+}
+
+// From CStreaming::RequestModel
+void
+CStreamingPrefetch::ModelRequested(int32 id)
+{
+	if(id >= STREAM_OFFSET_TXD)
+		return;
+	if(ms_bRequesting){
+		if(!(ms_aPrefetched[id] & PREFETCH_REQUESTED) && CStreaming::ms_aInfoForModel[id].m_loadState == STREAMSTATE_NOTLOADED){
+			if(!(ms_aPrefetched[id] & PREFETCH_EXPIRED))
+				ms_nNumPrefetched++;
+			ms_aPrefetched[id] = PREFETCH_REQUESTED;
+			ms_nPrefetchedMemory += CStreaming::ms_aInfoForModel[id].GetCdSize()*CDSTREAM_SECTOR_SIZE;
+		}
+	}else if(ms_aPrefetched[id]){
+		if(CStreaming::ms_aInfoForModel[id].m_loadState == STREAMSTATE_LOADED)
+			ms_nNumHits++;
+		else
+			ms_nNumLate++;
+		Forget(id);
+	}
+}
+
+// From CStreaming::RemoveModel
+void
+CStreamingPrefetch::ModelRemoved(int32 id)
+{
+	if(id >= STREAM_OFFSET_TXD || !ms_aPrefetched[id])
+		return;
+	if(CStreaming::ms_aInfoForModel[id].m_loadState == STREAMSTATE_LOADED){
+		ms_nNumWasted++;
+		Forget(id);
+	}else if(ms_nNumExpired < MAX_EXPIRED){
+		Forget(id);
+		ms_aPrefetched[id] = PREFETCH_EXPIRED;
+		ms_aExpired[ms_nNumExpired++] = id;
+	}else{
+		ms_nNumCancelled++;
+		Forget(id);
+	}
+}
+
+// Requests from last frame that weren't made again are cancelled
+void
+CStreamingPrefetch::CheckExpired(void)
+{
+	int i;
+	for(i = 0; i < ms_nNumExpired; i++)
+		if(ms_aPrefetched[ms_aExpired[i]] == PREFETCH_EXPIRED){
+			ms_aPrefetched[ms_aExpired[i]] = 0;
+			ms_nNumCancelled++;
+		}
+	ms_nNumExpired = 0;
+}
+
+static bool
+CanPrefetch(int32 id)
+{
+	return CStreaming::ms_numModelsRequested < PREFETCH_MAX_REQUESTS &&
+		CStreamingPrefetch::ms_nPrefetchedMemory + CStreaming::ms_aInfoForModel[id].GetCdSize()*CDSTREAM_SECTOR_SIZE <=
+			CStreaming::ms_memoryAvailable/PREFETCH_MEMORY_SHARE;
+}
+
+static void
+ProcessSectorList(CPtrList &list)
+{
+	CPtrNode *node;
+	CEntity *e;
+	int32 id;
+
+	for(node = list.first; node; node = node->next){
+		e = (CEntity*)node->item;
+		if(e->m_scanCode == CWorld::GetCurrentScanCode())
+			continue;
+		e->m_scanCode = CWorld::GetCurrentScanCode();
+		// no cull zone test, the zones are those of where the player is now
+		if(e->bStreamingDontDelete || e->bIsSubway ||
+		   e->IsObject() && ((CObject*)e)->ObjectCreatedBy == TEMP_OBJECT)
+			continue;
+		id = e->GetModelIndex();
+		if(CStreaming::ms_aInfoForModel[id].m_loadState != STREAMSTATE_NOTLOADED)
+			continue;
+		CTimeModelInfo *mi = (CTimeModelInfo*)CModelInfo::GetModelInfo(id);
+		if(mi->GetModelType() == MITYPE_TIME && !CClock::GetIsTimeInRange(mi->GetTimeOn(), mi->GetTimeOff()))
+			continue;
+		if((CVector2D(e->GetPosition()) - vecScanPos).Magnitude() - PREFETCH_MARGIN > mi->GetLargestLodDistance())
+			continue;
+		if(CanPrefetch(id))
+			CStreaming::RequestModel(id, 0);
+	}
+}
+
+// Sectors in a wedge in front of pos
+static void
+ScanWedge(const CVector2D &pos, const CVector2D &dir)
+{
+	int x, y, x1, x2, y1, y2;
+	const float sectorRadius = Sqrt(SQR(SECTOR_SIZE_X/2) + SQR(SECTOR_SIZE_Y/2));
+
+	x1 = Max(CWorld::GetSectorIndexX(pos.x - PREFETCH_SCAN_DIST), 0);
+	x2 = Min(CWorld::GetSectorIndexX(pos.x + PREFETCH_SCAN_DIST), NUMSECTORS_X-1);
+	y1 = Max(CWorld::GetSectorIndexY(pos.y - PREFETCH_SCAN_DIST), 0);
+	y2 = Min(CWorld::GetSectorIndexY(pos.y + PREFETCH_SCAN_DIST), NUMSECTORS_Y-1);
+	vecScanPos = pos;
+	for(y = y1; y <= y2; y++)
+		for(x = x1; x <= x2; x++){
+			CVector2D centre(CWorld::GetWorldX(x) + SECTOR_SIZE_X/2, CWorld::GetWorldY(y) + SECTOR_SIZE_Y/2);
+			CVector2D d = centre - pos;
+			float dist = d.Magnitude();
+			if(dist > PREFETCH_SCAN_DIST + sectorRadius)
+				continue;
+			// the whole sector counts when it reaches into the wedge
+			if(dist > sectorRadius && DotProduct2D(d, dir) < PREFETCH_SCAN_COS*dist - sectorRadius)
+				continue;
+			CSector *s = CWorld::GetSector(x, y);
+			ProcessSectorList(s->m_lists[ENTITYLIST_BUILDINGS]);
+			ProcessSectorList(s->m_lists[ENTITYLIST_BUILDINGS_OVERLAP]);
+			ProcessSectorList(s->m_lists[ENTITYLIST_OBJECTS]);
+			ProcessSectorList(s->m_lists[ENTITYLIST_DUMMIES]);
+		}
+}
+
+// The linked node closest to straight on, -1 if all turn too much
+static int32
+FindNextNode(int32 node, const CVector2D &dir)
+{
+	int32 i, n, next;
+	float bestDot, dot, len;
+	CVector2D nodePos = ThePaths.m_pathNodes[node].GetPosition();
+
+	next = -1;
+	bestDot = 0.5f;
+	for(i = 0; i < ThePaths.m_pathNodes[node].numLinks; i++){
+		n = ThePaths.ConnectedNode(ThePaths.m_pathNodes[node].firstLink + i);
+		CVector2D d = CVector2D(ThePaths.m_pathNodes[n].GetPosition()) - nodePos;
+		len = d.Magnitude();
+		if(len < 0.01f)
+			continue;
+		dot = DotProduct2D(d, dir)/len;
+		if(dot > bestDot){
+			bestDot = dot;
+			next = n;
+		}
+	}
+	return next;
+}
+
+// Follows the car paths from pos for dist metres
+static void
+PredictAlongPaths(const CVector &pos, CVector2D dir, float dist, CVector2D &outPos, CVector2D &outDir)
+{
+	int32 node, next, step;
+	CVector2D p = pos;
+
+	if(nPathNode < 0 ||
+	   (CVector2D(ThePaths.m_pathNodes[nPathNode].GetPosition()) - p).MagnitudeSqr() > SQR(PREFETCH_PATH_NODE_DIST))
+		nPathNode = ThePaths.FindNodeClosestToCoorsFavourDirection(pos, PATH_CAR, dir.x, dir.y);
+
+	// skip the nodes we've passed already
+	node = nPathNode;
+	for(step = 0; step < PREFETCH_MAX_PATH_STEPS; step++){
+		if(DotProduct2D(CVector2D(ThePaths.m_pathNodes[node].GetPosition()) - p, dir) > 0.0f)
+			break;
+		next = FindNextNode(node, dir);
+		if(next == -1)
+			break;
+		node = next;
+	}
+	nPathNode = node;
+
+	for(step = 0; step < PREFETCH_MAX_PATH_STEPS; step++){
+		CVector2D d = CVector2D(ThePaths.m_pathNodes[node].GetPosition()) - p;
+		float len = d.Magnitude();
+		if(len >= dist){
+			outPos = p + d*(dist/len);
+			outDir = d/len;
+			return;
+		}
+		dist -= len;
+		p += d;
+		if(len > 0.01f)
+			dir = d/len;
+		next = FindNextNode(node, dir);
+		if(next == -1)
+			break;
+		node = next;
+	}
+	// off the paths, go straight
+	outPos = p + dir*dist;
+	outDir = dir;
+}
+
+void
+CStreamingPrefetch::Update(bool predict)
+{
+	int i;
+
+	if(!predict || !bUsePrefetch || CStreaming::ms_numModelsRequested >= PREFETCH_MAX_REQUESTS ||
+	   ms_nPrefetchedMemory >= CStreaming::ms_memoryAvailable/PREFETCH_MEMORY_SHARE){
+		CheckExpired();
+		return;
+	}
+
+	CVehicle *veh = FindPlayerVehicle();
+	CVector pos = FindPlayerCoors();
+	CVector speed = FindPlayerSpeed() * 50.0f;	// per second
+	float speed2D = speed.Magnitude2D();
+	if(speed2D < PREFETCH_MIN_SPEED){
+		nPathNode = -1;
+		CheckExpired();
+		return;
+	}
+	CVector2D dir(speed.x/speed2D, speed.y/speed2D);
+	bool onRoads = veh && (veh->IsCar() || veh->IsBike()) && veh->GetModelIndex() != MI_DODO;
+	CVector2D camOffset = TheCamera.GetPosition() - pos;
+
+	CWorld::AdvanceCurrentScanCode();
+	ms_bRequesting = true;
+	for(i = 1; i <= PREFETCH_NUM_SECONDS; i++){
+		CVector2D p, d;
+		if(onRoads)
+			PredictAlongPaths(pos, dir, speed2D*i, p, d);
+		else{
+			p = CVector2D(pos) + dir*(speed2D*i);
+			d = dir;
+		}
+		ScanWedge(p + camOffset, d);
+		if(CStreaming::ms_numModelsRequested >= PREFETCH_MAX_REQUESTS)
+			break;
+	}
+	ms_bRequesting = false;
+	CheckExpired();
+}
+
+void
+CStreamingPrefetch::DumpStats(void)
+{
+	int32 numUsed = ms_nNumHits + ms_nNumLate + ms_nNumWasted;
+	debug("Prefetch: %d models prefetched, %d KB waiting to be used\n", ms_nNumPrefetched, (int32)(ms_nPrefetchedMemory/1024));
+	debug("Prefetch: %d hits, %d late, %d removed unused, %d cancelled\n", ms_nNumHits, ms_nNumLate, ms_nNumWasted, ms_nNumCancelled);
+	debug("Prefetch: hit rate %.1f%%\n", numUsed ? 100.0f*ms_nNumHits/numUsed : 0.0f);
+}
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+
+// Requests the models around where the player will be in a few seconds, so fast
+// vehicles don't outrun streaming. Road vehicles follow the car paths, anything
+// else goes straight. Prefetch requests are only made while few normal ones are
+// waiting, and they go away at the end of the frame like normal ones, so when
+// the prediction changes the old requests are simply not made again.
+
+class CStreamingPrefetch
+{
+	static bool ms_bRequesting;
+	static uint8 ms_aPrefetched[STREAM_OFFSET_TXD];
+	enum { MAX_EXPIRED = 64 };
+	static int16 ms_aExpired[MAX_EXPIRED];
+	static int32 ms_nNumExpired;
+
+	static void Forget(int32 id);
+	static void CheckExpired(void);
+public:
+	static bool bUsePrefetch;
+	static size_t ms_nPrefetchedMemory;	// of the models below that weren't needed yet
+	static int32 ms_nNumPrefetched;	// models requested by the prefetcher that weren't requested otherwise
+	static int32 ms_nNumHits;	// loaded by the time they were needed
+	static int32 ms_nNumLate;	// still on their way
+	static int32 ms_nNumWasted;	// removed again after they were loaded
+	static int32 ms_nNumCancelled;	// not loaded before the prediction dropped them
+
+	static void Init(void);
+	static void Update(bool predict);
+	static void ModelRequested(int32 id);
+	static void ModelRemoved(int32 id);
+	static void DumpStats(void);
+};
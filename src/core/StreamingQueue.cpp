@@ -0,0 +1,235 @@
+#include "common.h"
+
+#ifdef SORTED_REQUEST_QUEUE
+#include "ModelInfo.h"
+#include "Streaming.h"
+#include "StreamingQueue.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+enum
+{
+	QUEUEFLAG_QUEUED = 1,
+	QUEUEFLAG_PRIORITY = 2,
+
+	NUMRANKWORDS = (NUMSTREAMINFO + 31) / 32,
+	NUMSUMMARYWORDS = (NUMRANKWORDS + 31) / 32
+};
+
+bool CStreamingQueue::ms_bOrderValid;
+uint8 CStreamingQueue::ms_aQueueFlags[NUMSTREAMINFO];
+int16 CStreamingQueue::ms_aTxdOfModel[STREAM_OFFSET_TXD];
+int16 CStreamingQueue::ms_aNumModelsUsingTxd[TXDSTORESIZE];
+
+static int16 aOrder[NUMSTREAMINFO];	// stream ids by rank
+static int16 aRanks[NUMSTREAMINFO];	// ranks by stream id
+static uint32 aRankPosns[NUMSTREAMINFO];
+static int32 numEmptyRanks;
+
+static inline int32
+LowestBit(uint32 x)
+{
+#ifdef _MSC_VER
+	unsigned long i;
+	_BitScanForward(&i, x);
+	return i;
+#else
+	return __builtin_ctz(x);
+#endif
+}
+
+// A bit per rank and a bit per word that isn't 0
+struct tRankBits
+{
+	uint32 bits[NUMRANKWORDS];
+	uint32 summary[NUMSUMMARYWORDS];
+
+	void Clear(void)
+	{
+		memset(bits, 0, sizeof(bits));
+		memset(summary, 0, sizeof(summary));
+	}
+	void Set(int32 rank)
+	{
+		bits[rank>>5] |= 1u << (rank&31);
+		summary[rank>>10] |= 1u << ((rank>>5)&31);
+	}
+	void Unset(int32 rank)
+	{
+		bits[rank>>5] &= ~(1u << (rank&31));
+		if(bits[rank>>5] == 0)
+			summary[rank>>10] &= ~(1u << ((rank>>5)&31));
+	}
+	int32 FindNext(int32 rank)
+	{
+		if(rank >= NUMSTREAMINFO)
+			return -1;
+		int32 word = rank>>5;
+		uint32 b = bits[word] & (~0u << (rank&31));
+		if(b)
+			return word*32 + LowestBit(b);
+		if(++word >= NUMRANKWORDS)
+			return -1;
+		int32 s = word>>5;
+		uint32 m = summary[s] & (~0u << (word&31));
+		for(;;){
+			if(m){
+				word = s*32 + LowestBit(m);
+				return word*32 + LowestBit(bits[word]);
+			}
+			if(++s >= NUMSUMMARYWORDS)
+				return -1;
+			m = summary[s];
+		}
+	}
+};
+
+static tRankBits queuedRanks;
+static tRankBits priorityRanks;
+
+static int
+CompareStreamPositions(const void *a, const void *b)
+{
+	CStreamingInfo *sa = &CStreaming::ms_aInfoForModel[*(const int16*)a];
+	CStreamingInfo *sb = &CStreaming::ms_aInfoForModel[*(const int16*)b];
+	uint32 posnA, posnB, size;
+	bool hasA = sa->GetCdPosnAndSize(posnA, size);
+	bool hasB = sb->GetCdPosnAndSize(posnB, size);
+	if(hasA != hasB)
+		return hasA ? 1 : -1;
+	if(hasA && posnA != posnB)
+		return posnA < posnB ? -1 : 1;
+	return *(const int16*)a - *(const int16*)b;
+}
+
+void
+CStreamingQueue::Init(void)
+{
+	int32 i;
+	for(i = 0; i < NUMSTREAMINFO; i++)
+		ms_aQueueFlags[i] = 0;
+	for(i = 0; i < TXDSTORESIZE; i++)
+		ms_aNumModelsUsingTxd[i] = 0;
+	queuedRanks.Clear();
+	priorityRanks.Clear();
+	ms_bOrderValid = false;
+}
+
+// Only when positions changed, which is loading the directories and the odd special model
+void
+CStreamingQueue::UpdateOrder(void)
+{
+	int32 i;
+	uint32 size;
+
+	for(i = 0; i < NUMSTREAMINFO; i++)
+		aOrder[i] = i;
+	qsort(aOrder, NUMSTREAMINFO, sizeof(int16), CompareStreamPositions);
+	numEmptyRanks = 0;
+	queuedRanks.Clear();
+	priorityRanks.Clear();
+	for(i = 0; i < NUMSTREAMINFO; i++){
+		int32 streamId = aOrder[i];
+		aRanks[streamId] = i;
+		if(!CStreaming::ms_aInfoForModel[streamId].GetCdPosnAndSize(aRankPosns[i], size)){
+			aRankPosns[i] = 0;
+			numEmptyRanks++;
+		}
+		if(ms_aQueueFlags[streamId] & QUEUEFLAG_QUEUED)
+			queuedRanks.Set(i);
+		if(ms_aQueueFlags[streamId] & QUEUEFLAG_PRIORITY)
+			priorityRanks.Set(i);
+	}
+	ms_bOrderValid = true;
+}
+
+void
+CStreamingQueue::Add(int32 streamId)
+{
+	if(ms_aQueueFlags[streamId])
+		return;
+	ms_aQueueFlags[streamId] = QUEUEFLAG_QUEUED;
+	if(streamId < STREAM_OFFSET_TXD){
+		ms_aTxdOfModel[streamId] = CModelInfo::GetModelInfo(streamId)->GetTxdSlot();
+		if(ms_aTxdOfModel[streamId] >= 0)
+			ms_aNumModelsUsingTxd[ms_aTxdOfModel[streamId]]++;
+	}
+	if(ms_bOrderValid)
+		queuedRanks.Set(aRanks[streamId]);
+}
+
+void
+CStreamingQueue::Remove(int32 streamId)
+{
+	if(ms_aQueueFlags[streamId] == 0)
+		return;
+	ms_aQueueFlags[streamId] = 0;
+	if(streamId < STREAM_OFFSET_TXD && ms_aTxdOfModel[streamId] >= 0)
+		ms_aNumModelsUsingTxd[ms_aTxdOfModel[streamId]]--;
+	if(ms_bOrderValid){
+		queuedRanks.Unset(aRanks[streamId]);
+		priorityRanks.Unset(aRanks[streamId]);
+	}
+}
+
+void
+CStreamingQueue::SetPriority(int32 streamId)
+{
+	if(ms_aQueueFlags[streamId] == 0)
+		return;
+	ms_aQueueFlags[streamId] |= QUEUEFLAG_PRIORITY;
+	if(ms_bOrderValid)
+		priorityRanks.Set(aRanks[streamId]);
+}
+
+void
+CStreamingQueue::ClearPriority(int32 streamId)
+{
+	ms_aQueueFlags[streamId] &= ~QUEUEFLAG_PRIORITY;
+	if(ms_bOrderValid)
+		priorityRanks.Unset(aRanks[streamId]);
+}
+
+int32
+CStreamingQueue::GetNumEmptyRanks(void)
+{
+	if(!ms_bOrderValid)
+		UpdateOrder();
+	return numEmptyRanks;
+}
+
+// First rank with a position not before posn
+int32
+CStreamingQueue::GetRank(uint32 posn)
+{
+	if(!ms_bOrderValid)
+		UpdateOrder();
+	int32 lo = numEmptyRanks;
+	int32 hi = NUMSTREAMINFO;
+	while(lo < hi){
+		int32 mid = (lo + hi) / 2;
+		if(aRankPosns[mid] < posn)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+// First queued rank from rank on, -1 if there is none
+int32
+CStreamingQueue::FindNext(int32 rank, bool priority)
+{
+	if(!ms_bOrderValid)
+		UpdateOrder();
+	return priority ? priorityRanks.FindNext(rank) : queuedRanks.FindNext(rank);
+}
+
+int32
+CStreamingQueue::GetStreamId(int32 rank)
+{
+	return aOrder[rank];
+}
+#endif
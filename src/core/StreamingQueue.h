@@ -0,0 +1,32 @@
+#pragma once
+
+// The requested list of CStreaming again, as bitmaps over the stream ids sorted
+// by their position on the CD. Finding the next file after a position is a
+// bit scan instead of a walk over the whole list.
+
+class CStreamingQueue
+{
+public:
+	static void Init(void);
+	static void PositionsChanged(void) { ms_bOrderValid = false; }
+	static void Add(int32 streamId);
+	static void Remove(int32 streamId);
+	static void SetPriority(int32 streamId);
+	static void ClearPriority(int32 streamId);
+	static bool IsQueued(int32 streamId) { return ms_aQueueFlags[streamId] != 0; }
+	static bool IsTxdUsed(int32 txdId) { return ms_aNumModelsUsingTxd[txdId] != 0; }
+
+	// ranks are indices into the sorted order, files without a position come first
+	static int32 GetNumEmptyRanks(void);
+	static int32 GetRank(uint32 posn);
+	static int32 FindNext(int32 rank, bool priority);
+	static int32 GetStreamId(int32 rank);
+
+private:
+	static bool ms_bOrderValid;
+	static uint8 ms_aQueueFlags[NUMSTREAMINFO];
+	static int16 ms_aTxdOfModel[STREAM_OFFSET_TXD];	// when it was added
+	static int16 ms_aNumModelsUsingTxd[TXDSTORESIZE];
+
+	static void UpdateOrder(void);
+};
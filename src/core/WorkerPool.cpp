@@ -0,0 +1,195 @@
+#ifdef _WIN32
+#define WITHWINDOWS
+#endif
+#include "common.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <semaphore.h>
+#include <unistd.h>
+#endif
+
+#include "WorkerPool.h"
+
+#ifdef _WIN32
+typedef HANDLE WorkerThread;
+typedef HANDLE WorkerSema;
+#define ATOMIC_FETCH_INC(p) (InterlockedIncrement((volatile LONG*)(p)) - 1)
+#define ATOMIC_CAS(p, o, n) (InterlockedCompareExchange((volatile LONG*)(p), (n), (o)) == (o))
+#define SEMA_WAIT(s) WaitForSingleObject(s, INFINITE)
+#define SEMA_POST(s) ReleaseSemaphore(s, 1, nil)
+#else
+typedef pthread_t WorkerThread;
+typedef sem_t WorkerSema;
+#define ATOMIC_FETCH_INC(p) __sync_fetch_and_add((p), 1)
+#define ATOMIC_CAS(p, o, n) __sync_bool_compare_and_swap((p), (o), (n))
+#define SEMA_WAIT(s) sem_wait(&s)
+#define SEMA_POST(s) sem_post(&s)
+#endif
+
+struct WorkerBatch
+{
+	WorkerJobFunc func;
+	void *arg;
+	int32 numItems;
+	int32 chunkSize;
+	int32 numChunks;
+	volatile int32 nextChunk;
+};
+
+int32 CWorkerPool::ms_numWorkers;
+volatile int32 CWorkerPool::ms_bInBatch;
+
+static WorkerThread gWorkerThreads[MAX_WORKERTHREADS];
+static WorkerSema gWorkerStartSema;	// released once per worker when a batch is ready
+static WorkerSema gWorkerDoneSema;	// released by every worker when it ran out of chunks
+static WorkerBatch gWorkerBatch;
+static volatile bool gbWorkersQuit;
+static thread_local int32 gThreadIndex;
+
+static void
+RunBatchChunks(WorkerBatch *batch)
+{
+	int32 chunk;
+	while((chunk = ATOMIC_FETCH_INC(&batch->nextChunk)) < batch->numChunks){
+		int32 start = chunk * batch->chunkSize;
+		int32 end = Min(start + batch->chunkSize, batch->numItems);
+		batch->func(start, end, batch->arg);
+	}
+}
+
+#ifdef _WIN32
+static DWORD WINAPI
+WorkerThreadFunc(LPVOID param)
+#else
+static void*
+WorkerThreadFunc(void *param)
+#endif
+{
+	gThreadIndex = (int32)(uintptr)param;
+	for(;;){
+		SEMA_WAIT(gWorkerStartSema);
+		if(gbWorkersQuit)
+			break;
+		RunBatchChunks(&gWorkerBatch);
+		SEMA_POST(gWorkerDoneSema);
+	}
+	return 0;
+}
+
+static int32
+GetNumCores(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors;
+#else
+	return sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+void
+CWorkerPool::Initialise(int32 numWorkers)
+{
+	if(numWorkers < 0)
+		numWorkers = GetNumCores() - 1;
+	numWorkers = clamp(numWorkers, 0, (int32)MAX_WORKERTHREADS);
+
+	ms_numWorkers = 0;
+	ms_bInBatch = 0;
+	gbWorkersQuit = false;
+	if(numWorkers == 0)
+		return;
+
+#ifdef _WIN32
+	gWorkerStartSema = CreateSemaphore(nil, 0, MAX_WORKERTHREADS, nil);
+	gWorkerDoneSema = CreateSemaphore(nil, 0, MAX_WORKERTHREADS, nil);
+	if(gWorkerStartSema == nil || gWorkerDoneSema == nil){
+		debug("CWorkerPool: failed to create semaphores\n");
+		return;
+	}
+#else
+	if(sem_init(&gWorkerStartSema, 0, 0) == -1 || sem_init(&gWorkerDoneSema, 0, 0) == -1){
+		debug("CWorkerPool: failed to create semaphores\n");
+		return;
+	}
+#endif
+
+	for(int32 i = 0; i < numWorkers; i++){
+#ifdef _WIN32
+		gWorkerThreads[i] = CreateThread(nil, 0, WorkerThreadFunc, (LPVOID)(uintptr)(i+1), 0, nil);
+		if(gWorkerThreads[i] == nil)
+			break;
+#else
+		if(pthread_create(&gWorkerThreads[i], nil, WorkerThreadFunc, (void*)(uintptr)(i+1)) != 0)
+			break;
+#endif
+		ms_numWorkers++;
+	}
+	debug("CWorkerPool: using %d worker threads\n", ms_numWorkers);
+}
+
+void
+CWorkerPool::Shutdown(void)
+{
+	if(ms_numWorkers == 0)
+		return;
+
+	gbWorkersQuit = true;
+	for(int32 i = 0; i < ms_numWorkers; i++)
+		SEMA_POST(gWorkerStartSema);
+	for(int32 i = 0; i < ms_numWorkers; i++){
+#ifdef _WIN32
+		WaitForSingleObject(gWorkerThreads[i], INFINITE);
+		CloseHandle(gWorkerThreads[i]);
+#else
+		pthread_join(gWorkerThreads[i], nil);
+#endif
+	}
+#ifdef _WIN32
+	CloseHandle(gWorkerStartSema);
+	CloseHandle(gWorkerDoneSema);
+#else
+	sem_destroy(&gWorkerStartSema);
+	sem_destroy(&gWorkerDoneSema);
+#endif
+	ms_numWorkers = 0;
+}
+
+int32
+CWorkerPool::GetThreadIndex(void)
+{
+	return gThreadIndex;
+}
+
+void
+CWorkerPool::ParallelFor(int32 numItems, int32 chunkSize, WorkerJobFunc func, void *arg)
+{
+	if(numItems <= 0)
+		return;
+	if(chunkSize < 1)
+		chunkSize = 1;
+
+	// nested or concurrent batches and single chunks just run on the calling thread
+	if(ms_numWorkers == 0 || numItems <= chunkSize || !ATOMIC_CAS(&ms_bInBatch, 0, 1)){
+		for(int32 start = 0; start < numItems; start += chunkSize)
+			func(start, Min(start + chunkSize, numItems), arg);
+		return;
+	}
+
+	gWorkerBatch.func = func;
+	gWorkerBatch.arg = arg;
+	gWorkerBatch.numItems = numItems;
+	gWorkerBatch.chunkSize = chunkSize;
+	gWorkerBatch.numChunks = (numItems + chunkSize - 1) / chunkSize;
+	gWorkerBatch.nextChunk = 0;
+
+	int32 numWakeUp = Min(ms_numWorkers, gWorkerBatch.numChunks - 1);
+	for(int32 i = 0; i < numWakeUp; i++)
+		SEMA_POST(gWorkerStartSema);
+	RunBatchChunks(&gWorkerBatch);
+	for(int32 i = 0; i < numWakeUp; i++)
+		SEMA_WAIT(gWorkerDoneSema);
+	ATOMIC_CAS(&ms_bInBatch, 1, 0);
+}
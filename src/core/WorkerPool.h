@@ -0,0 +1,28 @@
+#pragma once
+
+// A small pool of worker threads used to split independent per-item work across cores.
+// The calling thread always takes part in a batch, so everything still runs (serially)
+// when no workers could be created. Jobs must not touch RW or any other global state
+// unless the caller guarantees that the items are disjoint.
+
+typedef void (*WorkerJobFunc)(int32 start, int32 end, void *arg);
+
+class CWorkerPool
+{
+	static int32 ms_numWorkers;
+	static volatile int32 ms_bInBatch;	// claimed atomically by the thread running a batch
+public:
+	static void Initialise(int32 numWorkers = -1);
+	static void Shutdown(void);
+	static int32 GetNumWorkers(void) { return ms_numWorkers; }
+	static int32 GetNumThreads(void) { return ms_numWorkers + 1; }
+	static bool IsInBatch(void) { return ms_bInBatch != 0; }
+	static int32 GetThreadIndex(void);	// 1 to GetNumWorkers() on the workers, 0 elsewhere
+
+	// Calls func on [start, end) ranges of at most chunkSize items and returns when
+	// all items are done. Chunks are fixed by numItems and chunkSize alone, so the
+	// split doesn't depend on thread timing. Only one batch uses the workers at a
+	// time, one started from a job or from another thread while it runs is done
+	// on the calling thread alone.
+	static void ParallelFor(int32 numItems, int32 chunkSize, WorkerJobFunc func, void *arg);
+};
@@ -1,15 +1,18 @@
 #include "common.h"
 #include "Camera.h"
 #include "CarCtrl.h"
+#include "CollisionIslands.h"
 #include "CopPed.h"
 #include "CutsceneMgr.h"
 #include "DMAudio.h"
+#include "Broadphase.h"
 #include "Entity.h"
 #include "EventList.h"
 #include "Explosion.h"
 #include "Fire.h"
 #include "Garages.h"
 #include "Glass.h"
+#include "GroundHeights.h"
 #include "Messages.h"
 #include "ModelIndices.h"
 #include "Object.h"
@@ -22,11 +25,15 @@
 #include "References.h"
 #include "Replay.h"
 #include "RpAnimBlend.h"
+#include "Simd.h"
 #include "Shadows.h"
 #include "TempColModels.h"
 #include "Vehicle.h"
 #include "WaterLevel.h"
+#include "WorkerPool.h"
 #include "World.h"
+#include "WorldQuery.h"
+#include "timebars.h"
 
 
 #define OBJECT_REPOSITION_OFFSET_Z 2.0f
@@ -50,6 +57,10 @@ bool CWorld::bProcessCutsceneOnly;
 bool CWorld::bDoingCarCollisions;
 bool CWorld::bIncludeCarTyres;
 
+#ifdef PARALLEL_WORLD_PROCESS
+bool CWorld::bParallelProcess = true;
+#endif
+
 void
 CWorld::Initialise()
 {
@@ -93,6 +104,143 @@ CWorld::Remove(CEntity *ent)
 	if(!ent->IsStatic()) ((CPhysical *)ent)->RemoveFromMovingList();
 }
 
+#ifdef PACKED_SECTOR_LISTS
+static void
+SetSectorEntryBounds(CSectorArrayEntry &entry, CEntity *entity)
+{
+	// only buildings are guaranteed not to move without being re-added
+	CColModel *colModel = entity->IsBuilding() ? CModelInfo::GetModelInfo(entity->GetModelIndex())->GetColModel() : nil;
+	entry.bStaticBounds = colModel != nil;
+	if(!entry.bStaticBounds)
+		return;
+
+	entry.position = entity->GetPosition();
+	entity->GetBoundCentre(entry.boundCentre);
+	entry.boundRadius = entity->GetBoundRadius();
+
+	// grow the sphere until it holds the bounding box, so rejecting lines against it is safe
+	const CVector &c = colModel->boundingSphere.center;
+	CVector extent(Max(Abs(colModel->boundingBox.min.x - c.x), Abs(colModel->boundingBox.max.x - c.x)),
+	               Max(Abs(colModel->boundingBox.min.y - c.y), Abs(colModel->boundingBox.max.y - c.y)),
+	               Max(Abs(colModel->boundingBox.min.z - c.z), Abs(colModel->boundingBox.max.z - c.z)));
+	entry.cullRadius = Max(entry.boundRadius, extent.Magnitude()) * 1.01f + 0.01f;
+}
+
+static bool
+LineMayHitSectorEntry(const CColLine &line, const CSectorArrayEntry &entry)
+{
+	if(!entry.bStaticBounds)
+		return true;
+	CVector dir = line.p1 - line.p0;
+	CVector diff = entry.boundCentre - line.p0;
+	float lenSqr = dir.MagnitudeSqr();
+	float t = lenSqr > 0.0f ? clamp(DotProduct(diff, dir) / lenSqr, 0.0f, 1.0f) : 0.0f;
+	return (diff - dir * t).MagnitudeSqr() <= SQR(entry.cullRadius);
+}
+
+void
+CSectorArray::Add(CEntity *entity)
+{
+	if(num == size) {
+		size = size == 0 ? 8 : size * 2;
+		entries = (CSectorArrayEntry *)realloc(entries, size * sizeof(CSectorArrayEntry));
+		assert(entries);
+	}
+	entries[num].entity = entity;
+	SetSectorEntryBounds(entries[num], entity);
+	num++;
+}
+
+void
+CSectorArray::Remove(CEntity *entity)
+{
+	for(int32 i = num - 1; i >= 0; i--)
+		if(entries[i].entity == entity) {
+			entries[i] = entries[--num];
+			return;
+		}
+}
+
+void
+CSectorArray::UpdateBounds(CEntity *entity)
+{
+	for(int32 i = 0; i < num; i++)
+		if(entries[i].entity == entity)
+			SetSectorEntryBounds(entries[i], entity);
+}
+
+// Refreshes the cached bounds after a building was moved in place (the bridge does that)
+void
+CWorld::UpdateSectorArrayBounds(CEntity *entity)
+{
+	UpdateSectorArrayBounds(entity, entity->GetBoundRect());
+}
+
+// Same, for sectors the entity may be in that its new bounds don't cover any more
+void
+CWorld::UpdateSectorArrayBounds(CEntity *entity, const CRect &oldBounds)
+{
+	CRect bounds = entity->GetBoundRect();
+	bounds.ContainRect(oldBounds);
+	int32 x1 = clamp(GetSectorIndexX(bounds.left), 0, NUMSECTORS_X - 1);
+	int32 x2 = clamp(GetSectorIndexX(bounds.right), 0, NUMSECTORS_X - 1);
+	int32 y1 = clamp(GetSectorIndexY(bounds.top), 0, NUMSECTORS_Y - 1);
+	int32 y2 = clamp(GetSectorIndexY(bounds.bottom), 0, NUMSECTORS_Y - 1);
+	for(int32 y = y1; y <= y2; y++)
+		for(int32 x = x1; x <= x2; x++) {
+			CSector *s = GetSector(x, y);
+			s->m_arrays[ENTITYLIST_BUILDINGS].UpdateBounds(entity);
+			s->m_arrays[ENTITYLIST_BUILDINGS_OVERLAP].UpdateBounds(entity);
+		}
+}
+
+#ifndef MASTER
+// Times the same bound sphere query over the CPtrList and the packed array
+// of every list in the sector the camera is in.
+void
+CWorld::BenchmarkSectorLists(void)
+{
+	const int32 numRuns = 1000;
+	CVector pos = TheCamera.GetPosition();
+	CSector *sector = GetSector(clamp(GetSectorIndexX(pos.x), 0, NUMSECTORS_X - 1), clamp(GetSectorIndexY(pos.y), 0, NUMSECTORS_Y - 1));
+	float radius = 30.0f;
+	int32 numEntities = 0;
+	int32 hitsList = 0, hitsArray = 0;
+
+	for(int32 l = 0; l < NUMSECTORENTITYLISTS; l++)
+		numEntities += sector->m_arrays[l].num;
+
+	uint32 start = CTimer::GetCurrentTimeInCycles();
+	for(int32 run = 0; run < numRuns; run++)
+		for(int32 l = 0; l < NUMSECTORENTITYLISTS; l++)
+			for(CPtrNode *node = sector->m_lists[l].first; node; node = node->next) {
+				CEntity *e = (CEntity *)node->item;
+				if(e->GetIsTouching(pos, radius))
+					hitsList++;
+			}
+	uint32 listCycles = CTimer::GetCurrentTimeInCycles() - start;
+
+	start = CTimer::GetCurrentTimeInCycles();
+	for(int32 run = 0; run < numRuns; run++)
+		for(int32 l = 0; l < NUMSECTORENTITYLISTS; l++) {
+			CSectorArray &array = sector->m_arrays[l];
+			for(int32 i = array.num - 1; i >= 0; i--) {
+				CSectorArrayEntry &entry = array.entries[i];
+				if(entry.bStaticBounds ? SQR(entry.boundRadius + radius) > (entry.boundCentre - pos).MagnitudeSqr()
+				                       : entry.entity->GetIsTouching(pos, radius))
+					hitsArray++;
+			}
+		}
+	uint32 arrayCycles = CTimer::GetCurrentTimeInCycles() - start;
+
+	float cyclesPerUs = CTimer::GetCyclesPerMillisecond() / 1000.0f;
+	debug("Sector list benchmark: %d entities, %d queries\n", numEntities, numRuns);
+	debug("  CPtrList:    %.1f us/query (%d hits)\n", listCycles / cyclesPerUs / numRuns, hitsList / numRuns);
+	debug("  CSectorArray: %.1f us/query (%d hits)\n", arrayCycles / cyclesPerUs / numRuns, hitsArray / numRuns);
+}
+#endif
+#endif
+
 void
 CWorld::ClearScanCodes(void)
 {
@@ -116,18 +264,14 @@ CWorld::ClearScanCodes(void)
 void
 CWorld::ClearExcitingStuffFromArea(const CVector &pos, float radius, bool bRemoveProjectilesAndTidyUpShadows)
 {
-	CPedPool *pedPool = CPools::GetPedPool();
-	for(int32 i = 0; i < pedPool->GetSize(); i++) {
-		CPed *pPed = pedPool->GetSlot(i);
-		if(pPed && !pPed->IsPlayer() && pPed->CanBeDeleted() &&
+	for(CPed *pPed : *CPools::GetPedPool()) {
+		if(!pPed->IsPlayer() && pPed->CanBeDeleted() &&
 		   CVector2D(pPed->GetPosition() - pos).MagnitudeSqr() < SQR(radius)) {
 			CPopulation::RemovePed(pPed);
 		}
 	}
-	CVehiclePool *VehiclePool = CPools::GetVehiclePool();
-	for(int32 i = 0; i < VehiclePool->GetSize(); i++) {
-		CVehicle *pVehicle = VehiclePool->GetSlot(i);
-		if(pVehicle && CVector2D(pVehicle->GetPosition() - pos).MagnitudeSqr() < SQR(radius) &&
+	for(CVehicle *pVehicle : *CPools::GetVehiclePool()) {
+		if(CVector2D(pVehicle->GetPosition() - pos).MagnitudeSqr() < SQR(radius) &&
 		   !pVehicle->bIsLocked && pVehicle->CanBeDeleted()) {
 			if(pVehicle->pDriver) {
 				CPopulation::RemovePed(pVehicle->pDriver);
@@ -273,39 +417,39 @@ CWorld::ProcessLineOfSightSector(CSector &sector, const CColLine &line, CColPoin
 	bIncludeDeadPeds = false;
 
 	if(checkBuildings) {
-		ProcessLineOfSightSectorList(sector.m_lists[ENTITYLIST_BUILDINGS], line, point, mindist, entity,
+		ProcessLineOfSightSectorList(sector.GetQueryLists()[ENTITYLIST_BUILDINGS], line, point, mindist, entity,
 		                             ignoreSeeThrough);
-		ProcessLineOfSightSectorList(sector.m_lists[ENTITYLIST_BUILDINGS_OVERLAP], line, point, mindist, entity,
+		ProcessLineOfSightSectorList(sector.GetQueryLists()[ENTITYLIST_BUILDINGS_OVERLAP], line, point, mindist, entity,
 		                             ignoreSeeThrough);
 	}
 
 	if(checkVehicles) {
-		ProcessLineOfSightSectorList(sector.m_lists[ENTITYLIST_VEHICLES], line, point, mindist, entity,
+		ProcessLineOfSightSectorList(sector.GetQueryLists()[ENTITYLIST_VEHICLES], line, point, mindist, entity,
 		                             ignoreSeeThrough);
-		ProcessLineOfSightSectorList(sector.m_lists[ENTITYLIST_VEHICLES_OVERLAP], line, point, mindist, entity,
+		ProcessLineOfSightSectorList(sector.GetQueryLists()[ENTITYLIST_VEHICLES_OVERLAP], line, point, mindist, entity,
 		                             ignoreSeeThrough);
 	}
 
 	if(checkPeds) {
 		if(deadPeds) bIncludeDeadPeds = true;
-		ProcessLineOfSightSectorList(sector.m_lists[ENTITYLIST_PEDS], line, point, mindist, entity,
+		ProcessLineOfSightSectorList(sector.GetQueryLists()[ENTITYLIST_PEDS], line, point, mindist, entity,
 		                             ignoreSeeThrough);
-		ProcessLineOfSightSectorList(sector.m_lists[ENTITYLIST_PEDS_OVERLAP], line, point, mindist, entity,
+		ProcessLineOfSightSectorList(sector.GetQueryLists()[ENTITYLIST_PEDS_OVERLAP], line, point, mindist, entity,
 		                             ignoreSeeThrough);
 		bIncludeDeadPeds = false;
 	}
 
 	if(checkObjects) {
-		ProcessLineOfSightSectorList(sector.m_lists[ENTITYLIST_OBJECTS], line, point, mindist, entity,
+		ProcessLineOfSightSectorList(sector.GetQueryLists()[ENTITYLIST_OBJECTS], line, point, mindist, entity,
 		                             ignoreSeeThrough, ignoreSomeObjects);
-		ProcessLineOfSightSectorList(sector.m_lists[ENTITYLIST_OBJECTS_OVERLAP], line, point, mindist, entity,
+		ProcessLineOfSightSectorList(sector.GetQueryLists()[ENTITYLIST_OBJECTS_OVERLAP], line, point, mindist, entity,
 		                             ignoreSeeThrough, ignoreSomeObjects);
 	}
 
 	if(checkDummies) {
-		ProcessLineOfSightSectorList(sector.m_lists[ENTITYLIST_DUMMIES], line, point, mindist, entity,
+		ProcessLineOfSightSectorList(sector.GetQueryLists()[ENTITYLIST_DUMMIES], line, point, mindist, entity,
 		                             ignoreSeeThrough);
-		ProcessLineOfSightSectorList(sector.m_lists[ENTITYLIST_DUMMIES_OVERLAP], line, point, mindist, entity,
+		ProcessLineOfSightSectorList(sector.GetQueryLists()[ENTITYLIST_DUMMIES_OVERLAP], line, point, mindist, entity,
 		                             ignoreSeeThrough);
 	}
 
@@ -318,50 +462,58 @@ CWorld::ProcessLineOfSightSector(CSector &sector, const CColLine &line, CColPoin
 		return false;
 }
 
+static CColModel*
+GetLineOfSightColModel(CEntity *e, bool deadPeds)
+{
+	if(e->IsPed()) {
+		if(e->bUsesCollision || deadPeds && ((CPed *)e)->m_nPedState == PED_DEAD) {
+#ifdef PED_SKIN
+			if(IsClumpSkinned(e->GetClump()))
+				return ((CPedModelInfo *)CModelInfo::GetModelInfo(e->GetModelIndex()))->AnimatePedColModelSkinned(e->GetClump());
+#endif
+			if(((CPed *)e)->UseGroundColModel())
+				return &CTempColModels::ms_colModelPedGroundHit;
+#ifdef ANIMATE_PED_COL_MODEL
+			return CPedModelInfo::AnimatePedColModel(
+			    ((CPedModelInfo *)CModelInfo::GetModelInfo(e->GetModelIndex()))->GetHitColModel(),
+			    RpClumpGetFrame(e->GetClump()));
+#else
+			return ((CPedModelInfo *)CModelInfo::GetModelInfo(e->GetModelIndex()))->GetHitColModel();
+#endif
+		}
+	} else if(e->bUsesCollision)
+		return CModelInfo::GetModelInfo(e->GetModelIndex())->GetColModel();
+	return nil;
+}
+
 bool
-CWorld::ProcessLineOfSightSectorList(CPtrList &list, const CColLine &line, CColPoint &point, float &dist,
+CWorld::ProcessLineOfSightSectorList(CSectorQueryList &list, const CColLine &line, CColPoint &point, float &dist,
                                      CEntity *&entity, bool ignoreSeeThrough, bool ignoreSomeObjects)
 {
 	bool deadPeds = false;
 	float mindist = dist;
-	CPtrNode *node;
 	CEntity *e;
 	CColModel *colmodel;
 
+#ifdef PACKED_SECTOR_LISTS
+	if(list.num > 0 && bIncludeDeadPeds && list.entries[0].entity->IsPed()) deadPeds = true;
+
+	for(int32 i = list.num - 1; i >= 0; i--) {
+		if(!LineMayHitSectorEntry(line, list.entries[i])) continue;
+		e = list.entries[i].entity;
+#else
+	CPtrNode *node;
+
 	if(list.first && bIncludeDeadPeds && ((CEntity *)list.first->item)->IsPed()) deadPeds = true;
 
 	for(node = list.first; node; node = node->next) {
 		e = (CEntity *)node->item;
+#endif
 		if(e->m_scanCode != GetCurrentScanCode() && e != pIgnoreEntity && (e->bUsesCollision || deadPeds) &&
 		   !(ignoreSomeObjects && CameraToIgnoreThisObject(e))) {
-			colmodel = nil;
 			e->m_scanCode = GetCurrentScanCode();
 
-			if(e->IsPed()) {
-				if(e->bUsesCollision || deadPeds && ((CPed *)e)->m_nPedState == PED_DEAD) {
-#ifdef PED_SKIN
-					if(IsClumpSkinned(e->GetClump()))
-						colmodel = ((CPedModelInfo *)CModelInfo::GetModelInfo(e->GetModelIndex()))->AnimatePedColModelSkinned(e->GetClump());
-					else
-#endif
-					if(((CPed *)e)->UseGroundColModel())
-						colmodel = &CTempColModels::ms_colModelPedGroundHit;
-					else
-#ifdef ANIMATE_PED_COL_MODEL
-						colmodel = CPedModelInfo::AnimatePedColModel(
-						    ((CPedModelInfo *)CModelInfo::GetModelInfo(e->GetModelIndex()))
-						        ->GetHitColModel(),
-						    RpClumpGetFrame(e->GetClump()));
-#else
-						colmodel =
-						    ((CPedModelInfo *)CModelInfo::GetModelInfo(e->GetModelIndex()))
-						        ->GetHitColModel();
-#endif
-				} else
-					colmodel = nil;
-			} else if(e->bUsesCollision)
-				colmodel = CModelInfo::GetModelInfo(e->GetModelIndex())->GetColModel();
-
+			colmodel = GetLineOfSightColModel(e, deadPeds);
 			if(colmodel && CCollision::ProcessLineOfSight(line, e->GetMatrix(), *colmodel, point, dist,
 			                                              ignoreSeeThrough))
 				entity = e;
@@ -395,37 +547,37 @@ CWorld::ProcessVerticalLineSector(CSector &sector, const CColLine &line, CColPoi
 	float mindist = 1.0f;
 
 	if(checkBuildings) {
-		ProcessVerticalLineSectorList(sector.m_lists[ENTITYLIST_BUILDINGS], line, point, mindist, entity,
+		ProcessVerticalLineSectorList(sector.GetQueryLists()[ENTITYLIST_BUILDINGS], line, point, mindist, entity,
 		                              ignoreSeeThrough, poly);
-		ProcessVerticalLineSectorList(sector.m_lists[ENTITYLIST_BUILDINGS_OVERLAP], line, point, mindist,
+		ProcessVerticalLineSectorList(sector.GetQueryLists()[ENTITYLIST_BUILDINGS_OVERLAP], line, point, mindist,
 		                              entity, ignoreSeeThrough, poly);
 	}
 
 	if(checkVehicles) {
-		ProcessVerticalLineSectorList(sector.m_lists[ENTITYLIST_VEHICLES], line, point, mindist, entity,
+		ProcessVerticalLineSectorList(sector.GetQueryLists()[ENTITYLIST_VEHICLES], line, point, mindist, entity,
 		                              ignoreSeeThrough, poly);
-		ProcessVerticalLineSectorList(sector.m_lists[ENTITYLIST_VEHICLES_OVERLAP], line, point, mindist, entity,
+		ProcessVerticalLineSectorList(sector.GetQueryLists()[ENTITYLIST_VEHICLES_OVERLAP], line, point, mindist, entity,
 		                              ignoreSeeThrough, poly);
 	}
 
 	if(checkPeds) {
-		ProcessVerticalLineSectorList(sector.m_lists[ENTITYLIST_PEDS], line, point, mindist, entity,
+		ProcessVerticalLineSectorList(sector.GetQueryLists()[ENTITYLIST_PEDS], line, point, mindist, entity,
 		                              ignoreSeeThrough, poly);
-		ProcessVerticalLineSectorList(sector.m_lists[ENTITYLIST_PEDS_OVERLAP], line, point, mindist, entity,
+		ProcessVerticalLineSectorList(sector.GetQueryLists()[ENTITYLIST_PEDS_OVERLAP], line, point, mindist, entity,
 		                              ignoreSeeThrough, poly);
 	}
 
 	if(checkObjects) {
-		ProcessVerticalLineSectorList(sector.m_lists[ENTITYLIST_OBJECTS], line, point, mindist, entity,
+		ProcessVerticalLineSectorList(sector.GetQueryLists()[ENTITYLIST_OBJECTS], line, point, mindist, entity,
 		                              ignoreSeeThrough, poly);
-		ProcessVerticalLineSectorList(sector.m_lists[ENTITYLIST_OBJECTS_OVERLAP], line, point, mindist, entity,
+		ProcessVerticalLineSectorList(sector.GetQueryLists()[ENTITYLIST_OBJECTS_OVERLAP], line, point, mindist, entity,
 		                              ignoreSeeThrough, poly);
 	}
 
 	if(checkDummies) {
-		ProcessVerticalLineSectorList(sector.m_lists[ENTITYLIST_DUMMIES], line, point, mindist, entity,
+		ProcessVerticalLineSectorList(sector.GetQueryLists()[ENTITYLIST_DUMMIES], line, point, mindist, entity,
 		                              ignoreSeeThrough, poly);
-		ProcessVerticalLineSectorList(sector.m_lists[ENTITYLIST_DUMMIES_OVERLAP], line, point, mindist, entity,
+		ProcessVerticalLineSectorList(sector.GetQueryLists()[ENTITYLIST_DUMMIES_OVERLAP], line, point, mindist, entity,
 		                              ignoreSeeThrough, poly);
 	}
 
@@ -433,16 +585,23 @@ CWorld::ProcessVerticalLineSector(CSector &sector, const CColLine &line, CColPoi
 }
 
 bool
-CWorld::ProcessVerticalLineSectorList(CPtrList &list, const CColLine &line, CColPoint &point, float &dist,
+CWorld::ProcessVerticalLineSectorList(CSectorQueryList &list, const CColLine &line, CColPoint &point, float &dist,
                                       CEntity *&entity, bool ignoreSeeThrough, CStoredCollPoly *poly)
 {
 	float mindist = dist;
-	CPtrNode *node;
 	CEntity *e;
 	CColModel *colmodel;
 
+#ifdef PACKED_SECTOR_LISTS
+	for(int32 i = list.num - 1; i >= 0; i--) {
+		if(!LineMayHitSectorEntry(line, list.entries[i])) continue;
+		e = list.entries[i].entity;
+#else
+	CPtrNode *node;
+
 	for(node = list.first; node; node = node->next) {
 		e = (CEntity *)node->item;
+#endif
 		if(e->m_scanCode != GetCurrentScanCode() && e->bUsesCollision) {
 			e->m_scanCode = GetCurrentScanCode();
 
@@ -460,6 +619,269 @@ CWorld::ProcessVerticalLineSectorList(CPtrList &list, const CColLine &line, CCol
 		return false;
 }
 
+#ifdef LINE_OF_SIGHT_BATCHES
+// The lines of a batch in SoA layout, padded to a multiple of 4 so they can be culled 4 at a time
+struct tLineBatch
+{
+	float p0x[MAX_BATCHED_LINES];
+	float p0y[MAX_BATCHED_LINES];
+	float p0z[MAX_BATCHED_LINES];
+	float dx[MAX_BATCHED_LINES];
+	float dy[MAX_BATCHED_LINES];
+	float dz[MAX_BATCHED_LINES];
+	float invLenSqr[MAX_BATCHED_LINES];
+	float dists[MAX_BATCHED_LINES];
+	int32 numLines;
+	int32 numPadded;
+	float maxLength;
+	bool bVertical;
+	const CColLine *lines;
+	CColPoint *points;
+	CEntity **entities;
+};
+
+static void
+SetupLineBatch(tLineBatch &batch, int32 numLines, const CColLine *lines, CColPoint *points, CEntity **entities, bool vertical)
+{
+	assert(numLines > 0 && numLines <= MAX_BATCHED_LINES);
+	batch.numLines = numLines;
+	batch.numPadded = (numLines + 3) & ~3;
+	batch.maxLength = 0.0f;
+	batch.bVertical = vertical;
+	batch.lines = lines;
+	batch.points = points;
+	batch.entities = entities;
+	for(int32 i = 0; i < batch.numPadded; i++) {
+		// padding repeats the last line, its bits are masked off later
+		const CColLine &line = lines[Min(i, numLines - 1)];
+		CVector dir = line.p1 - line.p0;
+		float lenSqr = dir.MagnitudeSqr();
+		batch.p0x[i] = line.p0.x;
+		batch.p0y[i] = line.p0.y;
+		batch.p0z[i] = line.p0.z;
+		batch.dx[i] = dir.x;
+		batch.dy[i] = dir.y;
+		batch.dz[i] = dir.z;
+		batch.invLenSqr[i] = lenSqr > 0.0f ? 1.0f / lenSqr : 0.0f;
+		batch.maxLength = Max(batch.maxLength, Sqrt(lenSqr));
+	}
+	for(int32 i = 0; i < numLines; i++) {
+		batch.dists[i] = 1.0f;
+		entities[i] = nil;
+	}
+}
+
+// Returns a bit for every line of the batch that passes within radius of centre
+static uint32
+FindBatchLinesNearSphere(const tLineBatch &batch, const CVector &centre, float radius)
+{
+	uint32 mask = 0;
+	Simd4f cx = Simd4Splat(centre.x);
+	Simd4f cy = Simd4Splat(centre.y);
+	Simd4f cz = Simd4Splat(centre.z);
+	Simd4f radiusSqr = Simd4Splat(SQR(radius));
+	Simd4f zero = Simd4Splat(0.0f);
+	Simd4f one = Simd4Splat(1.0f);
+	for(int32 i = 0; i < batch.numPadded; i += 4) {
+		Simd4f dx = Simd4Load(&batch.dx[i]);
+		Simd4f dy = Simd4Load(&batch.dy[i]);
+		Simd4f dz = Simd4Load(&batch.dz[i]);
+		Simd4f ex = Simd4Sub(cx, Simd4Load(&batch.p0x[i]));
+		Simd4f ey = Simd4Sub(cy, Simd4Load(&batch.p0y[i]));
+		Simd4f ez = Simd4Sub(cz, Simd4Load(&batch.p0z[i]));
+		Simd4f t = Simd4Add(Simd4Add(Simd4Mul(ex, dx), Simd4Mul(ey, dy)), Simd4Mul(ez, dz));
+		t = Simd4Min(Simd4Max(Simd4Mul(t, Simd4Load(&batch.invLenSqr[i])), zero), one);
+		ex = Simd4Sub(ex, Simd4Mul(dx, t));
+		ey = Simd4Sub(ey, Simd4Mul(dy, t));
+		ez = Simd4Sub(ez, Simd4Mul(dz, t));
+		Simd4f distSqr = Simd4Add(Simd4Add(Simd4Mul(ex, ex), Simd4Mul(ey, ey)), Simd4Mul(ez, ez));
+		mask |= Simd4LessEqual(distSqr, radiusSqr) << i;
+	}
+	return mask & ((1 << batch.numLines) - 1);
+}
+
+static void
+ProcessLineBatchSectorList(CSectorQueryList &list, tLineBatch &batch, bool ignoreSeeThrough, bool ignoreSomeObjects)
+{
+	bool deadPeds = false;
+	CEntity *e;
+	CColModel *colmodel;
+	CVector centre;
+	float radius;
+	uint32 mask;
+
+#ifdef PACKED_SECTOR_LISTS
+	if(list.num > 0 && CWorld::bIncludeDeadPeds && list.entries[0].entity->IsPed()) deadPeds = true;
+
+	for(int32 i = list.num - 1; i >= 0; i--) {
+		CSectorArrayEntry &entry = list.entries[i];
+		// vertical lines are tested along the model's up axis, which needs the matrix, so only cull the others early
+		if(entry.bStaticBounds && !batch.bVertical &&
+		   FindBatchLinesNearSphere(batch, entry.boundCentre, entry.cullRadius) == 0)
+			continue;
+		e = entry.entity;
+#else
+	CPtrNode *node;
+
+	if(list.first && CWorld::bIncludeDeadPeds && ((CEntity *)list.first->item)->IsPed()) deadPeds = true;
+
+	for(node = list.first; node; node = node->next) {
+		e = (CEntity *)node->item;
+#endif
+		if(e->m_scanCode == CWorld::GetCurrentScanCode())
+			continue;
+		if(batch.bVertical) {
+			if(!e->bUsesCollision)
+				continue;
+			e->m_scanCode = CWorld::GetCurrentScanCode();
+			colmodel = CModelInfo::GetModelInfo(e->GetModelIndex())->GetColModel();
+		} else {
+			if(e == CWorld::pIgnoreEntity || !(e->bUsesCollision || deadPeds) ||
+			   ignoreSomeObjects && CWorld::CameraToIgnoreThisObject(e))
+				continue;
+			e->m_scanCode = CWorld::GetCurrentScanCode();
+			colmodel = GetLineOfSightColModel(e, deadPeds);
+			if(colmodel == nil)
+				continue;
+		}
+
+		// sphere around the bounding box, every line that misses the box is rejected by CCollision anyway
+		const CColBox &box = colmodel->boundingBox;
+		centre = e->GetMatrix() * ((box.min + box.max) * 0.5f);
+		radius = (box.max - box.min).Magnitude() * 0.5f * 1.01f + 0.01f;
+		if(batch.bVertical) {
+			// CCollision moves the lower end of a vertical line onto the model's z axis,
+			// which shifts it by at most length * sin(tilt)
+			float upZ = e->GetUp().z;
+			radius += batch.maxLength * Sqrt(Max(1.0f - SQR(upZ), 0.0f));
+		}
+		mask = FindBatchLinesNearSphere(batch, centre, radius);
+
+		for(int32 j = 0; mask; j++, mask >>= 1) {
+			if((mask & 1) == 0)
+				continue;
+			if(batch.bVertical ? CCollision::ProcessVerticalLine(batch.lines[j], e->GetMatrix(), *colmodel, batch.points[j],
+			                                                     batch.dists[j], ignoreSeeThrough, nil)
+			                   : CCollision::ProcessLineOfSight(batch.lines[j], e->GetMatrix(), *colmodel, batch.points[j],
+			                                                    batch.dists[j], ignoreSeeThrough))
+				batch.entities[j] = e;
+		}
+	}
+}
+
+static void
+ProcessLineBatchSector(CSector &sector, tLineBatch &batch, bool checkBuildings, bool checkVehicles, bool checkPeds,
+                       bool checkObjects, bool checkDummies, bool ignoreSeeThrough, bool ignoreSomeObjects)
+{
+	bool deadPeds = !!CWorld::bIncludeDeadPeds;
+	CWorld::bIncludeDeadPeds = false;
+
+	if(checkBuildings) {
+		ProcessLineBatchSectorList(sector.GetQueryLists()[ENTITYLIST_BUILDINGS], batch, ignoreSeeThrough, false);
+		ProcessLineBatchSectorList(sector.GetQueryLists()[ENTITYLIST_BUILDINGS_OVERLAP], batch, ignoreSeeThrough, false);
+	}
+
+	if(checkVehicles) {
+		ProcessLineBatchSectorList(sector.GetQueryLists()[ENTITYLIST_VEHICLES], batch, ignoreSeeThrough, false);
+		ProcessLineBatchSectorList(sector.GetQueryLists()[ENTITYLIST_VEHICLES_OVERLAP], batch, ignoreSeeThrough, false);
+	}
+
+	if(checkPeds) {
+		// dead peds only count for lines of sight, like in ProcessLineOfSightSector
+		if(deadPeds && !batch.bVertical) CWorld::bIncludeDeadPeds = true;
+		ProcessLineBatchSectorList(sector.GetQueryLists()[ENTITYLIST_PEDS], batch, ignoreSeeThrough, false);
+		ProcessLineBatchSectorList(sector.GetQueryLists()[ENTITYLIST_PEDS_OVERLAP], batch, ignoreSeeThrough, false);
+		CWorld::bIncludeDeadPeds = false;
+	}
+
+	if(checkObjects) {
+		ProcessLineBatchSectorList(sector.GetQueryLists()[ENTITYLIST_OBJECTS], batch, ignoreSeeThrough, ignoreSomeObjects);
+		ProcessLineBatchSectorList(sector.GetQueryLists()[ENTITYLIST_OBJECTS_OVERLAP], batch, ignoreSeeThrough, ignoreSomeObjects);
+	}
+
+	if(checkDummies) {
+		ProcessLineBatchSectorList(sector.GetQueryLists()[ENTITYLIST_DUMMIES], batch, ignoreSeeThrough, false);
+		ProcessLineBatchSectorList(sector.GetQueryLists()[ENTITYLIST_DUMMIES_OVERLAP], batch, ignoreSeeThrough, false);
+	}
+
+	CWorld::bIncludeDeadPeds = deadPeds;
+}
+
+static int32
+GetLineBatchResult(const tLineBatch &batch)
+{
+	int32 numHits = 0;
+	for(int32 i = 0; i < batch.numLines; i++)
+		if(batch.entities[i])
+			numHits++;
+	return numHits;
+}
+
+// Same as calling ProcessLineOfSight for every line, but each entity around the lines
+// is only fetched once. Meant for lines close to each other, because all sectors in the
+// rectangle around them are visited.
+int32
+CWorld::ProcessLineOfSightBatch(int32 numLines, const CColLine *lines, CColPoint *points, CEntity **entities,
+                                bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects,
+                                bool checkDummies, bool ignoreSeeThrough, bool ignoreSomeObjects)
+{
+	tLineBatch batch;
+	float minX, maxX, minY, maxY;
+
+	SetupLineBatch(batch, numLines, lines, points, entities, false);
+	AdvanceCurrentScanCode();
+
+	minX = maxX = lines[0].p0.x;
+	minY = maxY = lines[0].p0.y;
+	for(int32 i = 0; i < numLines; i++) {
+		minX = Min(minX, Min(lines[i].p0.x, lines[i].p1.x));
+		maxX = Max(maxX, Max(lines[i].p0.x, lines[i].p1.x));
+		minY = Min(minY, Min(lines[i].p0.y, lines[i].p1.y));
+		maxY = Max(maxY, Max(lines[i].p0.y, lines[i].p1.y));
+	}
+
+	int32 xstart = clamp(GetSectorIndexX(minX), 0, NUMSECTORS_X - 1);
+	int32 xend = clamp(GetSectorIndexX(maxX), 0, NUMSECTORS_X - 1);
+	int32 ystart = clamp(GetSectorIndexY(minY), 0, NUMSECTORS_Y - 1);
+	int32 yend = clamp(GetSectorIndexY(maxY), 0, NUMSECTORS_Y - 1);
+	for(int32 y = ystart; y <= yend; y++)
+		for(int32 x = xstart; x <= xend; x++)
+			ProcessLineBatchSector(*GetSector(x, y), batch, checkBuildings, checkVehicles, checkPeds, checkObjects,
+			                       checkDummies, ignoreSeeThrough, ignoreSomeObjects);
+
+	return GetLineBatchResult(batch);
+}
+
+// Same as calling ProcessVerticalLine for every line (only p0 and the z of p1 are used).
+int32
+CWorld::ProcessVerticalLineBatch(int32 numLines, const CColLine *lines, CColPoint *points, CEntity **entities,
+                                 bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects,
+                                 bool checkDummies, bool ignoreSeeThrough)
+{
+	tLineBatch batch;
+	CColLine verticalLines[MAX_BATCHED_LINES];
+
+	for(int32 i = 0; i < numLines; i++)
+		verticalLines[i].Set(lines[i].p0, CVector(lines[i].p0.x, lines[i].p0.y, lines[i].p1.z));
+	SetupLineBatch(batch, numLines, verticalLines, points, entities, true);
+	AdvanceCurrentScanCode();
+
+	for(int32 i = 0; i < numLines; i++) {
+		int32 x = GetSectorIndexX(lines[i].p0.x);
+		int32 y = GetSectorIndexY(lines[i].p0.y);
+		int32 j;
+		for(j = 0; j < i; j++)
+			if(GetSectorIndexX(lines[j].p0.x) == x && GetSectorIndexY(lines[j].p0.y) == y)
+				break;
+		if(j == i)
+			ProcessLineBatchSector(*GetSector(x, y), batch, checkBuildings, checkVehicles, checkPeds, checkObjects,
+			                       checkDummies, ignoreSeeThrough, false);
+	}
+
+	return GetLineBatchResult(batch);
+}
+#endif
+
 bool
 CWorld::GetIsLineOfSightClear(const CVector &point1, const CVector &point2, bool checkBuildings, bool checkVehicles,
                               bool checkPeds, bool checkObjects, bool checkDummies, bool ignoreSeeThrough,
@@ -590,41 +1012,41 @@ CWorld::GetIsLineOfSightSectorClear(CSector &sector, const CColLine &line, bool
                                     bool ignoreSomeObjects)
 {
 	if(checkBuildings) {
-		if(!GetIsLineOfSightSectorListClear(sector.m_lists[ENTITYLIST_BUILDINGS], line, ignoreSeeThrough))
+		if(!GetIsLineOfSightSectorListClear(sector.GetQueryLists()[ENTITYLIST_BUILDINGS], line, ignoreSeeThrough))
 			return false;
-		if(!GetIsLineOfSightSectorListClear(sector.m_lists[ENTITYLIST_BUILDINGS_OVERLAP], line,
+		if(!GetIsLineOfSightSectorListClear(sector.GetQueryLists()[ENTITYLIST_BUILDINGS_OVERLAP], line,
 		                                    ignoreSeeThrough))
 			return false;
 	}
 
 	if(checkVehicles) {
-		if(!GetIsLineOfSightSectorListClear(sector.m_lists[ENTITYLIST_VEHICLES], line, ignoreSeeThrough))
+		if(!GetIsLineOfSightSectorListClear(sector.GetQueryLists()[ENTITYLIST_VEHICLES], line, ignoreSeeThrough))
 			return false;
-		if(!GetIsLineOfSightSectorListClear(sector.m_lists[ENTITYLIST_VEHICLES_OVERLAP], line,
+		if(!GetIsLineOfSightSectorListClear(sector.GetQueryLists()[ENTITYLIST_VEHICLES_OVERLAP], line,
 		                                    ignoreSeeThrough))
 			return false;
 	}
 
 	if(checkPeds) {
-		if(!GetIsLineOfSightSectorListClear(sector.m_lists[ENTITYLIST_PEDS], line, ignoreSeeThrough))
+		if(!GetIsLineOfSightSectorListClear(sector.GetQueryLists()[ENTITYLIST_PEDS], line, ignoreSeeThrough))
 			return false;
-		if(!GetIsLineOfSightSectorListClear(sector.m_lists[ENTITYLIST_PEDS_OVERLAP], line, ignoreSeeThrough))
+		if(!GetIsLineOfSightSectorListClear(sector.GetQueryLists()[ENTITYLIST_PEDS_OVERLAP], line, ignoreSeeThrough))
 			return false;
 	}
 
 	if(checkObjects) {
-		if(!GetIsLineOfSightSectorListClear(sector.m_lists[ENTITYLIST_OBJECTS], line, ignoreSeeThrough,
+		if(!GetIsLineOfSightSectorListClear(sector.GetQueryLists()[ENTITYLIST_OBJECTS], line, ignoreSeeThrough,
 		                                    ignoreSomeObjects))
 			return false;
-		if(!GetIsLineOfSightSectorListClear(sector.m_lists[ENTITYLIST_OBJECTS_OVERLAP], line, ignoreSeeThrough,
+		if(!GetIsLineOfSightSectorListClear(sector.GetQueryLists()[ENTITYLIST_OBJECTS_OVERLAP], line, ignoreSeeThrough,
 		                                    ignoreSomeObjects))
 			return false;
 	}
 
 	if(checkDummies) {
-		if(!GetIsLineOfSightSectorListClear(sector.m_lists[ENTITYLIST_DUMMIES], line, ignoreSeeThrough))
+		if(!GetIsLineOfSightSectorListClear(sector.GetQueryLists()[ENTITYLIST_DUMMIES], line, ignoreSeeThrough))
 			return false;
-		if(!GetIsLineOfSightSectorListClear(sector.m_lists[ENTITYLIST_DUMMIES_OVERLAP], line, ignoreSeeThrough))
+		if(!GetIsLineOfSightSectorListClear(sector.GetQueryLists()[ENTITYLIST_DUMMIES_OVERLAP], line, ignoreSeeThrough))
 			return false;
 	}
 
@@ -632,15 +1054,22 @@ CWorld::GetIsLineOfSightSectorClear(CSector &sector, const CColLine &line, bool
 }
 
 bool
-CWorld::GetIsLineOfSightSectorListClear(CPtrList &list, const CColLine &line, bool ignoreSeeThrough,
+CWorld::GetIsLineOfSightSectorListClear(CSectorQueryList &list, const CColLine &line, bool ignoreSeeThrough,
                                         bool ignoreSomeObjects)
 {
-	CPtrNode *node;
 	CEntity *e;
 	CColModel *colmodel;
 
+#ifdef PACKED_SECTOR_LISTS
+	for(int32 i = list.num - 1; i >= 0; i--) {
+		if(!LineMayHitSectorEntry(line, list.entries[i])) continue;
+		e = list.entries[i].entity;
+#else
+	CPtrNode *node;
+
 	for(node = list.first; node; node = node->next) {
 		e = (CEntity *)node->item;
+#endif
 		if(e->m_scanCode != GetCurrentScanCode() && e->bUsesCollision) {
 
 			e->m_scanCode = GetCurrentScanCode();
@@ -659,14 +1088,26 @@ CWorld::GetIsLineOfSightSectorListClear(CPtrList &list, const CColLine &line, bo
 }
 
 void
-CWorld::FindObjectsInRangeSectorList(CPtrList &list, Const CVector &centre, float radius, bool ignoreZ, int16 *numObjects,
+CWorld::FindObjectsInRangeSectorList(CSectorQueryList &list, Const CVector &centre, float radius, bool ignoreZ, int16 *numObjects,
                                      int16 lastObject, CEntity **objects)
 {
 	float radiusSqr = radius * radius;
 	float objDistSqr;
 
+#ifdef PACKED_SECTOR_LISTS
+	for(int32 i = list.num - 1; i >= 0; i--) {
+		CSectorArrayEntry &entry = list.entries[i];
+		CEntity *object = entry.entity;
+		if(entry.bStaticBounds) {
+			// same test as below, but without touching the entity when it's out of range
+			CVector diff = centre - entry.position;
+			objDistSqr = ignoreZ ? diff.MagnitudeSqr2D() : diff.MagnitudeSqr();
+			if(objDistSqr >= radiusSqr) continue;
+		}
+#else
 	for(CPtrNode *node = list.first; node; node = node->next) {
 		CEntity *object = (CEntity *)node->item;
+#endif
 		if(object->m_scanCode != GetCurrentScanCode()) {
 			object->m_scanCode = GetCurrentScanCode();
 
@@ -716,33 +1157,33 @@ CWorld::FindObjectsInRange(Const CVector &centre, float radius, bool ignoreZ, in
 		for(int curX = minX; curX <= maxX; curX++) {
 			CSector *sector = GetSector(curX, curY);
 			if(checkBuildings) {
-				FindObjectsInRangeSectorList(sector->m_lists[ENTITYLIST_BUILDINGS], centre, radius,
+				FindObjectsInRangeSectorList(sector->GetQueryLists()[ENTITYLIST_BUILDINGS], centre, radius,
 				                             ignoreZ, numObjects, lastObject, objects);
-				FindObjectsInRangeSectorList(sector->m_lists[ENTITYLIST_BUILDINGS_OVERLAP], centre,
+				FindObjectsInRangeSectorList(sector->GetQueryLists()[ENTITYLIST_BUILDINGS_OVERLAP], centre,
 				                             radius, ignoreZ, numObjects, lastObject, objects);
 			}
 			if(checkVehicles) {
-				FindObjectsInRangeSectorList(sector->m_lists[ENTITYLIST_VEHICLES], centre, radius,
+				FindObjectsInRangeSectorList(sector->GetQueryLists()[ENTITYLIST_VEHICLES], centre, radius,
 				                             ignoreZ, numObjects, lastObject, objects);
-				FindObjectsInRangeSectorList(sector->m_lists[ENTITYLIST_VEHICLES_OVERLAP], centre,
+				FindObjectsInRangeSectorList(sector->GetQueryLists()[ENTITYLIST_VEHICLES_OVERLAP], centre,
 				                             radius, ignoreZ, numObjects, lastObject, objects);
 			}
 			if(checkPeds) {
-				FindObjectsInRangeSectorList(sector->m_lists[ENTITYLIST_PEDS], centre, radius, ignoreZ,
+				FindObjectsInRangeSectorList(sector->GetQueryLists()[ENTITYLIST_PEDS], centre, radius, ignoreZ,
 				                             numObjects, lastObject, objects);
-				FindObjectsInRangeSectorList(sector->m_lists[ENTITYLIST_PEDS_OVERLAP], centre, radius,
+				FindObjectsInRangeSectorList(sector->GetQueryLists()[ENTITYLIST_PEDS_OVERLAP], centre, radius,
 				                             ignoreZ, numObjects, lastObject, objects);
 			}
 			if(checkObjects) {
-				FindObjectsInRangeSectorList(sector->m_lists[ENTITYLIST_OBJECTS], centre, radius,
+				FindObjectsInRangeSectorList(sector->GetQueryLists()[ENTITYLIST_OBJECTS], centre, radius,
 				                             ignoreZ, numObjects, lastObject, objects);
-				FindObjectsInRangeSectorList(sector->m_lists[ENTITYLIST_OBJECTS_OVERLAP], centre,
+				FindObjectsInRangeSectorList(sector->GetQueryLists()[ENTITYLIST_OBJECTS_OVERLAP], centre,
 				                             radius, ignoreZ, numObjects, lastObject, objects);
 			}
 			if(checkDummies) {
-				FindObjectsInRangeSectorList(sector->m_lists[ENTITYLIST_DUMMIES], centre, radius,
+				FindObjectsInRangeSectorList(sector->GetQueryLists()[ENTITYLIST_DUMMIES], centre, radius,
 				                             ignoreZ, numObjects, lastObject, objects);
-				FindObjectsInRangeSectorList(sector->m_lists[ENTITYLIST_DUMMIES_OVERLAP], centre,
+				FindObjectsInRangeSectorList(sector->GetQueryLists()[ENTITYLIST_DUMMIES_OVERLAP], centre,
 				                             radius, ignoreZ, numObjects, lastObject, objects);
 			}
 		}
@@ -866,47 +1307,47 @@ CWorld::TestSphereAgainstWorld(CVector centre, float radius, CEntity *entityToIg
 		for(int curX = minX; curX <= maxX; curX++) {
 			CSector *sector = GetSector(curX, curY);
 			if(checkBuildings) {
-				foundE = TestSphereAgainstSectorList(sector->m_lists[ENTITYLIST_BUILDINGS], centre,
+				foundE = TestSphereAgainstSectorList(sector->GetQueryLists()[ENTITYLIST_BUILDINGS], centre,
 				                                     radius, entityToIgnore, false);
 				if(foundE) return foundE;
 
-				foundE = TestSphereAgainstSectorList(sector->m_lists[ENTITYLIST_BUILDINGS_OVERLAP],
+				foundE = TestSphereAgainstSectorList(sector->GetQueryLists()[ENTITYLIST_BUILDINGS_OVERLAP],
 				                                     centre, radius, entityToIgnore, false);
 				if(foundE) return foundE;
 			}
 			if(checkVehicles) {
-				foundE = TestSphereAgainstSectorList(sector->m_lists[ENTITYLIST_VEHICLES], centre,
+				foundE = TestSphereAgainstSectorList(sector->GetQueryLists()[ENTITYLIST_VEHICLES], centre,
 				                                     radius, entityToIgnore, false);
 				if(foundE) return foundE;
 
-				foundE = TestSphereAgainstSectorList(sector->m_lists[ENTITYLIST_VEHICLES_OVERLAP],
+				foundE = TestSphereAgainstSectorList(sector->GetQueryLists()[ENTITYLIST_VEHICLES_OVERLAP],
 				                                     centre, radius, entityToIgnore, false);
 				if(foundE) return foundE;
 			}
 			if(checkPeds) {
-				foundE = TestSphereAgainstSectorList(sector->m_lists[ENTITYLIST_PEDS], centre, radius,
+				foundE = TestSphereAgainstSectorList(sector->GetQueryLists()[ENTITYLIST_PEDS], centre, radius,
 				                                     entityToIgnore, false);
 				if(foundE) return foundE;
 
-				foundE = TestSphereAgainstSectorList(sector->m_lists[ENTITYLIST_PEDS_OVERLAP], centre,
+				foundE = TestSphereAgainstSectorList(sector->GetQueryLists()[ENTITYLIST_PEDS_OVERLAP], centre,
 				                                     radius, entityToIgnore, false);
 				if(foundE) return foundE;
 			}
 			if(checkObjects) {
-				foundE = TestSphereAgainstSectorList(sector->m_lists[ENTITYLIST_OBJECTS], centre,
+				foundE = TestSphereAgainstSectorList(sector->GetQueryLists()[ENTITYLIST_OBJECTS], centre,
 				                                     radius, entityToIgnore, ignoreSomeObjects);
 				if(foundE) return foundE;
 
-				foundE = TestSphereAgainstSectorList(sector->m_lists[ENTITYLIST_OBJECTS_OVERLAP],
+				foundE = TestSphereAgainstSectorList(sector->GetQueryLists()[ENTITYLIST_OBJECTS_OVERLAP],
 				                                     centre, radius, entityToIgnore, ignoreSomeObjects);
 				if(foundE) return foundE;
 			}
 			if(checkDummies) {
-				foundE = TestSphereAgainstSectorList(sector->m_lists[ENTITYLIST_DUMMIES], centre,
+				foundE = TestSphereAgainstSectorList(sector->GetQueryLists()[ENTITYLIST_DUMMIES], centre,
 				                                     radius, entityToIgnore, false);
 				if(foundE) return foundE;
 
-				foundE = TestSphereAgainstSectorList(sector->m_lists[ENTITYLIST_DUMMIES_OVERLAP],
+				foundE = TestSphereAgainstSectorList(sector->GetQueryLists()[ENTITYLIST_DUMMIES_OVERLAP],
 				                                     centre, radius, entityToIgnore, false);
 				if(foundE) return foundE;
 			}
@@ -916,7 +1357,7 @@ CWorld::TestSphereAgainstWorld(CVector centre, float radius, CEntity *entityToIg
 }
 
 CEntity *
-CWorld::TestSphereAgainstSectorList(CPtrList &list, CVector spherePos, float radius, CEntity *entityToIgnore,
+CWorld::TestSphereAgainstSectorList(CSectorQueryList &list, CVector spherePos, float radius, CEntity *entityToIgnore,
                                     bool ignoreSomeObjects)
 {
 	static CColModel sphereCol;
@@ -941,8 +1382,23 @@ CWorld::TestSphereAgainstSectorList(CPtrList &list, CVector spherePos, float rad
 	CMatrix sphereMat;
 	sphereMat.SetTranslate(spherePos);
 
+#ifdef PACKED_SECTOR_LISTS
+	for(int32 i = list.num - 1; i >= 0; i--) {
+		CSectorArrayEntry &entry = list.entries[i];
+		CEntity *e = entry.entity;
+		if(entry.bStaticBounds) {
+			// same bound sphere test as below, but without touching the entity
+#ifdef FIX_BUGS
+			CVector diff = spherePos - entry.boundCentre;
+#else
+			CVector diff = spherePos - entry.position;
+#endif
+			if(!(entry.boundRadius + radius > diff.Magnitude())) continue;
+		}
+#else
 	for(CPtrNode *node = list.first; node; node = node->next) {
 		CEntity *e = (CEntity *)node->item;
+#endif
 
 		if(e->m_scanCode != GetCurrentScanCode()) {
 			e->m_scanCode = GetCurrentScanCode();
@@ -975,11 +1431,289 @@ CWorld::TestSphereAgainstSectorList(CPtrList &list, CVector spherePos, float rad
 	return nil;
 }
 
+#ifdef CONCURRENT_WORLD_QUERIES
+// lists in the order the scan code versions check them
+static const int32 aQueryListOrder[NUMSECTORENTITYLISTS] = {
+	ENTITYLIST_BUILDINGS, ENTITYLIST_BUILDINGS_OVERLAP,
+	ENTITYLIST_VEHICLES, ENTITYLIST_VEHICLES_OVERLAP,
+	ENTITYLIST_PEDS, ENTITYLIST_PEDS_OVERLAP,
+	ENTITYLIST_OBJECTS, ENTITYLIST_OBJECTS_OVERLAP,
+	ENTITYLIST_DUMMIES, ENTITYLIST_DUMMIES_OVERLAP
+};
+
+static uint32
+GetQueryListMask(bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies)
+{
+	uint32 mask = 0;
+	if(checkBuildings) mask |= 1<<ENTITYLIST_BUILDINGS | 1<<ENTITYLIST_BUILDINGS_OVERLAP;
+	if(checkVehicles) mask |= 1<<ENTITYLIST_VEHICLES | 1<<ENTITYLIST_VEHICLES_OVERLAP;
+	if(checkPeds) mask |= 1<<ENTITYLIST_PEDS | 1<<ENTITYLIST_PEDS_OVERLAP;
+	if(checkObjects) mask |= 1<<ENTITYLIST_OBJECTS | 1<<ENTITYLIST_OBJECTS_OVERLAP;
+	if(checkDummies) mask |= 1<<ENTITYLIST_DUMMIES | 1<<ENTITYLIST_DUMMIES_OVERLAP;
+	return mask;
+}
+
+// Sectors the line passes through, column by column. The order doesn't matter
+// when the whole line is processed anyway.
+static int32
+FindSectorsOnLine(const CVector &point1, const CVector &point2, CSector **sectors)
+{
+	int32 n = 0;
+	float minX = Min(point1.x, point2.x);
+	float maxX = Max(point1.x, point2.x);
+	int32 xstart = clamp(CWorld::GetSectorIndexX(minX), 0, NUMSECTORS_X - 1);
+	int32 xend = clamp(CWorld::GetSectorIndexX(maxX), 0, NUMSECTORS_X - 1);
+	for(int32 x = xstart; x <= xend; x++) {
+		// the part of the line inside this column
+		float y1 = point1.y;
+		float y2 = point2.y;
+		if(xstart != xend) {
+			float m = (point2.y - point1.y) / (point2.x - point1.x);
+			float x1 = x == xstart ? minX : CWorld::GetWorldX(x);
+			float x2 = x == xend ? maxX : CWorld::GetWorldX(x + 1);
+			y1 = (x1 - point1.x) * m + point1.y;
+			y2 = (x2 - point1.x) * m + point1.y;
+		}
+		int32 ystart = clamp(CWorld::GetSectorIndexY(Min(y1, y2)), 0, NUMSECTORS_Y - 1);
+		int32 yend = clamp(CWorld::GetSectorIndexY(Max(y1, y2)), 0, NUMSECTORS_Y - 1);
+		for(int32 y = ystart; y <= yend; y++)
+			sectors[n++] = CWorld::GetSector(x, y);
+	}
+	return n;
+}
+
+static void
+ProcessLineOfSightSectorList(CWorldQuery &query, CSectorQueryList &list, const CColLine &line, CColPoint &point,
+                             float &dist, CEntity *&entity, bool deadPeds, bool ignoreSeeThrough, bool ignoreSomeObjects)
+{
+#ifdef PACKED_SECTOR_LISTS
+	for(int32 i = list.num - 1; i >= 0; i--) {
+		if(!LineMayHitSectorEntry(line, list.entries[i])) continue;
+		CEntity *e = list.entries[i].entity;
+#else
+	for(CPtrNode *node = list.first; node; node = node->next) {
+		CEntity *e = (CEntity *)node->item;
+#endif
+		if(e != query.pIgnoreEntity && (e->bUsesCollision || deadPeds) &&
+		   !(ignoreSomeObjects && CWorld::CameraToIgnoreThisObject(e)) && query.FirstVisit(e)) {
+			CColModel *colmodel = query.GetLineOfSightColModel(e, deadPeds);
+			if(colmodel && CCollision::ProcessLineOfSight(line, e->GetMatrix(), *colmodel, point, dist,
+			                                              ignoreSeeThrough, query.pBVHTriangles))
+				entity = e;
+		}
+	}
+}
+
+bool
+CWorld::ProcessLineOfSight(CWorldQuery &query, const CVector &point1, const CVector &point2, CColPoint &point,
+                           CEntity *&entity, bool checkBuildings, bool checkVehicles, bool checkPeds,
+                           bool checkObjects, bool checkDummies, bool ignoreSeeThrough, bool ignoreSomeObjects)
+{
+	CSector *sectors[NUMSECTORS_X*2 + NUMSECTORS_Y];
+	CColLine line(point1, point2);
+	uint32 mask = GetQueryListMask(checkBuildings, checkVehicles, checkPeds, checkObjects, checkDummies);
+	float dist = 1.0f;
+
+	query.Begin();
+	entity = nil;
+
+	int32 numSectors = FindSectorsOnLine(point1, point2, sectors);
+	for(int32 s = 0; s < numSectors; s++)
+		for(int32 i = 0; i < NUMSECTORENTITYLISTS; i++) {
+			int32 l = aQueryListOrder[i];
+			if(mask & 1<<l)
+				::ProcessLineOfSightSectorList(query, sectors[s]->GetQueryLists()[l], line, point, dist, entity,
+				                             query.bIncludeDeadPeds && (l == ENTITYLIST_PEDS || l == ENTITYLIST_PEDS_OVERLAP),
+				                             ignoreSeeThrough,
+				                             ignoreSomeObjects && (l == ENTITYLIST_OBJECTS || l == ENTITYLIST_OBJECTS_OVERLAP));
+		}
+	return dist < 1.0f;
+}
+
+static bool
+GetIsLineOfSightSectorListClear(CWorldQuery &query, CSectorQueryList &list, const CColLine &line, bool ignoreSeeThrough,
+                                bool ignoreSomeObjects)
+{
+#ifdef PACKED_SECTOR_LISTS
+	for(int32 i = list.num - 1; i >= 0; i--) {
+		if(!LineMayHitSectorEntry(line, list.entries[i])) continue;
+		CEntity *e = list.entries[i].entity;
+#else
+	for(CPtrNode *node = list.first; node; node = node->next) {
+		CEntity *e = (CEntity *)node->item;
+#endif
+		if(e->bUsesCollision && e != query.pIgnoreEntity &&
+		   !(ignoreSomeObjects && CWorld::CameraToIgnoreThisObject(e)) && query.FirstVisit(e)) {
+			CColModel *colmodel = CModelInfo::GetModelInfo(e->GetModelIndex())->GetColModel();
+			if(CCollision::TestLineOfSight(line, e->GetMatrix(), *colmodel, ignoreSeeThrough, query.pBVHTriangles))
+				return false;
+		}
+	}
+	return true;
+}
+
+bool
+CWorld::GetIsLineOfSightClear(CWorldQuery &query, const CVector &point1, const CVector &point2, bool checkBuildings,
+                              bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies,
+                              bool ignoreSeeThrough, bool ignoreSomeObjects)
+{
+	CSector *sectors[NUMSECTORS_X*2 + NUMSECTORS_Y];
+	CColLine line(point1, point2);
+	uint32 mask = GetQueryListMask(checkBuildings, checkVehicles, checkPeds, checkObjects, checkDummies);
+
+	query.Begin();
+
+	int32 numSectors = FindSectorsOnLine(point1, point2, sectors);
+	for(int32 s = 0; s < numSectors; s++)
+		for(int32 i = 0; i < NUMSECTORENTITYLISTS; i++) {
+			int32 l = aQueryListOrder[i];
+			if(mask & 1<<l &&
+			   !::GetIsLineOfSightSectorListClear(query, sectors[s]->GetQueryLists()[l], line, ignoreSeeThrough,
+			                                    ignoreSomeObjects && (l == ENTITYLIST_OBJECTS || l == ENTITYLIST_OBJECTS_OVERLAP)))
+				return false;
+		}
+	return true;
+}
+
+static void
+FindObjectsInRangeSectorList(CWorldQuery &query, CSectorQueryList &list, const CVector &centre, float radius, bool ignoreZ,
+                             int16 *numObjects, int16 lastObject, CEntity **objects)
+{
+	float radiusSqr = radius * radius;
+
+#ifdef PACKED_SECTOR_LISTS
+	for(int32 i = list.num - 1; i >= 0; i--) {
+		CSectorArrayEntry &entry = list.entries[i];
+		CEntity *object = entry.entity;
+		if(entry.bStaticBounds) {
+			CVector diff = centre - entry.position;
+			if((ignoreZ ? diff.MagnitudeSqr2D() : diff.MagnitudeSqr()) >= radiusSqr) continue;
+		}
+#else
+	for(CPtrNode *node = list.first; node; node = node->next) {
+		CEntity *object = (CEntity *)node->item;
+#endif
+		if(query.FirstVisit(object)) {
+			CVector diff = centre - object->GetPosition();
+			float objDistSqr = ignoreZ ? diff.MagnitudeSqr2D() : diff.MagnitudeSqr();
+			if(objDistSqr < radiusSqr && *numObjects < lastObject) {
+				if(objects) { objects[*numObjects] = object; }
+				(*numObjects)++;
+			}
+		}
+	}
+}
+
+void
+CWorld::FindObjectsInRange(CWorldQuery &query, const CVector &centre, float radius, bool ignoreZ, int16 *numObjects,
+                           int16 lastObject, CEntity **objects, bool checkBuildings, bool checkVehicles, bool checkPeds,
+                           bool checkObjects, bool checkDummies)
+{
+	int minX = clamp(GetSectorIndexX(centre.x - radius), 0, NUMSECTORS_X - 1);
+	int minY = clamp(GetSectorIndexY(centre.y - radius), 0, NUMSECTORS_Y - 1);
+	int maxX = clamp(GetSectorIndexX(centre.x + radius), 0, NUMSECTORS_X - 1);
+	int maxY = clamp(GetSectorIndexY(centre.y + radius), 0, NUMSECTORS_Y - 1);
+	uint32 mask = GetQueryListMask(checkBuildings, checkVehicles, checkPeds, checkObjects, checkDummies);
+
+	query.Begin();
+
+	*numObjects = 0;
+	for(int curY = minY; curY <= maxY; curY++)
+		for(int curX = minX; curX <= maxX; curX++)
+			for(int32 i = 0; i < NUMSECTORENTITYLISTS; i++) {
+				int32 l = aQueryListOrder[i];
+				if(mask & 1<<l)
+					::FindObjectsInRangeSectorList(query, GetSector(curX, curY)->GetQueryLists()[l], centre, radius,
+					                             ignoreZ, numObjects, lastObject, objects);
+			}
+}
+
+static CEntity*
+TestSphereAgainstSectorList(CWorldQuery &query, CSectorQueryList &list, const CColSphere &sphere, CEntity *entityToIgnore,
+                            bool ignoreSomeObjects)
+{
+#ifdef PACKED_SECTOR_LISTS
+	for(int32 i = list.num - 1; i >= 0; i--) {
+		CSectorArrayEntry &entry = list.entries[i];
+		CEntity *e = entry.entity;
+		if(entry.bStaticBounds) {
+#ifdef FIX_BUGS
+			CVector diff = sphere.center - entry.boundCentre;
+#else
+			CVector diff = sphere.center - entry.position;
+#endif
+			if(!(entry.boundRadius + sphere.radius > diff.Magnitude())) continue;
+		}
+#else
+	for(CPtrNode *node = list.first; node; node = node->next) {
+		CEntity *e = (CEntity *)node->item;
+#endif
+		if(e != entityToIgnore && e->bUsesCollision &&
+		   !(ignoreSomeObjects && CWorld::CameraToIgnoreThisObject(e)) && query.FirstVisit(e)) {
+#ifdef FIX_BUGS
+			CVector diff = sphere.center - e->GetBoundCentre();
+#else
+			CVector diff = sphere.center - e->GetPosition();
+#endif
+			float distance = diff.Magnitude();
+
+			if(e->GetBoundRadius() + sphere.radius > distance) {
+				CColModel *eCol = CModelInfo::GetModelInfo(e->GetModelIndex())->GetColModel();
+				if(CCollision::TestSphereColModel(sphere, e->GetMatrix(), *eCol, query.pBVHTriangles) ||
+				   (e->IsVehicle() && ((CVehicle *)e)->m_vehType == VEHICLE_TYPE_CAR && e->GetModelIndex() != MI_DODO &&
+				    sphere.radius + eCol->boundingBox.max.x > distance))
+					return e;
+			}
+		}
+	}
+	return nil;
+}
+
+CEntity*
+CWorld::TestSphereAgainstWorld(CWorldQuery &query, const CVector &centre, float radius, CEntity *entityToIgnore,
+                               bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects,
+                               bool checkDummies, bool ignoreSomeObjects)
+{
+	int minX = clamp(GetSectorIndexX(centre.x - radius), 0, NUMSECTORS_X - 1);
+	int minY = clamp(GetSectorIndexY(centre.y - radius), 0, NUMSECTORS_Y - 1);
+	int maxX = clamp(GetSectorIndexX(centre.x + radius), 0, NUMSECTORS_X - 1);
+	int maxY = clamp(GetSectorIndexY(centre.y + radius), 0, NUMSECTORS_Y - 1);
+	uint32 mask = GetQueryListMask(checkBuildings, checkVehicles, checkPeds, checkObjects, checkDummies);
+	CColSphere sphere;
+	sphere.Set(radius, centre, 0, 0);
+
+	query.Begin();
+
+	for(int curY = minY; curY <= maxY; curY++)
+		for(int curX = minX; curX <= maxX; curX++)
+			for(int32 i = 0; i < NUMSECTORENTITYLISTS; i++) {
+				int32 l = aQueryListOrder[i];
+				if(!(mask & 1<<l))
+					continue;
+				CEntity *foundE = ::TestSphereAgainstSectorList(query, GetSector(curX, curY)->GetQueryLists()[l], sphere, entityToIgnore,
+				                                              ignoreSomeObjects && (l == ENTITYLIST_OBJECTS || l == ENTITYLIST_OBJECTS_OVERLAP));
+				if(foundE) return foundE;
+			}
+	return nil;
+}
+#endif
+
 float
 CWorld::FindGroundZForCoord(float x, float y)
 {
 	CColPoint point;
 	CEntity *ent;
+#ifdef GROUND_HEIGHT_FIELD
+	float groundZ;
+	bool found;
+	if(CGroundHeights::FindGroundZ(x, y, 1000.0f, groundZ, found)) {
+		// dummies aren't in the field, they can still be on top
+		if(ProcessVerticalLine(CVector(x, y, 1000.0f), found ? groundZ : -1000.0f, point, ent, false, false, false, false, true, false,
+		                       nil))
+			return point.point.z;
+		return found ? groundZ : 20.0f;
+	}
+#endif
 	if(ProcessVerticalLine(CVector(x, y, 1000.0f), -1000.0f, point, ent, true, false, false, false, true, false,
 	                       nil))
 		return point.point.z;
@@ -992,6 +1726,14 @@ CWorld::FindGroundZFor3DCoord(float x, float y, float z, bool *found)
 {
 	CColPoint point;
 	CEntity *ent;
+#ifdef GROUND_HEIGHT_FIELD
+	float groundZ;
+	bool fieldFound;
+	if(CGroundHeights::FindGroundZ(x, y, z, groundZ, fieldFound)) {
+		if(found) *found = fieldFound;
+		return fieldFound ? groundZ : 0.0f;
+	}
+#endif
 	if(ProcessVerticalLine(CVector(x, y, z), -1000.0f, point, ent, true, false, false, false, false, false, nil)) {
 		if(found) *found = true;
 		return point.point.z;
@@ -1021,26 +1763,20 @@ CWorld::FindRoofZFor3DCoord(float x, float y, float z, bool *found)
 void
 CWorld::RemoveReferencesToDeletedObject(CEntity *pDeletedObject)
 {
-	int32 i = CPools::GetPedPool()->GetSize();
-	while(--i >= 0) {
-		CPed *pPed = CPools::GetPedPool()->GetSlot(i);
-		if(pPed && pPed != pDeletedObject) {
+	for(CPed *pPed : *CPools::GetPedPool()) {
+		if(pPed != pDeletedObject) {
 			pPed->RemoveRefsToEntity(pDeletedObject);
 			if(pPed->m_pCurrentPhysSurface == pDeletedObject) pPed->m_pCurrentPhysSurface = nil;
 		}
 	}
-	i = CPools::GetVehiclePool()->GetSize();
-	while(--i >= 0) {
-		CVehicle *pVehicle = CPools::GetVehiclePool()->GetSlot(i);
-		if(pVehicle && pVehicle != pDeletedObject) {
+	for(CVehicle *pVehicle : *CPools::GetVehiclePool()) {
+		if(pVehicle != pDeletedObject) {
 			pVehicle->RemoveRefsToEntity(pDeletedObject);
 			pVehicle->RemoveRefsToVehicle(pDeletedObject);
 		}
 	}
-	i = CPools::GetObjectPool()->GetSize();
-	while(--i >= 0) {
-		CObject *pObject = CPools::GetObjectPool()->GetSlot(i);
-		if(pObject && pObject != pDeletedObject) { pObject->RemoveRefsToEntity(pDeletedObject); }
+	for(CObject *pObject : *CPools::GetObjectPool()) {
+		if(pObject != pDeletedObject) { pObject->RemoveRefsToEntity(pDeletedObject); }
 	}
 }
 
@@ -1778,6 +2514,10 @@ CWorld::ShutDown(void)
 			sprintf(gString, "Dummy overlap list %d,%d not empty\n", i % NUMSECTORS_X, i / NUMSECTORS_Y);
 			pSector->m_lists[ENTITYLIST_DUMMIES_OVERLAP].Flush();
 		}
+#ifdef PACKED_SECTOR_LISTS
+		for(int l = 0; l < NUMSECTORENTITYLISTS; l++)
+			pSector->m_arrays[l].Flush();
+#endif
 	}
 	ms_listMovingEntityPtrs.Flush();
 }
@@ -1911,9 +2651,98 @@ CWorld::RemoveStaticObjects()
 		pSector->m_lists[ENTITYLIST_BUILDINGS_OVERLAP].Flush();
 		pSector->m_lists[ENTITYLIST_DUMMIES].Flush();
 		pSector->m_lists[ENTITYLIST_DUMMIES_OVERLAP].Flush();
+#ifdef PACKED_SECTOR_LISTS
+		pSector->m_arrays[ENTITYLIST_BUILDINGS].Flush();
+		pSector->m_arrays[ENTITYLIST_BUILDINGS_OVERLAP].Flush();
+		pSector->m_arrays[ENTITYLIST_DUMMIES].Flush();
+		pSector->m_arrays[ENTITYLIST_DUMMIES_OVERLAP].Flush();
+#endif
 	}
 }
 
+#ifdef PARALLEL_WORLD_PROCESS
+struct tAnimUpdateJob
+{
+	CEntity *entity;
+	float timeDelta;
+	float relSpeed;
+};
+
+#define ANIM_UPDATE_CHUNK_SIZE 8
+
+static tAnimUpdateJob aAnimUpdateJobs[NUMPEDS + NUMVEHICLES + NUMOBJECTS];
+static int32 nNumAnimUpdateJobs;
+
+static void
+UpdateAnimFramesJob(int32 start, int32 end, void *arg)
+{
+	for(int32 i = start; i < end; i++)
+		aAnimUpdateJobs[i].relSpeed = RpAnimBlendClumpUpdateFrames(aAnimUpdateJobs[i].entity->GetClump());
+}
+
+// Frames of the queued clumps on the worker threads, then their times in list order
+static void
+FlushAnimUpdateJobs(void)
+{
+	CWorkerPool::ParallelFor(nNumAnimUpdateJobs, ANIM_UPDATE_CHUNK_SIZE, UpdateAnimFramesJob, nil);
+	for(int32 i = 0; i < nNumAnimUpdateJobs; i++)
+		RpAnimBlendClumpUpdateTimes(aAnimUpdateJobs[i].entity->GetClump(), aAnimUpdateJobs[i].timeDelta, aAnimUpdateJobs[i].relSpeed);
+	nNumAnimUpdateJobs = 0;
+}
+
+// Same as the first loop of CWorld::Process. Clumps whose update can't call back
+// into game code are queued after their blend update, and the queue is flushed
+// before anything that can: a clump with callbacks due is updated on its own,
+// in its place in the list, once the ones before it are done. Callbacks thus
+// run in the same order and see the same state as in the serial loop, and the
+// clumps of the queue can't be changed or removed until they're finished.
+void
+CWorld::ProcessAnimationsParallel(void)
+{
+	for(CPtrNode *node = ms_listMovingEntityPtrs.first; node; node = node->next) {
+		CEntity *movingEnt = (CEntity *)node->item;
+#ifdef SQUEEZE_PERFORMANCE
+		if (movingEnt->bRemoveFromWorld) {
+			FlushAnimUpdateJobs();
+			RemoveEntityInsteadOfProcessingIt(movingEnt);
+		} else
+#endif
+		if(movingEnt->m_rwObject && RwObjectGetType(movingEnt->m_rwObject) == rpCLUMP &&
+		   RpAnimBlendClumpGetFirstAssociation(movingEnt->GetClump())) {
+			float timeDelta = 0.02f * (movingEnt->IsObject()
+			                               ? CTimer::GetTimeStepNonClipped()
+			                               : CTimer::GetTimeStep());
+			if(RpAnimBlendClumpCanUpdateWithoutCallbacks(movingEnt->GetClump(), timeDelta)) {
+				if(nNumAnimUpdateJobs == (int32)ARRAY_SIZE(aAnimUpdateJobs))
+					FlushAnimUpdateJobs();
+				RpAnimBlendClumpUpdateBlends(movingEnt->GetClump(), timeDelta);
+				aAnimUpdateJobs[nNumAnimUpdateJobs].entity = movingEnt;
+				aAnimUpdateJobs[nNumAnimUpdateJobs].timeDelta = timeDelta;
+				nNumAnimUpdateJobs++;
+			} else {
+				FlushAnimUpdateJobs();
+				RpAnimBlendClumpUpdateAnimations(movingEnt->GetClump(), timeDelta);
+			}
+		}
+	}
+	FlushAnimUpdateJobs();
+}
+#endif
+
+// Whether a collision pass of CWorld::Process has to do movingEnt, sleeping ones are left out
+static bool
+NeedsCollisionPass(CEntity *movingEnt, int32 pass)
+{
+	if(movingEnt->bIsInSafePosition)
+		return false;
+#ifdef SLEEPING_ISLANDS
+	if(((CPhysical*)movingEnt)->bIsSleeping)
+		return false;
+	CCollisionIslands::ms_aNumProcessed[pass]++;
+#endif
+	return true;
+}
+
 void
 CWorld::Process(void)
 {
@@ -1939,6 +2768,11 @@ CWorld::Process(void)
 		CRecordDataForChase::ProcessControlCars();
 		CRecordDataForChase::SaveOrRetrieveCarPositions();
 	} else {
+#ifdef PARALLEL_WORLD_PROCESS
+		if(bParallelProcess)
+			ProcessAnimationsParallel();
+		else
+#endif
 		for(CPtrNode *node = ms_listMovingEntityPtrs.first; node; node = node->next) {
 			CEntity *movingEnt = (CEntity *)node->item;
 #ifdef SQUEEZE_PERFORMANCE
@@ -1984,20 +2818,32 @@ CWorld::Process(void)
 				movingEnt->UpdateRwFrame();
 			}
 		} else {
+#ifdef TIMEBARS
+			tbStartTimer(0, "Collision");
+#endif
+#ifdef COLLISION_BROADPHASE
+			CBroadphase::Update();
+#endif
+#ifdef SLEEPING_ISLANDS
+			CCollisionIslands::BeginFrame();
+#endif
 			bNoMoreCollisionTorque = false;
 			for(CPtrNode *node = ms_listMovingEntityPtrs.first; node; node = node->next) {
 				CEntity *movingEnt = (CEntity *)node->item;
-				if(!movingEnt->bIsInSafePosition) {
+				if(NeedsCollisionPass(movingEnt, COLLISIONPASS_FIRST)) {
 					movingEnt->ProcessCollision();
 					movingEnt->GetMatrix().UpdateRW();
 					movingEnt->UpdateRwFrame();
 				}
 			}
+#ifdef SLEEPING_ISLANDS
+			CCollisionIslands::PutRestingIslandsToSleep();
+#endif
 			bNoMoreCollisionTorque = true;
 			for(int i = 0; i < 4; i++) {
 				for(CPtrNode *node = ms_listMovingEntityPtrs.first; node; node = node->next) {
 					CEntity *movingEnt = (CEntity *)node->item;
-					if(!movingEnt->bIsInSafePosition) {
+					if(NeedsCollisionPass(movingEnt, COLLISIONPASS_RETRY1 + i)) {
 						movingEnt->ProcessCollision();
 						movingEnt->GetMatrix().UpdateRW();
 						movingEnt->UpdateRwFrame();
@@ -2006,7 +2852,7 @@ CWorld::Process(void)
 			}
 			for(CPtrNode *node = ms_listMovingEntityPtrs.first; node; node = node->next) {
 				CEntity *movingEnt = (CEntity *)node->item;
-				if(!movingEnt->bIsInSafePosition) {
+				if(NeedsCollisionPass(movingEnt, COLLISIONPASS_STUCK)) {
 					movingEnt->bIsStuck = true;
 					movingEnt->ProcessCollision();
 					movingEnt->GetMatrix().UpdateRW();
@@ -2017,7 +2863,7 @@ CWorld::Process(void)
 			bSecondShift = false;
 			for(CPtrNode *node = ms_listMovingEntityPtrs.first; node; node = node->next) {
 				CEntity *movingEnt = (CEntity *)node->item;
-				if(!movingEnt->bIsInSafePosition) {
+				if(NeedsCollisionPass(movingEnt, COLLISIONPASS_SHIFT)) {
 					movingEnt->ProcessShift();
 					movingEnt->GetMatrix().UpdateRW();
 					movingEnt->UpdateRwFrame();
@@ -2027,7 +2873,7 @@ CWorld::Process(void)
 			bSecondShift = true;
 			for(CPtrNode *node = ms_listMovingEntityPtrs.first; node; node = node->next) {
 				CPhysical *movingEnt = (CPhysical *)node->item;
-				if(!movingEnt->bIsInSafePosition) {
+				if(NeedsCollisionPass(movingEnt, COLLISIONPASS_SECOND_SHIFT)) {
 					movingEnt->ProcessShift();
 					movingEnt->GetMatrix().UpdateRW();
 					movingEnt->UpdateRwFrame();
@@ -2042,6 +2888,12 @@ CWorld::Process(void)
 					}
 				}
 			}
+#ifdef COLLISION_BROADPHASE
+			CBroadphase::EndPasses();
+#endif
+#ifdef TIMEBARS
+			tbEndTimer("Collision");
+#endif
 		}
 		for(CPtrNode *node = ms_listMovingEntityPtrs.first; node; node = node->next) {
 			CPed *movingPed = (CPed *)node->item;
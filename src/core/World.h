@@ -44,11 +44,22 @@ class CSector
 {
 public:
 	CPtrList m_lists[NUMSECTORENTITYLISTS];
+#ifdef PACKED_SECTOR_LISTS
+	CSectorArray m_arrays[NUMSECTORENTITYLISTS];
+
+	CSectorArray &GetArray(CPtrList *list) { return m_arrays[list - m_lists]; }
+	CSectorArray *GetQueryLists(void) { return m_arrays; }
+#else
+	CPtrList *GetQueryLists(void) { return m_lists; }
+#endif
 };
 
+#ifndef PACKED_SECTOR_LISTS
 VALIDATE_SIZE(CSector, 0x28);
+#endif
 
 class CEntity;
+class CWorldQuery;
 struct CColPoint;
 struct CColLine;
 struct CStoredCollPoly;
@@ -92,18 +103,29 @@ public:
 
 	static bool ProcessLineOfSight(const CVector &point1, const CVector &point2, CColPoint &point, CEntity *&entity, bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies, bool ignoreSeeThrough, bool ignoreSomeObjects = false);
 	static bool ProcessLineOfSightSector(CSector &sector, const CColLine &line, CColPoint &point, float &dist, CEntity *&entity, bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies, bool ignoreSeeThrough, bool ignoreSomeObjects = false);
-	static bool ProcessLineOfSightSectorList(CPtrList &list, const CColLine &line, CColPoint &point, float &dist, CEntity *&entity, bool ignoreSeeThrough, bool ignoreSomeObjects = false);
+	static bool ProcessLineOfSightSectorList(CSectorQueryList &list, const CColLine &line, CColPoint &point, float &dist, CEntity *&entity, bool ignoreSeeThrough, bool ignoreSomeObjects = false);
 	static bool ProcessVerticalLine(const CVector &point1, float z2, CColPoint &point, CEntity *&entity, bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies, bool ignoreSeeThrough, CStoredCollPoly *poly);
 	static bool ProcessVerticalLineSector(CSector &sector, const CColLine &line, CColPoint &point, CEntity *&entity, bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies, bool ignoreSeeThrough, CStoredCollPoly *poly);
-	static bool ProcessVerticalLineSectorList(CPtrList &list, const CColLine &line, CColPoint &point, float &dist, CEntity *&entity, bool ignoreSeeThrough, CStoredCollPoly *poly);
+	static bool ProcessVerticalLineSectorList(CSectorQueryList &list, const CColLine &line, CColPoint &point, float &dist, CEntity *&entity, bool ignoreSeeThrough, CStoredCollPoly *poly);
+#ifdef LINE_OF_SIGHT_BATCHES
+	static int32 ProcessLineOfSightBatch(int32 numLines, const CColLine *lines, CColPoint *points, CEntity **entities, bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies, bool ignoreSeeThrough, bool ignoreSomeObjects = false);
+	static int32 ProcessVerticalLineBatch(int32 numLines, const CColLine *lines, CColPoint *points, CEntity **entities, bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies, bool ignoreSeeThrough);
+#endif
 	static bool GetIsLineOfSightClear(const CVector &point1, const CVector &point2, bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies, bool ignoreSeeThrough, bool ignoreSomeObjects = false);
 	static bool GetIsLineOfSightSectorClear(CSector &sector, const CColLine &line, bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies, bool ignoreSeeThrough, bool ignoreSomeObjects = false);
-	static bool GetIsLineOfSightSectorListClear(CPtrList &list, const CColLine &line, bool ignoreSeeThrough, bool ignoreSomeObjects = false);
+	static bool GetIsLineOfSightSectorListClear(CSectorQueryList &list, const CColLine &line, bool ignoreSeeThrough, bool ignoreSomeObjects = false);
 	
 	static CEntity *TestSphereAgainstWorld(CVector centre, float radius, CEntity *entityToIgnore, bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies, bool ignoreSomeObjects);
-	static CEntity *TestSphereAgainstSectorList(CPtrList&, CVector, float, CEntity*, bool);
-	static void FindObjectsInRangeSectorList(CPtrList &list, Const CVector &centre, float radius, bool ignoreZ, int16 *numObjects, int16 lastObject, CEntity **objects);
+	static CEntity *TestSphereAgainstSectorList(CSectorQueryList&, CVector, float, CEntity*, bool);
+	static void FindObjectsInRangeSectorList(CSectorQueryList &list, Const CVector &centre, float radius, bool ignoreZ, int16 *numObjects, int16 lastObject, CEntity **objects);
 	static void FindObjectsInRange(Const CVector &centre, float radius, bool ignoreZ, int16 *numObjects, int16 lastObject, CEntity **objects, bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies);
+#ifdef CONCURRENT_WORLD_QUERIES
+	// same as the ones above, but with the scan codes and options in query, so they can run on other threads
+	static bool ProcessLineOfSight(CWorldQuery &query, const CVector &point1, const CVector &point2, CColPoint &point, CEntity *&entity, bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies, bool ignoreSeeThrough, bool ignoreSomeObjects = false);
+	static bool GetIsLineOfSightClear(CWorldQuery &query, const CVector &point1, const CVector &point2, bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies, bool ignoreSeeThrough, bool ignoreSomeObjects = false);
+	static CEntity *TestSphereAgainstWorld(CWorldQuery &query, const CVector &centre, float radius, CEntity *entityToIgnore, bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies, bool ignoreSomeObjects);
+	static void FindObjectsInRange(CWorldQuery &query, const CVector &centre, float radius, bool ignoreZ, int16 *numObjects, int16 lastObject, CEntity **objects, bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies);
+#endif
 	static void FindObjectsOfTypeInRangeSectorList(uint32 modelId, CPtrList& list, const CVector& position, float radius, bool bCheck2DOnly, int16* nEntitiesFound, int16 maxEntitiesToFind, CEntity** aEntities);
 	static void FindObjectsOfTypeInRange(uint32 modelId, const CVector& position, float radius, bool bCheck2DOnly, int16* nEntitiesFound, int16 maxEntitiesToFind, CEntity** aEntities, bool bBuildings, bool bVehicles, bool bPeds, bool bObjects, bool bDummies);
 	static float FindGroundZForCoord(float x, float y);
@@ -150,9 +172,21 @@ public:
 	static void RepositionOneObject(CEntity* pEntity);
 	static void RemoveStaticObjects();
 	static void Process();
+#ifdef PARALLEL_WORLD_PROCESS
+	static bool bParallelProcess;
+	static void ProcessAnimationsParallel();
+#endif
 	static void TriggerExplosion(const CVector& position, float fRadius, float fPower, CEntity* pCreator, bool bProcessVehicleBombTimer);
 	static void TriggerExplosionSectorList(CPtrList& list, const CVector& position, float fRadius, float fPower, CEntity* pCreator, bool bProcessVehicleBombTimer);
 	static void UseDetonator(CEntity *pEntity);
+
+#ifdef PACKED_SECTOR_LISTS
+	static void UpdateSectorArrayBounds(CEntity *entity);
+	static void UpdateSectorArrayBounds(CEntity *entity, const CRect &oldBounds);
+#ifndef MASTER
+	static void BenchmarkSectorLists(void);
+#endif
+#endif
 };
 
 extern CColPoint gaTempSphereColPoints[MAX_COLLISION_POINTS];
@@ -0,0 +1,261 @@
+#include "common.h"
+
+#ifdef WORLD_CACHE
+#include "FileMgr.h"
+#include "WorldCache.h"
+
+#define WORLDCACHE_FILE "DATA\\worldcache.dat"
+#define WORLDCACHE_VERSION 1	// bump when the records of CFileLoader change
+
+enum
+{
+	MAX_CACHED_FILES = 64,
+	MAX_CACHED_FILENAME = 64
+};
+
+struct tWorldCacheHeader
+{
+	char ident[4];
+	int32 version;
+	int32 numFiles;
+};
+
+struct tWorldCacheFile
+{
+	char name[MAX_CACHED_FILENAME];
+	uint32 textHash;
+	int32 size;	// bytes of records that follow
+};
+
+struct tWorldCacheRecord
+{
+	uint16 type;
+	uint16 size;	// of the data that follows, a multiple of 4
+};
+
+struct tWorldCacheEntry
+{
+	char name[MAX_CACHED_FILENAME];
+	uint32 textHash;
+	uint8 *data;
+	int32 size;
+	int32 capacity;	// 0 while data points into the file
+};
+
+int32 CWorldCache::ms_nNumReplayed;
+int32 CWorldCache::ms_nNumParsed;
+
+static uint8 *pFileData;
+static tWorldCacheEntry aEntries[MAX_CACHED_FILES];
+static int32 nNumEntries;
+static bool bLoaded;
+static bool bDirty;
+static tWorldCacheEntry *pCurrent;
+static bool bRecording;
+static int32 nReplayPos;
+
+// Every record has to be within the file and as big as its type says
+static bool
+CheckRecords(tWorldCacheEntry *entry, const int32 *recordSizes, int32 numRecordTypes)
+{
+	int32 pos;
+	tWorldCacheRecord *rec;
+
+	for(pos = 0; pos < entry->size; pos += sizeof(tWorldCacheRecord) + rec->size){
+		if(pos + (int32)sizeof(tWorldCacheRecord) > entry->size)
+			return false;
+		rec = (tWorldCacheRecord*)&entry->data[pos];
+		if(rec->type >= numRecordTypes || rec->size != ((recordSizes[rec->type] + 3) & ~3) ||
+		   pos + (int32)sizeof(tWorldCacheRecord) + rec->size > entry->size)
+			return false;
+	}
+	return true;
+}
+
+static uint32
+HashText(const char *text, int32 len)
+{
+	int32 i;
+	uint32 hash = 2166136261u;
+	for(i = 0; i < len; i++)
+		hash = (hash ^ (uint8)text[i]) * 16777619u;
+	return hash;
+}
+
+void
+CWorldCache::Load(void)
+{
+	int fd;
+	int32 i, len, pos;
+	tWorldCacheHeader *header;
+	tWorldCacheFile *file;
+
+	bLoaded = true;
+	fd = CFileMgr::OpenFile(WORLDCACHE_FILE, "rb");
+	if(fd == 0)
+		return;
+	len = CFileMgr::GetFileLength(fd);
+	pFileData = new uint8[Max(len, 1)];
+	len = CFileMgr::Read(fd, (char*)pFileData, len);
+	CFileMgr::CloseFile(fd);
+
+	header = (tWorldCacheHeader*)pFileData;
+	if(len < (int32)sizeof(tWorldCacheHeader) ||
+	   strncmp(header->ident, "WRLD", 4) != 0 ||
+	   header->version != WORLDCACHE_VERSION ||
+	   header->numFiles < 0 || header->numFiles > MAX_CACHED_FILES)
+		return;
+	pos = sizeof(tWorldCacheHeader);
+	for(i = 0; i < header->numFiles; i++){
+		file = (tWorldCacheFile*)&pFileData[pos];
+		pos += sizeof(tWorldCacheFile);
+		if(pos > len || file->size < 0 || file->size > len - pos){
+			nNumEntries = 0;
+			return;
+		}
+		strncpy(aEntries[i].name, file->name, MAX_CACHED_FILENAME-1);
+		aEntries[i].textHash = file->textHash;
+		aEntries[i].data = &pFileData[pos];
+		aEntries[i].size = file->size;
+		aEntries[i].capacity = 0;
+		pos += file->size;
+	}
+	nNumEntries = header->numFiles;
+	debug("Loaded %d files from %s\n", nNumEntries, WORLDCACHE_FILE);
+}
+
+void
+CWorldCache::Save(void)
+{
+	int fd;
+	int32 i;
+	tWorldCacheHeader header;
+	tWorldCacheFile file;
+
+	debug("World cache: %d files replayed, %d parsed\n", ms_nNumReplayed, ms_nNumParsed);
+	if(!bDirty)
+		return;
+	bDirty = false;
+
+	fd = CFileMgr::OpenFileForWriting(WORLDCACHE_FILE);
+	if(fd == 0)
+		return;
+	memcpy(header.ident, "WRLD", 4);
+	header.version = WORLDCACHE_VERSION;
+	header.numFiles = nNumEntries;
+	CFileMgr::Write(fd, (char*)&header, sizeof(header));
+	for(i = 0; i < nNumEntries; i++){
+		memset(&file, 0, sizeof(file));
+		strncpy(file.name, aEntries[i].name, MAX_CACHED_FILENAME-1);
+		file.textHash = aEntries[i].textHash;
+		file.size = aEntries[i].size;
+		CFileMgr::Write(fd, (char*)&file, sizeof(file));
+		CFileMgr::Write(fd, (char*)aEntries[i].data, aEntries[i].size);
+	}
+	CFileMgr::CloseFile(fd);
+}
+
+void
+CWorldCache::Shutdown(void)
+{
+	int32 i;
+	for(i = 0; i < nNumEntries; i++)
+		if(aEntries[i].capacity)
+			free(aEntries[i].data);
+	nNumEntries = 0;
+	delete[] pFileData;
+	pFileData = nil;
+	pCurrent = nil;
+	bRecording = false;
+	bLoaded = false;
+	bDirty = false;
+}
+
+bool
+CWorldCache::Begin(const char *filename, const char *text, int32 len, const int32 *recordSizes, int32 numRecordTypes)
+{
+	int32 i;
+	uint32 textHash;
+
+	if(!bLoaded)
+		Load();
+	textHash = HashText(text, len);
+	for(i = 0; i < nNumEntries; i++)
+		if(strcmp(aEntries[i].name, filename) == 0)
+			break;
+	if(i < nNumEntries && aEntries[i].textHash == textHash &&
+	   CheckRecords(&aEntries[i], recordSizes, numRecordTypes)){
+		pCurrent = &aEntries[i];
+		nReplayPos = 0;
+		bRecording = false;
+		ms_nNumReplayed++;
+		return true;
+	}
+
+	// parse the text and record what comes out of it
+	ms_nNumParsed++;
+	if(i == MAX_CACHED_FILES || strlen(filename) >= MAX_CACHED_FILENAME){
+		pCurrent = nil;
+		return false;
+	}
+	if(i == nNumEntries){
+		nNumEntries++;
+		strcpy(aEntries[i].name, filename);
+		aEntries[i].capacity = 0;
+	}
+	if(aEntries[i].capacity == 0)
+		aEntries[i].data = nil;
+	aEntries[i].textHash = textHash;
+	aEntries[i].size = 0;
+	pCurrent = &aEntries[i];
+	bRecording = true;
+	return false;
+}
+
+void
+CWorldCache::Record(int32 type, const void *data, int32 size)
+{
+	tWorldCacheRecord rec;
+	int32 needed;
+
+	if(!bRecording)
+		return;
+	rec.type = type;
+	rec.size = (size + 3) & ~3;
+	needed = pCurrent->size + sizeof(rec) + rec.size;
+	if(needed > pCurrent->capacity){
+		pCurrent->capacity = Max(needed, pCurrent->capacity*2);
+		pCurrent->data = (uint8*)realloc(pCurrent->data, pCurrent->capacity);
+	}
+	memcpy(&pCurrent->data[pCurrent->size], &rec, sizeof(rec));
+	memset(&pCurrent->data[pCurrent->size + sizeof(rec)], 0, rec.size);
+	memcpy(&pCurrent->data[pCurrent->size + sizeof(rec)], data, size);
+	pCurrent->size = needed;
+}
+
+bool
+CWorldCache::GetRecord(int32 *type, void **data)
+{
+	tWorldCacheRecord *rec;
+
+	if(pCurrent == nil || bRecording || nReplayPos + (int32)sizeof(tWorldCacheRecord) > pCurrent->size)
+		return false;
+	rec = (tWorldCacheRecord*)&pCurrent->data[nReplayPos];
+	// Begin checked them all, but don't run off the end whatever happens
+	if(nReplayPos + (int32)sizeof(tWorldCacheRecord) + rec->size > pCurrent->size)
+		return false;
+	*type = rec->type;
+	*data = &pCurrent->data[nReplayPos + sizeof(tWorldCacheRecord)];
+	nReplayPos += sizeof(tWorldCacheRecord) + rec->size;
+	return true;
+}
+
+void
+CWorldCache::End(void)
+{
+	if(bRecording)
+		bDirty = true;
+	pCurrent = nil;
+	bRecording = false;
+}
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+
+// What CFileLoader parsed out of the IDE, IPL and zone files, kept in
+// DATA\worldcache.dat. Each file has the hash of its text and the records of its
+// lines in the order they were read. While the text hashes the same and all the
+// records have the size of their type, the loader replays the records through
+// the same calls instead of parsing it again.
+// The whole cache is read at once with the first file and written back after
+// the level when a file had to be parsed.
+
+class CWorldCache
+{
+public:
+	static int32 ms_nNumReplayed;
+	static int32 ms_nNumParsed;
+
+	static void Load(void);
+	static void Save(void);
+	static void Shutdown(void);
+	// true if the records can be replayed, recordSizes has the size of every record type
+	static bool Begin(const char *filename, const char *text, int32 len, const int32 *recordSizes, int32 numRecordTypes);
+	static void Record(int32 type, const void *data, int32 size);
+	static bool GetRecord(int32 *type, void **data);
+	static void End(void);
+};
@@ -0,0 +1,148 @@
+#include "common.h"
+
+#ifdef CONCURRENT_WORLD_QUERIES
+#include "Building.h"
+#include "Dummy.h"
+#include "ModelInfo.h"
+#include "Object.h"
+#include "Ped.h"
+#include "Pools.h"
+#include "RwHelper.h"
+#include "TempColModels.h"
+#include "Treadable.h"
+#include "Vehicle.h"
+#include "WorldQuery.h"
+
+CWorldQuery::CWorldQuery(void)
+{
+	m_nGeneration = 0;
+	memset(m_aStamps, 0, sizeof(m_aStamps));
+	m_nNumUnpooled = 0;
+	m_pedColModel.ownsCollisionVolumes = false;
+	pIgnoreEntity = nil;
+	bIncludeDeadPeds = false;
+#ifdef COLLISION_BVH
+	pBVHTriangles = new int32[COLBVH_MAX_TRIANGLES];
+#else
+	pBVHTriangles = nil;
+#endif
+}
+
+CWorldQuery::~CWorldQuery(void)
+{
+	delete[] pBVHTriangles;
+}
+
+CWorldQuery&
+CWorldQuery::ForThisThread(void)
+{
+	// made the first time a thread asks and kept, the threads that run queries live as long as the game
+	static thread_local CWorldQuery *query;
+	if(query == nil)
+		query = new CWorldQuery;
+	return *query;
+}
+
+int32
+CWorldQuery::GetSlot(CEntity *e)
+{
+	int32 slot;
+	switch(e->GetType()){
+	case ENTITY_TYPE_BUILDING:
+		// buildings and treadables have the same type but their own pools
+		slot = CPools::GetBuildingPool()->GetJustIndex((CBuilding*)e);
+		if(slot >= 0 && slot < NUMBUILDINGS)
+			return slot;
+		slot = CPools::GetTreadablePool()->GetJustIndex((CTreadable*)e);
+		return slot >= 0 && slot < NUMTREADABLES ? NUMBUILDINGS + slot : -1;
+	case ENTITY_TYPE_VEHICLE:
+		slot = CPools::GetVehiclePool()->GetJustIndex((CVehicle*)e);
+		return slot >= 0 && slot < NUMVEHICLES ? NUMBUILDINGS + NUMTREADABLES + slot : -1;
+	case ENTITY_TYPE_PED:
+		slot = CPools::GetPedPool()->GetJustIndex((CPed*)e);
+		return slot >= 0 && slot < NUMPEDS ? NUMBUILDINGS + NUMTREADABLES + NUMVEHICLES + slot : -1;
+	case ENTITY_TYPE_OBJECT:
+		slot = CPools::GetObjectPool()->GetJustIndex((CObject*)e);
+		return slot >= 0 && slot < NUMOBJECTS ? NUMBUILDINGS + NUMTREADABLES + NUMVEHICLES + NUMPEDS + slot : -1;
+	case ENTITY_TYPE_DUMMY:
+		slot = CPools::GetDummyPool()->GetJustIndex((CDummy*)e);
+		return slot >= 0 && slot < NUMDUMMIES ? NUMBUILDINGS + NUMTREADABLES + NUMVEHICLES + NUMPEDS + NUMOBJECTS + slot : -1;
+	default:
+		return -1;
+	}
+}
+
+void
+CWorldQuery::Begin(void)
+{
+	if(++m_nGeneration == 0){
+		memset(m_aStamps, 0, sizeof(m_aStamps));
+		m_nGeneration = 1;
+	}
+	m_nNumUnpooled = 0;
+}
+
+// The query's replacement for comparing and setting m_scanCode
+bool
+CWorldQuery::FirstVisit(CEntity *e)
+{
+	int32 slot = GetSlot(e);
+	if(slot < 0){
+		for(int32 i = 0; i < m_nNumUnpooled; i++)
+			if(m_apUnpooled[i] == e)
+				return false;
+		if(m_nNumUnpooled < MAXUNPOOLEDENTITIES)
+			m_apUnpooled[m_nNumUnpooled++] = e;
+		return true;
+	}
+	int32 word = slot >> 5;
+	uint32 bit = 1u << (slot & 31);
+	if(m_aStamps[word] != m_nGeneration){
+		m_aStamps[word] = m_nGeneration;
+		m_aBits[word] = 0;
+	}
+	if(m_aBits[word] & bit)
+		return false;
+	m_aBits[word] |= bit;
+	return true;
+}
+
+CColModel*
+CWorldQuery::AnimatePedColModel(CPed *ped)
+{
+	CPedModelInfo *mi = (CPedModelInfo*)CModelInfo::GetModelInfo(ped->GetModelIndex());
+	if(!mi->AnimatePedColSpheres(ped->GetClump(), m_aPedSpheres))
+		return nil;
+	CColModel *hitColModel = mi->GetHitColModel();
+	m_pedColModel.boundingSphere = hitColModel->boundingSphere;
+	m_pedColModel.boundingBox = hitColModel->boundingBox;
+	m_pedColModel.level = hitColModel->level;
+	m_pedColModel.spheres = m_aPedSpheres;
+	m_pedColModel.numSpheres = NUMPEDINFONODES;
+	return &m_pedColModel;
+}
+
+// Like GetLineOfSightColModel in World.cpp, but peds are animated into the query's own col model
+CColModel*
+CWorldQuery::GetLineOfSightColModel(CEntity *e, bool deadPeds)
+{
+	if(e->IsPed()) {
+		CPed *ped = (CPed*)e;
+		if(e->bUsesCollision || deadPeds && ped->m_nPedState == PED_DEAD) {
+#ifdef PED_SKIN
+			if(IsClumpSkinned(e->GetClump()))
+				return AnimatePedColModel(ped);
+#endif
+			if(ped->UseGroundColModel())
+				return &CTempColModels::ms_colModelPedGroundHit;
+#ifdef ANIMATE_PED_COL_MODEL
+			return AnimatePedColModel(ped);
+#else
+			return ((CPedModelInfo *)CModelInfo::GetModelInfo(e->GetModelIndex()))->GetHitColModel();
+#endif
+		}
+	} else if(e->bUsesCollision)
+		return CModelInfo::GetModelInfo(e->GetModelIndex())->GetColModel();
+	return nil;
+}
+#endif
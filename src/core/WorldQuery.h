@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Collision.h"
+#include "PedModelInfo.h"
+
+class CEntity;
+class CPed;
+
+// Everything the CWorld query variants that take a CWorldQuery would otherwise keep
+// in shared state: which entities were seen already (instead of the scan codes),
+// the options that are CWorld globals for the normal queries and scratch space
+// for the collision tests. Each thread needs its own, the world must not change
+// while queries run on other threads than the main one.
+class CWorldQuery
+{
+	enum {
+		NUMQUERYSLOTS = NUMBUILDINGS + NUMTREADABLES + NUMVEHICLES + NUMPEDS + NUMOBJECTS + NUMDUMMIES,
+		NUMQUERYWORDS = (NUMQUERYSLOTS + 31) / 32,
+		MAXUNPOOLEDENTITIES = 16
+	};
+
+	// a word of bits is only valid when its stamp is the current generation,
+	// so starting a query doesn't have to clear anything
+	uint32 m_nGeneration;
+	uint32 m_aStamps[NUMQUERYWORDS];
+	uint32 m_aBits[NUMQUERYWORDS];
+	// not from a pool, shouldn't happen
+	CEntity *m_apUnpooled[MAXUNPOOLEDENTITIES];
+	int32 m_nNumUnpooled;
+
+	CColModel m_pedColModel;
+	CColSphere m_aPedSpheres[NUMPEDINFONODES];
+
+	static int32 GetSlot(CEntity *e);
+	CColModel *AnimatePedColModel(CPed *ped);
+public:
+	CEntity *pIgnoreEntity;	// CWorld::pIgnoreEntity
+	bool bIncludeDeadPeds;	// CWorld::bIncludeDeadPeds
+	int32 *pBVHTriangles;
+
+	CWorldQuery(void);
+	~CWorldQuery(void);
+	// One for every thread that calls it, so the main thread, the CWorkerPool
+	// workers and any other thread never share one. Set the options before
+	// using it, they're left as the last query had them.
+	static CWorldQuery &ForThisThread(void);
+	void Begin(void);
+	bool FirstVisit(CEntity *e);
+	CColModel *GetLineOfSightColModel(CEntity *e, bool deadPeds);
+};
@@ -133,6 +133,9 @@ enum Config {
 	NUM_CRANES = 8,
 
 	NUM_EXPLOSIONS = 48,
+
+	MAX_WORKERTHREADS = 7,
+	MAX_BATCHED_LINES = 16,
 };
 
 // We'll use this once we're ready to become independent of the game
@@ -300,6 +303,43 @@ enum Config {
 //#define PS2_AUDIO   // changes audio paths for cutscenes and radio to PS2 paths, needs vbdec to support VB with MSS
 
 
+// Performance
+#define PARALLEL_WORLD_PROCESS	// update entity animations in CWorld::Process on worker threads
+#define PACKED_SECTOR_LISTS	// spatial queries walk packed per-sector arrays with cached building bounds
+#define LINE_OF_SIGHT_BATCHES	// CWorld::ProcessLineOfSightBatch and ProcessVerticalLineBatch
+#ifndef VU_COLLISION
+#define SIMD_COLLISION	// SSE/NEON culling and transforms in CCollision::ProcessColModels
+#define COLLISION_BVH	// AABB trees for col models with many triangles
+#define CONCURRENT_WORLD_QUERIES	// CWorld queries that keep their state in a CWorldQuery so worker threads can run them
+#endif
+#define GROUND_HEIGHT_FIELD	// baked building heights for CWorld::FindGroundZForCoord and FindGroundZFor3DCoord, 8 MB of cells kept in memory and cached in groundz.dat in the user files folder
+#ifdef PACKED_SECTOR_LISTS
+#define COLLISION_BROADPHASE	// sweep and prune candidate lists for the collision passes of CWorld::Process
+#endif
+#define SLEEPING_ISLANDS	// resting groups of entities skip the collision retries and shifts
+#define HASHED_NAME_LOOKUPS	// CDirectory::FindItem and CModelInfo::GetModelInfo(name) use hash tables instead of scanning
+#define SORTED_REQUEST_QUEUE	// CStreaming finds the next file to read in bitmaps sorted by CD position instead of walking the requested list
+#define STREAMING_PREFETCH	// CStreaming requests the models along the predicted route of fast players
+#define STREAMING_FINALIZE_QUEUE	// streamed files are queued so their channel can read on, and converted on the main thread within a time budget per frame
+#define COST_AWARE_EVICTION	// CStreaming::RemoveLeastUsedModel weighs size, reload time, use and distance (GDSF) instead of plain LRU
+#define WORLD_CACHE	// CFileLoader reads the IDE, IPL and zone files whole and replays what it parsed from data\worldcache.dat while they're unchanged
+#define PARALLEL_INIT	// CGame::Initialise prepares the path data and bakes the ground heights on init threads, the loaders stay serial, and prints where startup time goes
+#define PARALLEL_RENDER_LIST	// CRenderer::ScanWorld works out distances, LODs and frustum tests of the entities on worker threads
+//#define OCCLUSION_CULLING	// big buildings in front of the camera are drawn into a small CPU depth buffer, what is behind them is left out. Not checked in game yet, so opt-in; the debug menu switches it off and shows the buffer and the culled count
+#define INSTANCED_RENDERING	// buildings that share a geometry are drawn with one instanced draw per material, librw GL3 only
+#define SORTED_RENDER_QUEUE	// CRenderer::RenderEverythingBarRoads draws opaque entities sorted by pipeline, TXD, model and distance instead of in scan order
+#define SORTED_ALPHA_ARRAYS	// CVisibilityPlugins appends alpha atomics and entities to growable arrays and radix sorts them once before drawing
+#ifndef _WIN32
+#define PARALLEL_CD_READS	// CdStreamPosix has the reads of all channels in flight at once, with io_uring if the kernel has it
+#define NUM_STREAMING_CHANNELS (4)	// CdStream channels CStreaming reads with, 2 originally, at most MAX_CDCHANNELS
+#define MAPPED_CD_IMAGES	// -mmapimg maps the images on local disks and CStreaming loads straight out of them
+#define CASEPATH_CACHE	// casepath keeps the listings of the directories it reads instead of scanning them for every file
+#endif
+#if !defined LIBRW || !defined RW_GL3 || defined RW_GLES2
+#undef INSTANCED_RENDERING	// needs GL 3.3
+#endif
+
+
 //#define SQUEEZE_PERFORMANCE
 #ifdef SQUEEZE_PERFORMANCE
 	#undef PS2_ALPHA_TEST
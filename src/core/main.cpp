@@ -64,6 +64,8 @@
 #include "debugmenu.h"
 #include "Clock.h"
 #include "custompipes.h"
+#include "OcclusionBuffer.h"
+#include "instancing.h"
 
 GlobalScene Scene;
 
@@ -407,6 +409,9 @@ Initialise3D(void *param)
 		bool ret = CGame::InitialiseRenderWare();
 #ifdef EXTENDED_PIPELINES
 		CustomPipes::CustomPipeInit();	// need Scene.world for this
+#endif
+#ifdef INSTANCED_RENDERING
+		CInstancing::Init();
 #endif
 		return ret;
 	}
@@ -417,6 +422,9 @@ Initialise3D(void *param)
 static void 
 Terminate3D(void)
 {
+#ifdef INSTANCED_RENDERING
+	CInstancing::Shutdown();
+#endif
 #ifdef EXTENDED_PIPELINES
 	CustomPipes::CustomPipeShutdown();
 #endif
@@ -955,6 +963,11 @@ Render2dStuff(void)
 		CSprite2d::DrawRect(CRect(SCREEN_WIDTH / 2 + SCREEN_SCALE_X(210), 0.0f, SCREEN_WIDTH, SCREEN_HEIGHT), black);
 	}
 
+#ifdef OCCLUSION_CULLING
+	if(COcclusionBuffer::bShowBuffer)
+		COcclusionBuffer::DrawDebug();
+#endif
+
 	MusicManager.DisplayRadioStationName();
 	TheConsole.Display();
 	if(CSceneEdit::m_bEditOn)
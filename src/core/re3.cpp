@@ -3,14 +3,25 @@
 #include "common.h"
 #include "crossplatform.h"
 #include "Renderer.h"
+#include "OcclusionBuffer.h"
+#include "instancing.h"
+#include "VisibilityPlugins.h"
 #include "Credits.h"
 #include "Camera.h"
 #include "Weather.h"
 #include "Clock.h"
 #include "World.h"
+#include "Broadphase.h"
+#include "Collision.h"
+#include "CollisionIslands.h"
+#include "GroundHeights.h"
 #include "Vehicle.h"
 #include "ModelIndices.h"
 #include "Streaming.h"
+#include "CdStream.h"
+#include "StreamingPrefetch.h"
+#include "StreamingFinalizeQueue.h"
+#include "StreamingEviction.h"
 #include "PathFind.h"
 #include "Boat.h"
 #include "Heli.h"
@@ -733,6 +744,79 @@ DebugMenuPopulate(void)
 		DebugMenuAddCmd("Debug", "Stop Credits", CCredits::Stop);
 
 		DebugMenuAddVarBool8("Debug", "Show DebugStuffInRelease", &gbDebugStuffInRelease, nil);
+#ifdef PARALLEL_WORLD_PROCESS
+		DebugMenuAddVarBool8("Debug", "Parallel world process", &CWorld::bParallelProcess, nil);
+#endif
+#ifdef PARALLEL_RENDER_LIST
+		DebugMenuAddVarBool8("Debug", "Parallel render list", &CRenderer::ms_bParallelScan, nil);
+#endif
+#ifdef OCCLUSION_CULLING
+		DebugMenuAddVarBool8("Debug", "Occlusion culling", &COcclusionBuffer::bUseOcclusion, nil);
+		DebugMenuAddVarBool8("Debug", "Show occlusion buffer", &COcclusionBuffer::bShowBuffer, nil);
+		DebugMenuAddVar("Debug", "Occluders", &COcclusionBuffer::ms_nNumOccluders, nil, 1, 0, 0x7FFFFFFF, nil);
+		DebugMenuAddVar("Debug", "Occlusion culled entities", &COcclusionBuffer::ms_nNumCulled, nil, 1, 0, 0x7FFFFFFF, nil);
+#endif
+#ifdef INSTANCED_RENDERING
+		DebugMenuAddVarBool8("Debug", "Instanced rendering", &CInstancing::bEnabled, nil);
+		DebugMenuAddVar("Debug", "Instanced batches", &CInstancing::ms_nNumBatches, nil, 1, 0, 0x7FFFFFFF, nil);
+		DebugMenuAddVar("Debug", "Instanced buildings", &CInstancing::ms_nNumInstanced, nil, 1, 0, 0x7FFFFFFF, nil);
+		DebugMenuAddCmd("Debug", "Check instanced rendering", CInstancing::Check);
+#endif
+#ifdef SORTED_RENDER_QUEUE
+		DebugMenuAddVarBool8("Debug", "Sort opaque render list", &CRenderer::ms_bSortRenderQueue, nil);
+		DebugMenuAddVar("Debug", "State changes in scan order", &CRenderer::ms_nStateChangesUnsorted, nil, 1, 0, 0x7FFFFFFF, nil);
+		DebugMenuAddVar("Debug", "State changes sorted", &CRenderer::ms_nStateChangesSorted, nil, 1, 0, 0x7FFFFFFF, nil);
+#endif
+#ifdef SORTED_ALPHA_ARRAYS
+		DebugMenuAddVar("Debug", "Alpha list overflows", &CVisibilityPlugins::ms_nAlphaListOverflows, nil, 1, 0, 0x7FFFFFFF, nil);
+#endif
+#ifdef PACKED_SECTOR_LISTS
+		DebugMenuAddCmd("Debug", "Benchmark sector lists", CWorld::BenchmarkSectorLists);
+#endif
+#ifdef SIMD_COLLISION
+		DebugMenuAddVarBool8("Debug", "SIMD collision", &CCollision::bUseSimd, nil);
+		DebugMenuAddCmd("Debug", "Check SIMD collision", CCollision::CheckSimdCollision);
+#endif
+#if defined COLLISION_BVH && !defined MASTER
+		DebugMenuAddCmd("Debug", "Report col BVH memory", CCollision::ReportBVHMemory);
+#endif
+#ifdef GROUND_HEIGHT_FIELD
+		DebugMenuAddVarBool8("Debug", "Ground height field", &CGroundHeights::bUseField, nil);
+		DebugMenuAddCmd("Debug", "Check ground heights", CGroundHeights::CheckGroundHeights);
+#endif
+#ifdef COLLISION_BROADPHASE
+		DebugMenuAddVarBool8("Debug", "Collision broadphase", &CBroadphase::bUseBroadphase, nil);
+		DebugMenuAddVar("Debug", "Broadphase pairs", &CBroadphase::ms_nNumPairs, nil, 1, 0, 0x7FFFFFFF, nil);
+#endif
+#ifdef SLEEPING_ISLANDS
+		DebugMenuAddVarBool8("Debug", "Sleeping islands", &CCollisionIslands::bUseIslands, nil);
+		DebugMenuAddVar("Debug", "Sleeping entities", &CCollisionIslands::ms_nNumSleeping, nil, 1, 0, 0x7FFFFFFF, nil);
+		{
+			static const char *passNames[NUM_COLLISIONPASSES] = {
+				"Processed collision", "Processed retry 1", "Processed retry 2", "Processed retry 3",
+				"Processed retry 4", "Processed stuck", "Processed shift", "Processed 2nd shift"
+			};
+			for(int i = 0; i < NUM_COLLISIONPASSES; i++)
+				DebugMenuAddVar("Debug", passNames[i], &CCollisionIslands::ms_aNumProcessed[i], nil, 1, 0, 0x7FFFFFFF, nil);
+		}
+#endif
+#ifdef PARALLEL_CD_READS
+		DebugMenuAddCmd("Debug", "Dump CdStream stats", CdStreamDumpStats);
+#endif
+#ifdef STREAMING_PREFETCH
+		DebugMenuAddVarBool8("Debug", "Streaming prefetch", &CStreamingPrefetch::bUsePrefetch, nil);
+		DebugMenuAddCmd("Debug", "Dump prefetch stats", CStreamingPrefetch::DumpStats);
+#endif
+#ifdef STREAMING_FINALIZE_QUEUE
+		DebugMenuAddVar("Debug", "Streaming finalize budget (ms)", &CStreamingFinalizeQueue::ms_nFinalizeBudget, nil, 1, 1, 33, nil);
+		DebugMenuAddCmd("Debug", "Dump finalize queue stats", CStreamingFinalizeQueue::DumpStats);
+#endif
+#ifdef COST_AWARE_EVICTION
+		DebugMenuAddVar("Debug", "Eviction policy", &CStreamingEviction::ms_nPolicy, nil, 1, 0, NUM_EVICTION_POLICIES-1, CStreamingEviction::ms_apPolicyNames);
+		DebugMenuAddVar("Debug", "Eviction thrash window (s)", &CStreamingEviction::ms_nThrashWindow, nil, 1, 1, 60, nil);
+		DebugMenuAddCmd("Debug", "Reset eviction stats", CStreamingEviction::ResetStats);
+		DebugMenuAddCmd("Debug", "Dump eviction stats", CStreamingEviction::DumpStats);
+#endif
 #ifdef TIMEBARS
 		DebugMenuAddVarBool8("Debug", "Show Timebars", &gbShowTimebars, nil);
 #endif
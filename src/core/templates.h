@@ -41,19 +41,73 @@ class CPool
 			uint8 u;
 	}     *m_flags;
 	int    m_size;
-	int    m_allocPtr;
+	// indices of the used slots, so iterating over them is cheap
+	int   *m_slots;
+	int   *m_slotPos;	// where each used slot is in m_slots
+	int    m_numUsed;
+	// the free slots in the order they were freed, New takes the oldest one
+	// like the old round robin scan did, so a slot isn't reused right away
+	int   *m_freeNext;
+	int   *m_freePrev;
+	int    m_freeHead;
+	int    m_freeTail;
+
+	void LinkFree(int i){
+		m_freeNext[i] = -1;
+		m_freePrev[i] = m_freeTail;
+		if(m_freeTail >= 0)
+			m_freeNext[m_freeTail] = i;
+		else
+			m_freeHead = i;
+		m_freeTail = i;
+	}
+	void UnlinkFree(int i){
+		if(m_freePrev[i] >= 0)
+			m_freeNext[m_freePrev[i]] = m_freeNext[i];
+		else
+			m_freeHead = m_freeNext[i];
+		if(m_freeNext[i] >= 0)
+			m_freePrev[m_freeNext[i]] = m_freePrev[i];
+		else
+			m_freeTail = m_freePrev[i];
+	}
+	// after the flags were changed behind our back
+	void RebuildSlots(void){
+		m_numUsed = 0;
+		m_freeHead = -1;
+		m_freeTail = -1;
+		for(int i = 0; i < m_size; i++)
+			if(m_flags[i].free)
+				LinkFree(i);
+			else{
+				m_slotPos[i] = m_numUsed;
+				m_slots[m_numUsed++] = i;
+			}
+	}
+	void MarkUsed(int i){
+		if(m_flags[i].free){
+			m_flags[i].free = 0;
+			UnlinkFree(i);
+			m_slotPos[i] = m_numUsed;
+			m_slots[m_numUsed++] = i;
+		}
+	}
 
 public:
 	CPool(int size){
 		// TODO: use new here
 		m_entries = (U*)malloc(sizeof(U)*size);
 		m_flags = (Flags*)malloc(sizeof(Flags)*size);
+		m_slots = (int*)malloc(sizeof(int)*size);
+		m_slotPos = (int*)malloc(sizeof(int)*size);
+		m_freeNext = (int*)malloc(sizeof(int)*size);
+		m_freePrev = (int*)malloc(sizeof(int)*size);
 		m_size = size;
-		m_allocPtr = 0;
 		for(int i = 0; i < size; i++){
 			m_flags[i].id   = 0;
 			m_flags[i].free = 1;
 		}
+		RebuildSlots();
 	}
 
 	~CPool() {
@@ -63,35 +117,30 @@ public:
 		if (m_size > 0) {
 			free(m_entries);
 			free(m_flags);
+			free(m_slots);
+			free(m_slotPos);
+			free(m_freeNext);
+			free(m_freePrev);
 			m_entries = nil;
 			m_flags = nil;
+			m_slots = nil;
+			m_slotPos = nil;
+			m_freeNext = nil;
+			m_freePrev = nil;
 			m_size = 0;
-			m_allocPtr = 0;
+			m_numUsed = 0;
+			m_freeHead = -1;
+			m_freeTail = -1;
 		}
 	}
 	int GetSize(void) const { return m_size; }
 	T *New(void){
-		bool wrapped = false;
-		do
-#ifdef FIX_BUGS
-			if (++m_allocPtr >= m_size) {
-				m_allocPtr = 0;
-				if (wrapped)
-					return nil;
-				wrapped = true;
-			}
-#else
-			if(++m_allocPtr == m_size){
-				if(wrapped)
-					return nil;
-				wrapped = true;
-				m_allocPtr = 0;
-			}
-#endif
-		while(!m_flags[m_allocPtr].free);
-		m_flags[m_allocPtr].free = 0;
-		m_flags[m_allocPtr].id++;
-		return (T*)&m_entries[m_allocPtr];
+		if(m_freeHead < 0)
+			return nil;
+		int i = m_freeHead;
+		MarkUsed(i);
+		m_flags[i].id++;
+		return (T*)&m_entries[i];
 	}
 	T *New(int handle){
 		T *entry = (T*)&m_entries[handle>>8];
@@ -100,17 +149,19 @@ public:
 	}
 	void SetNotFreeAt(int handle){
 		int idx = handle>>8;
-		m_flags[idx].free = 0;
+		MarkUsed(idx);
 		m_flags[idx].id = handle & 0x7F;
-		for(m_allocPtr = 0; m_allocPtr < m_size; m_allocPtr++)
-			if(m_flags[m_allocPtr].free)
-				return;
 	}
 	void Delete(T *entry){
 		int i = GetJustIndex(entry);
+		if(m_flags[i].free)
+			return;
 		m_flags[i].free = 1;
-		if(i < m_allocPtr)
-			m_allocPtr = i;
+		// move the last used slot into the hole
+		int last = m_slots[--m_numUsed];
+		m_slots[m_slotPos[i]] = last;
+		m_slotPos[last] = m_slotPos[i];
+		LinkFree(i);
 	}
 	T *GetSlot(int i){
 		return m_flags[i].free ? nil : (T*)&m_entries[i];
@@ -132,12 +183,7 @@ public:
 		return (int)((U*)entry - m_entries);
 	}
 	int GetNoOfUsedSpaces(void) const{
-		int i;
-		int n = 0;
-		for(i = 0; i < m_size; i++)
-			if(!m_flags[i].free)
-				n++;
-		return n;
+		return m_numUsed;
 	}
 	bool IsFreeSlot(int i) { return !!m_flags[i].free; }
 	void ClearStorage(uint8 *&flags, U *&entries){
@@ -151,7 +197,7 @@ public:
 		memcpy(m_flags, flags, sizeof(uint8)*m_size);
 		memcpy(m_entries, entries, sizeof(U)*m_size);
 		debug("Size copied:%d (%d)\n", sizeof(U)*m_size, sizeof(Flags)*m_size);
-		m_allocPtr = 0;
+		RebuildSlots();
 		ClearStorage(flags, entries);
 		debug("CopyBack:%d (/%d)\n", GetNoOfUsedSpaces(), m_size); /* Assumed inlining */
 	}
@@ -162,6 +208,38 @@ public:
 		memcpy(entries, m_entries, sizeof(U)*m_size);
 		debug("Stored:%d (/%d)\n", GetNoOfUsedSpaces(), m_size); /* Assumed inlining */
 	}
+
+	// Used entries, for(CPed *ped : *CPools::GetPedPool()). Goes from the last one
+	// to the first, so the current entry may be deleted and new ones are skipped.
+	// Deleting any other entry would move a visited one to where we haven't been yet.
+	class Iterator
+	{
+		CPool *m_pool;
+		int m_pos;	// one past the current entry in m_slots
+		int m_slot;	// the current entry
+		int m_numUsed;	// m_pool->m_numUsed when we got to it
+
+		void Enter(void){
+			if(m_pos > 0){
+				m_slot = m_pool->m_slots[m_pos-1];
+				m_numUsed = m_pool->m_numUsed;
+			}
+		}
+	public:
+		Iterator(CPool *pool, int pos) : m_pool(pool), m_pos(pos), m_slot(-1), m_numUsed(0) { Enter(); }
+		T *operator*(void) const { return (T*)&m_pool->m_entries[m_slot]; }
+		Iterator &operator++(void){
+			assert(m_pool->m_numUsed >= m_numUsed - (m_pool->m_flags[m_slot].free ? 1 : 0));
+			m_pos--;
+			if(m_pos > m_pool->m_numUsed)
+				m_pos = m_pool->m_numUsed;
+			Enter();
+			return *this;
+		}
+		bool operator!=(const Iterator &it) const { return m_pos != it.m_pos; }
+	};
+	Iterator begin(void) { return Iterator(this, m_numUsed); }
+	Iterator end(void) { return Iterator(this, 0); }
 };
 
 template<typename T>
@@ -6,6 +6,7 @@
 #include "Text.h"
 
 #define MAX_TIMERS (50)
+#define MAX_COUNTERS (10)
 #define MAX_MS_COLLECTED (40)
 
 // enables frame time output
@@ -19,10 +20,18 @@ struct sTimeBar
 	int32 unk;
 };
 
+struct sTimeBarCounter
+{
+	char name[24];
+	int32 value;
+};
+
 struct
 {
 	sTimeBar Timers[MAX_TIMERS];
 	uint32 count;
+	sTimeBarCounter Counters[MAX_COUNTERS];
+	uint32 numCounters;
 } TimerBar;
 float MaxTimes[MAX_TIMERS];
 float MaxFrameTime;
@@ -36,6 +45,7 @@ float FrameInitTime;
 void tbInit()
 {
 	TimerBar.count = 0;
+	TimerBar.numCounters = 0;
 	uint32 i = CTimer::GetFrameCounter() & 0x7F;
 	if (i == 0) {
 		do
@@ -69,6 +79,23 @@ void tbEndTimer(char* name)
 	TimerBar.Timers[n].endTime = (float)CTimer::GetCurrentTimeInCycles() / (float)CTimer::GetCyclesPerFrame();
 }
 
+// Adds up per frame what is passed under the same name
+void tbCount(char *name, int32 value)
+{
+	uint32 i;
+	for (i = 0; i < TimerBar.numCounters; i++) {
+		if (strcmp(name, TimerBar.Counters[i].name) == 0) {
+			TimerBar.Counters[i].value += value;
+			return;
+		}
+	}
+	if (TimerBar.numCounters == MAX_COUNTERS)
+		return;
+	strncpy(TimerBar.Counters[i].name, name, sizeof(TimerBar.Counters[i].name)-1);
+	TimerBar.Counters[i].value = value;
+	TimerBar.numCounters++;
+}
+
 float Diag_GetFPS()
 {
 	return 39000.0f / (msCollected[(curMS - 1) % MAX_MS_COLLECTED] - msCollected[curMS % MAX_MS_COLLECTED]);
@@ -115,6 +142,12 @@ void tbDisplay()
 
 		CFont::PrintString(RsGlobal.maximumWidth * (4.0f / DEFAULT_SCREEN_WIDTH), RsGlobal.maximumHeight * ((8.0f * (TimerBar.count + 4)) / DEFAULT_SCREEN_HEIGHT), wtemp);
 #endif // FRAMETIME
+
+		for (uint32 i = 0; i < TimerBar.numCounters; i++) {
+			sprintf(temp, "%s: %d", &TimerBar.Counters[i].name[0], TimerBar.Counters[i].value);
+			AsciiToUnicode(temp, wtemp);
+			CFont::PrintString(RsGlobal.maximumWidth * (4.0f / DEFAULT_SCREEN_WIDTH), RsGlobal.maximumHeight * ((8.0f * (TimerBar.count + 6 + i)) / DEFAULT_SCREEN_HEIGHT), wtemp);
+		}
 #endif // !FINAL
 	}
 }
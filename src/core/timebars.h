@@ -3,4 +3,5 @@
 void tbInit();
 void tbStartTimer(int32, char*);
 void tbEndTimer(char*);
+void tbCount(char*, int32);
 void tbDisplay();
\ No newline at end of file
@@ -1,8 +1,10 @@
 #include "common.h"
 
 #include "Building.h"
+#include "GroundHeights.h"
 #include "Streaming.h"
 #include "Pools.h"
+#include "World.h"
 
 void *CBuilding::operator new(size_t sz) { return CPools::GetBuildingPool()->New();  }
 void CBuilding::operator delete(void *p, size_t sz) { CPools::GetBuildingPool()->Delete((CBuilding*)p); }
@@ -12,9 +14,22 @@ CBuilding::ReplaceWithNewModel(int32 id)
 {
 	DeleteRwObject();
 
+#ifdef PACKED_SECTOR_LISTS
+	CRect oldBounds = GetBoundRect();
+#endif
+#ifdef GROUND_HEIGHT_FIELD
+	CGroundHeights::InvalidateArea(GetBoundRect());
+#endif
 	if (CModelInfo::GetModelInfo(m_modelIndex)->GetNumRefs() == 0)
 		CStreaming::RemoveModel(m_modelIndex);
 	m_modelIndex = id;
+#ifdef GROUND_HEIGHT_FIELD
+	CGroundHeights::InvalidateArea(GetBoundRect());
+#endif
+#ifdef PACKED_SECTOR_LISTS
+	// the cached bounds are those of the old col model
+	CWorld::UpdateSectorArrayBounds(this, oldBounds);
+#endif
 
 	if(bIsBIGBuilding)
 		if(m_level == LEVEL_GENERIC || m_level == CGame::currLevel)
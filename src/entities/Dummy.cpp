@@ -37,6 +37,9 @@ CDummy::Add(void)
 			CPtrNode *node = list->InsertItem(this);
 			assert(node);
 			m_entryInfoList.InsertItem(list, node, s);
+#ifdef PACKED_SECTOR_LISTS
+			s->GetArray(list).Add(this);
+#endif
 		}
 }
 
@@ -47,6 +50,9 @@ CDummy::Remove(void)
 	for(node = m_entryInfoList.first; node; node = next){
 		next = node->next;
 		node->list->DeleteNode(node->listnode);
+#ifdef PACKED_SECTOR_LISTS
+		node->sector->GetArray(node->list).Remove(this);
+#endif
 		m_entryInfoList.DeleteNode(node);
 	}
 }
@@ -205,6 +205,9 @@ CEntity::Add(void)
 				break;
 			}
 			list->InsertItem(this);
+#ifdef PACKED_SECTOR_LISTS
+			s->GetArray(list).Add(this);
+#endif
 		}
 }
 
@@ -265,6 +268,9 @@ CEntity::Remove(void)
 				break;
 			}
 			list->RemoveItem(this);
+#ifdef PACKED_SECTOR_LISTS
+			s->GetArray(list).Remove(this);
+#endif
 		}
 }
 
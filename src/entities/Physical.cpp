@@ -15,8 +15,16 @@
 #include "CarCtrl.h"
 #include "DMAudio.h"
 #include "Automobile.h"
+#include "Broadphase.h"
+#include "CollisionIslands.h"
 #include "Physical.h"
 
+#ifdef COLLISION_BROADPHASE
+#define SECTOR_QUERY_LIST(type) (movingLists && (type) >= ENTITYLIST_OBJECTS ? &movingLists[type] : &lists[type])
+#else
+#define SECTOR_QUERY_LIST(type) (&lists[type])
+#endif
+
 CPhysical::CPhysical(void)
 {
 	int i;
@@ -64,7 +72,11 @@ CPhysical::CPhysical(void)
 	m_treadable[PATH_CAR] = nil;
 	m_treadable[PATH_PED] = nil;
 
+#ifdef SLEEPING_ISLANDS
+	bIsSleeping = false;
+#else
 	m_phy_flagA10 = false;
+#endif
 	m_phy_flagA20 = false;
 
 #ifdef FIX_BUGS
@@ -129,7 +141,13 @@ CPhysical::Add(void)
 			CPtrNode *node = list->InsertItem(this);
 			assert(node);
 			m_entryInfoList.InsertItem(list, node, s);
+#ifdef PACKED_SECTOR_LISTS
+			s->GetArray(list).Add(this);
+#endif
 		}
+#ifdef COLLISION_BROADPHASE
+	CBroadphase::Invalidate();
+#endif
 }
 
 void
@@ -139,8 +157,14 @@ CPhysical::Remove(void)
 	for(node = m_entryInfoList.first; node; node = next){
 		next = node->next;
 		node->list->DeleteNode(node->listnode);
+#ifdef PACKED_SECTOR_LISTS
+		node->sector->GetArray(node->list).Remove(this);
+#endif
 		m_entryInfoList.DeleteNode(node);
 	}
+#ifdef COLLISION_BROADPHASE
+	CBroadphase::Remove(this);
+#endif
 }
 
 void
@@ -194,12 +218,21 @@ CPhysical::RemoveAndAdd(void)
 				// If we still have old nodes, use them
 				next->list->RemoveNode(next->listnode);
 				list->InsertNode(next->listnode);
+#ifdef PACKED_SECTOR_LISTS
+				if(next->list != list){
+					next->sector->GetArray(next->list).Remove(this);
+					s->GetArray(list).Add(this);
+				}
+#endif
 				next->list = list;
 				next->sector = s;
 				next = next->next;
 			}else{
 				CPtrNode *node = list->InsertItem(this);
 				m_entryInfoList.InsertItem(list, node, s);
+#ifdef PACKED_SECTOR_LISTS
+				s->GetArray(list).Add(this);
+#endif
 			}
 		}
 
@@ -208,6 +241,9 @@ CPhysical::RemoveAndAdd(void)
 	for(node = next; node; node = next){
 		next = node->next;
 		node->list->DeleteNode(node->listnode);
+#ifdef PACKED_SECTOR_LISTS
+		node->sector->GetArray(node->list).Remove(this);
+#endif
 		m_entryInfoList.DeleteNode(node);
 	}
 }
@@ -253,6 +289,9 @@ CPhysical::AddCollisionRecord(CEntity *ent)
 	AddCollisionRecord_Treadable(ent);
 	this->bHasCollided = true;
 	ent->bHasCollided = true;
+#ifdef SLEEPING_ISLANDS
+	CCollisionIslands::AddContact(this, ent);
+#endif
 	if(IsVehicle() && ent->IsVehicle()){
 		if(((CVehicle*)this)->m_nAlarmState == -1)
 			((CVehicle*)this)->m_nAlarmState = 15000;
@@ -1038,11 +1077,17 @@ CPhysical::ApplyFriction(float adhesiveLimit, CColPoint &colpoint)
 }
 
 bool
-CPhysical::ProcessShiftSectorList(CPtrList *lists)
+#ifdef COLLISION_BROADPHASE
+CPhysical::ProcessShiftSectorList(CSectorQueryList *lists, CSectorQueryList *movingLists)
+#else
+CPhysical::ProcessShiftSectorList(CSectorQueryList *lists)
+#endif
 {
 	int i, j;
-	CPtrList *list;
+	CSectorQueryList *list;
+#ifndef PACKED_SECTOR_LISTS
 	CPtrNode *node;
+#endif
 	CPhysical *A, *B;
 	CObject *Bobj;
 	bool canshift;
@@ -1063,9 +1108,24 @@ CPhysical::ProcessShiftSectorList(CPtrList *lists)
 	A->GetBoundCentre(center);
 	radius = A->GetBoundRadius();
 	for(i = 0; i <= ENTITYLIST_PEDS_OVERLAP; i++){
-		list = &lists[i];
+		list = SECTOR_QUERY_LIST(i);
+#ifdef PACKED_SECTOR_LISTS
+		for(int32 k = list->num - 1; k >= 0; k--){
+			if(k >= list->num)
+				continue;	// entries were removed while shifting
+			CSectorArrayEntry &entry = list->entries[k];
+			if(entry.bStaticBounds &&
+			   !(SQR(entry.boundRadius + radius) > (entry.boundCentre - center).MagnitudeSqr()))
+				continue;
+			B = (CPhysical*)entry.entity;
+#ifdef COLLISION_BROADPHASE
+			if(B == nil)
+				continue;	// removed from the world during the passes
+#endif
+#else
 		for(node = list->first; node; node = node->next){
 			B = (CPhysical*)node->item;
+#endif
 			Bobj = (CObject*)B;
 			skipShift = false;
 
@@ -1198,7 +1258,11 @@ CPhysical::ProcessShiftSectorList(CPtrList *lists)
 }
 
 bool
-CPhysical::ProcessCollisionSectorList_SimpleCar(CPtrList *lists)
+#ifdef COLLISION_BROADPHASE
+CPhysical::ProcessCollisionSectorList_SimpleCar(CSectorQueryList *lists, CSectorQueryList *movingLists)
+#else
+CPhysical::ProcessCollisionSectorList_SimpleCar(CSectorQueryList *lists)
+#endif
 {
 	static CColPoint aColPoints[MAX_COLLISION_POINTS];
 	float radius;
@@ -1217,18 +1281,27 @@ CPhysical::ProcessCollisionSectorList_SimpleCar(CPtrList *lists)
 
 	for(listtype = 3; listtype >= 0; listtype--){
 		// Go through vehicles and objects
-		CPtrList *list;
+		CSectorQueryList *list;
 		switch(listtype){
-		case 0:	list = &lists[ENTITYLIST_VEHICLES]; break;
-		case 1:	list = &lists[ENTITYLIST_VEHICLES_OVERLAP]; break;
-		case 2:	list = &lists[ENTITYLIST_OBJECTS]; break;
-		case 3:	list = &lists[ENTITYLIST_OBJECTS_OVERLAP]; break;
+		case 0:	list = SECTOR_QUERY_LIST(ENTITYLIST_VEHICLES); break;
+		case 1:	list = SECTOR_QUERY_LIST(ENTITYLIST_VEHICLES_OVERLAP); break;
+		case 2:	list = SECTOR_QUERY_LIST(ENTITYLIST_OBJECTS); break;
+		case 3:	list = SECTOR_QUERY_LIST(ENTITYLIST_OBJECTS_OVERLAP); break;
 		}
 
 		// Find first collision in list
+#ifdef PACKED_SECTOR_LISTS
+		for(int32 k = list->num - 1; k >= 0; k--){
+			B = (CPhysical*)list->entries[k].entity;
+#ifdef COLLISION_BROADPHASE
+			if(B == nil)
+				continue;	// removed from the world during the passes
+#endif
+#else
 		CPtrNode *listnode;
 		for(listnode = list->first; listnode; listnode = listnode->next){
 			B = (CPhysical*)listnode->item;
+#endif
 			if(B != A &&
 			   B->m_scanCode != CWorld::GetCurrentScanCode() &&
 			   B->bUsesCollision &&
@@ -1360,12 +1433,16 @@ collision:
 }
 
 bool
-CPhysical::ProcessCollisionSectorList(CPtrList *lists)
+#ifdef COLLISION_BROADPHASE
+CPhysical::ProcessCollisionSectorList(CSectorQueryList *lists, CSectorQueryList *movingLists)
+#else
+CPhysical::ProcessCollisionSectorList(CSectorQueryList *lists)
+#endif
 {
 	static CColPoint aColPoints[MAX_COLLISION_POINTS];
 	float radius;
 	CVector center;
-	CPtrList *list;
+	CSectorQueryList *list;
 	CPhysical *A, *B;
 	CObject *Aobj, *Bobj;
 	CPed *Aped, *Bped;
@@ -1384,11 +1461,30 @@ CPhysical::ProcessCollisionSectorList(CPtrList *lists)
 	A->GetBoundCentre(center);
 
 	for(j = 0; j <= ENTITYLIST_PEDS_OVERLAP; j++){
-		list = &lists[j];
-
+		list = SECTOR_QUERY_LIST(j);
+
+#ifdef PACKED_SECTOR_LISTS
+		for(int32 k = list->num - 1; k >= 0; k--){
+			if(k >= list->num)
+				continue;	// entries were removed by a collision response
+			CSectorArrayEntry &entry = list->entries[k];
+			B = (CPhysical*)entry.entity;
+#ifdef COLLISION_BROADPHASE
+			if(B == nil)
+				continue;	// removed from the world during the passes
+#endif
+			// buildings we can't touch are skipped without loading them,
+			// unless the code below has to reset A's colliding entity
+			if(entry.bStaticBounds &&
+			   !(SQR(entry.boundRadius + radius) > (entry.boundCentre - center).MagnitudeSqr()) &&
+			   !(A->IsObject() && Aobj->m_pCollidingEntity == B) &&
+			   !(A->IsPed() && Aped->m_pCollidingEntity == B))
+				continue;
+#else
 		CPtrNode *listnode;
 		for(listnode = list->first; listnode; listnode = listnode->next){
 			B = (CPhysical*)listnode->item;
+#endif
 			Bobj = (CObject*)B;
 			Bped = (CPed*)B;
 
@@ -1737,6 +1833,20 @@ CPhysical::ProcessCollisionSectorList(CPtrList *lists)
 	return false;
 }
 
+#ifdef COLLISION_BROADPHASE
+static CSectorQueryList aNoCandidates[NUMSECTORENTITYLISTS];
+
+// Buildings come from the sector, the moving entity lists are replaced
+// by the broadphase candidates which are only checked once.
+static CSectorQueryList*
+GetMovingLists(CEntryInfoNode *node, CSectorQueryList *candidates)
+{
+	if(candidates == nil)
+		return nil;
+	return node->prev == nil ? candidates : aNoCandidates;
+}
+#endif
+
 bool
 CPhysical::CheckCollision(void)
 {
@@ -1744,9 +1854,17 @@ CPhysical::CheckCollision(void)
 
 	bCollisionProcessed = false;
 	CWorld::AdvanceCurrentScanCode();
+#ifdef COLLISION_BROADPHASE
+	CSectorQueryList candidates[NUMSECTORENTITYLISTS];
+	bool useCandidates = CBroadphase::GetCandidateLists(this, candidates);
 	for(node = m_entryInfoList.first; node; node = node->next)
-		if(ProcessCollisionSectorList(node->sector->m_lists))
+		if(ProcessCollisionSectorList(node->sector->GetQueryLists(), GetMovingLists(node, useCandidates ? candidates : nil)))
 			return true;
+#else
+	for(node = m_entryInfoList.first; node; node = node->next)
+		if(ProcessCollisionSectorList(node->sector->GetQueryLists()))
+			return true;
+#endif
 	return false;
 }
 
@@ -1757,9 +1875,17 @@ CPhysical::CheckCollision_SimpleCar(void)
 
 	bCollisionProcessed = false;
 	CWorld::AdvanceCurrentScanCode();
+#ifdef COLLISION_BROADPHASE
+	CSectorQueryList candidates[NUMSECTORENTITYLISTS];
+	bool useCandidates = CBroadphase::GetCandidateLists(this, candidates);
+	for(node = m_entryInfoList.first; node; node = node->next)
+		if(ProcessCollisionSectorList_SimpleCar(node->sector->GetQueryLists(), GetMovingLists(node, useCandidates ? candidates : nil)))
+			return true;
+#else
 	for(node = m_entryInfoList.first; node; node = node->next)
-		if(ProcessCollisionSectorList_SimpleCar(node->sector->m_lists))
+		if(ProcessCollisionSectorList_SimpleCar(node->sector->GetQueryLists()))
 			return true;
+#endif
 	return false;
 }
 
@@ -1784,13 +1910,24 @@ CPhysical::ProcessShift(void)
 
 		CEntryInfoNode *node;
 		bool hasshifted = false;
+#ifdef COLLISION_BROADPHASE
+		CSectorQueryList candidates[NUMSECTORENTITYLISTS];
+		bool useCandidates = CBroadphase::GetCandidateLists(this, candidates);
+		for(node = m_entryInfoList.first; node; node = node->next)
+			hasshifted |= ProcessShiftSectorList(node->sector->GetQueryLists(), GetMovingLists(node, useCandidates ? candidates : nil));
+#else
 		for(node = m_entryInfoList.first; node; node = node->next)
-			hasshifted |= ProcessShiftSectorList(node->sector->m_lists);
+			hasshifted |= ProcessShiftSectorList(node->sector->GetQueryLists());
+#endif
 		m_bIsVehicleBeingShifted = false;
 		if(hasshifted){
 			CWorld::AdvanceCurrentScanCode();
 			for(node = m_entryInfoList.first; node; node = node->next)
-				if(ProcessCollisionSectorList(node->sector->m_lists)){
+#ifdef COLLISION_BROADPHASE
+				if(ProcessCollisionSectorList(node->sector->GetQueryLists(), GetMovingLists(node, useCandidates ? candidates : nil))){
+#else
+				if(ProcessCollisionSectorList(node->sector->GetQueryLists())){
+#endif
 					GetMatrix() = matrix;
 					return;
 				}
@@ -55,7 +55,11 @@ public:
 	uint8 bAffectedByGravity : 1;
 	uint8 bInfiniteMass : 1;
 	uint8 bIsInWater : 1;
+#ifdef SLEEPING_ISLANDS
+	uint8 bIsSleeping : 1; // its island rests, only the first collision pass of the frame processes it
+#else
 	uint8 m_phy_flagA10 : 1; // unused
+#endif
 	uint8 m_phy_flagA20 : 1; // unused
 	uint8 bHitByTrain : 1;
 	uint8 bSkipLineCol : 1;
@@ -153,9 +157,16 @@ public:
 	bool ApplyFriction(CPhysical *B, float adhesiveLimit, CColPoint &colpoint);
 	bool ApplyFriction(float adhesiveLimit, CColPoint &colpoint);
 
-	bool ProcessShiftSectorList(CPtrList *ptrlists);
-	bool ProcessCollisionSectorList_SimpleCar(CPtrList *lists);
-	bool ProcessCollisionSectorList(CPtrList *lists);
+#ifdef COLLISION_BROADPHASE
+	// movingLists, if given, replace the object, vehicle and ped lists of the sector
+	bool ProcessShiftSectorList(CSectorQueryList *lists, CSectorQueryList *movingLists = nil);
+	bool ProcessCollisionSectorList_SimpleCar(CSectorQueryList *lists, CSectorQueryList *movingLists = nil);
+	bool ProcessCollisionSectorList(CSectorQueryList *lists, CSectorQueryList *movingLists = nil);
+#else
+	bool ProcessShiftSectorList(CSectorQueryList *lists);
+	bool ProcessCollisionSectorList_SimpleCar(CSectorQueryList *lists);
+	bool ProcessCollisionSectorList(CSectorQueryList *lists);
+#endif
 	bool CheckCollision(void);
 	bool CheckCollision_SimpleCar(void);
 };
@@ -0,0 +1,303 @@
+#include "common.h"
+
+#ifdef INSTANCED_RENDERING
+
+#include "main.h"
+#include "Entity.h"
+#include "Renderer.h"
+#include "instancing.h"
+
+#define MIN_INSTANCES 3	// fewer go the usual way
+#define ATTRIB_INSTANCE 13	// three rows of the world matrix, after librw's attributes
+
+struct tInstanceRows
+{
+	float row[3][4];
+};
+
+bool CInstancing::bEnabled = true;
+int32 CInstancing::ms_nNumBatches;
+int32 CInstancing::ms_nNumInstanced;
+
+static rw::gl3::Shader *instancedShader;
+static GLuint instanceBuffer;
+static CEntity *aBatchEntities[NUMVISIBLEENTITIES];
+static tInstanceRows aInstanceRows[NUMVISIBLEENTITIES];
+static int32 nNumBatchEntities;
+static bool bCheckNextFrame;
+
+void
+CInstancing::Init(void)
+{
+	using namespace rw::gl3;
+
+	// needs GL 3.3, which llvmpipe has as well
+	if(glDrawElementsInstanced == nil || glVertexAttribDivisor == nil)
+		return;
+
+	{
+#include "shaders/simple_fs_gl3.inc"
+#include "shaders/instanced_gl3.inc"
+	const char *vs[] = { shaderDecl, header_vert_src, instanced_vert_src, nil };
+	const char *fs[] = { shaderDecl, header_frag_src, simple_frag_src, nil };
+	instancedShader = Shader::create(vs, fs);
+	}
+	if(instancedShader == nil){
+		printf("Error: couldn't create the instancing shader\n");
+		return;
+	}
+	glGenBuffers(1, &instanceBuffer);
+}
+
+void
+CInstancing::Shutdown(void)
+{
+	if(instancedShader == nil)
+		return;
+	instancedShader->destroy();
+	instancedShader = nil;
+	glDeleteBuffers(1, &instanceBuffer);
+	instanceBuffer = 0;
+}
+
+// Only atomics that librw's default pipeline would draw and that are instanced already
+static bool
+CanInstance(CEntity *ent)
+{
+	if(ent->m_rwObject == nil || RwObjectGetType(ent->m_rwObject) != rpATOMIC)
+		return false;
+	RpAtomic *atomic = (RpAtomic*)ent->m_rwObject;
+	RpAtomicCallBackRender cb = RpAtomicGetRenderCallBack(atomic);
+	if(atomic->pipeline != nil ||
+	   cb != AtomicDefaultRenderCallBack && cb != (RpAtomicCallBackRender)rw::Atomic::defaultRenderCB)
+		return false;
+	rw::Geometry *geo = atomic->geometry;
+	return geo->instData && geo->instData->platform == rw::PLATFORM_GL3 && !geo->lockedSinceInst;
+}
+
+bool
+CInstancing::Add(CEntity *ent)
+{
+	if(!bEnabled || instancedShader == nil || !ent->IsBuilding())
+		return false;
+#ifndef MASTER
+	if(gbShowCollisionPolys || gbDontRenderBuildings || gbDontRenderBigBuildings)
+		return false;
+#endif
+	if(!CanInstance(ent))
+		return false;
+	aBatchEntities[nNumBatchEntities++] = ent;
+	return true;
+}
+
+static rw::Geometry*
+GetGeometry(CEntity *ent)
+{
+	return ((RpAtomic*)ent->m_rwObject)->geometry;
+}
+
+static int
+CompareGeometry(const void *a, const void *b)
+{
+	uintptr ga = (uintptr)GetGeometry(*(CEntity**)a);
+	uintptr gb = (uintptr)GetGeometry(*(CEntity**)b);
+	return ga < gb ? -1 : ga > gb ? 1 : 0;
+}
+
+static void
+DrawInstancesSimple(rw::gl3::InstanceDataHeader *header, rw::gl3::InstanceData *inst, int32 num)
+{
+	rw::gl3::flushCache();
+	glDrawElementsInstanced(header->primType, inst->numIndex, GL_UNSIGNED_SHORT, (void*)(uintptr)inst->offset, num);
+}
+
+// What drawInst does, including the PS2 alpha test emulation of drawInst_GSemu
+static void
+DrawInstances(rw::gl3::InstanceDataHeader *header, rw::gl3::InstanceData *inst, int32 num)
+{
+	using namespace rw;
+
+	Material *m = inst->material;
+	bool hasAlpha = inst->vertexAlpha || m->color.alpha != 0xFF ||
+		m->texture && m->texture->raster && Raster::formatHasAlpha(m->texture->raster->format);
+	if(!GetRenderState(GSALPHATEST) || !hasAlpha){
+		DrawInstancesSimple(header, inst, num);
+		return;
+	}
+
+	uint32 alphafunc = GetRenderState(ALPHATESTFUNC);
+	if(GetRenderState(ZWRITEENABLE)){
+		uint32 alpharef = GetRenderState(ALPHATESTREF);
+		SetRenderState(ALPHATESTFUNC, ALPHAGREATEREQUAL);
+		SetRenderState(ALPHATESTREF, GetRenderState(GSALPHATESTREF));
+		DrawInstancesSimple(header, inst, num);
+		SetRenderState(ALPHATESTFUNC, ALPHALESS);
+		SetRenderState(ZWRITEENABLE, 0);
+		DrawInstancesSimple(header, inst, num);
+		SetRenderState(ZWRITEENABLE, 1);
+		SetRenderState(ALPHATESTREF, alpharef);
+	}else{
+		SetRenderState(ALPHATESTFUNC, ALPHAALWAYS);
+		DrawInstancesSimple(header, inst, num);
+	}
+	SetRenderState(ALPHATESTFUNC, alphafunc);
+}
+
+// Like the default render callback of librw's GL3 pipeline, with the world
+// matrices coming from the instance buffer
+static void
+RenderBatch(int32 first, int32 num)
+{
+	using namespace rw;
+	using namespace rw::gl3;
+
+	Atomic *atomic = (Atomic*)aBatchEntities[first]->m_rwObject;
+	InstanceDataHeader *header = (InstanceDataHeader*)atomic->geometry->instData;
+	Material *m;
+	int32 i;
+
+	lightingCB(atomic);
+
+#ifdef RW_GL_USE_VAOS
+	glBindVertexArray(header->vao);
+#else
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, header->ibo);
+	glBindBuffer(GL_ARRAY_BUFFER, header->vbo);
+	setAttribPointers(header->attribDesc, header->numAttribs);
+#endif
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	for(i = 0; i < 3; i++){
+		glEnableVertexAttribArray(ATTRIB_INSTANCE + i);
+		glVertexAttribPointer(ATTRIB_INSTANCE + i, 4, GL_FLOAT, GL_FALSE, sizeof(tInstanceRows),
+			(void*)(uintptr)(first*sizeof(tInstanceRows) + i*sizeof(aInstanceRows[0].row[0])));
+		glVertexAttribDivisor(ATTRIB_INSTANCE + i, 1);
+	}
+
+	InstanceData *inst = header->inst;
+	int32 n = header->numMeshes;
+
+	instancedShader->use();
+
+	while(n--){
+		m = inst->material;
+
+		setMaterial(m->color, m->surfaceProps);
+
+		setTexture(0, m->texture);
+
+		rw::SetRenderState(VERTEXALPHA, inst->vertexAlpha || m->color.alpha != 0xFF);
+
+		DrawInstances(header, inst, num);
+		inst++;
+	}
+
+	for(i = 0; i < 3; i++){
+		glVertexAttribDivisor(ATTRIB_INSTANCE + i, 0);
+		glDisableVertexAttribArray(ATTRIB_INSTANCE + i);
+	}
+#ifndef RW_GL_USE_VAOS
+	disableAttribPointers(header->attribDesc, header->numAttribs);
+#endif
+}
+
+static void
+RenderBatches(bool instanced)
+{
+	int32 i, j, k;
+	bool resetLights;
+
+	CInstancing::ms_nNumBatches = 0;
+	CInstancing::ms_nNumInstanced = 0;
+	// the same for all buildings
+	resetLights = aBatchEntities[0]->SetupLighting();
+	for(i = 0; i < nNumBatchEntities; i = j){
+		for(j = i+1; j < nNumBatchEntities && GetGeometry(aBatchEntities[j]) == GetGeometry(aBatchEntities[i]); j++);
+		if(!instanced || j - i < MIN_INSTANCES){
+			for(k = i; k < j; k++)
+				aBatchEntities[k]->Render();
+		}else{
+			RenderBatch(i, j - i);
+			CInstancing::ms_nNumBatches++;
+			CInstancing::ms_nNumInstanced += j - i;
+		}
+	}
+	aBatchEntities[0]->RemoveLighting(resetLights);
+}
+
+// Draws the batched buildings on their own, once one by one and once instanced,
+// and compares the frame buffer. Takes a frame, so this runs on llvmpipe too.
+static void
+CheckBatches(void)
+{
+	static RwRGBA clearColour = { 0, 0, 0, 255 };
+	RwRaster *raster = RwCameraGetRaster(Scene.camera);
+	int32 width = RwRasterGetWidth(raster);
+	int32 height = RwRasterGetHeight(raster);
+	uint8 *pixels[2];
+	int32 i, c, pass, numCovered, numDiffering, diff, maxDiff;
+
+	for(pass = 0; pass < 2; pass++){
+		RwCameraClear(Scene.camera, &clearColour, rwCAMERACLEARIMAGE | rwCAMERACLEARZ);
+		RenderBatches(pass == 1);
+		pixels[pass] = new uint8[width*height*4];
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels[pass]);
+	}
+
+	numCovered = 0;
+	numDiffering = 0;
+	maxDiff = 0;
+	for(i = 0; i < width*height*4; i += 4){
+		diff = 0;
+		for(c = 0; c < 3; c++)
+			diff = Max(diff, ABS(pixels[0][i+c] - pixels[1][i+c]));
+		if(pixels[0][i] || pixels[0][i+1] || pixels[0][i+2])
+			numCovered++;
+		// a step or two is down to the world matrix being multiplied differently
+		if(diff > 2)
+			numDiffering++;
+		maxDiff = Max(maxDiff, diff);
+	}
+	debug("Instancing check: %d buildings, %d of them in %d batches, %d of %d pixels differ, by up to %d\n",
+		nNumBatchEntities, CInstancing::ms_nNumInstanced, CInstancing::ms_nNumBatches,
+		numDiffering, numCovered, maxDiff);
+	delete[] pixels[0];
+	delete[] pixels[1];
+}
+
+void
+CInstancing::Render(void)
+{
+	int32 i;
+
+	if(nNumBatchEntities == 0){
+		ms_nNumBatches = 0;
+		ms_nNumInstanced = 0;
+		return;
+	}
+
+	qsort(aBatchEntities, nNumBatchEntities, sizeof(CEntity*), CompareGeometry);
+	for(i = 0; i < nNumBatchEntities; i++){
+		rw::Matrix *m = ((RpAtomic*)aBatchEntities[i]->m_rwObject)->getFrame()->getLTM();
+		tInstanceRows *r = &aInstanceRows[i];
+		r->row[0][0] = m->right.x; r->row[0][1] = m->up.x; r->row[0][2] = m->at.x; r->row[0][3] = m->pos.x;
+		r->row[1][0] = m->right.y; r->row[1][1] = m->up.y; r->row[1][2] = m->at.y; r->row[1][3] = m->pos.y;
+		r->row[2][0] = m->right.z; r->row[2][1] = m->up.z; r->row[2][2] = m->at.z; r->row[2][3] = m->pos.z;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, nNumBatchEntities*sizeof(tInstanceRows), aInstanceRows, GL_STREAM_DRAW);
+
+	if(bCheckNextFrame && rw::engine->currentCamera == Scene.camera){
+		bCheckNextFrame = false;
+		CheckBatches();
+	}else
+		RenderBatches(true);
+	nNumBatchEntities = 0;
+}
+
+void
+CInstancing::Check(void)
+{
+	bCheckNextFrame = true;
+}
+
+#endif
@@ -0,0 +1,24 @@
+#pragma once
+
+#ifdef INSTANCED_RENDERING
+
+class CEntity;
+
+// Buildings of the render list that share a geometry are drawn with one
+// instanced draw per material through librw's GL3 backend. The world
+// matrices of all of them go into one vertex buffer per frame.
+class CInstancing
+{
+public:
+	static bool bEnabled;
+	static int32 ms_nNumBatches;	// last frame
+	static int32 ms_nNumInstanced;	// last frame
+
+	static void Init(void);
+	static void Shutdown(void);
+	static bool Add(CEntity *ent);
+	static void Render(void);
+	static void Check(void);
+};
+
+#endif
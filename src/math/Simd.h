@@ -0,0 +1,80 @@
+#pragma once
+
+// Minimal 4-wide float vector used by the SIMD code paths.
+// Maps to SSE or NEON where available and to plain C otherwise, so the
+// same code compiles everywhere. No FMA is used, results are bit-identical
+// to the scalar expressions when they are evaluated in the same order.
+
+#if defined __SSE__ || defined _M_X64 || defined _M_IX86_FP && _M_IX86_FP >= 1
+#include <xmmintrin.h>
+#define SIMD_SSE
+#elif defined __ARM_NEON || defined __ARM_NEON__
+#include <arm_neon.h>
+#define SIMD_NEON
+#endif
+
+#if defined SIMD_SSE
+
+typedef __m128 Simd4f;
+
+inline Simd4f Simd4Splat(float f) { return _mm_set1_ps(f); }
+inline Simd4f Simd4Set(float x, float y, float z, float w) { return _mm_setr_ps(x, y, z, w); }
+inline Simd4f Simd4Load(const float *p) { return _mm_loadu_ps(p); }
+inline void Simd4Store(float *p, Simd4f v) { _mm_storeu_ps(p, v); }
+inline Simd4f Simd4Add(Simd4f a, Simd4f b) { return _mm_add_ps(a, b); }
+inline Simd4f Simd4Sub(Simd4f a, Simd4f b) { return _mm_sub_ps(a, b); }
+inline Simd4f Simd4Mul(Simd4f a, Simd4f b) { return _mm_mul_ps(a, b); }
+inline Simd4f Simd4Min(Simd4f a, Simd4f b) { return _mm_min_ps(a, b); }
+inline Simd4f Simd4Max(Simd4f a, Simd4f b) { return _mm_max_ps(a, b); }
+inline Simd4f Simd4Abs(Simd4f a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+// these return one bit per lane
+inline int Simd4Less(Simd4f a, Simd4f b) { return _mm_movemask_ps(_mm_cmplt_ps(a, b)); }
+inline int Simd4LessEqual(Simd4f a, Simd4f b) { return _mm_movemask_ps(_mm_cmple_ps(a, b)); }
+inline int Simd4Greater(Simd4f a, Simd4f b) { return _mm_movemask_ps(_mm_cmpgt_ps(a, b)); }
+
+#elif defined SIMD_NEON
+
+typedef float32x4_t Simd4f;
+
+inline Simd4f Simd4Splat(float f) { return vdupq_n_f32(f); }
+inline Simd4f Simd4Set(float x, float y, float z, float w) { float f[4] = { x, y, z, w }; return vld1q_f32(f); }
+inline Simd4f Simd4Load(const float *p) { return vld1q_f32(p); }
+inline void Simd4Store(float *p, Simd4f v) { vst1q_f32(p, v); }
+inline Simd4f Simd4Add(Simd4f a, Simd4f b) { return vaddq_f32(a, b); }
+inline Simd4f Simd4Sub(Simd4f a, Simd4f b) { return vsubq_f32(a, b); }
+inline Simd4f Simd4Mul(Simd4f a, Simd4f b) { return vmulq_f32(a, b); }
+inline Simd4f Simd4Min(Simd4f a, Simd4f b) { return vminq_f32(a, b); }
+inline Simd4f Simd4Max(Simd4f a, Simd4f b) { return vmaxq_f32(a, b); }
+inline Simd4f Simd4Abs(Simd4f a) { return vabsq_f32(a); }
+inline int Simd4Mask(uint32x4_t m) {
+	return (vgetq_lane_u32(m, 0) & 1) | (vgetq_lane_u32(m, 1) & 2) | (vgetq_lane_u32(m, 2) & 4) | (vgetq_lane_u32(m, 3) & 8);
+}
+inline int Simd4Less(Simd4f a, Simd4f b) { return Simd4Mask(vcltq_f32(a, b)); }
+inline int Simd4LessEqual(Simd4f a, Simd4f b) { return Simd4Mask(vcleq_f32(a, b)); }
+inline int Simd4Greater(Simd4f a, Simd4f b) { return Simd4Mask(vcgtq_f32(a, b)); }
+
+#else
+
+struct Simd4f { float f[4]; };
+
+inline Simd4f Simd4Splat(float f) { Simd4f r = { { f, f, f, f } }; return r; }
+inline Simd4f Simd4Set(float x, float y, float z, float w) { Simd4f r = { { x, y, z, w } }; return r; }
+inline Simd4f Simd4Load(const float *p) { Simd4f r = { { p[0], p[1], p[2], p[3] } }; return r; }
+inline void Simd4Store(float *p, Simd4f v) { p[0] = v.f[0]; p[1] = v.f[1]; p[2] = v.f[2]; p[3] = v.f[3]; }
+#define SIMD4_OP(name, expr) \
+	inline Simd4f name(Simd4f a, Simd4f b) { Simd4f r; for(int i = 0; i < 4; i++) { float x = a.f[i], y = b.f[i]; r.f[i] = expr; } return r; }
+SIMD4_OP(Simd4Add, x + y)
+SIMD4_OP(Simd4Sub, x - y)
+SIMD4_OP(Simd4Mul, x * y)
+SIMD4_OP(Simd4Min, x < y ? x : y)
+SIMD4_OP(Simd4Max, x > y ? x : y)
+#undef SIMD4_OP
+inline Simd4f Simd4Abs(Simd4f a) { Simd4f r; for(int i = 0; i < 4; i++) r.f[i] = a.f[i] < 0.0f ? -a.f[i] : a.f[i]; return r; }
+#define SIMD4_CMP(name, op) \
+	inline int name(Simd4f a, Simd4f b) { int m = 0; for(int i = 0; i < 4; i++) if(a.f[i] op b.f[i]) m |= 1 << i; return m; }
+SIMD4_CMP(Simd4Less, <)
+SIMD4_CMP(Simd4LessEqual, <=)
+SIMD4_CMP(Simd4Greater, >)
+#undef SIMD4_CMP
+
+#endif
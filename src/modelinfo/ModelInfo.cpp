@@ -18,6 +18,17 @@ CStore<CVehicleModelInfo, VEHICLEMODELSIZE> CModelInfo::ms_vehicleModelStore;
 CStore<CXtraCompsModelInfo, XTRACOMPSMODELSIZE> CModelInfo::ms_xtraCompsModelStore;
 CStore<C2dEffect, TWODFXSIZE> CModelInfo::ms_2dEffectStore;
 
+#ifdef HASHED_NAME_LOOKUPS
+int16 CModelInfo::ms_aNameHashHeads[NAMEHASHSIZE];
+int16 CModelInfo::ms_aNameHashNext[MODELINFOSIZE];
+int16 CModelInfo::ms_aNameHashBucket[MODELINFOSIZE];
+int16 CModelInfo::ms_aUnhashedModels[MODELINFOSIZE];
+int32 CModelInfo::ms_nNumUnhashedModels;
+int32 CModelInfo::ms_nNumNameLookups;
+int32 CModelInfo::ms_nNumNameCompares;
+int32 CModelInfo::ms_nNumLinearNameCompares;
+#endif
+
 void
 CModelInfo::Initialise(void)
 {
@@ -26,6 +37,13 @@ CModelInfo::Initialise(void)
 
 	for(i = 0; i < MODELINFOSIZE; i++)
 		ms_modelInfoPtrs[i] = nil;
+#ifdef HASHED_NAME_LOOKUPS
+	for(i = 0; i < NAMEHASHSIZE; i++)
+		ms_aNameHashHeads[i] = -1;
+	for(i = 0; i < MODELINFOSIZE; i++)
+		ms_aNameHashBucket[i] = -1;
+	ms_nNumUnhashedModels = 0;
+#endif
 	ms_2dEffectStore.clear();
 	ms_mloInstanceStore.clear();
 	ms_xtraCompsModelStore.clear();
@@ -126,6 +144,9 @@ CModelInfo::AddSimpleModel(int id)
 	modelinfo = CModelInfo::ms_simpleModelStore.alloc();
 	CModelInfo::ms_modelInfoPtrs[id] = modelinfo;
 	modelinfo->Init();
+#ifdef HASHED_NAME_LOOKUPS
+	NameChanged(id);
+#endif
 	return modelinfo;
 }
 
@@ -138,6 +159,9 @@ CModelInfo::AddMloModel(int id)
 	modelinfo->m_clump = nil;
 	modelinfo->firstInstance = 0;
 	modelinfo->lastInstance = 0;
+#ifdef HASHED_NAME_LOOKUPS
+	NameChanged(id);
+#endif
 	return modelinfo;
 }
 
@@ -148,6 +172,9 @@ CModelInfo::AddTimeModel(int id)
 	modelinfo = CModelInfo::ms_timeModelStore.alloc();
 	CModelInfo::ms_modelInfoPtrs[id] = modelinfo;
 	modelinfo->Init();
+#ifdef HASHED_NAME_LOOKUPS
+	NameChanged(id);
+#endif
 	return modelinfo;
 }
 
@@ -158,6 +185,9 @@ CModelInfo::AddClumpModel(int id)
 	modelinfo = CModelInfo::ms_clumpModelStore.alloc();
 	CModelInfo::ms_modelInfoPtrs[id] = modelinfo;
 	modelinfo->m_clump = nil;
+#ifdef HASHED_NAME_LOOKUPS
+	NameChanged(id);
+#endif
 	return modelinfo;
 }
 
@@ -168,6 +198,9 @@ CModelInfo::AddPedModel(int id)
 	modelinfo = CModelInfo::ms_pedModelStore.alloc();
 	CModelInfo::ms_modelInfoPtrs[id] = modelinfo;
 	modelinfo->m_clump = nil;
+#ifdef HASHED_NAME_LOOKUPS
+	NameChanged(id);
+#endif
 	return modelinfo;
 }
 
@@ -183,9 +216,84 @@ CModelInfo::AddVehicleModel(int id)
 	modelinfo->m_materials1[0] = nil;
 	modelinfo->m_materials2[0] = nil;
 	modelinfo->m_bikeSteerAngle = 999.99f;
+#ifdef HASHED_NAME_LOOKUPS
+	NameChanged(id);
+#endif
 	return modelinfo;
 }
 
+#ifdef HASHED_NAME_LOOKUPS
+void
+CModelInfo::UnhashName(int id)
+{
+	int16 *link;
+	if(ms_aNameHashBucket[id] < 0)
+		return;
+	for(link = &ms_aNameHashHeads[ms_aNameHashBucket[id]]; *link != id; link = &ms_aNameHashNext[*link]);
+	*link = ms_aNameHashNext[id];
+	ms_aNameHashBucket[id] = -1;
+}
+
+// Has to be called when the name of a model changes
+void
+CModelInfo::NameChanged(int id)
+{
+	if(ms_aNameHashBucket[id] == -2)
+		return;
+	UnhashName(id);
+	ms_aNameHashBucket[id] = -2;
+	ms_aUnhashedModels[ms_nNumUnhashedModels++] = id;
+}
+
+void
+CModelInfo::HashNewNames(void)
+{
+	int i, id, bucket;
+	int16 *link;
+
+	for(i = 0; i < ms_nNumUnhashedModels; i++){
+		id = ms_aUnhashedModels[i];
+		ms_aNameHashBucket[id] = -1;
+		if(ms_modelInfoPtrs[id] == nil)
+			continue;
+		bucket = CGeneral::GetUppercaseKey(ms_modelInfoPtrs[id]->GetName()) & (NAMEHASHSIZE-1);
+		for(link = &ms_aNameHashHeads[bucket]; *link != -1 && *link < id; link = &ms_aNameHashNext[*link]);
+		ms_aNameHashNext[id] = *link;
+		*link = id;
+		ms_aNameHashBucket[id] = bucket;
+	}
+	ms_nNumUnhashedModels = 0;
+}
+
+CBaseModelInfo*
+CModelInfo::GetModelInfo(const char *name, int *id)
+{
+	CBaseModelInfo *modelinfo;
+	int i;
+
+	HashNewNames();
+	ms_nNumNameLookups++;
+	for(i = ms_aNameHashHeads[CGeneral::GetUppercaseKey(name) & (NAMEHASHSIZE-1)]; i != -1; i = ms_aNameHashNext[i]){
+		modelinfo = ms_modelInfoPtrs[i];
+		ms_nNumNameCompares++;
+		if(!CGeneral::faststricmp(modelinfo->GetName(), name)){
+			ms_nNumLinearNameCompares += i+1;
+			if(id)
+				*id = i;
+			return modelinfo;
+		}
+	}
+	ms_nNumLinearNameCompares += MODELINFOSIZE;
+	return nil;
+}
+
+void
+CModelInfo::DumpNameLookupStats(void)
+{
+	debug("CModelInfo: %d name lookups, %d name compares, %d slots without the hash table\n",
+		ms_nNumNameLookups, ms_nNumNameCompares, ms_nNumLinearNameCompares);
+}
+#else
 CBaseModelInfo*
 CModelInfo::GetModelInfo(const char *name, int *id)
 {
@@ -200,6 +308,7 @@ CModelInfo::GetModelInfo(const char *name, int *id)
 	}
 	return nil;
 }
+#endif
 
 bool
 CModelInfo::IsBoatModel(int32 id)
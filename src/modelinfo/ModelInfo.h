@@ -23,6 +23,19 @@ class CModelInfo
 	static CStore<CVehicleModelInfo, VEHICLEMODELSIZE> ms_vehicleModelStore;
 	static CStore<C2dEffect, TWODFXSIZE> ms_2dEffectStore;
 	static CStore<CXtraCompsModelInfo, XTRACOMPSMODELSIZE> ms_xtraCompsModelStore;
+#ifdef HASHED_NAME_LOOKUPS
+	enum { NAMEHASHSIZE = 8192 };
+	// Models get their names after they're added, so new ones are only
+	// hashed by the next GetModelInfo(name). Buckets are in id order.
+	static int16 ms_aNameHashHeads[NAMEHASHSIZE];
+	static int16 ms_aNameHashNext[MODELINFOSIZE];
+	static int16 ms_aNameHashBucket[MODELINFOSIZE];	// -1 if not hashed, -2 if waiting to be
+	static int16 ms_aUnhashedModels[MODELINFOSIZE];
+	static int32 ms_nNumUnhashedModels;
+
+	static void UnhashName(int id);
+	static void HashNewNames(void);
+#endif
 
 public:
 	static void Initialise(void);
@@ -39,6 +52,14 @@ public:
 	static CStore<CInstance, MLOINSTANCESIZE> &GetMloInstanceStore(void) { return ms_mloInstanceStore; }
 
 	static CBaseModelInfo *GetModelInfo(const char *name, int *id);
+#ifdef HASHED_NAME_LOOKUPS
+	static void NameChanged(int id);
+
+	static int32 ms_nNumNameLookups;
+	static int32 ms_nNumNameCompares;
+	static int32 ms_nNumLinearNameCompares;	// slots scanning ms_modelInfoPtrs would have looked at
+	static void DumpNameLookupStats(void);
+#endif
 	static CBaseModelInfo *GetModelInfo(int id){
 		return ms_modelInfoPtrs[id];
 	}
@@ -193,7 +193,6 @@ struct ColNodeInfo
 	float radius;
 };
 
-#define NUMPEDINFONODES 8
 ColNodeInfo m_pColNodeInfos[NUMPEDINFONODES] = {
 	{ nil,          PED_HEAD,		PEDPIECE_HEAD,  0.0f,   0.05f, 0.2f },
 	{ "Storso",     0,				PEDPIECE_TORSO,  0.0f,   0.15f, 0.2f },
@@ -389,3 +388,60 @@ CPedModelInfo::AnimatePedColModelSkinned(RpClump *clump)
 }
 
 #endif
+
+#ifdef CONCURRENT_WORLD_QUERIES
+// Same as the animating functions above, but writes to the caller's spheres
+// and doesn't allocate, so several threads can do it at once.
+bool
+CPedModelInfo::AnimatePedColSpheres(RpClump *clump, CColSphere *spheres)
+{
+	if(m_hitColModel == nil)
+		return false;
+	for(int i = 0; i < NUMPEDINFONODES; i++)
+		spheres[i] = m_hitColModel->spheres[i];
+#ifdef PED_SKIN
+	if(IsClumpSkinned(clump)){
+		RpHAnimHierarchy *hier = GetAnimHierarchyFromSkinClump(clump);
+		CMatrix invmat;
+		Invert(CMatrix(RwFrameGetMatrix(RpClumpGetFrame(clump))), invmat);
+		for(int i = 0; i < NUMPEDINFONODES; i++){
+			int idx = RpHAnimIDGetIndex(hier, ConvertPedNode2BoneTag(m_pColNodeInfos[i].pedNode));
+			CVector pos = invmat * *(CVector*)&RpHAnimHierarchyGetMatrixArray(hier)[idx].pos;
+			spheres[i].center.x = pos.x + m_pColNodeInfos[i].x;
+			spheres[i].center.y = pos.y + 0.0f;
+			spheres[i].center.z = pos.z + m_pColNodeInfos[i].z;
+		}
+		return true;
+	}
+#endif
+	RwObjectNameAssociation nameAssoc;
+	RwObjectIdAssociation idAssoc;
+	RwFrame *root = RpClumpGetFrame(clump);
+	for(int i = 0; i < NUMPEDINFONODES; i++){
+		RwFrame *f = nil;
+		if(m_pColNodeInfos[i].name){
+			nameAssoc.name = m_pColNodeInfos[i].name;
+			nameAssoc.frame = nil;
+			RwFrameForAllChildren(root, FindFrameFromNameCB, &nameAssoc);
+			f = nameAssoc.frame;
+		}else{
+			idAssoc.id = m_pColNodeInfos[i].pedNode;
+			idAssoc.frame = nil;
+			RwFrameForAllChildren(root, FindFrameFromIdCB, &idAssoc);
+			f = idAssoc.frame;
+		}
+		if(f){
+			CVector pos = *(CVector*)&RwFrameGetMatrix(f)->pos;
+			for(f = RwFrameGetParent(f); f; f = RwFrameGetParent(f)){
+				pos = CMatrix(RwFrameGetMatrix(f)) * pos;
+				if(RwFrameGetParent(f) == root)
+					break;
+			}
+			spheres[i].center.x = pos.x + m_pColNodeInfos[i].x;
+			spheres[i].center.y = pos.y + 0.0f;
+			spheres[i].center.z = pos.z + m_pColNodeInfos[i].z;
+		}
+	}
+	return true;
+}
+#endif
@@ -20,6 +20,8 @@ enum PedNode {
 	PED_NODE_MAX// Not valid: PED_LOWERLEGL
 };
 
+#define NUMPEDINFONODES 8	// spheres of the hit col model
+
 class CPedModelInfo : public CClumpModelInfo
 {
 public:
@@ -54,6 +56,9 @@ public:
 	CColModel *GetHitColModel(void) { return m_hitColModel; }
 	static CColModel *AnimatePedColModel(CColModel* colmodel, RwFrame* frame);
 	CColModel *AnimatePedColModelSkinned(RpClump *clump);
+#ifdef CONCURRENT_WORLD_QUERIES
+	bool AnimatePedColSpheres(RpClump *clump, CColSphere *spheres);
+#endif
 
 #ifdef PED_SKIN
 	static RpAtomic *findLimbsCb(RpAtomic *atomic, void *data);
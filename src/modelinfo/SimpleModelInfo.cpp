@@ -135,6 +135,22 @@ CSimpleModelInfo::GetAtomicFromDistance(float dist)
 	return nil;
 }
 
+#ifdef PARALLEL_RENDER_LIST
+// Same but without going through m_isDamaged, so threads can ask at the same time
+RpAtomic*
+CSimpleModelInfo::GetAtomicFromDistance(float dist, bool damaged) const
+{
+	int i;
+	i = 0;
+	if(damaged)
+		i = m_firstDamaged;
+	for(; i < m_numAtomics; i++)
+		if(dist < m_lodDistances[i] * TheCamera.LODDistMultiplier)
+			return m_atomics[i];
+	return nil;
+}
+#endif
+
 void
 CSimpleModelInfo::FindRelatedModel(void)
 {
@@ -40,6 +40,9 @@ public:
 	float GetNearDistance(void);
 	float GetLargestLodDistance(void);
 	RpAtomic *GetAtomicFromDistance(float dist);
+#ifdef PARALLEL_RENDER_LIST
+	RpAtomic *GetAtomicFromDistance(float dist, bool damaged) const;
+#endif
 	void FindRelatedModel(void);
 	void SetupBigBuilding(void);
 
@@ -783,6 +783,28 @@ CPed::OurPedCanSeeThisOne(CEntity *target)
 	return !CWorld::ProcessLineOfSight(headPos, target->GetPosition(), colpoint, ent, true, false, false, false, false, false);
 }
 
+#ifdef CONCURRENT_WORLD_QUERIES
+// Same, for worker threads
+bool
+CPed::OurPedCanSeeThisOne(CWorldQuery &query, CEntity *target)
+{
+	CColPoint colpoint;
+	CEntity *ent;
+
+	CVector2D dist = CVector2D(target->GetPosition()) - CVector2D(GetPosition());
+
+	if (DotProduct2D(dist, CVector2D(GetForward())) < 0.0f)
+		return false;
+
+	if (dist.Magnitude() >= 40.0f)
+		return false;
+
+	CVector headPos = this->GetPosition();
+	headPos.z += 1.0f;
+	return !CWorld::ProcessLineOfSight(query, headPos, target->GetPosition(), colpoint, ent, true, false, false, false, false, false);
+}
+#endif
+
 void
 CPed::Avoid(void)
 {
@@ -18,6 +18,7 @@ struct CPathNode;
 class CAccident;
 class CObject;
 class CFire;
+class CWorldQuery;
 struct AnimBlendFrameData;
 class CAnimBlendAssociation;
 
@@ -545,6 +546,9 @@ public:
 	void ApplyHeadShot(eWeaponType weaponType, CVector pos, bool evenOnPlayer);
 	void RemoveBodyPart(PedNode nodeId, int8 direction);
 	bool OurPedCanSeeThisOne(CEntity *target);
+#ifdef CONCURRENT_WORLD_QUERIES
+	bool OurPedCanSeeThisOne(CWorldQuery &query, CEntity *target);
+#endif
 	void Avoid(void);
 	void Attack(void);
 	void ClearAimFlag(void);
@@ -16,6 +16,8 @@
 #include "Pools.h"
 #include "Darkel.h"
 #include "CarCtrl.h"
+#include "WorkerPool.h"
+#include "WorldQuery.h"
 
 #define PAD_MOVE_TO_GAME_WORLD_MOVE 60.0f
 
@@ -851,6 +853,40 @@ CPlayerPed::EvaluateTarget(CEntity *candidate, CEntity **targetPtr, float *lastC
 	}
 }
 
+#ifdef CONCURRENT_WORLD_QUERIES
+#define LOCKON_CHUNK_SIZE 4
+
+// Peds that pass the cheap tests of the lock-on loops, in the order they are
+// evaluated. Their line of sight tests run on the worker threads.
+static CPed *apLockOnCandidates[NUMPEDS];
+static bool abCanSeeLockOnCandidate[NUMPEDS];
+
+static void
+CanSeeLockOnCandidatesJob(int32 start, int32 end, void *arg)
+{
+	CPed *player = (CPed*)arg;
+	CWorldQuery &query = CWorldQuery::ForThisThread();
+	query.pIgnoreEntity = nil;
+	query.bIncludeDeadPeds = false;
+	for(int32 i = start; i < end; i++)
+		abCanSeeLockOnCandidate[i] = player->OurPedCanSeeThisOne(query, apLockOnCandidates[i]);
+}
+
+static int32
+FindLockOnCandidates(CPed *player, CEntity *previousTarget)
+{
+	int32 numCandidates = 0;
+	for (int h = CPools::GetPedPool()->GetSize() - 1; h >= 0; h--) {
+		CPed *pedToCheck = CPools::GetPedPool()->GetSlot(h);
+		if (pedToCheck && pedToCheck != FindPlayerPed() && pedToCheck != previousTarget &&
+		    !pedToCheck->DyingOrDead() && !pedToCheck->bInVehicle && pedToCheck->m_leader != FindPlayerPed())
+			apLockOnCandidates[numCandidates++] = pedToCheck;
+	}
+	CWorkerPool::ParallelFor(numCandidates, LOCKON_CHUNK_SIZE, CanSeeLockOnCandidatesJob, player);
+	return numCandidates;
+}
+#endif
+
 bool
 CPlayerPed::FindNextWeaponLockOnTarget(CEntity *previousTarget, bool lookToLeft)
 {
@@ -863,6 +899,13 @@ CPlayerPed::FindNextWeaponLockOnTarget(CEntity *previousTarget, bool lookToLeft)
 	CVector distVec = previousTarget->GetPosition() - GetPosition();
 	float referenceBeta = CGeneral::GetATanOfXY(distVec.x, distVec.y);
 
+#ifdef CONCURRENT_WORLD_QUERIES
+	int32 numCandidates = FindLockOnCandidates(this, previousTarget);
+	for (int i = 0; i < numCandidates; i++)
+		if (abCanSeeLockOnCandidate[i])
+			EvaluateNeighbouringTarget(apLockOnCandidates[i], &nextTarget, &lastCloseness,
+				weaponRange, referenceBeta, lookToLeft);
+#else
 	for (int h = CPools::GetPedPool()->GetSize() - 1; h >= 0; h--) {
 		CPed *pedToCheck = CPools::GetPedPool()->GetSlot(h);
 		if (pedToCheck) {
@@ -876,6 +919,7 @@ CPlayerPed::FindNextWeaponLockOnTarget(CEntity *previousTarget, bool lookToLeft)
 			}
 		}
 	}
+#endif
 	for (int i = 0; i < ARRAY_SIZE(m_nTargettableObjects); i++) {
 		CObject *obj = CPools::GetObjectPool()->GetAt(m_nTargettableObjects[i]);
 		if (obj)
@@ -910,6 +954,13 @@ CPlayerPed::FindWeaponLockOnTarget(void)
 	// nextTarget = nil;
 	float lastCloseness = -10000.0f;
 	float referenceBeta = CGeneral::GetATanOfXY(GetForward().x, GetForward().y);
+#ifdef CONCURRENT_WORLD_QUERIES
+	int32 numCandidates = FindLockOnCandidates(this, nil);
+	for (int i = 0; i < numCandidates; i++)
+		if (abCanSeeLockOnCandidate[i])
+			EvaluateTarget(apLockOnCandidates[i], &nextTarget, &lastCloseness,
+				weaponRange, referenceBeta, IsThisPedAttackingPlayer(apLockOnCandidates[i]));
+#else
 	for (int h = CPools::GetPedPool()->GetSize() - 1; h >= 0; h--) {
 		CPed *pedToCheck = CPools::GetPedPool()->GetSlot(h);
 		if (pedToCheck) {
@@ -923,6 +974,7 @@ CPlayerPed::FindWeaponLockOnTarget(void)
 			}
 		}
 	}
+#endif
 	for (int i = 0; i < ARRAY_SIZE(m_nTargettableObjects); i++) {
 		CObject *obj = CPools::GetObjectPool()->GetAt(m_nTargettableObjects[i]);
 		if (obj)
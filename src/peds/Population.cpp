@@ -862,11 +862,8 @@ CPopulation::MoveCarsAndPedsOutOfAbandonedZones()
 	int frame = CTimer::GetFrameCounter() & 7;
 	if (frame == 1) {
 		int movedVehicleCount = 0;
-		int poolSize = CPools::GetVehiclePool()->GetSize();
-		for (int poolIndex = poolSize - 1; poolIndex >= 0; poolIndex--) {
-
-			CVehicle* veh = CPools::GetVehiclePool()->GetSlot(poolIndex);
-			if (veh && veh->m_nZoneLevel == LEVEL_GENERIC && veh->IsCar()) {
+		for (CVehicle *veh : *CPools::GetVehiclePool()) {
+			if (veh->m_nZoneLevel == LEVEL_GENERIC && veh->IsCar()) {
 
 				if(veh->GetStatus() != STATUS_ABANDONED && veh->GetStatus() != STATUS_WRECKED && veh->GetStatus() != STATUS_PLAYER &&
 					veh->GetStatus() != STATUS_PLAYER_REMOTE) {
@@ -908,11 +905,8 @@ CPopulation::MoveCarsAndPedsOutOfAbandonedZones()
 			}
 		}
 	} else if (frame == 5) {
-		int poolSize = CPools::GetPedPool()->GetSize();
-		for (int poolIndex = poolSize - 1; poolIndex >= 0; poolIndex--) {
-
-			CPed *ped = CPools::GetPedPool()->GetSlot(poolIndex);
-			if (ped && ped->m_nZoneLevel == LEVEL_GENERIC && !ped->bInVehicle) {
+		for (CPed *ped : *CPools::GetPedPool()) {
+			if (ped->m_nZoneLevel == LEVEL_GENERIC && !ped->bInVehicle) {
 
 				CVector pedPos(ped->GetPosition());
 				CPopulation::FindCollisionZoneForCoors(&pedPos, &zone, &level);
@@ -944,15 +938,9 @@ CPopulation::MoveCarsAndPedsOutOfAbandonedZones()
 void
 CPopulation::ConvertAllObjectsToDummyObjects()
 {
-	int poolSize = CPools::GetObjectPool()->GetSize();
-	for (int poolIndex = poolSize - 1; poolIndex >= 0; poolIndex--) {
-
-		CObject *obj = CPools::GetObjectPool()->GetSlot(poolIndex);
-		if (obj) {
-			if (obj->CanBeDeleted())
-				ConvertToDummyObject(obj);
-		}
-	}
+	for (CObject *obj : *CPools::GetObjectPool())
+		if (obj->CanBeDeleted())
+			ConvertToDummyObject(obj);
 }
 
 void
@@ -1102,15 +1090,17 @@ CPopulation::ManagePopulation(void)
 		}
 	}
 
-	int pedPoolSize = CPools::GetPedPool()->GetSize();
 #ifndef SQUEEZE_PERFORMANCE
-	for (int poolIndex = pedPoolSize-1; poolIndex >= 0; poolIndex--) {
+	for (CPed *ped : *CPools::GetPedPool()) {
 #else
+	int pedPoolSize = CPools::GetPedPool()->GetSize();
 	for (int poolIndex = (pedPoolSize * (frameMod32 + 1) / 32) - 1; poolIndex >= pedPoolSize * frameMod32 / 32; poolIndex--) {
-#endif
 		CPed *ped = CPools::GetPedPool()->GetSlot(poolIndex);
+		if (ped == nil)
+			continue;
+#endif
 
-		if (ped && !ped->IsPlayer() && ped->CanBeDeleted() && !ped->bInVehicle) {
+		if (!ped->IsPlayer() && ped->CanBeDeleted() && !ped->bInVehicle) {
 			if (ped->m_nPedState == PED_DEAD && CTimer::GetTimeInMilliseconds() - ped->m_bloodyFootprintCountOrDeathTime > 60000)
 				ped->bFadeOut = true;
 
@@ -0,0 +1,564 @@
+#include <float.h>
+#include "common.h"
+
+#ifdef OCCLUSION_CULLING
+#include "Simd.h"
+#include "Camera.h"
+#include "World.h"
+#include "ModelInfo.h"
+#include "Collision.h"
+#include "Building.h"
+#include "Sprite2d.h"
+#include "OcclusionBuffer.h"
+
+#define OCCLUSION_WIDTH 256
+#define OCCLUSION_HEIGHT 128
+#define OCCLUSION_MARGIN 1.05f	// the buffer reaches a bit past the screen so clamping to it never hides anything
+#define OCCLUSION_NEAR 1.0f
+#define OCCLUDER_DISTANCE 160.0f	// for buildings, LODs are taken as far as they're drawn
+#define OCCLUDER_MIN_RADIUS 10.0f
+#define OCCLUDER_MIN_SIZE 4.0f
+#define OCCLUDER_SLICE 20.0f	// longer boxes are cut up so each piece gets a depth of its own
+#define OCCLUDER_PROBES 4	// lines per side of the footprint and of every face
+#define OCCLUDER_INSET 0.5f	// boxes are kept this far inside the collision
+#define MAX_OCCLUDERS 64
+#define MAX_OCCLUDER_CANDIDATES 512
+
+enum
+{
+	OCCLUDER_UNKNOWN,
+	OCCLUDER_NONE,
+	OCCLUDER_BOX
+};
+
+struct tOccluderBox
+{
+	CVector min, max;	// model space
+};
+
+struct tOccluderCandidate
+{
+	CEntity *ent;
+	float score;
+};
+
+bool COcclusionBuffer::bUseOcclusion = true;
+bool COcclusionBuffer::bShowBuffer;
+int32 COcclusionBuffer::ms_nNumOccluders;
+int32 COcclusionBuffer::ms_nNumCulled;
+
+static float aDepth[OCCLUSION_HEIGHT][OCCLUSION_WIDTH];	// distance along the view direction, FLT_MAX where nothing was drawn
+static float aLaneMask[16][4];	// 0 for the lanes set in the index, FLT_MAX for the others
+static bool bLaneMaskReady;
+
+static uint8 aOccluderState[MODELINFOSIZE];
+static tOccluderBox aOccluderBoxes[MODELINFOSIZE];
+static tOccluderCandidate aCandidates[MAX_OCCLUDER_CANDIDATES];
+static int32 nNumCandidates;
+
+// a copy of the camera, so threads testing entities read something that doesn't change
+static CMatrix camMatrix;
+static CVector camPosition;
+static float fScaleX, fScaleY;
+
+static float Min3(float a, float b, float c) { return Min(a, Min(b, c)); }
+static float Max3(float a, float b, float c) { return Max(a, Max(b, c)); }
+static float &Axis(CVector &v, int i) { return i == 0 ? v.x : i == 1 ? v.y : v.z; }
+static float Axis(const CVector &v, int i) { return i == 0 ? v.x : i == 1 ? v.y : v.z; }
+
+// Separating axes, touching the box doesn't count
+static bool
+TriangleOverlapsBox(CVector a, CVector b, CVector c, const CVector &min, const CVector &max)
+{
+	int i, j;
+	CVector centre = (min + max) * 0.5f;
+	CVector half = (max - min) * 0.5f;
+	a -= centre;
+	b -= centre;
+	c -= centre;
+
+	if(Max3(a.x, b.x, c.x) <= -half.x || Min3(a.x, b.x, c.x) >= half.x ||
+	   Max3(a.y, b.y, c.y) <= -half.y || Min3(a.y, b.y, c.y) >= half.y ||
+	   Max3(a.z, b.z, c.z) <= -half.z || Min3(a.z, b.z, c.z) >= half.z)
+		return false;
+
+	CVector edges[3] = { b - a, c - b, a - c };
+	CVector normal = CrossProduct(edges[0], edges[1]);
+	if(Abs(DotProduct(normal, a)) >= half.x*Abs(normal.x) + half.y*Abs(normal.y) + half.z*Abs(normal.z))
+		return false;
+
+	const CVector boxAxes[3] = { CVector(1.0f, 0.0f, 0.0f), CVector(0.0f, 1.0f, 0.0f), CVector(0.0f, 0.0f, 1.0f) };
+	for(i = 0; i < 3; i++)
+		for(j = 0; j < 3; j++){
+			CVector axis = CrossProduct(boxAxes[j], edges[i]);
+			float r = half.x*Abs(axis.x) + half.y*Abs(axis.y) + half.z*Abs(axis.z);
+			if(r == 0.0f)
+				continue;	// edge along this box axis
+			float pa = DotProduct(axis, a);
+			float pb = DotProduct(axis, b);
+			float pc = DotProduct(axis, c);
+			if(Min3(pa, pb, pc) >= r || Max3(pa, pb, pc) <= -r)
+				return false;
+		}
+	return true;
+}
+
+// No surface of the col model goes through the box, and lines going out of
+// every face on a grid all run into one. So the box sits in one piece of
+// collision closed on all sides, not in a gap between probes or under a roof.
+static bool
+IsBoxEnclosed(CColModel *col, const tOccluderBox *box)
+{
+	CColPoint point;
+	CMatrix unity;
+	float mindist;
+	int f, i, j, axis, u, v;
+
+	for(i = 0; i < col->numTriangles; i++)
+		if(TriangleOverlapsBox(col->vertices[col->triangles[i].a].Get(), col->vertices[col->triangles[i].b].Get(),
+		                       col->vertices[col->triangles[i].c].Get(), box->min, box->max))
+			return false;
+
+	unity.SetUnity();
+	for(f = 0; f < 6; f++){
+		axis = f/2;
+		u = (axis+1) % 3;
+		v = (axis+2) % 3;
+		for(i = 0; i < OCCLUDER_PROBES; i++)
+			for(j = 0; j < OCCLUDER_PROBES; j++){
+				CVector start, end;
+				Axis(start, axis) = Axis(f & 1 ? box->max : box->min, axis);
+				Axis(start, u) = Axis(box->min, u) + (Axis(box->max, u) - Axis(box->min, u))*(2*i+1)/(2*OCCLUDER_PROBES);
+				Axis(start, v) = Axis(box->min, v) + (Axis(box->max, v) - Axis(box->min, v))*(2*j+1)/(2*OCCLUDER_PROBES);
+				end = start;
+				Axis(end, axis) = f & 1 ? Axis(col->boundingBox.max, axis) + 1.0f : Axis(col->boundingBox.min, axis) - 1.0f;
+				mindist = 1.0f;
+				if(!CCollision::ProcessLineOfSight(CColLine(start, end), unity, *col, point, mindist, true))
+					return false;
+			}
+	}
+	return true;
+}
+
+static float
+GetBoxVolume(const tOccluderBox *box)
+{
+	CVector size = box->max - box->min;
+	return size.x*size.y*size.z;
+}
+
+static bool
+IsBigEnough(const tOccluderBox *box)
+{
+	CVector size = box->max - box->min;
+	return size.x >= OCCLUDER_MIN_SIZE && size.y >= OCCLUDER_MIN_SIZE && size.z >= OCCLUDER_MIN_SIZE;
+}
+
+// Works out a box that is solid, once per model. The largest box of the col model
+// is solid as it is. Otherwise lines dropped on a grid over the footprint give a
+// box from the highest ground floor to the lowest roof, which is only taken when
+// IsBoxEnclosed says it's solid. Either is kept OCCLUDER_INSET inside the collision.
+static bool
+FindOccluderBox(int32 modelIndex, CColModel *col, tOccluderBox *box)
+{
+	CColPoint point;
+	CMatrix unity;
+	tOccluderBox colBox, probeBox;
+	float mindist, top, bottom;
+	bool haveColBox, haveProbeBox;
+	int i, j;
+
+	CVector inset(OCCLUDER_INSET, OCCLUDER_INSET, OCCLUDER_INSET);
+	haveColBox = false;
+	for(i = 0; i < col->numBoxes; i++){
+		tOccluderBox b;
+		b.min = col->boxes[i].min + inset;
+		b.max = col->boxes[i].max - inset;
+		if(IsBigEnough(&b) && (!haveColBox || GetBoxVolume(&b) > GetBoxVolume(&colBox))){
+			colBox = b;
+			haveColBox = true;
+		}
+	}
+
+	CVector min = col->boundingBox.min;
+	CVector max = col->boundingBox.max;
+	CVector size = max - min;
+	haveProbeBox = size.x >= OCCLUDER_MIN_SIZE && size.y >= OCCLUDER_MIN_SIZE && size.z >= OCCLUDER_MIN_SIZE &&
+		col->numTriangles > 0;
+	unity.SetUnity();
+	top = max.z;
+	bottom = min.z;
+	for(i = 0; i < OCCLUDER_PROBES && haveProbeBox; i++)
+		for(j = 0; j < OCCLUDER_PROBES && haveProbeBox; j++){
+			float x = min.x + size.x*(2*i+1)/(2*OCCLUDER_PROBES);
+			float y = min.y + size.y*(2*j+1)/(2*OCCLUDER_PROBES);
+			mindist = 1.0f;
+			if(!CCollision::ProcessLineOfSight(CColLine(CVector(x, y, max.z + 1.0f), CVector(x, y, min.z - 1.0f)),
+			                                   unity, *col, point, mindist, true)){
+				haveProbeBox = false;
+				break;
+			}
+			top = Min(top, point.point.z);
+			mindist = 1.0f;
+			if(!CCollision::ProcessLineOfSight(CColLine(CVector(x, y, min.z - 1.0f), CVector(x, y, max.z + 1.0f)),
+			                                   unity, *col, point, mindist, true) ||
+			   point.point.z > min.z + 2.0f){
+				haveProbeBox = false;
+				break;
+			}
+			bottom = Max(bottom, point.point.z);
+		}
+	if(haveProbeBox){
+		probeBox.min = CVector(min.x + size.x/(2*OCCLUDER_PROBES), min.y + size.y/(2*OCCLUDER_PROBES), bottom) + inset;
+		probeBox.max = CVector(max.x - size.x/(2*OCCLUDER_PROBES), max.y - size.y/(2*OCCLUDER_PROBES), top) - inset;
+		haveProbeBox = IsBigEnough(&probeBox) &&
+			(!haveColBox || GetBoxVolume(&probeBox) > GetBoxVolume(&colBox)) &&
+			IsBoxEnclosed(col, &probeBox);
+	}
+
+	if(haveProbeBox)
+		*box = probeBox;
+	else if(haveColBox)
+		*box = colBox;
+	else
+		return false;
+	return true;
+}
+
+static tOccluderBox*
+GetOccluderBox(CEntity *ent)
+{
+	int32 mi = ent->GetModelIndex();
+	if(aOccluderState[mi] == OCCLUDER_UNKNOWN){
+		CColModel *col = CModelInfo::GetModelInfo(mi)->GetColModel();
+		if(col == nil)
+			return nil;	// maybe next time
+		aOccluderState[mi] = FindOccluderBox(mi, col, &aOccluderBoxes[mi]) ? OCCLUDER_BOX : OCCLUDER_NONE;
+	}
+	return aOccluderState[mi] == OCCLUDER_BOX ? &aOccluderBoxes[mi] : nil;
+}
+
+static void
+AddCandidate(CEntity *ent, bool lod)
+{
+	CSimpleModelInfo *mi = (CSimpleModelInfo*)CModelInfo::GetModelInfo(ent->GetModelIndex());
+
+	// only what is sure to be drawn, and drawn solid
+	if(mi->GetModelType() != MITYPE_SIMPLE || ent->bZoneCulled || !ent->bIsVisible || ent->m_rwObject == nil)
+		return;
+	if(mi->m_drawLast || mi->m_additive || mi->m_noZwrite || ent->bDrawLast)
+		return;
+	if(mi->GetColModel() == nil || ent->GetBoundRadius() < OCCLUDER_MIN_RADIUS)
+		return;
+	float dist = (ent->GetPosition() - camPosition).Magnitude();
+	if(dist > mi->GetLargestLodDistance())
+		return;
+	if(lod){
+		if(dist < mi->GetNearDistance())
+			return;
+	}else{
+		if(mi->m_alpha != 255 || dist > OCCLUDER_DISTANCE + ent->GetBoundRadius())
+			return;
+	}
+	if(!ent->GetIsOnScreen() || GetOccluderBox(ent) == nil)
+		return;
+
+	if(nNumCandidates < MAX_OCCLUDER_CANDIDATES){
+		aCandidates[nNumCandidates].ent = ent;
+		aCandidates[nNumCandidates].score = ent->GetBoundRadius() / Max(dist, 1.0f);
+		nNumCandidates++;
+	}
+}
+
+static int
+CompareCandidates(const void *a, const void *b)
+{
+	float sa = ((tOccluderCandidate*)a)->score;
+	float sb = ((tOccluderCandidate*)b)->score;
+	return sa > sb ? -1 : sa < sb ? 1 : 0;
+}
+
+// Fills a convex polygon given in pixels. A pixel is only in when it and the
+// pixels around it are, so rounding never lets an occluder grow.
+static void
+RasterizePolygon(const CVector2D *v, int n, float depth)
+{
+	float a[8], b[8], c[8];
+	float area, minx, maxx, miny, maxy;
+	int i, j, x, y, x0, x1, y0, y1;
+
+	area = 0.0f;
+	minx = maxx = v[0].x;
+	miny = maxy = v[0].y;
+	for(i = 0; i < n; i++){
+		j = (i+1) % n;
+		area += v[i].x*v[j].y - v[j].x*v[i].y;
+		minx = Min(minx, v[i].x);
+		maxx = Max(maxx, v[i].x);
+		miny = Min(miny, v[i].y);
+		maxy = Max(maxy, v[i].y);
+	}
+	if(area == 0.0f)
+		return;
+	x0 = Max((int)Ceil(minx - 0.5f), 0);
+	x1 = Min((int)Floor(maxx - 0.5f), OCCLUSION_WIDTH-1);
+	y0 = Max((int)Ceil(miny - 0.5f), 0);
+	y1 = Min((int)Floor(maxy - 0.5f), OCCLUSION_HEIGHT-1);
+	if(x0 > x1 || y0 > y1)
+		return;
+
+	// edge functions, >= 0 inside whichever way round the polygon goes
+	float sign = area > 0.0f ? 1.0f : -1.0f;
+	for(i = 0; i < n; i++){
+		j = (i+1) % n;
+		a[i] = (v[i].y - v[j].y) * sign;
+		b[i] = (v[j].x - v[i].x) * sign;
+		c[i] = (v[i].x*v[j].y - v[j].x*v[i].y) * sign;
+		// the edge moved in by a pixel and a half, so the centre test covers the 3x3 pixels around it
+		c[i] -= 1.5f*(Abs(a[i]) + Abs(b[i]));
+	}
+
+	Simd4f zero = Simd4Splat(0.0f);
+	Simd4f depthv = Simd4Splat(depth);
+	Simd4f offsets = Simd4Set(0.5f, 1.5f, 2.5f, 3.5f);
+	for(y = y0; y <= y1; y++){
+		float *row = aDepth[y];
+		float py = y + 0.5f;
+		for(x = x0 & ~3; x <= x1; x += 4){
+			Simd4f px = Simd4Add(Simd4Splat((float)x), offsets);
+			int outside = 0;
+			for(i = 0; i < n; i++)
+				outside |= Simd4Less(Simd4Add(Simd4Mul(Simd4Splat(a[i]), px), Simd4Splat(b[i]*py + c[i])), zero);
+			int inside = ~outside & 15;
+			if(inside == 0)
+				continue;
+			Simd4f d = Simd4Max(depthv, Simd4Load(aLaneMask[inside]));
+			Simd4Store(row + x, Simd4Min(Simd4Load(row + x), d));
+		}
+	}
+}
+
+static void
+ProjectToBuffer(const CVector &v, CVector2D &out)
+{
+	out.x = OCCLUSION_WIDTH/2 + v.x/v.y * fScaleX;
+	out.y = OCCLUSION_HEIGHT/2 - v.z/v.y * fScaleY;
+}
+
+// Corners are numbered by bits, 1 for max x, 2 for max y, 4 for max z
+static const int aBoxFaces[6][4] = {
+	{ 0, 2, 6, 4 },	// -x
+	{ 1, 5, 7, 3 },	// +x
+	{ 0, 4, 5, 1 },	// -y
+	{ 2, 3, 7, 6 },	// +y
+	{ 0, 1, 3, 2 },	// -z
+	{ 4, 6, 7, 5 }	// +z
+};
+
+// Draws the faces of a box that point at the camera, each at the depth of its
+// furthest corner. corners are in camera space, y is the view direction.
+static void
+RasterizeBox(const CVector *corners)
+{
+	CVector axes[3], clipped[8];
+	CVector2D poly[8];
+	int f, i, n;
+
+	axes[0] = corners[1] - corners[0];
+	axes[1] = corners[2] - corners[0];
+	axes[2] = corners[4] - corners[0];
+	for(f = 0; f < 6; f++){
+		// outward normal is -axis for even faces, +axis for odd ones
+		float facing = DotProduct(axes[f/2], corners[aBoxFaces[f][0]]);
+		if(f & 1 ? facing >= 0.0f : facing <= 0.0f)
+			continue;
+
+		// clip to the near plane
+		n = 0;
+		for(i = 0; i < 4; i++){
+			const CVector &p = corners[aBoxFaces[f][i]];
+			const CVector &q = corners[aBoxFaces[f][(i+1)%4]];
+			if(p.y >= OCCLUSION_NEAR)
+				clipped[n++] = p;
+			if((p.y >= OCCLUSION_NEAR) != (q.y >= OCCLUSION_NEAR))
+				clipped[n++] = p + (q - p) * ((OCCLUSION_NEAR - p.y) / (q.y - p.y));
+		}
+		if(n < 3)
+			continue;
+		float depth = 0.0f;
+		for(i = 0; i < n; i++){
+			depth = Max(depth, clipped[i].y);
+			ProjectToBuffer(clipped[i], poly[i]);
+		}
+		RasterizePolygon(poly, n, depth);
+	}
+}
+
+static void
+RasterizeOccluder(CEntity *ent)
+{
+	tOccluderBox *box = GetOccluderBox(ent);
+	CMatrix mat = camMatrix * ent->GetMatrix();
+	CVector size = box->max - box->min;
+	CVector corners[8];
+	int nx, ny, ix, iy, i;
+
+	nx = Min((int)(size.x / OCCLUDER_SLICE) + 1, 4);
+	ny = Min((int)(size.y / OCCLUDER_SLICE) + 1, 4);
+	CVector ax = Multiply3x3(mat, CVector(size.x/nx, 0.0f, 0.0f));
+	CVector ay = Multiply3x3(mat, CVector(0.0f, size.y/ny, 0.0f));
+	CVector az = Multiply3x3(mat, CVector(0.0f, 0.0f, size.z));
+	CVector base = mat * box->min;
+	for(ix = 0; ix < nx; ix++)
+		for(iy = 0; iy < ny; iy++){
+			CVector origin = base + ax*(float)ix + ay*(float)iy;
+			for(i = 0; i < 8; i++)
+				corners[i] = origin + (i&1 ? ax : CVector(0.0f, 0.0f, 0.0f)) +
+					(i&2 ? ay : CVector(0.0f, 0.0f, 0.0f)) + (i&4 ? az : CVector(0.0f, 0.0f, 0.0f));
+			RasterizeBox(corners);
+		}
+}
+
+void
+COcclusionBuffer::Update(void)
+{
+	CPtrNode *node;
+	int x, y, x1, x2, y1, y2, i, l;
+
+	ms_nNumOccluders = 0;
+	ms_nNumCulled = 0;
+	if(!bUseOcclusion)
+		return;
+
+	if(!bLaneMaskReady){
+		for(i = 0; i < 16; i++)
+			for(l = 0; l < 4; l++)
+				aLaneMask[i][l] = i & (1<<l) ? 0.0f : FLT_MAX;
+		bLaneMaskReady = true;
+	}
+
+	RwV2d vw = *RwCameraGetViewWindow(TheCamera.m_pRwCamera);
+	camMatrix = TheCamera.GetCameraMatrix();
+	camPosition = TheCamera.GetPosition();
+	fScaleX = OCCLUSION_WIDTH/2 / (vw.x * OCCLUSION_MARGIN);
+	fScaleY = OCCLUSION_HEIGHT/2 / (vw.y * OCCLUSION_MARGIN);
+	for(y = 0; y < OCCLUSION_HEIGHT; y++)
+		for(x = 0; x < OCCLUSION_WIDTH; x++)
+			aDepth[y][x] = FLT_MAX;
+
+	nNumCandidates = 0;
+	CWorld::AdvanceCurrentScanCode();
+	x1 = Max(CWorld::GetSectorIndexX(camPosition.x - OCCLUDER_DISTANCE), 0);
+	x2 = Min(CWorld::GetSectorIndexX(camPosition.x + OCCLUDER_DISTANCE), NUMSECTORS_X-1);
+	y1 = Max(CWorld::GetSectorIndexY(camPosition.y - OCCLUDER_DISTANCE), 0);
+	y2 = Min(CWorld::GetSectorIndexY(camPosition.y + OCCLUDER_DISTANCE), NUMSECTORS_Y-1);
+	for(y = y1; y <= y2; y++)
+		for(x = x1; x <= x2; x++)
+			for(l = ENTITYLIST_BUILDINGS; l <= ENTITYLIST_BUILDINGS_OVERLAP; l++)
+				for(node = CWorld::GetSector(x, y)->m_lists[l].first; node; node = node->next){
+					CEntity *ent = (CEntity*)node->item;
+					if(ent->m_scanCode == CWorld::GetCurrentScanCode())
+						continue;
+					ent->m_scanCode = CWorld::GetCurrentScanCode();
+					AddCandidate(ent, false);
+				}
+	if(CCollision::ms_collisionInMemory != LEVEL_GENERIC)
+		for(node = CWorld::GetBigBuildingList(CCollision::ms_collisionInMemory).first; node; node = node->next)
+			AddCandidate((CEntity*)node->item, true);
+	for(node = CWorld::GetBigBuildingList(LEVEL_GENERIC).first; node; node = node->next)
+		AddCandidate((CEntity*)node->item, true);
+
+	// the ones that look biggest
+	qsort(aCandidates, nNumCandidates, sizeof(tOccluderCandidate), CompareCandidates);
+	ms_nNumOccluders = Min(nNumCandidates, MAX_OCCLUDERS);
+	for(i = 0; i < ms_nNumOccluders; i++)
+		RasterizeOccluder(aCandidates[i].ent);
+}
+
+bool
+COcclusionBuffer::IsOccluded(CEntity *ent)
+{
+	CVector corners[8];
+	float nearDepth, minx, maxx, miny, maxy;
+	int i, x, y, x0, x1, y0, y1;
+
+	if(ms_nNumOccluders == 0)
+		return false;
+
+	CColModel *col = CModelInfo::GetModelInfo(ent->GetModelIndex())->GetColModel();
+	CMatrix mat = camMatrix * ent->GetMatrix();
+	CVector size = col->boundingBox.max - col->boundingBox.min;
+	CVector ax = Multiply3x3(mat, CVector(size.x, 0.0f, 0.0f));
+	CVector ay = Multiply3x3(mat, CVector(0.0f, size.y, 0.0f));
+	CVector az = Multiply3x3(mat, CVector(0.0f, 0.0f, size.z));
+	CVector base = mat * col->boundingBox.min;
+
+	nearDepth = FLT_MAX;
+	minx = miny = FLT_MAX;
+	maxx = maxy = -FLT_MAX;
+	for(i = 0; i < 8; i++){
+		CVector2D p;
+		corners[i] = base;
+		if(i & 1) corners[i] += ax;
+		if(i & 2) corners[i] += ay;
+		if(i & 4) corners[i] += az;
+		if(corners[i].y < OCCLUSION_NEAR)
+			return false;
+		nearDepth = Min(nearDepth, corners[i].y);
+		ProjectToBuffer(corners[i], p);
+		minx = Min(minx, p.x);
+		maxx = Max(maxx, p.x);
+		miny = Min(miny, p.y);
+		maxy = Max(maxy, p.y);
+	}
+
+	// every pixel the box touches, the part off the buffer is off screen
+	x0 = Max((int)Floor(minx), 0);
+	x1 = Min((int)Floor(maxx), OCCLUSION_WIDTH-1);
+	y0 = Max((int)Floor(miny), 0);
+	y1 = Min((int)Floor(maxy), OCCLUSION_HEIGHT-1);
+	if(x0 > x1 || y0 > y1)
+		return false;
+
+	Simd4f nearv = Simd4Splat(nearDepth);
+	for(y = y0; y <= y1; y++){
+		const float *row = aDepth[y];
+		for(x = x0 & ~3; x <= x1; x += 4){
+			int lanes = 15;
+			if(x < x0) lanes &= 15 << (x0 - x);
+			if(x + 3 > x1) lanes &= 15 >> (x + 3 - x1);
+			if((Simd4Less(Simd4Load(row + x), nearv) & lanes) != lanes)
+				return false;
+		}
+	}
+	return true;
+}
+
+// The buffer over the screen, brighter is closer
+void
+COcclusionBuffer::DrawDebug(void)
+{
+	int x, y, start, shade, runShade;
+
+	float w = SCREEN_WIDTH * OCCLUSION_MARGIN / OCCLUSION_WIDTH;
+	float h = SCREEN_HEIGHT * OCCLUSION_MARGIN / OCCLUSION_HEIGHT;
+	float left = SCREEN_WIDTH/2 - w*OCCLUSION_WIDTH/2;
+	float top = SCREEN_HEIGHT/2 - h*OCCLUSION_HEIGHT/2;
+	for(y = 0; y < OCCLUSION_HEIGHT; y++){
+		start = 0;
+		runShade = -1;
+		for(x = 0; x <= OCCLUSION_WIDTH; x++){
+			shade = -1;
+			if(x < OCCLUSION_WIDTH && aDepth[y][x] != FLT_MAX)
+				shade = 16 * clamp(15 - (int)(aDepth[y][x] / (OCCLUDER_DISTANCE/8.0f)), 1, 15);
+			if(shade == runShade)
+				continue;
+			if(runShade != -1)
+				CSprite2d::DrawRect(CRect(left + start*w, top + y*h, left + x*w, top + (y+1)*h),
+					CRGBA(runShade, runShade, runShade, 160));
+			start = x;
+			runShade = shade;
+		}
+	}
+}
+#endif
@@ -0,0 +1,21 @@
+#pragma once
+
+// A small depth buffer the CPU fills with the solid cores of large buildings
+// in front of the camera before the render list is built. An entity whose
+// bounding box lies behind it at every pixel it covers is left out. Nothing
+// is written while the render list is built, so threads can test entities.
+
+class CEntity;
+
+class COcclusionBuffer
+{
+public:
+	static bool bUseOcclusion;
+	static bool bShowBuffer;
+	static int32 ms_nNumOccluders;	// this frame
+	static int32 ms_nNumCulled;	// this frame
+
+	static void Update(void);
+	static bool IsOccluded(CEntity *ent);
+	static void DrawDebug(void);
+};
@@ -1,4 +1,5 @@
 #include "common.h"
+#include <rpmatfx.h>
 
 #include "main.h"
 #include "Lights.h"
@@ -21,6 +22,10 @@
 #include "Renderer.h"
 #include "Frontend.h"
 #include "custompipes.h"
+#include "WorkerPool.h"
+#include "OcclusionBuffer.h"
+#include "instancing.h"
+#include "timebars.h"
 
 bool gbShowPedRoadGroups;
 bool gbShowCarRoadGroups;
@@ -52,6 +57,14 @@ CVector CRenderer::ms_vecCameraPosition;
 CVehicle *CRenderer::m_pFirstPersonVehicle;
 bool CRenderer::m_loadingPriority;
 float CRenderer::ms_lodDistScale = 1.2f;
+#ifdef PARALLEL_RENDER_LIST
+bool CRenderer::ms_bParallelScan = true;
+#endif
+#ifdef SORTED_RENDER_QUEUE
+bool CRenderer::ms_bSortRenderQueue = true;
+int32 CRenderer::ms_nStateChangesUnsorted;
+int32 CRenderer::ms_nStateChangesSorted;
+#endif
 
 void
 CRenderer::Init(void)
@@ -70,7 +83,9 @@ void
 CRenderer::PreRender(void)
 {
 	int i;
+#ifndef SORTED_ALPHA_ARRAYS
 	CLink<CVisibilityPlugins::AlphaObjectInfo> *node;
+#endif
 
 	for(i = 0; i < ms_nNoOfVisibleEntities; i++)
 		ms_aVisibleEntityPtrs[i]->PreRender();
@@ -82,10 +97,16 @@ CRenderer::PreRender(void)
 		ms_aInVisibleEntityPtrs[i]->PreRender();
 	}
 
+#ifdef SORTED_ALPHA_ARRAYS
+	// not sorted yet, the order doesn't matter here
+	for(i = 0; i < CVisibilityPlugins::m_alphaEntityList.num; i++)
+		CVisibilityPlugins::m_alphaEntityList.items[i].entity->PreRender();
+#else
 	for(node = CVisibilityPlugins::m_alphaEntityList.head.next;
 	    node != &CVisibilityPlugins::m_alphaEntityList.tail;
 	    node = node->next)
 		((CEntity*)node->item.entity)->PreRender();
+#endif
 
 	CHeli::SpecialHeliPreRender();
 	CShadows::RenderExtraPlayerShadows();
@@ -222,6 +243,101 @@ CRenderer::RenderRoads(void)
 	}
 }
 
+#ifdef SORTED_RENDER_QUEUE
+// Opaque entities are drawn in the order of a key that keeps what shares
+// render state together, most expensive switch first, near to far last.
+enum
+{
+	RENDERPIPE_DEFAULT,
+	RENDERPIPE_MATFX,
+	RENDERPIPE_CLUMP
+};
+
+#define RENDERKEY_PIPE_SHIFT 56
+#define RENDERKEY_TXD_SHIFT 40
+#define RENDERKEY_MODEL_SHIFT 24
+#define RENDERKEY_DEPTH_SHIFT 8
+#define RENDERKEY_DEPTH_SCALE 4.0f	// buckets per metre
+
+struct tRenderQueueEntry
+{
+	uint64 key;
+	CEntity *ent;
+};
+
+static tRenderQueueEntry aRenderQueue[NUMVISIBLEENTITIES];
+static int32 nNumRenderQueue;
+
+static uint64
+GetRenderKey(CEntity *e, float dist)
+{
+	uint64 pipe, txd, model, depth;
+
+	if(e->m_rwObject && RwObjectGetType(e->m_rwObject) == rpCLUMP)
+		pipe = RENDERPIPE_CLUMP;
+	else if(e->m_rwObject && RpMatFXAtomicQueryEffects((RpAtomic*)e->m_rwObject))
+		pipe = RENDERPIPE_MATFX;
+	else
+		pipe = RENDERPIPE_DEFAULT;
+	txd = (uint16)CModelInfo::GetModelInfo(e->GetModelIndex())->GetTxdSlot();
+	model = (uint16)e->GetModelIndex();
+	depth = Min((int32)(dist * RENDERKEY_DEPTH_SCALE), 0xFFFF);
+	return pipe << RENDERKEY_PIPE_SHIFT | txd << RENDERKEY_TXD_SHIFT |
+		model << RENDERKEY_MODEL_SHIFT | depth << RENDERKEY_DEPTH_SHIFT;
+}
+
+static int
+CompareRenderKeys(const void *a, const void *b)
+{
+	uint64 ka = ((tRenderQueueEntry*)a)->key;
+	uint64 kb = ((tRenderQueueEntry*)b)->key;
+	return ka < kb ? -1 : ka > kb ? 1 : 0;
+}
+
+// Pipeline, TXD and model switches between one draw and the next
+static int32
+CountStateChanges(void)
+{
+	static const uint64 fields[3] = {
+		(uint64)0xFF << RENDERKEY_PIPE_SHIFT,
+		(uint64)0xFFFF << RENDERKEY_TXD_SHIFT,
+		(uint64)0xFFFF << RENDERKEY_MODEL_SHIFT
+	};
+	int32 i, f, n;
+
+	n = 0;
+	for(i = 1; i < nNumRenderQueue; i++)
+		for(f = 0; f < 3; f++)
+			if((aRenderQueue[i].key & fields[f]) != (aRenderQueue[i-1].key & fields[f]))
+				n++;
+	return n;
+}
+
+static void
+RenderQueuedEntities(void)
+{
+	int32 i;
+	int32 unsorted, sorted;
+
+	unsorted = CountStateChanges();
+	if(CRenderer::ms_bSortRenderQueue){
+		qsort(aRenderQueue, nNumRenderQueue, sizeof(tRenderQueueEntry), CompareRenderKeys);
+		sorted = CountStateChanges();
+	}else
+		sorted = unsorted;
+	CRenderer::ms_nStateChangesUnsorted += unsorted;
+	CRenderer::ms_nStateChangesSorted += sorted;
+#ifdef TIMEBARS
+	tbCount("State chg scan order", unsorted);
+	tbCount("State chg sorted", sorted);
+#endif
+
+	for(i = 0; i < nNumRenderQueue; i++)
+		CRenderer::RenderOneNonRoad(aRenderQueue[i].ent);
+	nNumRenderQueue = 0;
+}
+#endif
+
 void
 CRenderer::RenderEverythingBarRoads(void)
 {
@@ -242,6 +358,10 @@ CRenderer::RenderEverythingBarRoads(void)
 		if(CustomPipes::bRenderingEnvMap && (e->IsPed() || e->IsVehicle()))
 			continue;
 #endif
+#ifdef INSTANCED_RENDERING
+		if(CInstancing::Add(e))
+			continue;
+#endif
 
 		if(e->IsVehicle() ||
 		   e->IsPed() && CVisibilityPlugins::GetClumpAlpha((RpClump*)e->m_rwObject) != 255){
@@ -257,9 +377,23 @@ CRenderer::RenderEverythingBarRoads(void)
 					RenderOneNonRoad(e);
 				}
 			}
-		}else
+		}else{
+#ifdef SORTED_RENDER_QUEUE
+			dist = ms_vecCameraPosition - e->GetPosition();
+			aRenderQueue[nNumRenderQueue].key = GetRenderKey(e, dist.Magnitude());
+			aRenderQueue[nNumRenderQueue].ent = e;
+			nNumRenderQueue++;
+#else
 			RenderOneNonRoad(e);
+#endif
+		}
 	}
+#ifdef SORTED_RENDER_QUEUE
+	RenderQueuedEntities();
+#endif
+#ifdef INSTANCED_RENDERING
+	CInstancing::Render();
+#endif
 }
 
 void
@@ -342,9 +476,103 @@ enum Visbility
 #define OTHERUNAVAILABLE (other != -1 && CModelInfo::GetModelInfo(other)->GetRwObject() == nil)
 #define CANTIMECULL (!OTHERUNAVAILABLE)
 
+#ifdef PARALLEL_RENDER_LIST
+enum
+{
+	SCAN_NORMAL,
+	SCAN_PRIORITY,
+	SCAN_SUBWAY
+};
+
+// What SetupEntityVisibility needs to know about an entity that takes time
+// to work out but doesn't change anything, filled in on the worker threads.
+struct tScanEntity
+{
+	CEntity *ent;
+	float dist;	// to the camera
+	RpAtomic *atomic;	// of a simple model for dist
+	RpAtomic *fadeAtomic;	// and for dist - FADE_DISTANCE
+	uint8 type;
+	bool cullZoneVisible;
+	bool onScreen;
+	bool occluded;	// on screen but behind the occluders
+};
+
+#define SCAN_BATCH_SIZE 4096
+#define SCAN_CHUNK_SIZE 64
+
+static tScanEntity aScanEntities[SCAN_BATCH_SIZE];
+static int32 nNumScanEntities;
+
+#define ENTITY_DIST (scan->dist)
+#define ENTITY_ONSCREEN (scan->onScreen)
+#define ENTITY_ATOMIC (scan->atomic)
+#define ENTITY_FADEATOMIC (scan->fadeAtomic)
+#define ENTITY_OCCLUDED (scan->occluded)
+
+void
+CRenderer::PrepareScanEntity(tScanEntity *scan)
+{
+	CEntity *ent = scan->ent;
+	CSimpleModelInfo *mi = (CSimpleModelInfo*)CModelInfo::GetModelInfo(ent->GetModelIndex());
+	bool simple = mi->GetModelType() == MITYPE_SIMPLE || mi->GetModelType() == MITYPE_TIME;
+	float dist;
+
+	scan->dist = (ent->GetPosition() - ms_vecCameraPosition).Magnitude();
+	scan->cullZoneVisible = scan->type == SCAN_SUBWAY || IsEntityCullZoneVisible(ent);
+	// clumps without an object have no bounds to test
+	scan->onScreen = ent->bIsVisible && (simple || ent->m_rwObject) && ent->GetIsOnScreen();
+#ifdef OCCLUSION_CULLING
+	scan->occluded = scan->onScreen && COcclusionBuffer::IsOccluded(ent);
+#else
+	scan->occluded = false;
+#endif
+	scan->atomic = nil;
+	scan->fadeAtomic = nil;
+	if(simple){
+		// as in SetupEntityVisibility, m_isDamaged is never set outside of it
+		dist = scan->dist;
+		if(LOD_DISTANCE + STREAM_DISTANCE < dist && dist < mi->GetLargestLodDistance())
+			dist = mi->GetLargestLodDistance();
+		bool damaged = ent->IsObject() && ent->bRenderDamaged;
+		scan->atomic = mi->GetAtomicFromDistance(dist, damaged);
+		if(scan->atomic == nil && !mi->m_noFade)
+			scan->fadeAtomic = mi->GetAtomicFromDistance(dist - FADE_DISTANCE, damaged);
+	}
+}
+
+void
+CRenderer::PrepareScanEntities(int32 start, int32 end, void *arg)
+{
+	for(int32 i = start; i < end; i++)
+		PrepareScanEntity(&aScanEntities[i]);
+}
+
 int32
 CRenderer::SetupEntityVisibility(CEntity *ent)
 {
+	tScanEntity scan;
+	scan.ent = ent;
+	scan.type = SCAN_NORMAL;
+	PrepareScanEntity(&scan);
+	return SetupEntityVisibility(&scan);
+}
+
+int32
+CRenderer::SetupEntityVisibility(tScanEntity *scan)
+{
+	CEntity *ent = scan->ent;
+#else
+#define ENTITY_DIST ((ent->GetPosition() - ms_vecCameraPosition).Magnitude())
+#define ENTITY_ONSCREEN (ent->GetIsOnScreen())
+#define ENTITY_ATOMIC (mi->GetAtomicFromDistance(dist))
+#define ENTITY_FADEATOMIC (mi->GetAtomicFromDistance(dist - FADE_DISTANCE))
+#define ENTITY_OCCLUDED (COcclusionBuffer::IsOccluded(ent))
+
+int32
+CRenderer::SetupEntityVisibility(CEntity *ent)
+{
+#endif
 	CSimpleModelInfo *mi = (CSimpleModelInfo*)CModelInfo::GetModelInfo(ent->m_modelIndex);
 	CTimeModelInfo *ti;
 	int32 other;
@@ -385,10 +613,16 @@ CRenderer::SetupEntityVisibility(CEntity *ent)
 			// All sorts of Clumps
 			if(ent->m_rwObject == nil || !ent->bIsVisible)
 				return VIS_INVISIBLE;
-			if(!ent->GetIsOnScreen())
+			if(!ENTITY_ONSCREEN)
 				return VIS_OFFSCREEN;
+#ifdef OCCLUSION_CULLING
+			if(ENTITY_OCCLUDED){
+				COcclusionBuffer::ms_nNumCulled++;
+				return VIS_OFFSCREEN;
+			}
+#endif
 			if(ent->bDrawLast){
-				dist = (ent->GetPosition() - ms_vecCameraPosition).Magnitude();
+				dist = ENTITY_DIST;
 				CVisibilityPlugins::InsertEntityIntoSortedList(ent, dist);
 				ent->bDistanceFade = false;
 				return VIS_INVISIBLE;
@@ -399,13 +633,13 @@ CRenderer::SetupEntityVisibility(CEntity *ent)
 		   ((CObject*)ent)->ObjectCreatedBy == TEMP_OBJECT){
 			if(ent->m_rwObject == nil || !ent->bIsVisible)
 				return VIS_INVISIBLE;
-			return ent->GetIsOnScreen() ? VIS_VISIBLE : VIS_OFFSCREEN;
+			return ENTITY_ONSCREEN ? VIS_VISIBLE : VIS_OFFSCREEN;
 		}
 	}
 
 	// Simple ModelInfo
 
-	dist = (ent->GetPosition() - ms_vecCameraPosition).Magnitude();
+	dist = ENTITY_DIST;
 
 	// This can only happen with multi-atomic models (e.g. railtracks)
 	// but why do we bump up the distance? can only be fading...
@@ -415,7 +649,7 @@ CRenderer::SetupEntityVisibility(CEntity *ent)
 	if(ent->IsObject() && ent->bRenderDamaged)
 		mi->m_isDamaged = true;
 
-	RpAtomic *a = mi->GetAtomicFromDistance(dist);
+	RpAtomic *a = ENTITY_ATOMIC;
 	if(a){
 		mi->m_isDamaged = false;
 		if(ent->m_rwObject == nil)
@@ -430,10 +664,17 @@ CRenderer::SetupEntityVisibility(CEntity *ent)
 		if(ent->m_rwObject == nil || !ent->bIsVisible)
 			return VIS_INVISIBLE;
 
-		if(!ent->GetIsOnScreen()){
+		if(!ENTITY_ONSCREEN){
+			mi->m_alpha = 255;
+			return VIS_OFFSCREEN;
+		}
+#ifdef OCCLUSION_CULLING
+		if(ENTITY_OCCLUDED){
 			mi->m_alpha = 255;
+			COcclusionBuffer::ms_nNumCulled++;
 			return VIS_OFFSCREEN;
 		}
+#endif
 
 		if(mi->m_alpha != 255){
 			CVisibilityPlugins::InsertEntityIntoSortedList(ent, dist);
@@ -461,7 +702,7 @@ CRenderer::SetupEntityVisibility(CEntity *ent)
 
 	// We might be fading
 
-	a = mi->GetAtomicFromDistance(dist - FADE_DISTANCE);
+	a = ENTITY_FADEATOMIC;
 	mi->m_isDamaged = false;
 	if(a == nil){
 		// request model
@@ -480,9 +721,15 @@ CRenderer::SetupEntityVisibility(CEntity *ent)
 	if(ent->m_rwObject == nil || !ent->bIsVisible)
 		return VIS_INVISIBLE;
 
-	if(!ent->GetIsOnScreen()){
+	if(!ENTITY_ONSCREEN){
 		mi->m_alpha = 255;
 		return VIS_OFFSCREEN;
+#ifdef OCCLUSION_CULLING
+	}else if(ENTITY_OCCLUDED){
+		mi->m_alpha = 255;
+		COcclusionBuffer::ms_nNumCulled++;
+		return VIS_OFFSCREEN;
+#endif
 	}else{
 		CVisibilityPlugins::InsertEntityIntoSortedList(ent, dist);
 		ent->bDistanceFade = true;
@@ -543,6 +790,12 @@ CRenderer::SetupBigBuildingVisibility(CEntity *ent)
 			RpAtomicSetGeometry(rwobj, RpAtomicGetGeometry(a), rpATOMICSAMEBOUNDINGSPHERE); // originally 5 (mistake?)
 		if(!ent->IsVisibleComplex())
 			return VIS_INVISIBLE;
+#ifdef OCCLUSION_CULLING
+		if(COcclusionBuffer::IsOccluded(ent)){
+			COcclusionBuffer::ms_nNumCulled++;
+			return VIS_INVISIBLE;
+		}
+#endif
 		if(mi->m_drawLast){
 			CVisibilityPlugins::InsertEntityIntoSortedList(ent, dist);
 			ent->bDistanceFade = false;
@@ -571,6 +824,12 @@ CRenderer::SetupBigBuildingVisibility(CEntity *ent)
 	RpAtomic *rwobj = (RpAtomic*)ent->m_rwObject;
 	if(RpAtomicGetGeometry(a) != RpAtomicGetGeometry(rwobj))
 		RpAtomicSetGeometry(rwobj, RpAtomicGetGeometry(a), rpATOMICSAMEBOUNDINGSPHERE); // originally 5 (mistake?)
+#ifdef OCCLUSION_CULLING
+	if(ent->IsVisibleComplex() && COcclusionBuffer::IsOccluded(ent)){
+		COcclusionBuffer::ms_nNumCulled++;
+		return VIS_INVISIBLE;
+	}
+#endif
 	if(ent->IsVisibleComplex())
 		CVisibilityPlugins::InsertEntityIntoSortedList(ent, dist);
 	return VIS_INVISIBLE;
@@ -582,6 +841,13 @@ CRenderer::ConstructRenderList(void)
 	ms_nNoOfVisibleEntities = 0;
 	ms_nNoOfInVisibleEntities = 0;
 	ms_vecCameraPosition = TheCamera.GetPosition();
+#ifdef SORTED_RENDER_QUEUE
+	ms_nStateChangesUnsorted = 0;
+	ms_nStateChangesSorted = 0;
+#endif
+#ifdef OCCLUSION_CULLING
+	COcclusionBuffer::Update();
+#endif
 	// TODO: blocked ranges, but unused
 	ScanWorld();
 }
@@ -617,6 +883,15 @@ CRenderer::ScanWorld(void)
 	CVector vectors[9];
 	RwMatrix *cammatrix;
 	RwV2d poly[3];
+#ifdef PARALLEL_RENDER_LIST
+	void (*scanList)(CPtrList *) = ms_bParallelScan ? CollectSectorList : ScanSectorList;
+	void (*scanListPriority)(CPtrList *) = ms_bParallelScan ? CollectSectorList_Priority : ScanSectorList_Priority;
+	void (*scanListSubway)(CPtrList *) = ms_bParallelScan ? CollectSectorList_Subway : ScanSectorList_Subway;
+#else
+	void (*scanList)(CPtrList *) = ScanSectorList;
+	void (*scanListPriority)(CPtrList *) = ScanSectorList_Priority;
+	void (*scanListSubway)(CPtrList *) = ScanSectorList_Subway;
+#endif
 
 	memset(vectors, 0, sizeof(vectors));
 	vectors[CORNER_FAR_TOPLEFT].x = -vw.x * f;
@@ -681,7 +956,10 @@ CRenderer::ScanWorld(void)
 		if(y2 >= NUMSECTORS_Y-1) y2 = NUMSECTORS_Y-1;
 		for(; x1 <= x2; x1++)
 			for(int y = y1; y <= y2; y++)
-				ScanSectorList(CWorld::GetSector(x1, y)->m_lists);
+				scanList(CWorld::GetSector(x1, y)->m_lists);
+#ifdef PARALLEL_RENDER_LIST
+		ScanCollectedEntities();
+#endif
 	}else{
 		CVehicle *train = FindPlayerTrain();
 		if(train && train->GetPosition().z < 0.0f){
@@ -691,7 +969,10 @@ CRenderer::ScanWorld(void)
 			poly[1].y = CWorld::GetSectorY(vectors[CORNER_LOD_LEFT].y);
 			poly[2].x = CWorld::GetSectorX(vectors[CORNER_LOD_RIGHT].x);
 			poly[2].y = CWorld::GetSectorY(vectors[CORNER_LOD_RIGHT].y);
-			ScanSectorPoly(poly, 3, ScanSectorList_Subway);
+			ScanSectorPoly(poly, 3, scanListSubway);
+#ifdef PARALLEL_RENDER_LIST
+			ScanCollectedEntities();
+#endif
 		}else{
 			if(f > LOD_DISTANCE){
 				// priority
@@ -701,7 +982,7 @@ CRenderer::ScanWorld(void)
 				poly[1].y = CWorld::GetSectorY(vectors[CORNER_PRIO_LEFT].y);
 				poly[2].x = CWorld::GetSectorX(vectors[CORNER_PRIO_RIGHT].x);
 				poly[2].y = CWorld::GetSectorY(vectors[CORNER_PRIO_RIGHT].y);
-				ScanSectorPoly(poly, 3, ScanSectorList_Priority);
+				ScanSectorPoly(poly, 3, scanListPriority);
 
 				// below LOD
 				poly[0].x = CWorld::GetSectorX(vectors[CORNER_CAM].x);
@@ -710,7 +991,7 @@ CRenderer::ScanWorld(void)
 				poly[1].y = CWorld::GetSectorY(vectors[CORNER_LOD_LEFT].y);
 				poly[2].x = CWorld::GetSectorX(vectors[CORNER_LOD_RIGHT].x);
 				poly[2].y = CWorld::GetSectorY(vectors[CORNER_LOD_RIGHT].y);
-				ScanSectorPoly(poly, 3, ScanSectorList);
+				ScanSectorPoly(poly, 3, scanList);
 			}else{
 				poly[0].x = CWorld::GetSectorX(vectors[CORNER_CAM].x);
 				poly[0].y = CWorld::GetSectorY(vectors[CORNER_CAM].y);
@@ -718,8 +999,11 @@ CRenderer::ScanWorld(void)
 				poly[1].y = CWorld::GetSectorY(vectors[CORNER_FAR_TOPLEFT].y);
 				poly[2].x = CWorld::GetSectorX(vectors[CORNER_FAR_TOPRIGHT].x);
 				poly[2].y = CWorld::GetSectorY(vectors[CORNER_FAR_TOPRIGHT].y);
-				ScanSectorPoly(poly, 3, ScanSectorList);
+				ScanSectorPoly(poly, 3, scanList);
 			}
+#ifdef PARALLEL_RENDER_LIST
+			ScanCollectedEntities();
+#endif
 #ifdef NO_ISLAND_LOADING
 			if (CMenuManager::m_PrefsIslandLoading == CMenuManager::ISLAND_LOADING_HIGH) {
 				ScanBigBuildingList(CWorld::GetBigBuildingList(LEVEL_INDUSTRIAL));
@@ -1146,6 +1430,105 @@ CRenderer::ScanSectorList_RequestModels(CPtrList *lists)
 	}
 }
 
+#ifdef PARALLEL_RENDER_LIST
+// Instead of setting up the entities of a sector right away these only note
+// them, in the same order and with the same scan codes ScanSectorList would.
+void
+CRenderer::CollectSectorEntities(CPtrList *lists, int32 type)
+{
+	CPtrNode *node;
+	CEntity *ent;
+	int i;
+
+	for(i = 0; i < NUMSECTORENTITYLISTS; i++)
+		for(node = lists[i].first; node; node = node->next){
+			ent = (CEntity*)node->item;
+			if(ent->m_scanCode == CWorld::GetCurrentScanCode())
+				continue;	// already seen
+			ent->m_scanCode = CWorld::GetCurrentScanCode();
+			if(nNumScanEntities == SCAN_BATCH_SIZE)
+				ScanCollectedEntities();
+			aScanEntities[nNumScanEntities].ent = ent;
+			aScanEntities[nNumScanEntities].type = type;
+			nNumScanEntities++;
+		}
+}
+
+void
+CRenderer::CollectSectorList(CPtrList *lists)
+{
+	CollectSectorEntities(lists, SCAN_NORMAL);
+}
+
+void
+CRenderer::CollectSectorList_Priority(CPtrList *lists)
+{
+	CollectSectorEntities(lists, SCAN_PRIORITY);
+}
+
+void
+CRenderer::CollectSectorList_Subway(CPtrList *lists)
+{
+	CollectSectorEntities(lists, SCAN_SUBWAY);
+}
+
+// The workers fill in their share of the entities, then the main thread goes
+// through all of them in the order they were collected and does what
+// ScanSectorList, ScanSectorList_Priority and ScanSectorList_Subway would.
+// Fading, model requests, RW objects and the lists are only touched here, so
+// the render lists come out the same as without threads.
+void
+CRenderer::ScanCollectedEntities(void)
+{
+	tScanEntity *scan;
+	CEntity *ent;
+	int32 i;
+	float dx, dy;
+
+	CWorkerPool::ParallelFor(nNumScanEntities, SCAN_CHUNK_SIZE, PrepareScanEntities, nil);
+
+	for(i = 0; i < nNumScanEntities; i++){
+		scan = &aScanEntities[i];
+		ent = scan->ent;
+		if(scan->cullZoneVisible)
+			switch(SetupEntityVisibility(scan)){
+			case VIS_VISIBLE:
+				ms_aVisibleEntityPtrs[ms_nNoOfVisibleEntities++] = ent;
+				break;
+			case VIS_INVISIBLE:
+				if(scan->type == SCAN_SUBWAY || !IsGlass(ent->GetModelIndex()))
+					break;
+				// fall through
+			case VIS_OFFSCREEN:
+				dx = ms_vecCameraPosition.x - ent->GetPosition().x;
+				dy = ms_vecCameraPosition.y - ent->GetPosition().y;
+				if(dx > -65.0f && dx < 65.0f &&
+				   dy > -65.0f && dy < 65.0f &&
+				   ms_nNoOfInVisibleEntities < NUMINVISIBLEENTITIES - 1)
+					ms_aInVisibleEntityPtrs[ms_nNoOfInVisibleEntities++] = ent;
+				break;
+			case VIS_STREAMME:
+				if(scan->type == SCAN_SUBWAY || CStreaming::ms_disableStreaming)
+					break;
+				if(scan->type == SCAN_PRIORITY){
+					CStreaming::RequestModel(ent->GetModelIndex(), 0);
+					if(CStreaming::ms_aInfoForModel[ent->GetModelIndex()].m_loadState != STREAMSTATE_LOADED)
+						m_loadingPriority = true;
+				}else if(!m_loadingPriority || CStreaming::ms_numModelsRequested < 10)
+					CStreaming::RequestModel(ent->GetModelIndex(), 0);
+				break;
+			}
+		else if(ent->IsBuilding() && ((CBuilding*)ent)->GetIsATreadable()){
+			if(!CStreaming::ms_disableStreaming)
+				if(SetupEntityVisibility(scan) == VIS_STREAMME)
+					if(scan->type == SCAN_PRIORITY || !m_loadingPriority || CStreaming::ms_numModelsRequested < 10)
+						CStreaming::RequestModel(ent->GetModelIndex(), 0);
+		}
+	}
+	nNumScanEntities = 0;
+}
+#endif
+
 // Put big buildings in front
 // This seems pointless because the sector lists shouldn't have big buildings in the first place
 void
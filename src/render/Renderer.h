@@ -17,6 +17,9 @@ extern bool gbDontRenderVehicles;
 
 class CVehicle;
 class CPtrList;
+#ifdef PARALLEL_RENDER_LIST
+struct tScanEntity;
+#endif
 
 class CRenderer
 {
@@ -28,9 +31,23 @@ class CRenderer
 	static CVector ms_vecCameraPosition;
 	static CVehicle *m_pFirstPersonVehicle;
 
+#ifdef PARALLEL_RENDER_LIST
+	static void PrepareScanEntity(tScanEntity *scan);
+	static void PrepareScanEntities(int32 start, int32 end, void *arg);
+	static void CollectSectorEntities(CPtrList *lists, int32 type);
+#endif
+
 public:
 	static float ms_lodDistScale;
 	static bool m_loadingPriority;
+#ifdef PARALLEL_RENDER_LIST
+	static bool ms_bParallelScan;
+#endif
+#ifdef SORTED_RENDER_QUEUE
+	static bool ms_bSortRenderQueue;
+	static int32 ms_nStateChangesUnsorted;	// this frame, in scan order
+	static int32 ms_nStateChangesSorted;	// this frame, as drawn
+#endif
 
 	static void Init(void);
 	static void Shutdown(void);
@@ -48,6 +65,9 @@ public:
 	static void RenderCollisionLines(void);
 
 	static int32 SetupEntityVisibility(CEntity *ent);
+#ifdef PARALLEL_RENDER_LIST
+	static int32 SetupEntityVisibility(tScanEntity *scan);
+#endif
 	static int32 SetupBigBuildingVisibility(CEntity *ent);
 
 	static void ConstructRenderList(void);
@@ -59,6 +79,12 @@ public:
 	static void ScanSectorList_Priority(CPtrList *lists);
 	static void ScanSectorList_Subway(CPtrList *lists);
 	static void ScanSectorList_RequestModels(CPtrList *lists);
+#ifdef PARALLEL_RENDER_LIST
+	static void CollectSectorList(CPtrList *lists);
+	static void CollectSectorList_Priority(CPtrList *lists);
+	static void CollectSectorList_Subway(CPtrList *lists);
+	static void ScanCollectedEntities(void);
+#endif
 
 	static void SortBIGBuildings(void);
 	static void SortBIGBuildingsForSectorList(CPtrList *list);
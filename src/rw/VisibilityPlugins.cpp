@@ -12,8 +12,14 @@
 
 #define FADE_DISTANCE 20.0f
 
+#ifdef SORTED_ALPHA_ARRAYS
+CVisibilityPlugins::AlphaObjectArray CVisibilityPlugins::m_alphaList;
+CVisibilityPlugins::AlphaObjectArray CVisibilityPlugins::m_alphaEntityList;
+int32 CVisibilityPlugins::ms_nAlphaListOverflows;
+#else
 CLinkList<CVisibilityPlugins::AlphaObjectInfo> CVisibilityPlugins::m_alphaList;
 CLinkList<CVisibilityPlugins::AlphaObjectInfo> CVisibilityPlugins::m_alphaEntityList;
+#endif
 
 int32 CVisibilityPlugins::ms_atomicPluginOffset = -1;
 int32 CVisibilityPlugins::ms_framePluginOffset = -1;
@@ -31,20 +37,128 @@ float CVisibilityPlugins::ms_pedLod0Dist;
 float CVisibilityPlugins::ms_pedLod1Dist;
 float CVisibilityPlugins::ms_pedFadeDist;
 
+#ifdef SORTED_ALPHA_ARRAYS
+void
+CVisibilityPlugins::AlphaObjectArray::Init(int32 size)
+{
+	items = new AlphaObjectInfo[size];
+	scratch = new AlphaObjectInfo[size];
+	capacity = size;
+	Clear();
+}
+
+void
+CVisibilityPlugins::AlphaObjectArray::Shutdown(void)
+{
+	delete[] items;
+	delete[] scratch;
+	items = nil;
+	scratch = nil;
+	capacity = 0;
+	Clear();
+}
+
+// Where the old list would have given up and the object was drawn unsorted
+void
+CVisibilityPlugins::AlphaObjectArray::Add(const AlphaObjectInfo &item)
+{
+	AlphaObjectInfo *grown;
+
+	if(num == capacity){
+		grown = new AlphaObjectInfo[capacity*2];
+		memcpy(grown, items, num*sizeof(AlphaObjectInfo));
+		delete[] items;
+		delete[] scratch;
+		items = grown;
+		scratch = new AlphaObjectInfo[capacity*2];
+		capacity *= 2;
+		ms_nAlphaListOverflows++;
+		debug("alpha list full, grown to %d\n", capacity);
+	}
+	items[num++] = item;
+	sorted = false;
+}
+
+// Bits of the float that sort like it, inverted so the farthest comes first
+static inline uint32
+FarToNearKey(float f)
+{
+	uint32 u;
+	memcpy(&u, &f, sizeof(u));
+	u ^= (u & 0x80000000) ? 0xFFFFFFFF : 0x80000000;
+	return ~u;
+}
+
+// Both sorts are stable, so objects at the same distance are drawn in the
+// order they were added, as they were from the linked lists
+void
+CVisibilityPlugins::AlphaObjectArray::Sort(void)
+{
+	uint32 count[4][256];
+	uint32 key, sum, n;
+	AlphaObjectInfo item, *tmp;
+	int32 i, j, pass;
+
+	if(sorted)
+		return;
+	sorted = true;
+
+	if(num <= 16){
+		for(i = 1; i < num; i++){
+			item = items[i];
+			for(j = i; j > 0 && items[j-1].sort < item.sort; j--)
+				items[j] = items[j-1];
+			items[j] = item;
+		}
+		return;
+	}
+
+	memset(count, 0, sizeof(count));
+	for(i = 0; i < num; i++){
+		key = FarToNearKey(items[i].sort);
+		for(pass = 0; pass < 4; pass++)
+			count[pass][(key >> pass*8) & 0xFF]++;
+	}
+	for(pass = 0; pass < 4; pass++){
+		// skip bytes that are the same for everything, usually the top one
+		key = FarToNearKey(items[0].sort);
+		if(count[pass][(key >> pass*8) & 0xFF] == (uint32)num)
+			continue;
+		sum = 0;
+		for(i = 0; i < 256; i++){
+			n = count[pass][i];
+			count[pass][i] = sum;
+			sum += n;
+		}
+		for(i = 0; i < num; i++){
+			key = FarToNearKey(items[i].sort);
+			scratch[count[pass][(key >> pass*8) & 0xFF]++] = items[i];
+		}
+		tmp = items;
+		items = scratch;
+		scratch = tmp;
+	}
+}
+#endif
+
 void
 CVisibilityPlugins::Initialise(void)
 {
 	m_alphaList.Init(NUMALPHALIST);
+#ifndef SORTED_ALPHA_ARRAYS
 	m_alphaList.head.item.sort = 0.0f;
 	m_alphaList.tail.item.sort = 100000000.0f;
+#endif
 #ifdef ASPECT_RATIO_SCALE
 	// default 150 if not enough for bigger FOVs
 	m_alphaEntityList.Init(NUMALPHAENTITYLIST * 3);
 #else
 	m_alphaEntityList.Init(NUMALPHAENTITYLIST);
 #endif // ASPECT_RATIO_SCALE
+#ifndef SORTED_ALPHA_ARRAYS
 	m_alphaEntityList.head.item.sort = 0.0f;
 	m_alphaEntityList.tail.item.sort = 100000000.0f;
+#endif
 }
 
 void
@@ -66,10 +180,15 @@ CVisibilityPlugins::InsertEntityIntoSortedList(CEntity *e, float dist)
 	AlphaObjectInfo item;
 	item.entity = e;
 	item.sort = dist;
+#ifdef SORTED_ALPHA_ARRAYS
+	m_alphaEntityList.Add(item);
+	return true;
+#else
 	bool ret = !!m_alphaEntityList.InsertSorted(item);
 //	if(!ret)
 //		printf("list full %d\n", m_alphaEntityList.Count());
 	return ret;
+#endif
 }
 
 void
@@ -84,10 +203,15 @@ CVisibilityPlugins::InsertAtomicIntoSortedList(RpAtomic *a, float dist)
 	AlphaObjectInfo item;
 	item.atomic = a;
 	item.sort = dist;
+#ifdef SORTED_ALPHA_ARRAYS
+	m_alphaList.Add(item);
+	return true;
+#else
 	bool ret = !!m_alphaList.InsertSorted(item);
 //	if(!ret)
 //		printf("list full %d\n", m_alphaList.Count());
 	return ret;
+#endif
 }
 
 void
@@ -129,22 +253,37 @@ SetTextureCB(RpMaterial *material, void *data)
 void
 CVisibilityPlugins::RenderAlphaAtomics(void)
 {
+#ifdef SORTED_ALPHA_ARRAYS
+	int32 i;
+	m_alphaList.Sort();
+	for(i = 0; i < m_alphaList.num; i++)
+		AtomicDefaultRenderCallBack(m_alphaList.items[i].atomic);
+#else
 	CLink<AlphaObjectInfo> *node;
 	for(node = m_alphaList.tail.prev;
 	    node != &m_alphaList.head;
 	    node = node->prev)
 		AtomicDefaultRenderCallBack(node->item.atomic);
+#endif
 }
 
 void
 CVisibilityPlugins::RenderFadingEntities(void)
 {
-	CLink<AlphaObjectInfo> *node;
 	CSimpleModelInfo *mi;
+#ifdef SORTED_ALPHA_ARRAYS
+	int32 i;
+	m_alphaEntityList.Sort();
+	for(i = 0; i < m_alphaEntityList.num; i++){
+		AlphaObjectInfo *item = &m_alphaEntityList.items[i];
+#else
+	CLink<AlphaObjectInfo> *node;
 	for(node = m_alphaEntityList.tail.prev;
 	    node != &m_alphaEntityList.head;
 	    node = node->prev){
-		CEntity *e = node->item.entity;
+		AlphaObjectInfo *item = &node->item;
+#endif
+		CEntity *e = item->entity;
 		if(e->m_rwObject == nil)
 			continue;
 #ifdef EXTENDED_PIPELINES
@@ -163,7 +302,7 @@ CVisibilityPlugins::RenderFadingEntities(void)
 			DeActivateDirectional();
 			SetAmbientColours();
 			e->bImBeingRendered = true;
-			RenderFadingAtomic((RpAtomic*)e->m_rwObject, node->item.sort);
+			RenderFadingAtomic((RpAtomic*)e->m_rwObject, item->sort);
 			e->bImBeingRendered = false;
 		}else
 			CRenderer::RenderOneNonRoad(e);
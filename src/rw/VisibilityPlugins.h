@@ -20,8 +20,29 @@ public:
 		float sort;
 	};
 
+#ifdef SORTED_ALPHA_ARRAYS
+	// Appended to in any order, sorted far to near once before it's drawn
+	struct AlphaObjectArray
+	{
+		AlphaObjectInfo *items;
+		AlphaObjectInfo *scratch;
+		int32 num;
+		int32 capacity;
+		bool sorted;
+
+		void Init(int32 size);
+		void Shutdown(void);
+		void Clear(void) { num = 0; sorted = true; }
+		void Add(const AlphaObjectInfo &item);
+		void Sort(void);
+	};
+	static AlphaObjectArray m_alphaList;
+	static AlphaObjectArray m_alphaEntityList;
+	static int32 ms_nAlphaListOverflows;	// times a list was full and grew
+#else
 	static CLinkList<AlphaObjectInfo> m_alphaList;
 	static CLinkList<AlphaObjectInfo> m_alphaEntityList;
+#endif
 	static RwCamera *ms_pCamera;
 	static RwV3d *ms_pCameraPosn;
 	static float ms_cullCompsDist;
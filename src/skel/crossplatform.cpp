@@ -129,6 +129,142 @@ FILE* _fcaseopen(char const* filename, char const* mode)
     return result;
 }
 
+#ifdef CASEPATH_CACHE
+#include <pthread.h>
+
+// Listings of the directories casepath went through, sorted case-insensitively.
+// A directory is found by device and inode, so chdir doesn't matter, and read
+// again once its mtime moves. A listing made in the second the directory last
+// changed isn't trusted, as mtime can't tell later changes in that second apart.
+struct tCaseDir
+{
+	dev_t dev;
+	ino_t ino;
+	time_t mtime;
+	time_t scanTime;
+	int numNames;
+	char **names;
+	char *nameBuf;
+};
+
+static tCaseDir *aCaseDirs;
+static int nNumCaseDirs;
+static int nMaxCaseDirs;
+static pthread_mutex_t caseDirMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int nCaseLookups;	// path components looked up in a directory
+static int nCaseScans;	// directories read
+static int nCaseScansSaved;	// lookups answered by a listing in the cache instead of reading the directory
+
+static int
+CompareCaseNames(const void *a, const void *b)
+{
+	return strcasecmp(*(char**)a, *(char**)b);
+}
+
+static int
+CompareCaseName(const void *key, const void *name)
+{
+	return strcasecmp((const char*)key, *(char**)name);
+}
+
+static bool
+ScanCaseDir(tCaseDir *dir, const char *path)
+{
+	DIR *d;
+	struct dirent *e;
+	int i, numNames, bufSize, bufUsed;
+
+	d = opendir(path);
+	if(d == nil)
+		return false;
+	nCaseScans++;
+	free(dir->names);
+	free(dir->nameBuf);
+	numNames = 0;
+	bufSize = 1024;
+	bufUsed = 0;
+	dir->nameBuf = (char*)malloc(bufSize);
+	while((e = readdir(d)) != nil){
+		int len = strlen(e->d_name) + 1;
+		if(bufUsed + len > bufSize){
+			bufSize = bufSize*2 + len;
+			dir->nameBuf = (char*)realloc(dir->nameBuf, bufSize);
+		}
+		strcpy(dir->nameBuf + bufUsed, e->d_name);
+		bufUsed += len;
+		numNames++;
+	}
+	closedir(d);
+
+	// names point into the buffer only now that it's done moving
+	dir->names = (char**)malloc(Max(numNames, 1) * sizeof(char*));
+	bufUsed = 0;
+	for(i = 0; i < numNames; i++){
+		dir->names[i] = dir->nameBuf + bufUsed;
+		bufUsed += strlen(dir->names[i]) + 1;
+	}
+	qsort(dir->names, numNames, sizeof(char*), CompareCaseNames);
+	dir->numNames = numNames;
+	dir->scanTime = time(nil);
+	return true;
+}
+
+// Copies the real name of a file in the directory at path to out.
+// -1 if path is no directory, 0 if no file matches
+static int
+FindCaseName(const char *path, const char *name, char *out)
+{
+	struct stat st;
+	tCaseDir *dir;
+	char **found;
+	int i;
+
+	if(stat(path, &st) == -1 || !S_ISDIR(st.st_mode))
+		return -1;
+
+	pthread_mutex_lock(&caseDirMutex);
+	nCaseLookups++;
+	for(i = 0; i < nNumCaseDirs; i++)
+		if(aCaseDirs[i].ino == st.st_ino && aCaseDirs[i].dev == st.st_dev)
+			break;
+	if(i == nNumCaseDirs){
+		if(nNumCaseDirs == nMaxCaseDirs){
+			nMaxCaseDirs = Max(nMaxCaseDirs*2, 32);
+			aCaseDirs = (tCaseDir*)realloc(aCaseDirs, nMaxCaseDirs * sizeof(tCaseDir));
+		}
+		dir = &aCaseDirs[nNumCaseDirs++];
+		memset(dir, 0, sizeof(tCaseDir));
+		dir->dev = st.st_dev;
+		dir->ino = st.st_ino;
+		dir->mtime = -1;
+	}else
+		dir = &aCaseDirs[i];
+
+	if(dir->mtime != st.st_mtime || dir->scanTime <= dir->mtime){
+		dir->mtime = st.st_mtime;
+		if(!ScanCaseDir(dir, path)){
+			dir->mtime = -1;
+			pthread_mutex_unlock(&caseDirMutex);
+			return -1;
+		}
+	}else
+		nCaseScansSaved++;
+
+	found = (char**)bsearch(name, dir->names, dir->numNames, sizeof(char*), CompareCaseName);
+	if(found)
+		strcpy(out, *found);
+	pthread_mutex_unlock(&caseDirMutex);
+	return found != nil;
+}
+
+void casepath_report(void)
+{
+	printf("casepath: %d lookups, %d directories read, %d directory reads saved by the cache\n",
+		nCaseLookups, nCaseScans, nCaseScansSaved);
+}
+#endif
+
 // Case-insensitivity on linux (from https://github.com/OneSadCookie/fcaseopen)
 // Returned string should freed manually (if exists)
 char* casepath(char const* path, bool checkPathFirst)
@@ -148,14 +284,24 @@ char* casepath(char const* path, bool checkPathFirst)
 
     size_t rl = 0;
 
+#ifdef CASEPATH_CACHE
+    // the directory to look in is what's in out so far
+    if (p[0] == '/' || p[0] == '\\')
+    {
+        out[0] = 0;
+    }
+#else
     DIR* d;
     if (p[0] == '/' || p[0] == '\\')
     {
         d = opendir("/");
     }
+#endif
     else
     {
+#ifndef CASEPATH_CACHE
         d = opendir(".");
+#endif
         out[0] = '.';
         out[1] = 0;
         rl = 1;
@@ -186,6 +332,25 @@ char* casepath(char const* path, bool checkPathFirst)
             continue;
         }
 
+#ifdef CASEPATH_CACHE
+        out[rl - 1] = 0;
+        int found = FindCaseName(rl == 1 ? "/" : out, c, out + rl);
+        out[rl - 1] = '/';
+        if (found == 1)
+        {
+            int reportedLen = (int)strlen(out + rl);
+            rl += reportedLen;
+            assert(reportedLen == strlen(c) && "casepath: This is not good at all");
+            continue;
+        }
+        // No match, or it wasn't a folder, permission error, I/O error etc.
+        // Add original name and continue converting further slashes.
+        if (found == 0)
+            printf("casepath couldn't find dir/file \"%s\", full path was %s\n", c, path);
+        strcpy(out + rl, c);
+        rl += strlen(c);
+        cantProceed = true;
+#else
         struct dirent* e;
         while (e = readdir(d))
         {
@@ -216,9 +381,12 @@ char* casepath(char const* path, bool checkPathFirst)
             rl += strlen(c);
             cantProceed = true;
         }
+#endif
     }
 
+#ifndef CASEPATH_CACHE
     if (d) closedir(d);
+#endif
     if (mayBeTrailingSlash) {
         out[rl] = '/';  rl += 1;
         out[rl] = '\0';
@@ -46,6 +46,9 @@ extern long _dwOperatingSystemVersion;
 char *casepath(char const *path, bool checkPathFirst = true);
 FILE *_fcaseopen(char const *filename, char const *mode);
 #define fcaseopen _fcaseopen
+#ifdef CASEPATH_CACHE
+void casepath_report(void);
+#endif
 #endif
 
 #ifdef RW_GL3
@@ -10,6 +10,9 @@
 
 #include "skeleton.h"
 #include "platform.h"
+#ifdef MAPPED_CD_IMAGES
+#include "CdStream.h"
+#endif
 
 
 
@@ -166,6 +169,14 @@ rsPreInitCommandLine(RwChar *arg)
 		return TRUE;
 	}
 #endif
+#ifdef MAPPED_CD_IMAGES
+	if (!strcmp(arg, RWSTRING("-mmapimg")))
+	{
+		gbCdStreamMapImages = true;
+
+		return TRUE;
+	}
+#endif
 	return FALSE;
 }
 
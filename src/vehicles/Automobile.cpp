@@ -3164,8 +3164,10 @@ CAutomobile::RcbanditCheck1CarWheels(CPtrList &list)
 void
 CAutomobile::PlaceOnRoadProperly(void)
 {
+#ifndef LINE_OF_SIGHT_BATCHES
 	CColPoint point;
 	CEntity *entity;
+#endif
 	CColModel *colModel = GetColModel();
 	float lenFwd, lenBack;
 	float frontZ, rearZ;
@@ -3176,6 +3178,29 @@ CAutomobile::PlaceOnRoadProperly(void)
 	CVector front(GetPosition().x + GetForward().x*lenFwd,
 	              GetPosition().y + GetForward().y*lenFwd,
 	              GetPosition().z + 5.0f);
+	CVector rear(GetPosition().x - GetForward().x*lenBack,
+	             GetPosition().y - GetForward().y*lenBack,
+	             GetPosition().z + 5.0f);
+#ifdef LINE_OF_SIGHT_BATCHES
+	CColLine lines[2];
+	CColPoint points[2];
+	CEntity *entities[2];
+	lines[0].Set(front, CVector(front.x, front.y, GetPosition().z - 5.0f));
+	lines[1].Set(rear, CVector(rear.x, rear.y, GetPosition().z - 5.0f));
+	CWorld::ProcessVerticalLineBatch(2, lines, points, entities, true, false, false, false, false, false);
+	if(entities[0]){
+		frontZ = points[0].point.z;
+		m_pCurGroundEntity = entities[0];
+	}else{
+		frontZ = m_fMapObjectHeightAhead;
+	}
+	if(entities[1]){
+		rearZ = points[1].point.z;
+		m_pCurGroundEntity = entities[1];
+	}else{
+		rearZ = m_fMapObjectHeightBehind;
+	}
+#else
 	if(CWorld::ProcessVerticalLine(front, GetPosition().z - 5.0f, point, entity,
 			true, false, false, false, false, false, nil)){
 		frontZ = point.point.z;
@@ -3184,9 +3209,6 @@ CAutomobile::PlaceOnRoadProperly(void)
 		frontZ = m_fMapObjectHeightAhead;
 	}
 
-	CVector rear(GetPosition().x - GetForward().x*lenBack,
-	             GetPosition().y - GetForward().y*lenBack,
-	             GetPosition().z + 5.0f);
 	if(CWorld::ProcessVerticalLine(rear, GetPosition().z - 5.0f, point, entity,
 			true, false, false, false, false, false, nil)){
 		rearZ = point.point.z;
@@ -3194,6 +3216,7 @@ CAutomobile::PlaceOnRoadProperly(void)
 	}else{
 		rearZ = m_fMapObjectHeightBehind;
 	}
+#endif
 
 	float len = lenFwd + lenBack;
 	float angle = Atan((frontZ - rearZ)/len);